@@ -15,6 +15,35 @@ extern "C"
 //----------------------------------------------------------------------------//
 //                                  CMT                                       //
 //----------------------------------------------------------------------------//
+/* Coarse-to-fine CMT location and depth search */
+int core_cmt_adaptiveGridSearch(const int l1,
+                                const int nlats, const int nlons,
+                                const int ndeps,
+                                const int nrefine, const int maxEvals,
+                                const int verbose,
+                                const bool deviatoric,
+                                const double utmSrcEasting,
+                                const double utmSrcNorthing,
+                                const double dx, const double dy,
+                                const double *__restrict__ srcDepths,
+                                const double *__restrict__ utmRecvEasting,
+                                const double *__restrict__ utmRecvNorthing,
+                                const double *__restrict__ staAlt,
+                                const double *__restrict__ nObsOffset,
+                                const double *__restrict__ eObsOffset,
+                                const double *__restrict__ uObsOffset,
+                                const double *__restrict__ nWts,
+                                const double *__restrict__ eWts,
+                                const double *__restrict__ uWts,
+                                int *nevals, int *iopt,
+                                double *__restrict__ evalEastings,
+                                double *__restrict__ evalNorthings,
+                                double *__restrict__ evalDepths,
+                                double *__restrict__ mts,
+                                double *__restrict__ objfn,
+                                double *__restrict__ nEst,
+                                double *__restrict__ eEst,
+                                double *__restrict__ uEst);
 /* Decompose a moment tensor */
 int core_cmt_decomposeMomentTensor(const int nmt,
                                    const double *__restrict__ M,
@@ -26,6 +55,48 @@ int core_cmt_decomposeMomentTensor(const int nmt,
                                    double *__restrict__ dip2,
                                    double *__restrict__ rake1,
                                    double *__restrict__ rake2);
+/* Decompose many moment tensors with a preallocated workspace */
+#define CMT_DECOMP_LWORK 19 /*!< Workspace length per moment tensor in
+                                 core_cmt_decomposeMomentTensor_work */
+int core_cmt_decomposeMomentTensor_work(const int nmt,
+                                        const double *__restrict__ M,
+                                        const int lwork,
+                                        double *__restrict__ work,
+                                        double *__restrict__ DC_pct,
+                                        double *__restrict__ Mw,
+                                        double *__restrict__ strike1,
+                                        double *__restrict__ strike2,
+                                        double *__restrict__ dip1,
+                                        double *__restrict__ dip2,
+                                        double *__restrict__ rake1,
+                                        double *__restrict__ rake2);
+/* CMT depth grid search with cached Green's functions */
+int core_cmt_cachedDepthGridSearch(struct GFAST_cmtGreensCache_struct *cache,
+                                   const int nsites,
+                                   const bool *__restrict__ luse,
+                                   const int l1, const int ndeps,
+                                   const int verbose,
+                                   const bool deviatoric,
+                                   const double utmSrcEasting,
+                                   const double utmSrcNorthing,
+                                   const double *__restrict__ srcDepths,
+                                   const double *__restrict__ utmRecvEasting,
+                                   const double *__restrict__ utmRecvNorthing,
+                                   const double *__restrict__ staAlt,
+                                   const double *__restrict__ nObsOffset,
+                                   const double *__restrict__ eObsOffset,
+                                   const double *__restrict__ uObsOffset,
+                                   const double *__restrict__ nWts,
+                                   const double *__restrict__ eWts,
+                                   const double *__restrict__ uWts,
+                                   double *__restrict__ nEst,
+                                   double *__restrict__ eEst,
+                                   double *__restrict__ uEst,
+                                   double *__restrict__ mts);
+/* Solve the 5 x 5 CMT normal equations */
+int core_cmt_choleskySolve5(const double *__restrict__ A,
+                            const double *__restrict__ b,
+                            double *__restrict__ x);
 /* CMT depth grid search */
 int core_cmt_depthGridSearch(const int l1, const int ndeps,
                              const int verbose,
@@ -49,6 +120,7 @@ int core_cmt_depthGridSearch(const int l1, const int ndeps,
 /* Frees memory on the CMT structures */
 void core_cmt_finalizeResults(struct GFAST_cmtResults_struct *cmt);
 void core_cmt_finalizeOffsetData(struct GFAST_offsetData_struct *offset_data);
+void core_cmt_finalizeGreensCache(struct GFAST_cmtResults_struct *cmt);
 void core_cmt_finalize(struct GFAST_cmt_props_struct *cmt_props,
                        struct GFAST_offsetData_struct *offset_data,
                        struct GFAST_cmtResults_struct *cmt);
@@ -78,6 +150,8 @@ int core_cmt_initialize(struct GFAST_cmt_props_struct props,
                         struct GFAST_data_struct gps_data,
                         struct GFAST_cmtResults_struct *cmt,
                         struct GFAST_offsetData_struct *cmt_data);
+/* Initialize the CMT Green's function cache */
+int core_cmt_initializeGreensCache(struct GFAST_cmtResults_struct *cmt);
 /* Reads the initialization parameters from the ini file */
 int core_cmt_readIni(const char *propfilename,
                     const char *group,
@@ -101,6 +175,27 @@ int core_cmt_setRHS(const int n,
                     const double *__restrict__ eOffset,
                     const double *__restrict__ uOffset,
                     double *__restrict__ U);
+/* Solve the CMT normal equations for a batch of sources */
+int core_cmt_solveNormalEquations(const int l1, const int nsrc,
+                                  const int verbose,
+                                  const bool deviatoric,
+                                  const double *__restrict__ utmSrcEastings,
+                                  const double *__restrict__ utmSrcNorthings,
+                                  const double *__restrict__ srcDepths,
+                                  const double *__restrict__ utmRecvEasting,
+                                  const double *__restrict__ utmRecvNorthing,
+                                  const double *__restrict__ staAlt,
+                                  const double *__restrict__ nObsOffset,
+                                  const double *__restrict__ eObsOffset,
+                                  const double *__restrict__ uObsOffset,
+                                  const double *__restrict__ nWts,
+                                  const double *__restrict__ eWts,
+                                  const double *__restrict__ uWts,
+                                  double *__restrict__ nEst,
+                                  double *__restrict__ eEst,
+                                  double *__restrict__ uEst,
+                                  double *__restrict__ mts,
+                                  double *__restrict__ wrss);
 /* Weight the forward model by the diagonal weight matrix */
 int core_cmt_weightForwardModel(const int mrows, const int ncols,
                                 const double *__restrict__ diagWt,
@@ -122,6 +217,13 @@ int core_cmt_weightObservations(const int mrows,
 void core_coordtools_ll2utm(const double lat_deg, const double lon_deg,
                             double *UTMNorthing, double *UTMEasting,
                             bool *lnorthp, int *zone);
+/* Convert arrays of lat/lon to UTM */
+int core_coordtools_ll2utm_batch(const int n,
+                                 const double *__restrict__ lat_deg,
+                                 const double *__restrict__ lon_deg,
+                                 const int zone,
+                                 double *__restrict__ UTMNorthing,
+                                 double *__restrict__ UTMEasting);
 /* Convert UTM to lat/lon */
 #ifdef _OPENMP
 #pragma omp declare simd
@@ -129,14 +231,38 @@ void core_coordtools_ll2utm(const double lat_deg, const double lon_deg,
 void core_coordtools_utm2ll(const int zone, const bool lnorthp,
                             const double UTMNorthing, const double UTMEasting,
                             double *lat_deg, double *lon_deg);
+/* Convert arrays of UTM to lat/lon */
+int core_coordtools_utm2ll_batch(const int n,
+                                 const int zone, const bool lnorthp,
+                                 const double *UTMNorthing,
+                                 const double *UTMEasting,
+                                 double *lat_deg, double *lon_deg);
 //----------------------------------------------------------------------------//
 //                         GFAST gps data streams                             //
 //----------------------------------------------------------------------------//
 /* Frees memory on the GPS data buffer */
 void core_data_finalize(struct GFAST_data_struct *gps_data);
+/* Frees the station geometry cache */
+void core_data_finalizeGeometry(struct GFAST_data_struct *gps_data);
+/* Memoized source-receiver hypocentral distances */
+const struct GFAST_hypoDistance_struct *
+    core_data_getHypocentralDistances(struct GFAST_data_struct gps_data,
+                                      const double ev_lat,
+                                      const double ev_lon,
+                                      const double ev_dep,
+                                      const int utm_zone,
+                                      int *ierr);
+/* Gets the cached UTM coordinates of a site */
+void core_data_getSiteUTM(
+    const struct GFAST_stationGeometry_struct *geometry,
+    const int k, const double lat, const double lon, const int zone,
+    double *northing, double *easting);
 /* Initializes the GPS metadata */
 int core_data_initialize(struct GFAST_props_struct props,
                          struct GFAST_data_struct *gps_data);
+/* Caches the station UTM coordinates */
+int core_data_initializeGeometry(struct GFAST_props_struct props,
+                                 struct GFAST_data_struct *gps_data);
 /* Reads the metadata file */
 int core_data_readMetaDataFile(const char *metaDataFile,
                                struct GFAST_data_struct *gps_data);
@@ -185,6 +311,59 @@ bool core_events_updateEvent(struct GFAST_shakeAlert_struct SA,
 //----------------------------------------------------------------------------//
 //                              finite fault                                  //
 //----------------------------------------------------------------------------//
+/* Gridsearch on fault planes with cached Green's functions */
+int core_ff_cachedFaultPlaneGridSearch(
+    struct GFAST_ffGreensCache_struct *cache,
+    const int nsites,
+    const bool *__restrict__ luse,
+    const enum ff_solver_type solver,
+    const int maxit, const double tol,
+    const double slipMin, const double slipMax,
+    const int nprobe,
+    const int l1, const int l2,
+    const int nstr, const int ndip,
+    const int nfp, const int verbose,
+    const double *__restrict__ nObsOffset,
+    const double *__restrict__ eObsOffset,
+    const double *__restrict__ uObsOffset,
+    const double *__restrict__ nWts,
+    const double *__restrict__ eWts,
+    const double *__restrict__ uWts,
+    const double *__restrict__ utmRecvEasting,
+    const double *__restrict__ utmRecvNorthing,
+    const double *__restrict__ staAlt,
+    const double *__restrict__ fault_xutm,
+    const double *__restrict__ fault_yutm,
+    const double *__restrict__ fault_alt,
+    const double *__restrict__ length,
+    const double *__restrict__ width,
+    const double *__restrict__ strike,
+    const double *__restrict__ dip,
+    double *__restrict__ sslip,
+    double *__restrict__ dslip,
+    double *__restrict__ Mw,
+    double *__restrict__ vr,
+    double *__restrict__ NN,
+    double *__restrict__ EN,
+    double *__restrict__ UN,
+    double *__restrict__ sslip_unc,
+    double *__restrict__ dslip_unc);
+/* Computes the diagonal of the slip covariance matrix */
+int core_ff_covarianceDiagonal(const int ncols, const int nprobe,
+                               const unsigned int seed,
+                               double *__restrict__ U,
+                               double *__restrict__ diag);
+/* Estimates the diagonal of the slip covariance matrix with CGLS */
+int core_ff_estimateCovarianceDiagonalCGLS(
+    const int mrowsG, const int ncols, const int mrowsT,
+    const double lampred,
+    const double *__restrict__ WG,
+    const int *__restrict__ rowPtr,
+    const int *__restrict__ colIdx,
+    const double *__restrict__ T,
+    const int nprobe, const unsigned int seed,
+    const int maxit, const double tol,
+    double *__restrict__ diag);
 /* Gridsearch on fault planes */
 int core_ff_faultPlaneGridSearch(const int l1, const int l2, 
                                  const int nstr, const int ndip,
@@ -216,13 +395,29 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
                                  double *__restrict__ dslip_unc
                                  );
 /* Frees finite fault structures */
+void core_ff_finalizeGreensCache(struct GFAST_ffResults_struct *ff);
 void core_ff_finalizeFaultPlane(struct GFAST_faultPlane_struct *fp);
 void core_ff_finalizeResults(struct GFAST_ffResults_struct *ff);
 void core_ff_finalizeOffsetData(struct GFAST_offsetData_struct *offset_data);
 void core_ff_finalize(struct GFAST_ff_props_struct *ff_props,
                       struct GFAST_offsetData_struct *ff_data,
                       struct GFAST_ffResults_struct *ff);
+/* Copies the cached forward model and regularizer for a fault plane */
+int core_ff_getCachedForwardModel(
+    const struct GFAST_ffGreensCache_struct *cache,
+    const int ifp, const int nsites,
+    const bool *__restrict__ luse,
+    const int l1, const int l2,
+    const int mrowsT, const int nnzT,
+    double *__restrict__ G,
+    int *__restrict__ rowPtrT,
+    int *__restrict__ colIdxT,
+    double *__restrict__ T);
+/* Computes the size of the sparse regularizer */
+int core_ff_getRegularizerSize(const int nstr, const int ndip,
+                               int *mrowsT, int *nnzT);
 /* Initializes finite fault data structures */
+int core_ff_initializeGreensCache(struct GFAST_ffResults_struct *ff);
 int core_ff_initialize(struct GFAST_ff_props_struct props,
                        struct GFAST_data_struct gps_data,
                        struct GFAST_ffResults_struct *ff,
@@ -276,12 +471,60 @@ int core_ff_setRegularizer(const int l2, const int nstr,
                            const double *__restrict__ width,
                            const double *__restrict__ length,
                            double *__restrict__ T);
+/* Set the sparse regularization matrix for the finite fault inversion */
+int core_ff_setRegularizerCSR(const int l2, const int nstr,
+                              const int ndip,
+                              const int mrowsT, const int nnzT,
+                              const double *__restrict__ width,
+                              const double *__restrict__ length,
+                              int *__restrict__ rowPtr,
+                              int *__restrict__ colIdx,
+                              double *__restrict__ T);
 /* Set the RHS */
 int core_ff_setRHS(const int n,
                    const double *__restrict__ nOffset,
                    const double *__restrict__ eOffset,
                    const double *__restrict__ uOffset,
                    double *__restrict__ U);
+/* Solves the regularized inversion with CGLS */
+int core_ff_solveCGLS(const int mrowsG, const int ncols, const int mrowsT,
+                      const double lampred,
+                      const double *__restrict__ WG,
+                      const double *__restrict__ Wu,
+                      const double *__restrict__ WuT,
+                      const int *__restrict__ rowPtr,
+                      const int *__restrict__ colIdx,
+                      const double *__restrict__ T,
+                      const int maxit, const double tol,
+                      const double slipMin, const double slipMax,
+                      double *__restrict__ S, int *niter);
+/* Solves the regularized inversion with the normal equations */
+int core_ff_solveNormalEquations(const int mrowsG, const int ncols,
+                                 const int mrowsT, const double lampred,
+                                 const double *__restrict__ WG,
+                                 const double *__restrict__ Wu,
+                                 const int *__restrict__ rowPtr,
+                                 const int *__restrict__ colIdx,
+                                 const double *__restrict__ T,
+                                 double *__restrict__ U,
+                                 double *__restrict__ S);
+/* Updates the cached Green's functions for the fault planes and sites */
+int core_ff_updateGreensCache(struct GFAST_ffGreensCache_struct *cache,
+                              const int nsites,
+                              const bool *__restrict__ luse,
+                              const int l1, const int l2,
+                              const int nstr, const int ndip,
+                              const int nfp, const int verbose,
+                              const double *__restrict__ utmRecvEasting,
+                              const double *__restrict__ utmRecvNorthing,
+                              const double *__restrict__ staAlt,
+                              const double *__restrict__ fault_xutm,
+                              const double *__restrict__ fault_yutm,
+                              const double *__restrict__ fault_alt,
+                              const double *__restrict__ length,
+                              const double *__restrict__ width,
+                              const double *__restrict__ strike,
+                              const double *__restrict__ dip);
 /* Weight the forward modeling matrix */
 int core_ff_weightForwardModel(const int mrows, const int ncols,
                                const double *__restrict__ diagWt,
@@ -426,6 +669,26 @@ int core_scaling_pgd_depthGridSearch(const int l1, const int ndeps,
                                      double *__restrict__ VR,
                                      double *__restrict__ iqt75_25,
                                      double *__restrict__ Uest);
+/* Closed form PGD magnitude estimate at a single depth */
+int core_scaling_pgd_evaluateDepth(const int l1,
+                                   const double A,
+                                   const double B,
+                                   const double C,
+                                   const double srcDepth,
+                                   const double utmSrcEasting,
+                                   const double utmSrcNorthing,
+                                   const double *__restrict__ utmRecvEasting,
+                                   const double *__restrict__ utmRecvNorthing,
+                                   const double *__restrict__ staAlt,
+                                   const double *__restrict__ d,
+                                   const double *__restrict__ W,
+                                   const double *__restrict__ Wb,
+                                   const double xden,
+                                   double *__restrict__ G,
+                                   double *__restrict__ srdist,
+                                   double *__restrict__ Uest,
+                                   double *__restrict__ wres,
+                                   double *M, double *VR);
 /* Finalize the PGD data structures */
 void core_scaling_pgd_finalizeData(
      struct GFAST_peakDisplacementData_struct *pgd_data);
@@ -446,6 +709,7 @@ int core_scaling_pgd_gridSearch(const int l1, const int ndeps,
                                 const int verbose,
                                 const double dist_tol,
                                 const double disp_def,
+                                const int iqr_sketch_min,
                                 const double *__restrict__ utmSrcEastings,
                                 const double *__restrict__ utmSrcNorthings,
                                 const double *__restrict__ srcDepths,
@@ -459,6 +723,11 @@ int core_scaling_pgd_gridSearch(const int l1, const int ndeps,
                                 double *__restrict__ VR, 
                                 double *__restrict__ iqr,
                                 double *__restrict__ Uest);
+/* Interquartile range of the weighted residuals */
+int core_scaling_pgd_interquartileRange(const int n, const int nsketch,
+                                        const double *__restrict__ x,
+                                        double *__restrict__ work,
+                                        double *iqr);
 /* Read ini file for PGD properties */
 int core_scaling_pgd_readIni(const char *propfilename,
                              const char *group,
@@ -492,6 +761,22 @@ int core_scaling_pgd_weightObservations(const int l1,
                                         const double *__restrict__ b,
                                         double *__restrict__ Wb);
 
+//----------------------------------------------------------------------------//
+//                                Scheduler                                   //
+//----------------------------------------------------------------------------//
+/* Ends the current tick and advances to the next deadline */
+int core_scheduler_endTick(struct GFAST_scheduler_struct *scheduler);
+/* Initializes the tick scheduler */
+int core_scheduler_initialize(const double interval,
+                              const double t0,
+                              const bool lrealTime,
+                              struct GFAST_scheduler_struct *scheduler);
+/* Prints the tick scheduler timing statistics */
+void core_scheduler_printStatistics(struct GFAST_scheduler_struct scheduler);
+/* Sleeps until the next deadline and begins a tick */
+double core_scheduler_waitForNextTick(struct GFAST_scheduler_struct *scheduler,
+                                      int *ierr);
+
 //----------------------------------------------------------------------------//
 //                            Waveform processor                              //
 //----------------------------------------------------------------------------//
@@ -503,8 +788,25 @@ int core_waveformProcessor_offset(const int utm_zone,
                                   const double ev_dep,
                                   const double ev_time,
                                   struct GFAST_data_struct gps_data,
+                                  struct GFAST_offsetState_struct *offState,
                                   struct GFAST_offsetData_struct *offset_data,
                                   int *ierr);
+/* Frees the running offset states */
+void core_waveformProcessor_finalizeOffsetTracker(
+    struct GFAST_offsetTracker_struct *tracker);
+/* Gets the running offset state for an event */
+struct GFAST_offsetState_struct *
+    core_waveformProcessor_getOffsetState(
+    struct GFAST_shakeAlert_struct SA,
+    const int nsites,
+    const int nwin,
+    const double *svel,
+    struct GFAST_offsetTracker_struct *tracker,
+    int *ierr);
+/* Removes the running offset states of inactive events */
+int core_waveformProcessor_pruneOffsetStates(
+    struct GFAST_activeEvents_struct events,
+    struct GFAST_offsetTracker_struct *tracker);
 /* Compute the peak displacement */
 int core_waveformProcessor_peakDisplacement(
     const int utm_zone,
@@ -514,21 +816,79 @@ int core_waveformProcessor_peakDisplacement(
     const double ev_dep,
     const double ev_time,
     struct GFAST_data_struct gps_data,
+    struct GFAST_peakDisplacementState_struct *pdState,
     struct GFAST_peakDisplacementData_struct *pgd_data,
     int *ierr);
+/* Computes the peak displacement and CMT and FF offsets in one pass */
+int core_waveformProcessor_peakDisplacementAndOffsets(
+    const struct GFAST_pgd_props_struct pgd_props,
+    const struct GFAST_cmt_props_struct cmt_props,
+    const struct GFAST_ff_props_struct ff_props,
+    const double ev_lat,
+    const double ev_lon,
+    const double ev_dep,
+    const double ev_time,
+    struct GFAST_data_struct gps_data,
+    struct GFAST_peakDisplacementState_struct *pdState,
+    struct GFAST_offsetState_struct *offState,
+    struct GFAST_peakDisplacementData_struct *pgd_data,
+    struct GFAST_offsetData_struct *cmt_data,
+    struct GFAST_offsetData_struct *ff_data,
+    int *nsites_pgd, int *nsites_cmt, int *nsites_ff);
+/* Computes the peak displacement and offsets at a site in one pass */
+int core_waveformProcessor_updateSite(
+    const int k,
+    const double ev_time,
+    const struct GFAST_waveform3CData_struct *data,
+    const bool lpgd,
+    const int noff,
+    const double *__restrict__ swave,
+    const int *__restrict__ iwin,
+    struct GFAST_peakDisplacementState_struct *pdState,
+    struct GFAST_offsetState_struct *offState,
+    double *peakDisp,
+    double *__restrict__ uOffset,
+    double *__restrict__ nOffset,
+    double *__restrict__ eOffset);
+/* Frees the incremental peak displacement states */
+void core_waveformProcessor_finalizePeakDisplacementTracker(
+    struct GFAST_peakDisplacementTracker_struct *tracker);
+/* Gets the incremental peak displacement state for an event */
+struct GFAST_peakDisplacementState_struct *
+    core_waveformProcessor_getPeakDisplacementState(
+    struct GFAST_shakeAlert_struct SA,
+    const int nsites,
+    struct GFAST_peakDisplacementTracker_struct *tracker,
+    int *ierr);
+/* Removes the peak displacement states of inactive events */
+int core_waveformProcessor_prunePeakDisplacementStates(
+    struct GFAST_activeEvents_struct events,
+    struct GFAST_peakDisplacementTracker_struct *tracker);
 
+#define GFAST_core_cmt_adaptiveGridSearch(...)       \
+              core_cmt_adaptiveGridSearch(__VA_ARGS__)
 #define GFAST_core_cmt_decomposeMomentTensor(...)       \
               core_cmt_decomposeMomentTensor(__VA_ARGS__)
+#define GFAST_core_cmt_decomposeMomentTensor_work(...)       \
+              core_cmt_decomposeMomentTensor_work(__VA_ARGS__)
+#define GFAST_core_cmt_cachedDepthGridSearch(...)       \
+              core_cmt_cachedDepthGridSearch(__VA_ARGS__)
+#define GFAST_core_cmt_choleskySolve5(...)       \
+              core_cmt_choleskySolve5(__VA_ARGS__)
 #define GFAST_core_cmt_depthGridSearch(...)       \
               core_cmt_depthGridSearch(__VA_ARGS__)
 #define GFAST_core_cmt_finalizeResults(...)       \
               core_cmt_finalizeResults(__VA_ARGS__)
 #define GFAST_core_cmt_finalizeOffsetData(...)       \
               core_cmt_finalizeOffsetData(__VA_ARGS__)
+#define GFAST_core_cmt_finalizeGreensCache(...)       \
+              core_cmt_finalizeGreensCache(__VA_ARGS__)
 #define GFAST_core_cmt_finalize(...)       \
               core_cmt_finalize(__VA_ARGS__)
 #define GFAST_core_cmt_initialize(...)       \
               core_cmt_initialize(__VA_ARGS__)
+#define GFAST_core_cmt_initializeGreensCache(...)       \
+              core_cmt_initializeGreensCache(__VA_ARGS__)
 #define GFAST_core_cmt_setDiagonalWeightMatrix(...)       \
               core_cmt_setDiagonalWeightMatrix(__VA_ARGS__)
 #define GFAST_core_cmt_setForwardModel(...)       \
@@ -539,6 +899,8 @@ int core_waveformProcessor_peakDisplacement(
               core_cmt_setForwardModel__deviatoric(__VA_ARGS__)
 #define GFAST_core_cmt_setRHS(...)       \
               core_cmt_setRHS(__VA_ARGS__)
+#define GFAST_core_cmt_solveNormalEquations(...)       \
+              core_cmt_solveNormalEquations(__VA_ARGS__)
 #define GFAST_core_cmt_weightForwardModel(...)       \
               core_cmt_weightForwardModel(__VA_ARGS__)
 #define GFAST_core_cmt_weightObservations(...)       \
@@ -546,13 +908,25 @@ int core_waveformProcessor_peakDisplacement(
 
 #define GFAST_core_coordtools_ll2utm(...) \
               core_coordtools_ll2utm(__VA_ARGS__)
+#define GFAST_core_coordtools_ll2utm_batch(...) \
+              core_coordtools_ll2utm_batch(__VA_ARGS__)
 #define GFAST_core_coordtools_utm2ll(...) \
               core_coordtools_utm2ll(__VA_ARGS__)
+#define GFAST_core_coordtools_utm2ll_batch(...) \
+              core_coordtools_utm2ll_batch(__VA_ARGS__)
 
 #define GFAST_core_data_finalize(...)       \
               core_data_finalize(__VA_ARGS__)
+#define GFAST_core_data_finalizeGeometry(...)       \
+              core_data_finalizeGeometry(__VA_ARGS__)
+#define GFAST_core_data_getHypocentralDistances(...)       \
+              core_data_getHypocentralDistances(__VA_ARGS__)
+#define GFAST_core_data_getSiteUTM(...)       \
+              core_data_getSiteUTM(__VA_ARGS__)
 #define GFAST_core_data_initialize(...)       \
               core_data_initialize(__VA_ARGS__)
+#define GFAST_core_data_initializeGeometry(...)       \
+              core_data_initializeGeometry(__VA_ARGS__)
 #define GFAST_core_data_readMetaDataFile(...)       \
               core_data_readMetaDataFile(__VA_ARGS__)
 #define GFAST_core_data_readSiteMaskFile(...)       \
@@ -573,8 +947,20 @@ int core_waveformProcessor_peakDisplacement(
 #define GFAST_core_events_updateEvent(...)       \
               core_events_updateEvent(__VA_ARGS__)
 
+#define GFAST_core_ff_cachedFaultPlaneGridSearch(...)       \
+              core_ff_cachedFaultPlaneGridSearch(__VA_ARGS__)
+#define GFAST_core_ff_covarianceDiagonal(...)       \
+              core_ff_covarianceDiagonal(__VA_ARGS__)
+#define GFAST_core_ff_estimateCovarianceDiagonalCGLS(...)       \
+              core_ff_estimateCovarianceDiagonalCGLS(__VA_ARGS__)
 #define GFAST_core_ff_faultPlaneGridSearch(...)       \
               core_ff_faultPlaneGridSearch(__VA_ARGS__)
+#define GFAST_core_ff_finalizeGreensCache(...)       \
+              core_ff_finalizeGreensCache(__VA_ARGS__)
+#define GFAST_core_ff_getCachedForwardModel(...)       \
+              core_ff_getCachedForwardModel(__VA_ARGS__)
+#define GFAST_core_ff_getRegularizerSize(...)       \
+              core_ff_getRegularizerSize(__VA_ARGS__)
 #define GFAST_core_ff_finalizeResults(...)       \
               core_ff_finalizeResults(__VA_ARGS__)
 #define GFAST_core_ff_finalizeFaultPlane(...)       \
@@ -585,6 +971,8 @@ int core_waveformProcessor_peakDisplacement(
               core_ff_finalize(__VA_ARGS__)
 #define GFAST_core_ff_initialize(...)       \
               core_ff_initialize(__VA_ARGS__)
+#define GFAST_core_ff_initializeGreensCache(...)       \
+              core_ff_initializeGreensCache(__VA_ARGS__)
 #define GFAST_core_scaling_pgd_finalize__props(...)       \
               core_scaling_pgd_finalize__props(__VA_ARGS__)
 #define GFAST_core_scaling_pgd_finalizeData(...)       \
@@ -601,8 +989,16 @@ int core_waveformProcessor_peakDisplacement(
               core_ff_setForwardModel__okadagreenF(__VA_ARGS__)
 #define GFAST_core_ff_setRegularizer(...)       \
               core_ff_setRegularizer(__VA_ARGS__)
+#define GFAST_core_ff_setRegularizerCSR(...)       \
+              core_ff_setRegularizerCSR(__VA_ARGS__)
 #define GFAST_core_ff_setRHS(...)       \
               core_ff_setRHS(__VA_ARGS__)
+#define GFAST_core_ff_solveCGLS(...)       \
+              core_ff_solveCGLS(__VA_ARGS__)
+#define GFAST_core_ff_solveNormalEquations(...)       \
+              core_ff_solveNormalEquations(__VA_ARGS__)
+#define GFAST_core_ff_updateGreensCache(...)       \
+              core_ff_updateGreensCache(__VA_ARGS__)
 #define GFAST_core_ff_weightForwardModel(...)       \
               core_ff_weightForwardModel(__VA_ARGS__)
 #define GFAST_core_ff_weightObservations(...)       \
@@ -625,10 +1021,14 @@ int core_waveformProcessor_peakDisplacement(
 
 #define GFAST_core_scaling_pgd_depthGridSearch(...)       \
               core_scaling_pgd_depthGridSearch(__VA_ARGS__)
+#define GFAST_core_scaling_pgd_evaluateDepth(...)       \
+              core_scaling_pgd_evaluateDepth(__VA_ARGS__)
 #define GFAST_core_scaling_pgd_setDiagonalWeightMatrix(...)       \
               core_scaling_pgd_setDiagonalWeightMatrix(__VA_ARGS__)
 #define GFAST_core_scaling_pgd_initialize(...)       \
               core_scaling_pgd_initialize(__VA_ARGS__)
+#define GFAST_core_scaling_pgd_interquartileRange(...)       \
+              core_scaling_pgd_interquartileRange(__VA_ARGS__)
 #define GFAST_core_scaling_pgd_setForwardModel(...)       \
               core_scaling_pgd_setForwardModel(__VA_ARGS__)
 #define GFAST_core_scaling_pgd_setRHS(...)       \
@@ -638,10 +1038,35 @@ int core_waveformProcessor_peakDisplacement(
 #define GFAST_core_scaling_pgd_weightObservations(...)       \
               core_scaling_pgd_weightObservations(__VA_ARGS__)
 
+#define GFAST_core_scheduler_endTick(...)       \
+              core_scheduler_endTick(__VA_ARGS__)
+#define GFAST_core_scheduler_initialize(...)       \
+              core_scheduler_initialize(__VA_ARGS__)
+#define GFAST_core_scheduler_printStatistics(...)       \
+              core_scheduler_printStatistics(__VA_ARGS__)
+#define GFAST_core_scheduler_waitForNextTick(...)       \
+              core_scheduler_waitForNextTick(__VA_ARGS__)
+
 #define GFAST_core_waveformProcessor_offset(...)       \
               core_waveformProcessor_offset(__VA_ARGS__)
+#define GFAST_core_waveformProcessor_finalizeOffsetTracker(...)       \
+              core_waveformProcessor_finalizeOffsetTracker(__VA_ARGS__)
+#define GFAST_core_waveformProcessor_getOffsetState(...)       \
+              core_waveformProcessor_getOffsetState(__VA_ARGS__)
+#define GFAST_core_waveformProcessor_pruneOffsetStates(...)       \
+              core_waveformProcessor_pruneOffsetStates(__VA_ARGS__)
 #define GFAST_core_waveformProcessor_peakDisplacement(...)       \
               core_waveformProcessor_peakDisplacement(__VA_ARGS__)
+#define GFAST_core_waveformProcessor_peakDisplacementAndOffsets(...)       \
+              core_waveformProcessor_peakDisplacementAndOffsets(__VA_ARGS__)
+#define GFAST_core_waveformProcessor_updateSite(...)       \
+              core_waveformProcessor_updateSite(__VA_ARGS__)
+#define GFAST_core_waveformProcessor_finalizePeakDisplacementTracker(...) \
+              core_waveformProcessor_finalizePeakDisplacementTracker(__VA_ARGS__)
+#define GFAST_core_waveformProcessor_getPeakDisplacementState(...)       \
+              core_waveformProcessor_getPeakDisplacementState(__VA_ARGS__)
+#define GFAST_core_waveformProcessor_prunePeakDisplacementStates(...)       \
+              core_waveformProcessor_prunePeakDisplacementStates(__VA_ARGS__)
 
 #ifdef __cplusplus
 }
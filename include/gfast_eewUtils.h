@@ -15,12 +15,14 @@ int eewUtils_driveCMT(struct GFAST_cmt_props_struct cmt_props,
                       const double SA_lat,
                       const double SA_lon,
                       const double SA_dep,
+                      const struct GFAST_stationGeometry_struct *geometry,
                       struct GFAST_offsetData_struct cmt_data,
                       struct GFAST_cmtResults_struct *cmt);
 /* Drive the finite fault computation */
 int eewUtils_driveFF(struct GFAST_ff_props_struct ff_props,
                      const double SA_lat,
                      const double SA_lon,
+                     const struct GFAST_stationGeometry_struct *geometry,
                      struct GFAST_offsetData_struct ff_data,
                      struct GFAST_ffResults_struct *ff);
 /* Drive GFAST */
@@ -30,6 +32,8 @@ int eewUtils_driveGFAST(const double currentTime,
                         struct GFAST_data_struct *gps_data,
                         struct h5traceBuffer_struct *h5traceBuffer,
                         struct GFAST_peakDisplacementData_struct *pgd_data,
+                        struct GFAST_peakDisplacementTracker_struct *pgdTracker,
+                        struct GFAST_offsetTracker_struct *offsetTracker,
                         struct GFAST_offsetData_struct *cmt_data,
                         struct GFAST_offsetData_struct *ff_data,
                         struct GFAST_pgdResults_struct *pgd,
@@ -41,6 +45,7 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
                       const double SA_lat,
                       const double SA_lon,
                       const double SA_dep,
+                      const struct GFAST_stationGeometry_struct *geometry,
                       struct GFAST_peakDisplacementData_struct pgd_data,
                       struct GFAST_pgdResults_struct *pgd);
 /* Make finite fault XML for shakeAlert */
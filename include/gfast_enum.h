@@ -66,6 +66,14 @@ enum ff_return_enum
     FF_MEMORY_ERROR = 5        /*!< Error during memory allocation */
 };
 
+enum ff_solver_type
+{
+    FF_DIRECT_SOLVER = 1, /*!< Solves the regularized slip inversion by
+                               factoring the normal equations */
+    FF_CGLS_SOLVER = 2    /*!< Solves the regularized slip inversion with
+                               warm started conjugate gradients */
+};
+
 enum alert_units_enum
 {
     UNKNOWN_UNITS = 0,    /*!< No units defined */
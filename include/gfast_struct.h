@@ -43,6 +43,10 @@ struct GFAST_pgd_props_struct
     int ngridSearch_lats; /*!< Number of latitudes in epicentral grid-search. */
     int ngridSearch_lons; /*!< Number of longitudes in epicentral grid-search.*/
     int ngridSearch_deps; /*!< Number of depths in PGD grid-search. */
+    int iqr_sketch_min;   /*!< If positive then the interquartile range of
+                               the residuals at a grid-search node with at
+                               least this many sites is approximated with
+                               a streaming sketch.  Otherwise it is exact. */
 };
 
 struct GFAST_cmt_props_struct
@@ -73,10 +77,20 @@ struct GFAST_cmt_props_struct
     int ngridSearch_lats; /*!< Number of latitudes in epicenter grid-search. */
     int ngridSearch_lons; /*!< Number of longitudes in epicenter grid-search. */
     int ngridSearch_deps; /*!< Number of depths in CMT grid-search. */
+    int adaptive_nrefine; /*!< Number of times the coarse depth grid is
+                               refined in the adaptive CMT search.  The
+                               coarse grid uses every 2^adaptive_nrefine'th
+                               depth so ngridSearch_deps - 1 must be a
+                               multiple of 2^adaptive_nrefine. */
+    int adaptive_maxEvals;/*!< Max number of depths evaluated by the
+                               adaptive CMT search. */
     bool ldeviatoric;     /*!< If true then the CMT inversion is 
                                constrained to purely deviatoric sources.
                                Otherwise, all 6 moment tensor terms
                                are inverted for. */
+    bool ladaptive;       /*!< If true then the CMT depths are searched
+                               coarse-to-fine.  Otherwise, all depths
+                               are evaluated. */
 };
 
 struct GFAST_ff_props_struct
@@ -89,6 +103,21 @@ struct GFAST_ff_props_struct
                               the offset. */
     double flen_pct;     /*!< Fault length safety factor. */
     double fwid_pct;     /*!< Fault width safety factor. */
+    double cgls_tol;     /*!< Relative tolerance on the preconditioned
+                              normal equations residual at which the
+                              CGLS slip solver stops. */
+    double min_slip;     /*!< Lower bound (m) on slip along strike and
+                              down dip in the CGLS slip solver. */
+    double max_slip;     /*!< Upper bound (m) on slip along strike and
+                              down dip in the CGLS slip solver. */
+    enum ff_solver_type
+           solver;       /*!< Slip inversion solver. */
+    int cgls_maxit;      /*!< Max number of iterations in the CGLS slip
+                              solver. */
+    int unc_nprobe;      /*!< If positive then this is the number of
+                              random probing vectors used to estimate the
+                              slip uncertainties.  Otherwise, they are
+                              computed exactly. */
     int verbose;         /*!< Controls verbosity - errors will always
                               be output. \n
                               = 1 -> Output generic information. \n
@@ -220,6 +249,10 @@ struct GFAST_props_struct
                                              and debug information. */
     bool lh5SummaryOnly;        /*!< If true then only the HDF5 summary
                                      will be written. */
+    bool lh5TraceBuffer;        /*!< If true then the waveform trace buffer
+                                     is also saved to an HDF5 file.
+                                     Otherwise the traces are only kept in
+                                     memory. */
     enum opmode_type opmode;    /*!< GFAST operation mode (realtime, 
                                      playback, offline). */
     enum dtinit_type dt_init;   /*!< Defines how to initialize GPS sampling
@@ -282,6 +315,60 @@ struct GFAST_faultPlane_struct
     int ndip;           /*!< Number of fault patches down dip */
 };
 
+struct GFAST_ffGreens_struct
+{
+    double *G;          /*!< Unweighted Green's functions for each site.
+                             The rows for the k'th site begin at row 3*k.
+                             The matrix is row major with leading dimension
+                             2*l2 [3*nsites x 2*l2] */
+    double *T;          /*!< Non-zeros of the regularizer in compressed
+                             sparse row format [nnzT] */
+    double *fault_xutm; /*!< Fault patch UTM eastings (m) [l2] */
+    double *fault_yutm; /*!< Fault patch UTM northings (m) [l2] */
+    double *fault_alt;  /*!< Fault patch depths (km) [l2] */
+    double *length;     /*!< Fault patch lengths (m) [l2] */
+    double *width;      /*!< Fault patch widths (m) [l2] */
+    double *strike;     /*!< Fault patch strikes (degrees) [l2] */
+    double *dip;        /*!< Fault patch dips (degrees) [l2] */
+    double *recvEasting;  /*!< Receiver UTM easting (m) of each site
+                               [nsites] */
+    double *recvNorthing; /*!< Receiver UTM northing (m) of each site
+                               [nsites] */
+    double *staAlt;     /*!< Station elevation (m) of each site [nsites] */
+    bool *lsiteValid;   /*!< If true then the k'th site's rows in G are
+                             current for the cached patches [nsites] */
+    double *slip;       /*!< Slip along strike and down dip from the most
+                             recent iterative solve.  The strike and dip
+                             components of the i'th patch are at 2*i and
+                             2*i+1 [2*l2] */
+    int *rowPtrT;       /*!< Row pointers of the regularizer [mrowsT+1] */
+    int *colIdxT;       /*!< Column indices of the regularizer [nnzT] */
+    int lastUse;        /*!< Use counter for recycling the least recently
+                             used plane */
+    int niter;          /*!< Number of iterations in the most recent
+                             iterative solve */
+    bool lvalid;        /*!< If true then the patch geometry and regularizer
+                             are set */
+    bool lslip;         /*!< If true then slip holds a starting solution
+                             for the next iterative solve */
+    char pad1[6];
+};
+
+struct GFAST_ffGreensCache_struct
+{
+    struct GFAST_ffGreens_struct
+        *planes;        /*!< Cached Green's functions and regularizers for
+                             recently inverted fault planes [maxPlanes] */
+    int *planeEntry;    /*!< Cache entry of the ifp'th fault plane in the
+                             most recent update [nfp] */
+    int maxPlanes;      /*!< Number of cached fault planes */
+    int nsites;         /*!< Number of sites */
+    int nstr;           /*!< Number of fault patches along strike */
+    int ndip;           /*!< Number of fault patches down dip */
+    int nfp;            /*!< Number of fault planes */
+    int useCounter;     /*!< Counter for least recently used recycling */
+};
+
 struct GFAST_ffResults_struct
 {
     struct GFAST_faultPlane_struct *fp;   /*!< Fault planes [nfp] */
@@ -297,10 +384,57 @@ struct GFAST_ffResults_struct
     double SA_lon;                        /*!< Source longitude (degrees) [-180,360) */
     double SA_dep;                        /*!< Source depth (km) */
     double SA_mag;                        /*!< Source magnitude (Mw) */
+    struct GFAST_ffGreensCache_struct
+        *greens;                          /*!< Cached Green's functions and
+                                               regularizers.  This may be
+                                               NULL. */
     int preferred_fault_plane;            /*!< Preferred fault plane */
     int nfp;                              /*!< Number of fault planes */
 };
 
+struct GFAST_cmtGreens_struct
+{
+    double *G;          /*!< Unweighted Green's functions at each depth.
+                             The rows for the j'th site in rowSite begin
+                             at row 3*j.  Each matrix is row major with
+                             leading dimension 5 [ndeps x 3*nsites x 5] */
+    double *ata;        /*!< Upper triangle of the weighted normal
+                             equations \f$ G^T W^T W G \f$ at each depth
+                             in row major format [ndeps x 5 x 5] */
+    double *diagWt;     /*!< North, east, and vertical data weights of each
+                             site in the normal equations [3*nsites] */
+    double *recvEasting;  /*!< Receiver UTM easting (m) of each site in
+                               the normal equations [nsites] */
+    double *recvNorthing; /*!< Receiver UTM northing (m) of each site in
+                               the normal equations [nsites] */
+    double *staAlt;     /*!< Station elevation (m) of each site in the
+                             normal equations [nsites] */
+    double *srcDepths;  /*!< Source depths (km) of the normal equations
+                             [ndeps] */
+    double srcEasting;  /*!< Source UTM easting (m) */
+    double srcNorthing; /*!< Source UTM northing (m) */
+    int *rowSite;       /*!< Site index of the j'th block of three rows in
+                             G [nsites] */
+    bool *lactive;      /*!< If true then the k'th site is in the
+                             normal equations [nsites] */
+    int nactive;        /*!< Number of sites in the normal equations */
+    int lastUse;        /*!< Use counter for recycling the least recently
+                             used event */
+    bool lvalid;        /*!< If true then the normal equations are valid */
+    char pad1[7];
+};
+
+struct GFAST_cmtGreensCache_struct
+{
+    struct GFAST_cmtGreens_struct
+        *events;        /*!< Cached Green's functions and normal equations
+                             for each recently inverted source [maxEvents] */
+    int maxEvents;      /*!< Number of cached sources */
+    int nsites;         /*!< Number of sites */
+    int ndeps;          /*!< Number of depths */
+    int useCounter;     /*!< Counter for least recently used recycling */
+};
+
 struct GFAST_cmtResults_struct
 {
     double *l2;        /*!< L_2 objective function at all depths [ndeps] */
@@ -338,8 +472,14 @@ struct GFAST_cmtResults_struct
     double *Einp;      /*!< Observed input east displacements [nsites] */
     double *Ninp;      /*!< Observed input north displacements [nsites] */
     double *Uinp;      /*!< Observed input vertical displacements [nsites] */
+    double *decompWork;/*!< Workspace for the moment tensor decompositions
+                            [CMT_DECOMP_LWORK*nlats*nlons*ndeps].  This
+                            may be NULL. */
     bool *lsiteUsed;   /*!< If true then the isite'th site from the
                             site list was used in the CMT estimation [nsite] */ 
+    struct GFAST_cmtGreensCache_struct
+        *greens;       /*!< Cached Green's functions and normal equations.
+                            This may be NULL. */
     int opt_indx;      /*!< Optimal index in depth grid search [0, ndeps) */
     int nlats;         /*!< Number of latitudes in grid search */
     int nlons;         /*!< Number of longitudes in grid serach */
@@ -389,6 +529,46 @@ struct GFAST_peakDisplacementData_struct
                           buffered data) */
 };
 
+struct GFAST_peakDisplacementState_struct
+{
+    char eventid[128]; /*!< Event ID to which this state belongs */
+    double *peakDisp;  /*!< Running peak displacement (meters) at the i'th
+                            site.  NaN if no sample has been processed
+                            [nsites] */
+    double *u0;        /*!< Up position (meters) at the origin time at the
+                            i'th site.  NaN if not yet known [nsites] */
+    double *n0;        /*!< North position (meters) at the origin time at the
+                            i'th site.  NaN if not yet known [nsites] */
+    double *e0;        /*!< East position (meters) at the origin time at the
+                            i'th site.  NaN if not yet known [nsites] */
+    double *tnext;     /*!< Epochal time (UTC seconds) of the next sample to
+                            process at the i'th site.  This is the first
+                            sample that was unknown on the previous call
+                            so that late samples are not missed [nsites] */
+    double ev_time;    /*!< Origin time (UTC seconds) for which the state is
+                            valid.  If the origin time changes then the
+                            state is reset. */
+    double latency;    /*!< Samples more than this many seconds before the
+                            end of the buffer that are still unknown are
+                            committed as missing and tnext moves past them.
+                            If not positive then unknown samples are
+                            revisited until the state is reset. */
+    int nsites;        /*!< Number of sites */
+    char pad1[4];
+};
+
+struct GFAST_peakDisplacementTracker_struct
+{
+    struct GFAST_peakDisplacementState_struct *states; /*!< Incremental peak
+                                                            displacement state
+                                                            for each active
+                                                            event [nstates] */
+    double latency;                                    /*!< Latency (s) given
+                                                            to each state */
+    int nstates;                                       /*!< Number of states */
+    char pad1[4];
+};
+
 struct GFAST_offsetData_struct
 {
     char **stnm;      /*!< Name of i'th site [nsites x 64] */
@@ -415,6 +595,58 @@ struct GFAST_offsetData_struct
     int nsites;       /*!< Number of sites */
 };
 
+struct GFAST_offsetState_struct
+{
+    char eventid[128]; /*!< Event ID to which this state belongs */
+    double *svel;      /*!< Shear wave window velocities (km/s) for which
+                            running sums are kept [nwin] */
+    double *u0;        /*!< Up position (meters) at the origin time at the
+                            i'th site.  NaN if not yet known [nsites] */
+    double *n0;        /*!< North position (meters) at the origin time at the
+                            i'th site.  NaN if not yet known [nsites] */
+    double *e0;        /*!< East position (meters) at the origin time at the
+                            i'th site.  NaN if not yet known [nsites] */
+    double *uSum;      /*!< Running sum of up displacements after the S wave
+                            for the iwin'th velocity and i'th site.  This
+                            is an array of dimension [nwin x nsites] */
+    double *nSum;      /*!< Running sum of north displacements after the
+                            S wave [nwin x nsites] */
+    double *eSum;      /*!< Running sum of east displacements after the
+                            S wave [nwin x nsites] */
+    double *tstart;    /*!< S wave time (UTC seconds) at which the running
+                            sums begin.  NaN if the sums have not begun
+                            [nwin x nsites] */
+    double *tnext;     /*!< Epochal time (UTC seconds) of the next sample to
+                            add to the running sums.  This is the first
+                            sample that was unknown on the previous call.
+                            Known samples after it are not in the running
+                            sums so that late samples are not missed
+                            [nwin x nsites] */
+    int *nsum;         /*!< Number of samples in the running sums
+                            [nwin x nsites] */
+    double ev_time;    /*!< Origin time (UTC seconds) for which the state is
+                            valid.  If the origin time changes then the
+                            state is reset. */
+    double latency;    /*!< Samples more than this many seconds before the
+                            end of the buffer that are still unknown are
+                            committed as missing and tnext moves past them.
+                            If not positive then unknown samples are
+                            revisited until the state is reset. */
+    int nsites;        /*!< Number of sites */
+    int nwin;          /*!< Number of window velocities */
+};
+
+struct GFAST_offsetTracker_struct
+{
+    struct GFAST_offsetState_struct *states; /*!< Running offset state for
+                                                  each active event
+                                                  [nstates] */
+    double latency;                          /*!< Latency (s) given to each
+                                                  state */
+    int nstates;                             /*!< Number of states */
+    char pad1[4];
+};
+
 
 struct GFAST_waveform3CData_struct
 {
@@ -455,11 +687,58 @@ struct GFAST_waveform3CData_struct
                                     finite fault inversion */
 };
 
+struct GFAST_hypoDistance_struct
+{
+    double *distance;   /*!< Hypocentral distance (km) from the source to
+                             each site [nsites] */
+    double ev_lat;      /*!< Source latitude (degrees) */
+    double ev_lon;      /*!< Source longitude (degrees) */
+    double ev_dep;      /*!< Source depth (km) */
+    double srcNorthing; /*!< Source UTM northing (m) */
+    double srcEasting;  /*!< Source UTM easting (m) */
+    int zoneIn;         /*!< Requested UTM zone.  If -1 then the zone was
+                             estimated from the source location. */
+    int zone;           /*!< UTM zone in which the distances were computed */
+    int lastUse;        /*!< Use counter for recycling the least recently
+                             used table */
+    bool lvalid;        /*!< If true then this table is valid */
+    char pad1[3];
+};
+
+struct GFAST_stationGeometry_struct
+{
+    struct GFAST_hypoDistance_struct
+        *hypoDist;        /*!< Memoized source-receiver distance tables
+                               [maxHypoDist] */
+    double *utmNorthing;  /*!< UTM northing (m) of the k'th site in the
+                               i'th cached zone.  This is an array of
+                               dimension [nzones x nsites] */
+    double *utmEasting;   /*!< UTM easting (m) of the k'th site in the
+                               i'th cached zone [nzones x nsites] */
+    double *sta_lat;      /*!< Site latitudes (degrees) for which the cache
+                               was computed [nsites] */
+    double *sta_lon;      /*!< Site longitudes (degrees) for which the cache
+                               was computed [nsites] */
+    double *sta_alt;      /*!< Site altitudes (m) for which the cache
+                               was computed [nsites] */
+    int zoneIndex[61];    /*!< Maps UTM zone z (1-60) to its row in the UTM
+                               tables.  -1 if the zone is not cached. */
+    int nzones;           /*!< Number of cached UTM zones */
+    int nsites;           /*!< Number of sites */
+    int maxHypoDist;      /*!< Number of memoized distance tables */
+    int useCounter;       /*!< Counter for least recently used recycling */
+};
+
 struct GFAST_data_struct
 {
     struct GFAST_waveform3CData_struct *data;  /*!< Collocated data structure.
                                                     This is an array with
                                                     dimension [stream_length] */
+    struct GFAST_stationGeometry_struct
+        *geometry;                           /*!< Cached site UTM coordinates
+                                                  and source-receiver
+                                                  distances.  This may be
+                                                  NULL. */
     int stream_length;                       /*!< Number of streams. */
 };
 
@@ -567,4 +846,28 @@ struct GFAST_xmlMessages_struct
     int mmessages; /*!< Max number of XML messages. */
 };
 
+struct GFAST_scheduler_struct
+{
+    double interval;    /*!< Time (s) between successive ticks. */
+    double tdeadline;   /*!< Epochal time (UTC seconds) of the current
+                             tick's deadline. */
+    double tstart;      /*!< Wall-clock epochal time (UTC seconds) at which
+                             the current tick began running. */
+    double lateness;    /*!< Time (s) the most recent tick started after
+                             its deadline. */
+    double maxLateness; /*!< Largest tick lateness (s) observed. */
+    double sumLateness; /*!< Sum of all tick latenesses (s). */
+    double runTime;     /*!< Time (s) the most recent tick spent running. */
+    double maxRunTime;  /*!< Largest tick run time (s) observed. */
+    double sumRunTime;  /*!< Sum of all tick run times (s). */
+    int nticks;         /*!< Number of ticks executed. */
+    int nmissed;        /*!< Number of deadlines that passed without a
+                             tick being started. */
+    bool lrealTime;     /*!< If true then the scheduler sleeps until each
+                             deadline.  Otherwise, the deadlines are
+                             simulated and the scheduler never sleeps
+                             (e.g. playback). */
+    bool linit;         /*!< If true then the structure is initialized. */
+};
+
 #endif /* _gfast_struct_h__ */
@@ -43,6 +43,12 @@ struct ewRing_struct
     SHM_INFO region;       /*!< Earthworm shared memory region corresponding to
                                 the earthworm ring */
     MSG_LOGO *getLogo;     /*!< Logos to scrounge from the ring [nlogo] */
+    char *msgArena;        /*!< Messages from the last ring read packed at
+                                their actual length [nArena] */
+    int *msgOffset;        /*!< Start index of the i'th message in msgArena
+                                [maxMessages+1] */
+    int nArena;            /*!< Allocated size of msgArena (bytes) */
+    int maxMessages;       /*!< Allocated number of message offsets */
     long ringKey;          /*!< Ring key number */
     short nlogo;           /*!< Number of logos */
     bool linit;            /*!< True if the structure is initialized.
@@ -71,6 +77,26 @@ struct ewRing_struct
 };
 #endif
 
+#ifndef SNCL_KEY_LEN
+#define SNCL_KEY_LEN 128
+#endif
+struct snclIndex_struct
+{
+    char *keys;           /*!< Interned upper case NET.STA.CHAN.LOC keys.  The
+                               i'th id's key begins at i*SNCL_KEY_LEN
+                               [maxids x SNCL_KEY_LEN] */
+    unsigned int *hashes; /*!< Hash of each id's key [maxids] */
+    int *table;           /*!< Open addressing hash table.  Holds the id of
+                               the key in each slot or -1 if the slot is
+                               empty [tableSize] */
+    int tableSize;        /*!< Size of the hash table (a power of 2) */
+    int maxids;           /*!< Max number of SNCLs that can be interned */
+    int nids;             /*!< Number of interned SNCLs.  The ids are dense
+                               and run from 0 to nids-1 in order of
+                               insertion */
+    bool linit;           /*!< If true then the structure is initialized */
+};
+
 struct tb2Trace_struct
 {
     char netw[64];      /*!< Network name */
@@ -86,6 +112,16 @@ struct tb2Trace_struct
     double dt;          /*!< Sampling period (s) */
     int nchunks;        /*!< Number of chunks */
     int npts;           /*!< Number of points in times and data */
+    int maxpts;         /*!< Allocated length of times and data */
+    int maxchunks;      /*!< Max number of chunks that chunkPtr can hold */
+};
+
+enum tb2Unpack_kernel
+{
+    TB2_UNPACK_AUTO = 0,    /*!< Widest kernel supported by the CPU */
+    TB2_UNPACK_SCALAR = 1,  /*!< Portable scalar kernel */
+    TB2_UNPACK_SSE41 = 2,   /*!< SSE4.1 kernel */
+    TB2_UNPACK_AVX2 = 3     /*!< AVX2 kernel */
 };
 
 struct tb2Data_struct
@@ -96,6 +132,32 @@ struct tb2Data_struct
                                          initialized. */
 };
 
+struct tb2Queue_struct
+{
+    struct tb2Data_struct *slots; /*!< Unpacked trace snapshots handed from
+                                       the acquisition thread to the
+                                       processing thread [nslots] */
+    struct tb2Data_struct backlog; /*!< Accumulates the ring reads made while
+                                       the queue is full so that the ring is
+                                       always drained.  Only the producer
+                                       accesses this. */
+    double *times;                /*!< Epochal time (UTC seconds) at which the
+                                       i'th snapshot was acquired [nslots] */
+    int nslots;                   /*!< Number of slots in the queue.  At most
+                                       nslots-1 snapshots can be pending. */
+    int head;                     /*!< Next slot the producer will write.
+                                       Only the producer modifies this. */
+    int tail;                     /*!< Next slot the consumer will read.
+                                       Only the consumer modifies this. */
+    int noverflow;                /*!< Number of times the producer found
+                                       the queue full */
+    bool lbacklog;                /*!< If true then backlog holds reads that
+                                       have not yet been published.  Only the
+                                       producer accesses this. */
+    bool linit;                   /*!< If true then the structure is
+                                       initialized. */
+};
+
 struct h5trace_struct
 {
     char netw[64];        /*!< Network name for forming earthworm requests */
@@ -108,6 +170,11 @@ struct h5trace_struct
     //double *buffer1;      /*!< Dataset 1 [maxpts] - TODO - delete its in h5 */
     //double *buffer2;      /*!< Dataset 2 [maxpts] - TODO - delete its in h5 */
     double *data;         /*!< Data to be copied onto other structure [ncopy] */
+    double *ringBuffer;   /*!< In-memory circular buffer holding the most
+                               recent maxpts samples of the trace.  Missing
+                               samples are NaN. [maxpts] */
+    double ringEndTime;   /*!< Epochal time (UTC-seconds) of the sample at
+                               ringHead */
     double t1;            /*!< Start time of data (UTC-seconds) */
     //double t1beg;         /*!< Epochal start time of buffer1 (UTC-seconds) - TODO - delete */
     //double t2beg;         /*!< Epochal start time of buffer2 (UTC-seconds) - TODO - delete */
@@ -124,6 +191,10 @@ struct h5trace_struct
     int ncopy;            /*!< Number of points to copy from Earthworm traceBuffer
                                to HDF5 or number of points to copy from HDF5 to
                                GFAST data buffer */
+    int nalloc;           /*!< Allocated length of data.  The data buffer is
+                               reused while ncopy <= nalloc. */
+    int ringHead;         /*!< Index of the most recent sample in
+                               ringBuffer */
     int traceNumber;      /*!< Trace number of H5 data block */
     int dtGroupNumber;    /*!< Sampling period group number */
 };
@@ -135,9 +206,18 @@ struct h5traceBuffer_struct
                                         [ndtGroups] */
     int *dtPtr;                    /*!< Maps from idt'th dtGroup to start index
                                         of traces [ndtGroups+1] */
+    int *tb2Map;                   /*!< Maps the i'th trace to its trace in
+                                        the tracebuffer2 data or -1 if it
+                                        is not there.  NULL until set by
+                                        traceBuffer_h5_setTb2DataMap
+                                        [ntraces] */
     hid_t fileID;                  /*!< HDF5 file handle */
     int ndtGroups;                 /*!< Number of sampling period groups */
     int ntraces;                   /*!< Number of traces to collect */
+    bool lringBuffer;              /*!< If true then the traces are buffered
+                                        in the in-memory circular buffers */
+    bool lh5File;                  /*!< If true then fileID is an open
+                                        HDF5 file */
     bool linit;                    /*!< True if the structure has been
                                         initialized */
 };
@@ -155,14 +235,18 @@ int traceBuffer_ewrr_finalize(struct ewRing_struct *ringInfo);
 /* Flush an earthworm ring */
 int traceBuffer_ewrr_flushRing(struct ewRing_struct *ringInfo);
 /* Read messages from the ring */
-char *traceBuffer_ewrr_getMessagesFromRing(const int messageBlock,
-                                           const bool showWarnings,
-                                           struct ewRing_struct *ringInfo,
-                                           int *nRead, int *ierr);
+const char *traceBuffer_ewrr_getMessagesFromRing(const int messageBlock,
+                                                 const bool showWarnings,
+                                                 struct ewRing_struct *ringInfo,
+                                                 int *nRead, int *ierr);
 /* Initialize the earthworm ring reader connection */
 int traceBuffer_ewrr_initialize(const char *ewRing,
                                 const int msWait,
                                 struct ewRing_struct *ringInfo);
+/* Initialize the tb2 snapshot queue */
+int traceBuffer_ewrr_initializetb2Queue(const int nslots,
+                                        struct tb2Data_struct tb2Data,
+                                        struct tb2Queue_struct *queue);
 
 /* Classify return value from Earthworm get transport call */
 int traceBuffer_ewrr_classifyGetRetval(const int retval);
@@ -172,9 +256,14 @@ int traceBuffer_ewrr_flushRing(struct ewRing_struct *ringInfo);
 int traceBuffer_ewrr_finalize(struct ewRing_struct *ringInfo);
 /* Frees memory on the tb2data structure */
 void traceBuffer_ewrr_freetb2Data(struct tb2Data_struct *tb2data);
+/* Frees memory on the tb2 snapshot queue */
+void traceBuffer_ewrr_freetb2Queue(struct tb2Queue_struct *queue);
 /* Frees memory on the tb2data trace structure */
 void traceBfufer_ewrr_freetb2Trace(const bool clearSNCL,
                                    struct tb2Trace_struct *trace);
+/* Grows the staging buffers on a tb2data trace structure */
+int traceBuffer_ewrr_reservetb2Trace(const int maxpts, const int maxchunks,
+                                     struct tb2Trace_struct *trace);
 /* Set the SNCLs of messages we'll retain */
 int traceBuffer_ewrr_settb2Data(const int ntraces,
                                 const char **nets,
@@ -182,10 +271,28 @@ int traceBuffer_ewrr_settb2Data(const int ntraces,
                                 const char **chans,
                                 const char **locs,
                                 struct tb2Data_struct *tb2data);
+/* Lock-free single producer/single consumer tb2 snapshot handoff */
+int traceBuffer_ewrr_tb2QueueReserve(struct tb2Queue_struct *queue);
+void traceBuffer_ewrr_tb2QueuePublish(struct tb2Queue_struct *queue);
+int traceBuffer_ewrr_tb2QueuePeek(struct tb2Queue_struct *queue);
+void traceBuffer_ewrr_tb2QueueRelease(struct tb2Queue_struct *queue);
+void traceBuffer_ewrr_tb2QueuePublishBacklog(struct tb2Queue_struct *queue,
+                                             const double time);
+/* Unpack the samples of a tracebuf2 message with the given kernel */
+int traceBuffer_ewrr_unpackSamples(const enum tb2Unpack_kernel kernel,
+                                   const int npts, const int lswap,
+                                   const int dtype,
+                                   const double t0, const double dt,
+                                   const char *__restrict__ msg,
+                                   int *__restrict__ resp,
+                                   double *__restrict__ times);
 /* Unpack messages */
 int traceBuffer_ewrr_unpackTraceBuf2Messages(
     const int nRead,
     const char *msgs,
+    const int *msgOffset,
+    const struct snclIndex_struct *snclIndex,
+    const bool lappend,
     struct tb2Data_struct *tb2Data);
 /* Reads a chunk of data from a Data group */
 double *traceBuffer_h5_readData(const hid_t groupID,
@@ -193,10 +300,18 @@ double *traceBuffer_h5_readData(const hid_t groupID,
                                 int *maxpts,
                                 double *dt, double *ts1, double *ts2,
                                 double *gain, int *ierr);
+/* Reads the [t1, t2] hyperslab from a Data group */
+int traceBuffer_h5_readDataSlab(const hid_t groupID,
+                                const int ntraces,
+                                const double t1, const double t2,
+                                struct h5trace_struct *traces);
 /* Sets data in h5 file */
 int traceBuffer_h5_setData(const double currentTime,
                            struct tb2Data_struct tb2Data,
                            struct h5traceBuffer_struct h5traceBuffer);
+/* Maps the traces to the tracebuffer2 data */
+int traceBuffer_h5_setTb2DataMap(const struct snclIndex_struct *snclIndex,
+                                 struct h5traceBuffer_struct *h5traceBuffer);
 /* Copies the trace buffer to the GFAST structure */
 int traceBuffer_h5_copyTraceBufferToGFAST(
     struct h5traceBuffer_struct *traceBuffer,
@@ -243,6 +358,28 @@ int traceBuffer_h5_setIntegerScalar(const hid_t groupID,
                                     const char *citem,
                                     const int scalar);
 
+/* Initialize the SNCL hash index */
+int traceBuffer_sncl_initialize(const int maxids,
+                                struct snclIndex_struct *snclIndex);
+/* Free the SNCL hash index */
+void traceBuffer_sncl_finalize(struct snclIndex_struct *snclIndex);
+/* Make the NET.STA.CHAN.LOC key for a SNCL */
+int traceBuffer_sncl_makeKey(const char *netw, const char *stnm,
+                             const char *chan, const char *loc,
+                             char key[SNCL_KEY_LEN]);
+/* Intern a SNCL and return its id */
+int traceBuffer_sncl_insert(const char *netw, const char *stnm,
+                            const char *chan, const char *loc,
+                            struct snclIndex_struct *snclIndex);
+int traceBuffer_sncl_insertKey(const char *key,
+                               struct snclIndex_struct *snclIndex);
+/* Look up the id of a SNCL */
+int traceBuffer_sncl_find(const char *netw, const char *stnm,
+                          const char *chan, const char *loc,
+                          const struct snclIndex_struct *snclIndex);
+int traceBuffer_sncl_findKey(const char *key,
+                             const struct snclIndex_struct *snclIndex);
+
 #define GFAST_traceBuffer_h5_copyTraceBufferToGFAST(...)       \
               traceBuffer_h5_copyTraceBufferToGFAST(__VA_ARGS__)
 #define GFAST_traceBuffer_h5_finalize(...)       \
@@ -263,6 +400,20 @@ int traceBuffer_h5_setIntegerScalar(const hid_t groupID,
               traceBuffer_h5_setIntegerScalar(__VA_ARGS__)
 #define GFAST_traceBuffer_h5_setTraceBufferFromGFAST(...)       \
               traceBuffer_h5_setTraceBufferFromGFAST(__VA_ARGS__)
+#define GFAST_traceBuffer_sncl_initialize(...)       \
+              traceBuffer_sncl_initialize(__VA_ARGS__)
+#define GFAST_traceBuffer_sncl_finalize(...)       \
+              traceBuffer_sncl_finalize(__VA_ARGS__)
+#define GFAST_traceBuffer_sncl_makeKey(...)       \
+              traceBuffer_sncl_makeKey(__VA_ARGS__)
+#define GFAST_traceBuffer_sncl_insert(...)       \
+              traceBuffer_sncl_insert(__VA_ARGS__)
+#define GFAST_traceBuffer_sncl_insertKey(...)       \
+              traceBuffer_sncl_insertKey(__VA_ARGS__)
+#define GFAST_traceBuffer_sncl_find(...)       \
+              traceBuffer_sncl_find(__VA_ARGS__)
+#define GFAST_traceBuffer_sncl_findKey(...)       \
+              traceBuffer_sncl_findKey(__VA_ARGS__)
 
 #ifdef __cplusplus
 }
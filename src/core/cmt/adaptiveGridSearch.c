@@ -0,0 +1,391 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include <float.h>
+#include "gfast_core.h"
+#include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
+
+static int evaluateNodes(const int l1, const int nnew,
+                         const int verbose,
+                         const bool deviatoric,
+                         const double *__restrict__ evalEastings,
+                         const double *__restrict__ evalNorthings,
+                         const double *__restrict__ evalDepths,
+                         const double *__restrict__ utmRecvEasting,
+                         const double *__restrict__ utmRecvNorthing,
+                         const double *__restrict__ staAlt,
+                         const double *__restrict__ nObsOffset,
+                         const double *__restrict__ eObsOffset,
+                         const double *__restrict__ uObsOffset,
+                         const double *__restrict__ nWts,
+                         const double *__restrict__ eWts,
+                         const double *__restrict__ uWts,
+                         double *__restrict__ work,
+                         double *__restrict__ nWork,
+                         double *__restrict__ eWork,
+                         double *__restrict__ uWork,
+                         double *__restrict__ mts,
+                         double *__restrict__ objfn);
+static bool isEvaluated(const int nevals,
+                        const double x, const double y, const double z,
+                        const double *__restrict__ evalEastings,
+                        const double *__restrict__ evalNorthings,
+                        const double *__restrict__ evalDepths);
+
+/*!
+ * @brief Performs a coarse-to-fine CMT search over source position and
+ *        depth.  The coarse grid of nlons x nlats x ndeps nodes centered
+ *        on the source is evaluated first.  Then, at each refinement, the
+ *        grid spacing is halved and the (up to) 26 neighbors of the node
+ *        with the smallest objective function \f$ l_2 / pct_{dc} \f$ are
+ *        evaluated.  The search stops after nrefine refinements or when
+ *        maxEvals nodes have been evaluated.  Results are only retained
+ *        for the evaluated nodes.
+ *
+ * @param[in] l1               number of sites
+ * @param[in] nlats            number of northings in coarse grid
+ * @param[in] nlons            number of eastings in coarse grid
+ * @param[in] ndeps            number of depths in coarse grid
+ * @param[in] nrefine          max number of refinements of the coarse grid
+ * @param[in] maxEvals         max number of nodes to evaluate.  this must
+ *                             be at least nlats*nlons*ndeps.
+ * @param[in] verbose          controls verbosity (< 2 is quiet)
+ * @param[in] deviatoric       if true then the moment tensor is
+ *                             constrained to be deviatoric.  this must
+ *                             be true.
+ * @param[in] utmSrcEasting    source UTM easting about which the coarse
+ *                             grid is centered (m)
+ * @param[in] utmSrcNorthing   source UTM northing about which the coarse
+ *                             grid is centered (m)
+ * @param[in] dx               coarse grid easting spacing (m)
+ * @param[in] dy               coarse grid northing spacing (m)
+ * @param[in] srcDepths        coarse grid depths (km) in increasing
+ *                             order and evenly spaced [ndeps]
+ * @param[in] utmRecvEasting   receiver UTM easting positions (m) [l1]
+ * @param[in] utmRecvNorthing  receiver UTM northing positions (m) [l1]
+ * @param[in] staAlt           station elevations above sea level (m) [l1]
+ * @param[in] nObsOffset       observed north offsets (m) [l1]
+ * @param[in] eObsOffset       observed east offsets (m) [l1]
+ * @param[in] uObsOffset       observed vertical offsets (m) [l1]
+ * @param[in] nWts             data weights on north offsets [l1]
+ * @param[in] eWts             data weights on east offsets [l1]
+ * @param[in] uWts             data weights on vertical offsets [l1]
+ *
+ * @param[out] nevals          number of nodes evaluated
+ * @param[out] iopt            index of the optimal node in [0, nevals)
+ * @param[out] evalEastings    UTM eastings of evaluated nodes (m)
+ *                             [maxEvals]
+ * @param[out] evalNorthings   UTM northings of evaluated nodes (m)
+ *                             [maxEvals]
+ * @param[out] evalDepths      depths of evaluated nodes (km) [maxEvals]
+ * @param[out] mts             moment tensors at the evaluated nodes
+ *                             packed
+ *                             \f$ \{m_{xx}, m_{yy}, m_{zz},
+ *                                   m_{xy}, m_{xz}, m_{yz} \} \f$
+ *                             in NED coordinates [6*maxEvals]
+ * @param[out] objfn           objective function at the evaluated nodes
+ *                             [maxEvals]
+ * @param[out] nEst            estimated north offsets at the evaluated
+ *                             nodes.  the i'th site at the j'th node is
+ *                             accessed by j*l1 + i [l1*maxEvals]
+ * @param[out] eEst            estimated east offsets at the evaluated
+ *                             nodes [l1*maxEvals]
+ * @param[out] uEst            estimated vertical offsets at the evaluated
+ *                             nodes [l1*maxEvals]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_cmt_adaptiveGridSearch(const int l1,
+                                const int nlats, const int nlons,
+                                const int ndeps,
+                                const int nrefine, const int maxEvals,
+                                const int verbose,
+                                const bool deviatoric,
+                                const double utmSrcEasting,
+                                const double utmSrcNorthing,
+                                const double dx, const double dy,
+                                const double *__restrict__ srcDepths,
+                                const double *__restrict__ utmRecvEasting,
+                                const double *__restrict__ utmRecvNorthing,
+                                const double *__restrict__ staAlt,
+                                const double *__restrict__ nObsOffset,
+                                const double *__restrict__ eObsOffset,
+                                const double *__restrict__ uObsOffset,
+                                const double *__restrict__ nWts,
+                                const double *__restrict__ eWts,
+                                const double *__restrict__ uWts,
+                                int *nevals, int *iopt,
+                                double *__restrict__ evalEastings,
+                                double *__restrict__ evalNorthings,
+                                double *__restrict__ evalDepths,
+                                double *__restrict__ mts,
+                                double *__restrict__ objfn,
+                                double *__restrict__ nEst,
+                                double *__restrict__ eEst,
+                                double *__restrict__ uEst)
+{
+    double *work, hx, hy, hz, x, xmax, xmin, y, ymax, ymin, z, zmax, zmin;
+    int idep, ierr, ilat, ilon, ix, iy, iz, irefine, j, k, maxBatch,
+        ncoarse, nnew, nrem;
+    //------------------------------------------------------------------------//
+    //
+    // Error check
+    *nevals = 0;
+    *iopt =-1;
+    ierr = 0;
+    ncoarse = nlats*nlons*ndeps;
+    if (l1 < 2 || nlats < 1 || nlons < 1 || ndeps < 1 || nrefine < 0)
+    {
+        LOG_ERRMSG("Invalid sizes l1=%d nlats=%d nlons=%d ndeps=%d nrefine=%d",
+                   l1, nlats, nlons, ndeps, nrefine);
+        return -1;
+    }
+    if (maxEvals < ncoarse)
+    {
+        LOG_ERRMSG("Evaluation budget %d is smaller than coarse grid %d",
+                   maxEvals, ncoarse);
+        return -1;
+    }
+    if ((nlons > 1 && !(dx > 0.0)) || (nlats > 1 && !(dy > 0.0)))
+    {
+        LOG_ERRMSG("Invalid grid spacing dx=%f dy=%f", dx, dy);
+        return -1;
+    }
+    if (srcDepths == NULL || evalEastings == NULL ||
+        evalNorthings == NULL || evalDepths == NULL ||
+        mts == NULL || objfn == NULL ||
+        nEst == NULL || eEst == NULL || uEst == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+    // Workspace for the largest batch
+    maxBatch = ncoarse;
+    if (maxBatch < 26){maxBatch = 26;}
+    work  = memory_calloc64f(CMT_DECOMP_LWORK*maxBatch + 8*maxBatch);
+    // Coarse grid centered on the source
+    hx = 0.0;
+    hy = 0.0;
+    hz = 0.0;
+    if (nlons > 1){hx = dx;}
+    if (nlats > 1){hy = dy;}
+    if (ndeps > 1)
+    {
+        hz = (srcDepths[ndeps-1] - srcDepths[0])/(double) (ndeps - 1);
+    }
+    xmin = utmSrcEasting  - (double) (nlons/2)*hx;
+    ymin = utmSrcNorthing - (double) (nlats/2)*hy;
+    zmin = srcDepths[0];
+    xmax = xmin + (double) (nlons - 1)*hx;
+    ymax = ymin + (double) (nlats - 1)*hy;
+    zmax = srcDepths[ndeps-1];
+    for (ilon=0; ilon<nlons; ilon++)
+    {
+        for (ilat=0; ilat<nlats; ilat++)
+        {
+            for (idep=0; idep<ndeps; idep++)
+            {
+                k = ilon*nlats*ndeps + ilat*ndeps + idep;
+                evalEastings[k]  = xmin + (double) ilon*hx;
+                evalNorthings[k] = ymin + (double) ilat*hy;
+                evalDepths[k]    = srcDepths[idep];
+            }
+        }
+    }
+    nnew = ncoarse;
+    for (irefine=0; irefine<=nrefine; irefine++)
+    {
+        // Refine about the current optimum
+        if (irefine > 0)
+        {
+            hx = 0.5*hx;
+            hy = 0.5*hy;
+            hz = 0.5*hz;
+            nnew = 0;
+            nrem = maxEvals - *nevals;
+            for (ix=-1; ix<=1; ix++)
+            {
+                for (iy=-1; iy<=1; iy++)
+                {
+                    for (iz=-1; iz<=1; iz++)
+                    {
+                        if (nnew == nrem){continue;}
+                        x = evalEastings[*iopt]  + (double) ix*hx;
+                        y = evalNorthings[*iopt] + (double) iy*hy;
+                        z = evalDepths[*iopt]    + (double) iz*hz;
+                        if (x < xmin || x > xmax || y < ymin || y > ymax ||
+                            z < zmin || z > zmax)
+                        {
+                            continue;
+                        }
+                        if (isEvaluated(*nevals + nnew, x, y, z,
+                                        evalEastings, evalNorthings,
+                                        evalDepths))
+                        {
+                            continue;
+                        }
+                        evalEastings[*nevals+nnew]  = x;
+                        evalNorthings[*nevals+nnew] = y;
+                        evalDepths[*nevals+nnew]    = z;
+                        nnew = nnew + 1;
+                    }
+                }
+            }
+            if (nnew == 0){break;}
+        }
+        // Evaluate the new nodes
+        ierr = evaluateNodes(l1, nnew, verbose, deviatoric,
+                             &evalEastings[*nevals],
+                             &evalNorthings[*nevals],
+                             &evalDepths[*nevals],
+                             utmRecvEasting, utmRecvNorthing, staAlt,
+                             nObsOffset, eObsOffset, uObsOffset,
+                             nWts, eWts, uWts,
+                             work,
+                             &nEst[l1*(*nevals)],
+                             &eEst[l1*(*nevals)],
+                             &uEst[l1*(*nevals)],
+                             &mts[6*(*nevals)], &objfn[*nevals]);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("Error evaluating nodes at refinement %d", irefine);
+            goto ERROR;
+        }
+        // Update the optimum
+        for (j=0; j<nnew; j++)
+        {
+            k = *nevals + j;
+            if (*iopt >= 0 && objfn[k] >= objfn[*iopt]){continue;}
+            *iopt = k;
+        }
+        *nevals = *nevals + nnew;
+        if (*nevals == maxEvals){break;}
+    }
+    if (verbose > 2)
+    {
+        LOG_DEBUGMSG("Adaptive CMT search evaluated %d nodes", *nevals);
+    }
+ERROR:;
+    memory_free64f(&work);
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Inverts for the moment tensors at a batch of nodes and computes
+ *        the objective function l2/pct_dc as in eewUtils_driveCMT.
+ */
+static int evaluateNodes(const int l1, const int nnew,
+                         const int verbose,
+                         const bool deviatoric,
+                         const double *__restrict__ evalEastings,
+                         const double *__restrict__ evalNorthings,
+                         const double *__restrict__ evalDepths,
+                         const double *__restrict__ utmRecvEasting,
+                         const double *__restrict__ utmRecvNorthing,
+                         const double *__restrict__ staAlt,
+                         const double *__restrict__ nObsOffset,
+                         const double *__restrict__ eObsOffset,
+                         const double *__restrict__ uObsOffset,
+                         const double *__restrict__ nWts,
+                         const double *__restrict__ eWts,
+                         const double *__restrict__ uWts,
+                         double *__restrict__ work,
+                         double *__restrict__ nWork,
+                         double *__restrict__ eWork,
+                         double *__restrict__ uWork,
+                         double *__restrict__ mts,
+                         double *__restrict__ objfn)
+{
+    double *dip1, *dip2, *Mw, *pct_dc, *rak1, *rak2, *str1, *str2,
+           eres, nres, sum_res2, ures;
+    int i, ierr, j;
+    ierr = core_cmt_solveNormalEquations(l1, nnew, verbose, deviatoric,
+                                         evalEastings,
+                                         evalNorthings,
+                                         evalDepths,
+                                         utmRecvEasting,
+                                         utmRecvNorthing,
+                                         staAlt,
+                                         nObsOffset,
+                                         eObsOffset,
+                                         uObsOffset,
+                                         nWts,
+                                         eWts,
+                                         uWts,
+                                         nWork,
+                                         eWork,
+                                         uWork,
+                                         mts,
+                                         NULL);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error solving for moment tensors");
+        return -1;
+    }
+    pct_dc = &work[CMT_DECOMP_LWORK*nnew];
+    Mw   = &pct_dc[nnew];
+    str1 = &Mw[nnew];
+    str2 = &str1[nnew];
+    dip1 = &str2[nnew];
+    dip2 = &dip1[nnew];
+    rak1 = &dip2[nnew];
+    rak2 = &rak1[nnew];
+    ierr = core_cmt_decomposeMomentTensor_work(nnew, mts,
+                                               CMT_DECOMP_LWORK*nnew, work,
+                                               pct_dc, Mw,
+                                               str1, str2,
+                                               dip1, dip2,
+                                               rak1, rak2);
+    if (ierr < 0)
+    {
+        LOG_ERRMSG("%s", "Error decomposing moment tensors");
+        return -1;
+    }
+    for (j=0; j<nnew; j++)
+    {
+        // Nodes that couldn't be decomposed can't be optimal
+        if (pct_dc[j] <= 0.0)
+        {
+            objfn[j] = DBL_MAX;
+            continue;
+        }
+        sum_res2 = 0.0;
+        for (i=0; i<l1; i++)
+        {
+            nres = nObsOffset[i] - nWork[j*l1+i];
+            eres = eObsOffset[i] - eWork[j*l1+i];
+            ures = uObsOffset[i] - uWork[j*l1+i];
+            sum_res2 = sum_res2 + nres*nres + eres*eres + ures*ures;
+        }
+        objfn[j] = sqrt(sum_res2)/pct_dc[j];
+    }
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Determines if the node (x, y, z) has already been evaluated.
+ */
+static bool isEvaluated(const int nevals,
+                        const double x, const double y, const double z,
+                        const double *__restrict__ evalEastings,
+                        const double *__restrict__ evalNorthings,
+                        const double *__restrict__ evalDepths)
+{
+    int i;
+    for (i=0; i<nevals; i++)
+    {
+        if (fabs(evalEastings[i] - x) < 1.e-3 &&
+            fabs(evalNorthings[i] - y) < 1.e-3 &&
+            fabs(evalDepths[i] - z) < 1.e-6)
+        {
+            return true;
+        }
+    }
+    return false;
+}
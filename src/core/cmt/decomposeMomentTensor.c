@@ -3,8 +3,13 @@
 #include "gfast_core.h"
 #include "compearth.h"
 #include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
 
 #define TEST_COMPEARTH 0
+#ifndef CMT_DECOMP_CHUNK
+#define CMT_DECOMP_CHUNK 32 /*!< Number of moment tensors each thread
+                                 decomposes at a time. */
+#endif
 #if (TEST_COMPEARTH == 1)
 #include "cmopad/cmopad.h"
 #endif
@@ -36,7 +41,8 @@
  * @param[out] rake2      rake on nodal plane 2 (degrees) for each moment
  *                        tensor [nmt]
  *
- * @result 0 indicates success
+ * @result 0 indicates success.  otherwise, this is the number of moment
+ *         tensors that could not be decomposed.  their outputs are zero.
  *
  * @author Ben Baker, ISTI
  *
@@ -51,6 +57,68 @@ int core_cmt_decomposeMomentTensor(const int nmt,
                                    double *__restrict__ dip2,
                                    double *__restrict__ rake1,
                                    double *__restrict__ rake2)
+{
+    double *work;
+    int ierr, lwork;
+    //------------------------------------------------------------------------//
+    lwork = CMT_DECOMP_LWORK*nmt;
+    work = memory_calloc64f(lwork);
+    ierr = core_cmt_decomposeMomentTensor_work(nmt, M, lwork, work,
+                                               DC_pct, Mw,
+                                               strike1, strike2,
+                                               dip1, dip2,
+                                               rake1, rake2);
+    memory_free64f(&work);
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Finds the moment tensor decompositions of the NED moment tensors
+ *        using a preallocated workspace.  This is intended for decomposing
+ *        all the moment tensors in a grid search in one call.  The moment
+ *        tensors are decomposed in chunks which, if PARALLEL_CMT is
+ *        defined, are distributed among threads.  If a chunk fails then
+ *        its moment tensors are decomposed one at a time so that a bad
+ *        moment tensor only loses its own results.
+ *
+ * @param[in] nmt         number of moment tensors to decompose
+ * @param[in] M           moment tensors (Nm) in NED for all nmt moment
+ *                        tensors packed as in core_cmt_decomposeMomentTensor
+ *                        [6*nmt]
+ * @param[in] lwork       size of workspace.  this must be at least
+ *                        CMT_DECOMP_LWORK*nmt.
+ *
+ * @param[out] work       workspace [lwork]
+ * @param[out] DC_pct     double couple percentage for each moment tensor
+ *                        [nmt]
+ * @param[out] Mw         moment magnitude for each moment tensor [nmt]
+ * @param[out] strike1    strike of nodal plane 1 (degrees) [nmt]
+ * @param[out] strike2    strike of nodal plane 2 (degrees) [nmt]
+ * @param[out] dip1       dip of nodal plane 1 (degrees) [nmt]
+ * @param[out] dip2       dip of nodal plane 2 (degrees) [nmt]
+ * @param[out] rake1      rake on nodal plane 1 (degrees) [nmt]
+ * @param[out] rake2      rake on nodal plane 2 (degrees) [nmt]
+ *
+ * @result 0 indicates success.  otherwise, this is the number of moment
+ *         tensors that could not be decomposed.  their double couple
+ *         percentages, magnitudes, and nodal planes are zero.
+ *         -1 indicates the workspace is too small.
+ *
+ * @author Ben Baker, ISTI
+ *
+ */
+int core_cmt_decomposeMomentTensor_work(const int nmt,
+                                        const double *__restrict__ M,
+                                        const int lwork,
+                                        double *__restrict__ work,
+                                        double *__restrict__ DC_pct,
+                                        double *__restrict__ Mw,
+                                        double *__restrict__ strike1,
+                                        double *__restrict__ strike2,
+                                        double *__restrict__ dip1,
+                                        double *__restrict__ dip2,
+                                        double *__restrict__ rake1,
+                                        double *__restrict__ rake2)
 {
 #if (TEST_COMPEARTH == 1)
     struct cmopad_struct cmt;
@@ -59,38 +127,72 @@ int core_cmt_decomposeMomentTensor(const int nmt,
     int verbose = 0;
 #endif
     double *M0, *fp1, *fp2, *pAxis, *tAxis, *bAxis, *isoPct, *devPct, *clvdPct;
-    int i, ierr;
+    int i, i0, ic, ierr, j, n, nchunks;
     //------------------------------------------------------------------------//
     // Initialize output
     ierr = 0;
-    M0 = (double *) calloc((size_t) nmt, sizeof(double));
-    fp1 = (double *) calloc((size_t) (3*nmt), sizeof(double));
-    fp2 = (double *) calloc((size_t) (3*nmt), sizeof(double));
-    pAxis = (double *) calloc((size_t) (3*nmt), sizeof(double));
-    bAxis = (double *) calloc((size_t) (3*nmt), sizeof(double));
-    tAxis = (double *) calloc((size_t) (3*nmt), sizeof(double)); 
-    isoPct = (double *) calloc((size_t) nmt, sizeof(double));
-    devPct = (double *) calloc((size_t) nmt, sizeof(double));
-    clvdPct = (double *) calloc((size_t) nmt, sizeof(double));
-    ierr = compearth_standardDecomposition(nmt, M, CE_NED,
-                                           M0, Mw, fp1, fp2,
-                                           pAxis, bAxis, tAxis,
-                                           isoPct, devPct, DC_pct, clvdPct);
-    if (ierr != 0)
+    if (nmt < 1){return 0;}
+    if (work == NULL || lwork < CMT_DECOMP_LWORK*nmt)
     {
-        LOG_ERRMSG("%s", "Error in compearth moment tensor decomposition");
-        array_zeros64f_work(nmt, DC_pct);
-        array_zeros64f_work(nmt, Mw);
-        array_zeros64f_work(nmt, strike1);
-        array_zeros64f_work(nmt, strike2);
-        array_zeros64f_work(nmt, dip1);
-        array_zeros64f_work(nmt, dip2);
-        array_zeros64f_work(nmt, rake1);
-        array_zeros64f_work(nmt, rake2);
+        LOG_ERRMSG("Workspace must be size %d", CMT_DECOMP_LWORK*nmt);
+        return -1;
     }
-    else
+    // Partition the workspace
+    M0 = work;
+    fp1 = &M0[nmt];
+    fp2 = &fp1[3*nmt];
+    pAxis = &fp2[3*nmt];
+    bAxis = &pAxis[3*nmt];
+    tAxis = &bAxis[3*nmt];
+    isoPct = &tAxis[3*nmt];
+    devPct = &isoPct[nmt];
+    clvdPct = &devPct[nmt];
+    nchunks = (nmt + CMT_DECOMP_CHUNK - 1)/CMT_DECOMP_CHUNK;
+#ifdef PARALLEL_CMT
+    #pragma omp parallel for \
+     firstprivate(nmt) private(i, i0, j, n) \
+     shared(bAxis, clvdPct, DC_pct, devPct, dip1, dip2, fp1, fp2, isoPct, \
+            M, M0, Mw, nchunks, pAxis, rake1, rake2, strike1, strike2, \
+            tAxis) \
+     reduction(+:ierr) default(none)
+#endif
+    for (ic=0; ic<nchunks; ic++)
     {
-        for (i=0; i<nmt; i++)
+        i0 = ic*CMT_DECOMP_CHUNK;
+        n = nmt - i0;
+        if (n > CMT_DECOMP_CHUNK){n = CMT_DECOMP_CHUNK;}
+        if (compearth_standardDecomposition(n, &M[6*i0], CE_NED,
+                                            &M0[i0], &Mw[i0],
+                                            &fp1[3*i0], &fp2[3*i0],
+                                            &pAxis[3*i0], &bAxis[3*i0],
+                                            &tAxis[3*i0],
+                                            &isoPct[i0], &devPct[i0],
+                                            &DC_pct[i0], &clvdPct[i0]) != 0)
+        {
+            // Retry one at a time so that only the bad tensors are lost
+            for (i=i0; i<i0+n; i++)
+            {
+                if (compearth_standardDecomposition(1, &M[6*i], CE_NED,
+                                                    &M0[i], &Mw[i],
+                                                    &fp1[3*i], &fp2[3*i],
+                                                    &pAxis[3*i], &bAxis[3*i],
+                                                    &tAxis[3*i],
+                                                    &isoPct[i], &devPct[i],
+                                                    &DC_pct[i],
+                                                    &clvdPct[i]) != 0)
+                {
+                    DC_pct[i] = 0.0;
+                    Mw[i] = 0.0;
+                    for (j=0; j<3; j++)
+                    {
+                        fp1[3*i+j] = 0.0;
+                        fp2[3*i+j] = 0.0;
+                    }
+                    ierr = ierr + 1;
+                }
+            }
+        }
+        for (i=i0; i<i0+n; i++)
         {
             strike1[i] = fp1[3*i];
             dip1[i]    = fp1[3*i+1];
@@ -100,15 +202,11 @@ int core_cmt_decomposeMomentTensor(const int nmt,
             rake2[i]   = fp2[3*i+2];
         }
     }
-    free(M0);
-    free(fp1);
-    free(fp2);
-    free(pAxis);
-    free(bAxis);
-    free(tAxis);
-    free(isoPct);
-    free(devPct);
-    free(clvdPct);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("Error compearth could not decompose %d of %d tensors",
+                   ierr, nmt);
+    }
 #if (TEST_COMPEARTH == 1)
     for (i=0; i<nmt; i++)
     {
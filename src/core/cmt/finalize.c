@@ -15,6 +15,7 @@
 void core_cmt_finalizeResults(struct GFAST_cmtResults_struct *cmt)
 {
     if (cmt == NULL){return;}
+    core_cmt_finalizeGreensCache(cmt);
     memory_free64f(&cmt->l2);
     memory_free64f(&cmt->pct_dc);
     memory_free64f(&cmt->objfn);
@@ -33,6 +34,7 @@ void core_cmt_finalizeResults(struct GFAST_cmtResults_struct *cmt)
     memory_free64f(&cmt->Einp);
     memory_free64f(&cmt->Ninp);
     memory_free64f(&cmt->Uinp);
+    memory_free64f(&cmt->decompWork);
     memory_free8l(&cmt->lsiteUsed);
     memset(cmt, 0, sizeof(struct GFAST_cmtResults_struct));
     return;
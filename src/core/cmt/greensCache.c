@@ -0,0 +1,534 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+#ifdef GFAST_USE_INTEL
+ #ifdef __clang__
+  #pragma clang diagnostic push
+  #pragma clang diagnostic ignored "-Weverything"
+ #endif
+ #include <mkl_lapacke.h>
+ #include <mkl_cblas.h>
+ #ifdef __clang__
+  #pragma clang diagnostic pop
+ #endif
+#else
+#include <lapacke.h>
+#include <cblas.h>
+#endif
+#include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
+#include "iscl/time/time.h"
+
+#define MAX_CMT_EVENTS 4 /*!< Number of sources whose Green's functions
+                              are cached.  This accommodates several
+                              simultaneous events. */
+
+static struct GFAST_cmtGreens_struct *
+    getEvent(const double utmSrcEasting, const double utmSrcNorthing,
+             const double *__restrict__ srcDepths,
+             struct GFAST_cmtGreensCache_struct *cache);
+
+/*!
+ * @brief Allocates the CMT Green's function cache on the CMT results
+ *        structure.  The space for each source is allocated on its first
+ *        use.
+ *
+ * @param[in,out] cmt    on input holds the number of sites and depths.
+ *                       on output the Green's function cache is set.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_cmt_initializeGreensCache(struct GFAST_cmtResults_struct *cmt)
+{
+    struct GFAST_cmtGreensCache_struct *cache;
+    //------------------------------------------------------------------------//
+    core_cmt_finalizeGreensCache(cmt);
+    if (cmt->nsites < 1 || cmt->ndeps < 1)
+    {
+        LOG_ERRMSG("Invalid number of sites %d or depths %d",
+                   cmt->nsites, cmt->ndeps);
+        return -1;
+    }
+    cache = (struct GFAST_cmtGreensCache_struct *)
+            calloc(1, sizeof(struct GFAST_cmtGreensCache_struct));
+    cache->nsites = cmt->nsites;
+    cache->ndeps = cmt->ndeps;
+    cache->maxEvents = MAX_CMT_EVENTS;
+    cache->events = (struct GFAST_cmtGreens_struct *)
+                    calloc((size_t) cache->maxEvents,
+                           sizeof(struct GFAST_cmtGreens_struct));
+    cmt->greens = cache;
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Frees the CMT Green's function cache.
+ *
+ * @param[in,out] cmt    on output the Green's function cache has been freed
+ *                       and set to NULL.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+void core_cmt_finalizeGreensCache(struct GFAST_cmtResults_struct *cmt)
+{
+    struct GFAST_cmtGreensCache_struct *cache;
+    struct GFAST_cmtGreens_struct *greens;
+    int i;
+    if (cmt == NULL || cmt->greens == NULL){return;}
+    cache = cmt->greens;
+    for (i=0; i<cache->maxEvents; i++)
+    {
+        greens = &cache->events[i];
+        memory_free64f(&greens->G);
+        memory_free64f(&greens->ata);
+        memory_free64f(&greens->diagWt);
+        memory_free64f(&greens->recvEasting);
+        memory_free64f(&greens->recvNorthing);
+        memory_free64f(&greens->staAlt);
+        memory_free64f(&greens->srcDepths);
+        memory_free32i(&greens->rowSite);
+        memory_free8l(&greens->lactive);
+    }
+    free(cache->events);
+    free(cache);
+    cmt->greens = NULL;
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Performs the deviatoric moment tensor depth grid search of
+ *        core_cmt_depthGridSearch with cached Green's functions.  The
+ *        forward model depends only on the source location, depth, active
+ *        sites, and data weights so the Green's functions and the
+ *        \f$ 5 \times 5 \f$ normal equations \f$ G^T W^T W G \f$ at each
+ *        depth are retained between calls.  When only the offsets change
+ *        the moment tensor is obtained by forming \f$ G^T W^T W U \f$ and
+ *        solving with the Cholesky solver of
+ *        core_cmt_solveNormalEquations.  When sites join the inversion
+ *        their rows are appended and \f$ G_{new}^T W^T W G_{new} \f$ is
+ *        added to the normal equations which costs
+ *        \f$ \mathcal{O}(n_{new}) \f$.  If a site leaves, moves, or has its
+ *        weights changed then the normal equations are recomputed.
+ *
+ * @param[in,out] cache        on input holds the cached normal equations.
+ *                             on output holds the normal equations for
+ *                             this source.
+ * @param[in] nsites           total number of sites
+ * @param[in] luse             if true then the k'th site is in the
+ *                             inversion.  the active sites must appear in
+ *                             the compacted arrays in the order of their
+ *                             site index [nsites]
+ * @param[in] l1               number of active sites
+ * @param[in] ndeps            number of source depths
+ * @param[in] verbose          controls verbosity (< 2 is quiet)
+ * @param[in] deviatoric       if true then the moment tensor is
+ *                             constrained to be deviatoric.  this must
+ *                             be true.
+ * @param[in] utmSrcEasting    source UTM easting position (m)
+ * @param[in] utmSrcNorthing   source UTM northing position (m)
+ * @param[in] srcDepths        source depths (km) [ndeps]
+ * @param[in] utmRecvEasting   receiver UTM easting positions (m) [l1]
+ * @param[in] utmRecvNorthing  receiver UTM northing positions (m) [l1]
+ * @param[in] staAlt           station elevations above sea level (m) [l1]
+ * @param[in] nObsOffset       observed north offsets (m) [l1]
+ * @param[in] eObsOffset       observed east offsets (m) [l1]
+ * @param[in] uObsOffset       observed vertical offsets (m) [l1]
+ * @param[in] nWts             data weights on north offsets [l1]
+ * @param[in] eWts             data weights on east offsets [l1]
+ * @param[in] uWts             data weights on vertical offsets [l1]
+ *
+ * @param[out] nEst            estimated north offsets at each depth.
+ *                             the i'th site at the idep'th depth is
+ *                             accessed by idep*l1 + i [l1*ndeps]
+ * @param[out] eEst            estimated east offsets at each depth
+ *                             [l1*ndeps]
+ * @param[out] uEst            estimated vertical offsets at each depth
+ *                             [l1*ndeps]
+ * @param[out] mts             moment tensors at each depth packed
+ *                             \f$ \{m_{xx}, m_{yy}, m_{zz},
+ *                                   m_{xy}, m_{xz}, m_{yz} \} \f$
+ *                             in NED coordinates [6*ndeps]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_cmt_cachedDepthGridSearch(struct GFAST_cmtGreensCache_struct *cache,
+                                   const int nsites,
+                                   const bool *__restrict__ luse,
+                                   const int l1, const int ndeps,
+                                   const int verbose,
+                                   const bool deviatoric,
+                                   const double utmSrcEasting,
+                                   const double utmSrcNorthing,
+                                   const double *__restrict__ srcDepths,
+                                   const double *__restrict__ utmRecvEasting,
+                                   const double *__restrict__ utmRecvNorthing,
+                                   const double *__restrict__ staAlt,
+                                   const double *__restrict__ nObsOffset,
+                                   const double *__restrict__ eObsOffset,
+                                   const double *__restrict__ uObsOffset,
+                                   const double *__restrict__ nWts,
+                                   const double *__restrict__ eWts,
+                                   const double *__restrict__ uWts,
+                                   double *__restrict__ nEst,
+                                   double *__restrict__ eEst,
+                                   double *__restrict__ uEst,
+                                   double *__restrict__ mts)
+{
+    struct GFAST_cmtGreens_struct *greens;
+    double *ata, *B, *diagWt, *G, *U, *UP, *W2U, *xadd, *yadd,
+           *zrs_negative, A[25], atb[5], S[5],
+           eq_alt, m11, m12, m13, m22, m23, m33;
+    int *cidx, *siteAdd, i, ic, idep, ierr, ierr1, j, k, m, m0, mrowsMax,
+        nadd, p, q;
+    bool lrebuild;
+    const int ncols = 5;
+    //------------------------------------------------------------------------//
+    //
+    // Initialize
+    ierr = 0;
+    cidx = NULL;
+    siteAdd = NULL;
+    diagWt = NULL;
+    U = NULL;
+    W2U = NULL;
+    xadd = NULL;
+    yadd = NULL;
+    // Error check
+    if (cache == NULL || luse == NULL)
+    {
+        if (cache == NULL){LOG_ERRMSG("%s", "cache is NULL");}
+        if (luse == NULL){LOG_ERRMSG("%s", "luse is NULL");}
+        return -1;
+    }
+    if (nsites != cache->nsites || ndeps != cache->ndeps)
+    {
+        LOG_ERRMSG("Inconsistent cache size %d %d %d %d",
+                   nsites, cache->nsites, ndeps, cache->ndeps);
+        return -1;
+    }
+    if (l1 < 2 || l1 > nsites)
+    {
+        LOG_ERRMSG("Error invalid number of input stations: %d", l1);
+        return -1;
+    }
+    if (srcDepths == NULL || utmRecvEasting == NULL ||
+        utmRecvNorthing == NULL || staAlt == NULL ||
+        nObsOffset == NULL || eObsOffset == NULL || uObsOffset == NULL ||
+        nEst == NULL || eEst == NULL || uEst == NULL || mts == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+    if (!deviatoric)
+    {
+        LOG_ERRMSG("%s", "Cannot perform general MT gridsearch!");
+        return -1;
+    }
+    // Initialize results to nothing
+    array_zeros64f_work(6*ndeps, mts);
+    array_zeros64f_work(l1*ndeps, uEst);
+    array_zeros64f_work(l1*ndeps, nEst);
+    array_zeros64f_work(l1*ndeps, eEst);
+    // Map the site indices to the compacted arrays
+    cidx = memory_calloc32i(nsites);
+    j = 0;
+    for (k=0; k<nsites; k++)
+    {
+        cidx[k] =-1;
+        if (!luse[k]){continue;}
+        cidx[k] = j;
+        j = j + 1;
+    }
+    if (j != l1)
+    {
+        LOG_ERRMSG("Site mask has %d sites but expected %d", j, l1);
+        ierr =-1;
+        goto ERROR;
+    }
+    // Set the RHS and data weights
+    diagWt = memory_calloc64f(3*l1);
+    U      = memory_calloc64f(3*l1);
+    ierr = core_cmt_setRHS(l1, nObsOffset, eObsOffset, uObsOffset, U);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error setting RHS!");
+        goto ERROR;
+    }
+    ierr = core_cmt_setDiagonalWeightMatrix(l1, nWts, eWts, uWts, diagWt);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Failed to set weight matrix - will set to identity");
+        for (i=0; i<3*l1; i++)
+        {
+            diagWt[i] = 1.0;
+        }
+        ierr = 0;
+    }
+    // Find this source's normal equations and figure out what changed
+    greens = getEvent(utmSrcEasting, utmSrcNorthing, srcDepths, cache);
+    lrebuild = !greens->lvalid;
+    for (k=0; k<nsites; k++)
+    {
+        if (lrebuild){break;}
+        if (!greens->lactive[k]){continue;}
+        if (!luse[k]){lrebuild = true; break;}
+        ic = cidx[k];
+        if (greens->recvEasting[k]  != utmRecvEasting[ic]  ||
+            greens->recvNorthing[k] != utmRecvNorthing[ic] ||
+            greens->staAlt[k]       != staAlt[ic]          ||
+            greens->diagWt[3*k+0]   != diagWt[3*ic+0]      ||
+            greens->diagWt[3*k+1]   != diagWt[3*ic+1]      ||
+            greens->diagWt[3*k+2]   != diagWt[3*ic+2])
+        {
+            lrebuild = true;
+        }
+    }
+    if (lrebuild)
+    {
+        if (verbose > 2)
+        {
+            LOG_DEBUGMSG("%s", "Computing CMT Green's functions");
+        }
+        greens->nactive = 0;
+        array_zeros8l_work(nsites, greens->lactive);
+    }
+    // Sites that must be appended to the normal equations
+    siteAdd = memory_calloc32i(l1);
+    nadd = 0;
+    for (k=0; k<nsites; k++)
+    {
+        if (!luse[k] || greens->lactive[k]){continue;}
+        siteAdd[nadd] = k;
+        nadd = nadd + 1;
+    }
+    if (nadd > 0 && !lrebuild && verbose > 2)
+    {
+        LOG_DEBUGMSG("Appending %d sites to CMT normal equations", nadd);
+    }
+    xadd = memory_calloc64f(nadd + 1);
+    yadd = memory_calloc64f(nadd + 1);
+    m0 = 3*greens->nactive;
+    for (i=0; i<nadd; i++)
+    {
+        k = siteAdd[i];
+        ic = cidx[k];
+        j = greens->nactive + i;
+        greens->rowSite[j] = k;
+        greens->lactive[k] = true;
+        greens->recvEasting[k] = utmRecvEasting[ic];
+        greens->recvNorthing[k] = utmRecvNorthing[ic];
+        greens->staAlt[k] = staAlt[ic];
+        greens->diagWt[3*k+0] = diagWt[3*ic+0];
+        greens->diagWt[3*k+1] = diagWt[3*ic+1];
+        greens->diagWt[3*k+2] = diagWt[3*ic+2];
+        xadd[i] = utmRecvEasting[ic] - utmSrcEasting;
+        yadd[i] = utmRecvNorthing[ic] - utmSrcNorthing;
+    }
+    greens->nactive = greens->nactive + nadd;
+    greens->lvalid = true;
+    m = 3*greens->nactive;
+    mrowsMax = 3*nsites;
+    // Doubly weighted data W^T W U in the cached row order
+    W2U = memory_calloc64f(m);
+    for (j=0; j<greens->nactive; j++)
+    {
+        ic = cidx[greens->rowSite[j]];
+        for (i=0; i<3; i++)
+        {
+            W2U[3*j+i] = diagWt[3*ic+i]*diagWt[3*ic+i]*U[3*ic+i];
+        }
+    }
+    // Grid search on source depths
+    time_tic();
+    if (verbose > 2)
+    {
+        LOG_DEBUGMSG("%s", "Beginning search on depths...");
+    }
+#ifdef PARALLEL_CMT
+    #pragma omp parallel \
+     firstprivate(l1, mrowsMax, ncols, ndeps) \
+     private (A, ata, atb, B, G, i, idep, ierr1, eq_alt, j, k, m11, m12, \
+              m13, m22, m23, m33, p, q, S, UP, zrs_negative) \
+     shared (cidx, eEst, greens, m, m0, mts, nadd, nEst, \
+             siteAdd, srcDepths, uEst, W2U, xadd, yadd) \
+     reduction(+:ierr) default (none)
+    {
+#endif
+    B            = memory_calloc64f(3*nadd*ncols + 1);
+    UP           = memory_calloc64f(m);
+    zrs_negative = memory_calloc64f(nadd + 1);
+#ifdef PARALLEL_CMT
+    #pragma omp for
+#endif
+    for (idep=0; idep<ndeps; idep++)
+    {
+        G = &greens->G[idep*mrowsMax*ncols];
+        ata = &greens->ata[idep*ncols*ncols];
+        if (nadd > 0)
+        {
+            // Green's functions for the new sites
+            eq_alt = srcDepths[idep]*1.e3;
+            for (i=0; i<nadd; i++)
+            {
+                zrs_negative[i] =-(greens->staAlt[siteAdd[i]] + eq_alt);
+            }
+            ierr1 = core_cmt_setForwardModel(nadd, true,
+                                             yadd, xadd, zrs_negative,
+                                             &G[m0*ncols]);
+            if (ierr1 != 0)
+            {
+                LOG_ERRMSG("%s", "Error constructing Green's function matrix");
+                ierr = ierr + 1;
+                continue;
+            }
+            // Add the new weighted rows to the normal equations
+            for (i=0; i<3*nadd; i++)
+            {
+                for (k=0; k<ncols; k++)
+                {
+                    B[i*ncols+k] = greens->diagWt[3*siteAdd[i/3]+i%3]
+                                  *G[(m0+i)*ncols+k];
+                }
+            }
+            cblas_dsyrk(CblasRowMajor, CblasUpper, CblasTrans,
+                        ncols, 3*nadd, 1.0, B, ncols,
+                        (m0 > 0) ? 1.0 : 0.0, ata, ncols);
+        }
+        // Solve G^T W^T W G S = G^T W^T W U
+        cblas_dgemv(CblasRowMajor, CblasTrans,
+                    m, ncols, 1.0, G, ncols, W2U, 1, 0.0, atb, 1);
+        for (p=0; p<ncols; p++)
+        {
+            for (q=p; q<ncols; q++)
+            {
+                A[p*ncols+q] = ata[p*ncols+q];
+                A[q*ncols+p] = ata[p*ncols+q];
+            }
+        }
+        ierr1 = core_cmt_choleskySolve5(A, atb, S);
+        if (ierr1 != 0)
+        {
+            LOG_ERRMSG("%s", "Error singular CMT forward model");
+            ierr = ierr + 1;
+            continue;
+        }
+        // Collect the moment tensors in NED coordinates
+        m12 = S[0];
+        m13 = S[1];
+        m33 = S[2];
+        m23 = S[4];
+        m11 = S[3] - 0.5*S[2];
+        m22 =-S[3] - 0.5*S[2];
+        mts[6*idep+0] = m11; // mxx
+        mts[6*idep+1] = m22; // myy
+        mts[6*idep+2] = m33; // mzz
+        mts[6*idep+3] = m12; // mxy
+        mts[6*idep+4] = m13; // mxz
+        mts[6*idep+5] = m23; // myz
+        // Compute the forward problem and scatter back to the site order
+        cblas_dgemv(CblasRowMajor, CblasNoTrans,
+                    m, ncols, 1.0, G, ncols, S, 1, 0.0, UP, 1);
+        for (j=0; j<m/3; j++)
+        {
+            i = cidx[greens->rowSite[j]];
+            nEst[idep*l1+i] = UP[3*j+0];
+            eEst[idep*l1+i] = UP[3*j+1];
+            uEst[idep*l1+i] =-UP[3*j+2];
+        }
+    } // Loop on source depths
+    memory_free64f(&B);
+    memory_free64f(&UP);
+    memory_free64f(&zrs_negative);
+#ifdef PARALLEL_CMT
+    } // End the parallel region
+#endif
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Errors were detect during the grid search");
+        greens->lvalid = false;
+    }
+    else
+    {
+        if (verbose > 2)
+        {
+            LOG_DEBUGMSG("Grid-search time: %f (s)", time_toc());
+        }
+    }
+ERROR:;
+    memory_free32i(&cidx);
+    memory_free32i(&siteAdd);
+    memory_free64f(&diagWt);
+    memory_free64f(&U);
+    memory_free64f(&W2U);
+    memory_free64f(&xadd);
+    memory_free64f(&yadd);
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Returns the cached normal equations for this source.  If the source
+ *        is not cached then the least recently used entry is recycled and
+ *        marked invalid.
+ */
+static struct GFAST_cmtGreens_struct *
+    getEvent(const double utmSrcEasting, const double utmSrcNorthing,
+             const double *__restrict__ srcDepths,
+             struct GFAST_cmtGreensCache_struct *cache)
+{
+    struct GFAST_cmtGreens_struct *greens;
+    int i, iuse, ndeps, nsites;
+    ndeps = cache->ndeps;
+    nsites = cache->nsites;
+    cache->useCounter = cache->useCounter + 1;
+    iuse = 0;
+    for (i=0; i<cache->maxEvents; i++)
+    {
+        greens = &cache->events[i];
+        if (greens->lvalid &&
+            greens->srcEasting == utmSrcEasting &&
+            greens->srcNorthing == utmSrcNorthing &&
+            memcmp(greens->srcDepths, srcDepths,
+                   (size_t) ndeps*sizeof(double)) == 0)
+        {
+            greens->lastUse = cache->useCounter;
+            return greens;
+        }
+        if (!greens->lvalid && cache->events[iuse].lvalid){iuse = i;}
+        if (greens->lvalid == cache->events[iuse].lvalid &&
+            greens->lastUse < cache->events[iuse].lastUse)
+        {
+            iuse = i;
+        }
+    }
+    // Recycle the least recently used source
+    greens = &cache->events[iuse];
+    if (greens->G == NULL)
+    {
+        greens->G = memory_calloc64f(ndeps*3*nsites*5);
+        greens->ata = memory_calloc64f(ndeps*5*5);
+        greens->diagWt = memory_calloc64f(3*nsites);
+        greens->recvEasting = memory_calloc64f(nsites);
+        greens->recvNorthing = memory_calloc64f(nsites);
+        greens->staAlt = memory_calloc64f(nsites);
+        greens->srcDepths = memory_calloc64f(ndeps);
+        greens->rowSite = memory_calloc32i(nsites);
+        greens->lactive = memory_calloc8l(nsites);
+    }
+    greens->srcEasting = utmSrcEasting;
+    greens->srcNorthing = utmSrcNorthing;
+    memcpy(greens->srcDepths, srcDepths, (size_t) ndeps*sizeof(double));
+    greens->nactive = 0;
+    greens->lvalid = false;
+    greens->lastUse = cache->useCounter;
+    return greens;
+}
@@ -2,9 +2,13 @@
 #include <stdlib.h>
 #include <string.h>
 #include "gfast_core.h"
+#include "iscl/memory/memory.h"
 
 /*!
- * @brief Performs the CMT depth grid search.
+ * @brief Performs the CMT grid search over source positions and depths.
+ *        Rather than a QR factorization at each grid point the 5 x 5
+ *        normal equations are accumulated and solved for batches of grid
+ *        points with core_cmt_solveNormalEquations.
  *
  * @param[in] l1               number of sites
  * @param[in] ndeps            number of depths
@@ -88,7 +92,8 @@ int core_cmt_gridSearch(const int l1,
                         double *__restrict__ uEst,
                         double *__restrict__ mts)
 {
-    int ierr, ierr1, ilat, ilon, ilatLon;
+    double *xsrc, *ysrc, *zsrc;
+    int idep, ierr, ilat, ilatLon, iloc, ilon, nloc;
     //------------------------------------------------------------------------//
     //
     // Check for NULL arrays 
@@ -153,46 +158,48 @@ int core_cmt_gridSearch(const int l1,
         LOG_ERRMSG("%s", "Cannot perform general MT gridsearch!");
         return -1;
     }
-    // Loop on the longitudes (eastings)
-    ierr = 0;
-#ifdef PARALLEL_CMT
-    #pragma omp parallel for collapse(2) \
-     private(ilatLon, ilat, ilon) \
-     reduction(+:ierr), shared(nEst, eEst, uEst, mts) \
-     default(none)
-#endif
+    // Expand the grid so that the sources are solved in batches
+    nloc = nlons*nlats*ndeps;
+    xsrc = memory_calloc64f(nloc);
+    ysrc = memory_calloc64f(nloc);
+    zsrc = memory_calloc64f(nloc);
     for (ilon=0; ilon<nlons; ilon++)
     {
-        // Scan through the latitudes (northings)
         for (ilat=0; ilat<nlats; ilat++)
         {
             ilatLon = ilon*nlats + ilat;
-            ierr1 = core_cmt_depthGridSearch(l1, ndeps,
-                                             verbose,
-                                             deviatoric,
-                                             utmSrcEastings[ilatLon],
-                                             utmSrcNorthings[ilatLon],
-                                             srcDepths,
-                                             utmRecvEasting,
-                                             utmRecvNorthing,
-                                             staAlt,
-                                             nObsOffset,
-                                             eObsOffset,
-                                             uObsOffset,
-                                             nWts,
-                                             eWts,
-                                             uWts,
-                                             &nEst[ilatLon*ndeps*l1],
-                                             &eEst[ilatLon*ndeps*l1],
-                                             &uEst[ilatLon*ndeps*l1],
-                                             &mts[6*ilatLon*ndeps]);
-            if (ierr1 != 0)
+            for (idep=0; idep<ndeps; idep++)
             {
-                LOG_ERRMSG("Error calling depthGridSearch %d %d", ilat, ilon);
-                ierr = ierr + 1;
+                iloc = ilatLon*ndeps + idep;
+                xsrc[iloc] = utmSrcEastings[ilatLon];
+                ysrc[iloc] = utmSrcNorthings[ilatLon];
+                zsrc[iloc] = srcDepths[idep];
             }
-        } // loop on latitudes 
-    } // loop on longitudes
+        }
+    }
+    ierr = core_cmt_solveNormalEquations(l1, nloc,
+                                         verbose,
+                                         deviatoric,
+                                         xsrc,
+                                         ysrc,
+                                         zsrc,
+                                         utmRecvEasting,
+                                         utmRecvNorthing,
+                                         staAlt,
+                                         nObsOffset,
+                                         eObsOffset,
+                                         uObsOffset,
+                                         nWts,
+                                         eWts,
+                                         uWts,
+                                         nEst,
+                                         eEst,
+                                         uEst,
+                                         mts,
+                                         NULL);
+    memory_free64f(&xsrc);
+    memory_free64f(&ysrc);
+    memory_free64f(&zsrc);
     // Check if i encountered an error
     if (ierr != 0)
     {
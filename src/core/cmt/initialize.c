@@ -112,10 +112,20 @@ int core_cmt_initialize(struct GFAST_cmt_props_struct props,
     cmt->Ninp      = memory_calloc64f(cmt->nsites);
     cmt->Uinp      = memory_calloc64f(cmt->nsites);
     cmt->lsiteUsed = memory_calloc8l(cmt->nsites);
+    cmt->decompWork = memory_calloc64f(CMT_DECOMP_LWORK*nlld);
     /* TODO fix me */
     for (i=0; i<cmt->ndeps; i++)
     {
         cmt->srcDepths[i] = (double) (i + 1);
     }
+    // Green's function cache
+    if (cmt->nsites > 0)
+    {
+        if (core_cmt_initializeGreensCache(cmt) != 0)
+        {
+            LOG_ERRMSG("%s", "Error initializing Green's function cache");
+            return -1;
+        }
+    }
     return 0;
 }
@@ -42,7 +42,7 @@ int core_cmt_readIni(const char *propfilename,
                     struct GFAST_cmt_props_struct *cmt_props)
 {
     char var[256];
-    int ierr;
+    int ierr, ncoarse, stride;
     dictionary *ini;
     ierr = 1;
     memset(cmt_props, 0, sizeof(struct  GFAST_cmt_props_struct));
@@ -134,6 +134,44 @@ int core_cmt_readIni(const char *propfilename,
         LOG_ERRMSG("%s", "Error general CMT inversions not yet programmed");
         goto ERROR;
     }
+    setVarName(group, "cmt_adaptive_search\0", var);
+    cmt_props->ladaptive = iniparser_getboolean(ini, var, false);
+    setVarName(group, "cmt_adaptive_nrefine\0", var);
+    cmt_props->adaptive_nrefine = iniparser_getint(ini, var, 3);
+    if (cmt_props->adaptive_nrefine < 0 || cmt_props->adaptive_nrefine > 16)
+    {
+        LOG_ERRMSG("Error CMT adaptive refinements %d must be in [0,16]",
+                   cmt_props->adaptive_nrefine);
+        goto ERROR;
+    }
+    if (cmt_props->ladaptive && cmt_props->ngridSearch_deps > 1)
+    {
+        // The refined depths must land on the depth grid
+        stride = 1 << cmt_props->adaptive_nrefine;
+        ncoarse = (cmt_props->ngridSearch_deps - 1)/stride + 1;
+        if ((cmt_props->ngridSearch_deps - 1)%stride != 0)
+        {
+            LOG_ERRMSG("Error %d CMT depths can't be refined %d times; "
+                       "use %d or %d depths",
+                       cmt_props->ngridSearch_deps,
+                       cmt_props->adaptive_nrefine,
+                       (ncoarse - 1)*stride + 1, ncoarse*stride + 1);
+            goto ERROR;
+        }
+    }
+    else
+    {
+        ncoarse = cmt_props->ngridSearch_deps;
+    }
+    setVarName(group, "cmt_adaptive_max_evals\0", var);
+    cmt_props->adaptive_maxEvals
+        = iniparser_getint(ini, var, cmt_props->ngridSearch_deps);
+    if (cmt_props->ladaptive && cmt_props->adaptive_maxEvals < ncoarse)
+    {
+        LOG_WARNMSG("Increasing CMT adaptive evaluations from %d to %d",
+                    cmt_props->adaptive_maxEvals, ncoarse);
+        cmt_props->adaptive_maxEvals = ncoarse;
+    }
     ierr = 0;
 ERROR:;
     iniparser_freedict(ini);
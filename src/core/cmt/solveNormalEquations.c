@@ -0,0 +1,380 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+#include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
+
+#ifndef CMT_NE_BLOCK
+#define CMT_NE_BLOCK 8 /*!< Number of sources whose normal equations are
+                            accumulated together.  The accumulations are
+                            stored with the source varying fastest so the
+                            inner loops vectorize. */
+#endif
+
+/*!
+ * @brief Solves the deviatoric moment tensor inversion for a batch of
+ *        source locations with the normal equations.  Since there are only
+ *        five unknowns, rather than factoring the \f$ 3 l_1 \times 5 \f$
+ *        weighted forward model at each source, the \f$ 5 \times 5 \f$
+ *        matrix \f$ G^T W^T W G \f$ and the vector \f$ G^T W^T W U \f$ are
+ *        accumulated for blocks of sources and each system is solved with
+ *        an equilibrated Cholesky factorization.  The weighted residual
+ *        sum of squares follows from the same accumulations as
+ *         \f[
+ *           || W (U - G m) ||^2 = (WU)^T (WU) - m^T G^T W^T W U.
+ *         \f]
+ *
+ * @param[in] l1               number of sites
+ * @param[in] nsrc             number of source locations
+ * @param[in] verbose          controls verbosity (< 2 is quiet)
+ * @param[in] deviatoric       if true then the moment tensor is
+ *                             constrained to be deviatoric.  this must
+ *                             be true.
+ * @param[in] utmSrcEastings   source UTM easting positions (m) [nsrc]
+ * @param[in] utmSrcNorthings  source UTM northing positions (m) [nsrc]
+ * @param[in] srcDepths        source depths (km) [nsrc]
+ * @param[in] utmRecvEasting   receiver UTM easting positions (m) [l1]
+ * @param[in] utmRecvNorthing  receiver UTM northing positions (m) [l1]
+ * @param[in] staAlt           station elevations above sea level (m) [l1]
+ * @param[in] nObsOffset       observed north offsets (m) [l1]
+ * @param[in] eObsOffset       observed east offsets (m) [l1]
+ * @param[in] uObsOffset       observed vertical offsets (m) [l1]
+ * @param[in] nWts             data weights on north offsets [l1]
+ * @param[in] eWts             data weights on east offsets [l1]
+ * @param[in] uWts             data weights on vertical offsets [l1]
+ *
+ * @param[out] nEst            estimated north offsets at each source.
+ *                             the i'th site at the isrc'th source is
+ *                             accessed by isrc*l1 + i [l1*nsrc]
+ * @param[out] eEst            estimated east offsets at each source
+ *                             [l1*nsrc]
+ * @param[out] uEst            estimated vertical offsets at each source
+ *                             [l1*nsrc]
+ * @param[out] mts             moment tensors at each source packed
+ *                             \f$ \{m_{xx}, m_{yy}, m_{zz},
+ *                                   m_{xy}, m_{xz}, m_{yz} \} \f$
+ *                             in NED coordinates [6*nsrc]
+ * @param[out] wrss            if not NULL then this is the weighted
+ *                             residual sum of squares at each source
+ *                             [nsrc]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_cmt_solveNormalEquations(const int l1, const int nsrc,
+                                  const int verbose,
+                                  const bool deviatoric,
+                                  const double *__restrict__ utmSrcEastings,
+                                  const double *__restrict__ utmSrcNorthings,
+                                  const double *__restrict__ srcDepths,
+                                  const double *__restrict__ utmRecvEasting,
+                                  const double *__restrict__ utmRecvNorthing,
+                                  const double *__restrict__ staAlt,
+                                  const double *__restrict__ nObsOffset,
+                                  const double *__restrict__ eObsOffset,
+                                  const double *__restrict__ uObsOffset,
+                                  const double *__restrict__ nWts,
+                                  const double *__restrict__ eWts,
+                                  const double *__restrict__ uWts,
+                                  double *__restrict__ nEst,
+                                  double *__restrict__ eEst,
+                                  double *__restrict__ uEst,
+                                  double *__restrict__ mts,
+                                  double *__restrict__ wrss)
+{
+    double *diagWt, *G, *Gblk, *U, *WU, *xrs, *yrs, *zrs,
+           A[25], ata[25*CMT_NE_BLOCK], atb[5*CMT_NE_BLOCK], b[5],
+           *gE, *gN, *gU, btb, S[5], up, we, we2, wn, wn2, wu, wu2,
+           wtwu;
+    int c, i, ib, ierr, ierr1, isrc, j, k, kp, kq, nb, nblocks, p, q;
+    const int ncols = 5;
+    const int nrow = 3*ncols;
+    //------------------------------------------------------------------------//
+    //
+    // Initialize
+    ierr = 0;
+    diagWt = NULL;
+    U = NULL;
+    WU = NULL;
+    // Error check
+    if (l1 < 2 || nsrc < 1)
+    {
+        if (l1 < 2){LOG_ERRMSG("Error invalid number of sites: %d", l1);}
+        if (nsrc < 1){LOG_ERRMSG("Error invalid number of sources: %d", nsrc);}
+        return -1;
+    }
+    if (utmSrcEastings == NULL || utmSrcNorthings == NULL ||
+        srcDepths == NULL || utmRecvEasting == NULL ||
+        utmRecvNorthing == NULL || staAlt == NULL ||
+        nObsOffset == NULL || eObsOffset == NULL || uObsOffset == NULL ||
+        nEst == NULL || eEst == NULL || uEst == NULL || mts == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+    if (!deviatoric)
+    {
+        LOG_ERRMSG("%s", "Cannot perform general MT gridsearch!");
+        return -1;
+    }
+    array_zeros64f_work(6*nsrc, mts);
+    array_zeros64f_work(l1*nsrc, nEst);
+    array_zeros64f_work(l1*nsrc, eEst);
+    array_zeros64f_work(l1*nsrc, uEst);
+    if (wrss != NULL){array_zeros64f_work(nsrc, wrss);}
+    // Set the RHS and data weights
+    diagWt = memory_calloc64f(3*l1);
+    U      = memory_calloc64f(3*l1);
+    WU     = memory_calloc64f(3*l1);
+    ierr = core_cmt_setRHS(l1, nObsOffset, eObsOffset, uObsOffset, U);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error setting RHS!");
+        goto ERROR;
+    }
+    ierr = core_cmt_setDiagonalWeightMatrix(l1, nWts, eWts, uWts, diagWt);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Failed to set weight matrix - will set to identity");
+        for (i=0; i<3*l1; i++)
+        {
+            diagWt[i] = 1.0;
+        }
+        ierr = 0;
+    }
+    wtwu = 0.0;
+    for (i=0; i<3*l1; i++)
+    {
+        WU[i] = diagWt[i]*U[i];
+        wtwu = wtwu + WU[i]*WU[i];
+    }
+    nblocks = (nsrc + CMT_NE_BLOCK - 1)/CMT_NE_BLOCK;
+    if (verbose > 2)
+    {
+        LOG_DEBUGMSG("Solving %d CMT normal equations", nsrc);
+    }
+#ifdef PARALLEL_CMT
+    #pragma omp parallel \
+     firstprivate(l1, ncols, nblocks, nrow, nsrc, wtwu) \
+     private (A, ata, atb, b, btb, c, G, Gblk, gE, gN, gU, i, ib, ierr1, \
+              isrc, j, k, kp, kq, nb, p, q, S, up, we, we2, wn, wn2, wu, wu2, \
+              xrs, yrs, zrs) \
+     shared (diagWt, eEst, mts, nEst, srcDepths, staAlt, uEst, \
+             utmRecvEasting, utmRecvNorthing, utmSrcEastings, \
+             utmSrcNorthings, WU, wrss) \
+     reduction(+:ierr) default (none)
+    {
+#endif
+    G    = memory_calloc64f(nrow*CMT_NE_BLOCK);
+    Gblk = memory_calloc64f(nrow*l1*CMT_NE_BLOCK);
+    xrs  = memory_calloc64f(CMT_NE_BLOCK);
+    yrs  = memory_calloc64f(CMT_NE_BLOCK);
+    zrs  = memory_calloc64f(CMT_NE_BLOCK);
+#ifdef PARALLEL_CMT
+    #pragma omp for
+#endif
+    for (ib=0; ib<nblocks; ib++)
+    {
+        isrc = ib*CMT_NE_BLOCK;
+        nb = nsrc - isrc;
+        if (nb > CMT_NE_BLOCK){nb = CMT_NE_BLOCK;}
+        memset(ata, 0, sizeof(ata));
+        memset(atb, 0, sizeof(atb));
+        for (i=0; i<l1; i++)
+        {
+            // Green's functions for this site at each source in the block.
+            // note the convention of x (north) and y (east).
+            for (j=0; j<nb; j++)
+            {
+                xrs[j] = utmRecvNorthing[i] - utmSrcNorthings[isrc+j];
+                yrs[j] = utmRecvEasting[i]  - utmSrcEastings[isrc+j];
+                zrs[j] =-(staAlt[i] + srcDepths[isrc+j]*1.e3);
+            }
+            ierr1 = core_cmt_setForwardModel(nb, true, xrs, yrs, zrs, G);
+            if (ierr1 != 0)
+            {
+                LOG_ERRMSG("%s", "Error constructing Green's functions");
+                ierr = ierr + 1;
+                break;
+            }
+            // Transpose so that the source varies fastest
+            for (p=0; p<nrow; p++)
+            {
+                for (j=0; j<nb; j++)
+                {
+                    Gblk[(i*nrow+p)*CMT_NE_BLOCK+j] = G[j*nrow+p];
+                }
+            }
+            // Accumulate the upper triangle of the normal equations
+            gN = &Gblk[i*nrow*CMT_NE_BLOCK];
+            gE = &gN[ncols*CMT_NE_BLOCK];
+            gU = &gE[ncols*CMT_NE_BLOCK];
+            wn2 = diagWt[3*i+0]*diagWt[3*i+0];
+            we2 = diagWt[3*i+1]*diagWt[3*i+1];
+            wu2 = diagWt[3*i+2]*diagWt[3*i+2];
+            wn = diagWt[3*i+0]*WU[3*i+0];
+            we = diagWt[3*i+1]*WU[3*i+1];
+            wu = diagWt[3*i+2]*WU[3*i+2];
+            for (p=0; p<ncols; p++)
+            {
+                for (q=p; q<ncols; q++)
+                {
+                    k = (p*ncols + q)*CMT_NE_BLOCK;
+                    kp = p*CMT_NE_BLOCK;
+                    kq = q*CMT_NE_BLOCK;
+#ifdef _OPENMP
+                    #pragma omp simd
+#endif
+                    for (j=0; j<CMT_NE_BLOCK; j++)
+                    {
+                        ata[k+j] = ata[k+j]
+                                 + wn2*gN[kp+j]*gN[kq+j]
+                                 + we2*gE[kp+j]*gE[kq+j]
+                                 + wu2*gU[kp+j]*gU[kq+j];
+                    }
+                }
+                k = p*CMT_NE_BLOCK;
+#ifdef _OPENMP
+                #pragma omp simd
+#endif
+                for (j=0; j<CMT_NE_BLOCK; j++)
+                {
+                    atb[k+j] = atb[k+j]
+                             + wn*gN[k+j] + we*gE[k+j] + wu*gU[k+j];
+                }
+            }
+        } // Loop on sites
+        if (i < l1){continue;}
+        // Solve the normal equations at each source
+        for (j=0; j<nb; j++)
+        {
+            for (p=0; p<ncols; p++)
+            {
+                for (q=p; q<ncols; q++)
+                {
+                    A[p*ncols+q] = ata[(p*ncols+q)*CMT_NE_BLOCK+j];
+                    A[q*ncols+p] = A[p*ncols+q];
+                }
+                b[p] = atb[p*CMT_NE_BLOCK+j];
+            }
+            ierr1 = core_cmt_choleskySolve5(A, b, S);
+            if (ierr1 != 0)
+            {
+                LOG_ERRMSG("Singular normal equations at source %d", isrc+j);
+                ierr = ierr + 1;
+                continue;
+            }
+            // Collect the moment tensors in NED coordinates
+            mts[6*(isrc+j)+0] = S[3] - 0.5*S[2]; // mxx
+            mts[6*(isrc+j)+1] =-S[3] - 0.5*S[2]; // myy
+            mts[6*(isrc+j)+2] = S[2];            // mzz
+            mts[6*(isrc+j)+3] = S[0];            // mxy
+            mts[6*(isrc+j)+4] = S[1];            // mxz
+            mts[6*(isrc+j)+5] = S[4];            // myz
+            // Weighted residual from the accumulations
+            if (wrss != NULL)
+            {
+                btb = wtwu;
+                for (p=0; p<ncols; p++){btb = btb - S[p]*b[p];}
+                wrss[isrc+j] = fmax(0.0, btb);
+            }
+            // Compute the forward problem
+            for (i=0; i<l1; i++)
+            {
+                for (c=0; c<3; c++)
+                {
+                    up = 0.0;
+                    for (p=0; p<ncols; p++)
+                    {
+                        up = up + Gblk[(i*nrow+c*ncols+p)*CMT_NE_BLOCK+j]*S[p];
+                    }
+                    if (c == 0){nEst[(isrc+j)*l1+i] = up;}
+                    if (c == 1){eEst[(isrc+j)*l1+i] = up;}
+                    if (c == 2){uEst[(isrc+j)*l1+i] =-up;}
+                }
+            }
+        } // Loop on sources in block
+    } // Loop on blocks
+    memory_free64f(&G);
+    memory_free64f(&Gblk);
+    memory_free64f(&xrs);
+    memory_free64f(&yrs);
+    memory_free64f(&zrs);
+#ifdef PARALLEL_CMT
+    } // End the parallel region
+#endif
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Errors were detected solving normal equations");
+    }
+ERROR:;
+    memory_free64f(&diagWt);
+    memory_free64f(&U);
+    memory_free64f(&WU);
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Solves the 5 x 5 symmetric positive definite system A x = b of the
+ *        deviatoric moment tensor normal equations with a Cholesky
+ *        factorization.  The system is first scaled to unit diagonal since
+ *        the Green's functions are O(1e-23).
+ *
+ * @param[in] A      symmetric matrix.  only the lower triangle is
+ *                   referenced [5 x 5]
+ * @param[in] b      right hand side [5]
+ *
+ * @param[out] x     solution [5]
+ *
+ * @result 0 indicates success.  -1 indicates A is not positive definite.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_cmt_choleskySolve5(const double *__restrict__ A,
+                            const double *__restrict__ b,
+                            double *__restrict__ x)
+{
+    double L[25], d[5], sum;
+    int i, j, k;
+    for (i=0; i<5; i++)
+    {
+        if (!(A[i*5+i] > 0.0)){return -1;}
+        d[i] = 1.0/sqrt(A[i*5+i]);
+    }
+    // Factor D A D = L L^T
+    for (j=0; j<5; j++)
+    {
+        sum = A[j*5+j]*d[j]*d[j];
+        for (k=0; k<j; k++){sum = sum - L[j*5+k]*L[j*5+k];}
+        if (!(sum > 0.0)){return -1;}
+        L[j*5+j] = sqrt(sum);
+        for (i=j+1; i<5; i++)
+        {
+            sum = A[i*5+j]*d[i]*d[j];
+            for (k=0; k<j; k++){sum = sum - L[i*5+k]*L[j*5+k];}
+            L[i*5+j] = sum/L[j*5+j];
+        }
+    }
+    // Forward substitution L y = D b
+    for (i=0; i<5; i++)
+    {
+        sum = b[i]*d[i];
+        for (k=0; k<i; k++){sum = sum - L[i*5+k]*x[k];}
+        x[i] = sum/L[i*5+i];
+    }
+    // Back substitution L^T z = y then x = D z
+    for (i=4; i>=0; i--)
+    {
+        sum = x[i];
+        for (k=i+1; k<5; k++){sum = sum - L[k*5+i]*x[k];}
+        x[i] = sum/L[i*5+i];
+    }
+    for (i=0; i<5; i++){x[i] = x[i]*d[i];}
+    return 0;
+}
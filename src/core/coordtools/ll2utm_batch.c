@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "gfast_core.h"
+
+/*!
+ * @brief Converts arrays of lat and lon values to UTM northings and
+ *        eastings.  This is the batch equivalent of core_coordtools_ll2utm.
+ *        The ellipsoid and series constants are computed once and each
+ *        point requires a single sin/cos pair; the sin(2 lat), sin(4 lat),
+ *        and sin(6 lat) terms are obtained with the double angle identities.
+ *        The loop has no branches besides the zone and hemisphere selects
+ *        and therefore vectorizes.
+ *
+ * @param[in] n             number of points
+ * @param[in] lat_deg       latitudes to convert to UTM northing (degrees)
+ *                          [n]
+ * @param[in] lon_deg       longitudes to convert to UTM easting (degrees)
+ *                          [n]
+ * @param[in] zone          if -1 then the central meridian for each point
+ *                          is chosen from its longitude.
+ *                          otherwise all points are projected into this
+ *                          zone which must be in the range [1,60].
+ *
+ * @param[out] UTMNorthing  corresponding UTM northings (m) [n].
+ *                          points in the southern hemisphere are given a
+ *                          false northing of 10,000 km.
+ * @param[out] UTMEasting   corresponding UTM eastings (m) [n]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_coordtools_ll2utm_batch(const int n,
+                                 const double *__restrict__ lat_deg,
+                                 const double *__restrict__ lon_deg,
+                                 const int zone,
+                                 double *__restrict__ UTMNorthing,
+                                 double *__restrict__ UTMEasting)
+{
+    double A, A2, C, c, cos2, cos4, lat, lon, lon_deg_use, lon0, M,
+           s, sin2, sin4, sin6, t, T, v;
+    int i, zone_loc;
+    // WGS84 parameters
+    const double a = 6378137.0000;
+    const double esq = 0.006694380069978522;
+    const double epsq = esq/(1.0 - esq);
+    const double k0 = 0.9996;
+    const double pi180 = M_PI/180.0;
+    // Meridian arc coefficients
+    const double esq2 = esq*esq;
+    const double esq3 = esq2*esq;
+    const double m0 = a*(1.0 - esq/4.0 - 3.0*esq2/64.0 - 5.0*esq3/256.0);
+    const double m2 = a*(3.0*esq/8.0 + 3.0*esq2/32.0 + 45.0*esq3/1024.0);
+    const double m4 = a*(15.0*esq2/256.0 + 45.0*esq3/1024.0);
+    const double m6 = a*(35.0*esq3/3072.0);
+    const double c6 = 330.0*epsq;
+    const double c5 = 58.0*epsq;
+    const double zoneLon0 = ((double) (abs(zone)*6) - 183.0)*pi180;
+    //------------------------------------------------------------------------//
+    if (n < 1){return 0;}
+    if (lat_deg == NULL || lon_deg == NULL ||
+        UTMNorthing == NULL || UTMEasting == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+    if (zone !=-1 && (zone < 1 || zone > 60))
+    {
+        LOG_ERRMSG("Invalid UTM zone %d", zone);
+        return -1;
+    }
+#ifdef _OPENMP
+    #pragma omp simd private(A, A2, C, c, cos2, cos4, lat, lon, lon_deg_use, \
+                             lon0, M, s, sin2, sin4, sin6, t, T, v, zone_loc)
+#endif
+    for (i=0; i<n; i++)
+    {
+        lon_deg_use = lon_deg[i];
+        if (lon_deg_use > 180.0){lon_deg_use = lon_deg_use - 360.0;}
+        lon = lon_deg_use*pi180;
+        lat = lat_deg[i]*pi180;
+        lon0 = zoneLon0;
+        if (zone ==-1)
+        {
+            zone_loc = (int) (fmod(floor((lon_deg_use + 180.0)/6.0), 60.0)
+                            + 0.5) + 1;
+            lon0 = ((double) (zone_loc*6) - 183.0)*pi180;
+        }
+        s = sin(lat);
+        c = cos(lat);
+        t = s/c;
+        sin2 = 2.0*s*c;
+        cos2 = 1.0 - 2.0*s*s;
+        sin4 = 2.0*sin2*cos2;
+        cos4 = 1.0 - 2.0*sin2*sin2;
+        sin6 = sin4*cos2 + cos4*sin2;
+
+        A = (lon - lon0)*c;
+        A2 = A*A;
+        v = a/sqrt(1.0 - esq*s*s);
+        T = t*t;
+        C = epsq*c*c;
+        M = m0*lat - m2*sin2 + m4*sin4 - m6*sin6;
+
+        UTMNorthing[i] = k0*( M + v*t*A2*( 0.5
+                              + A2*( (5.0 - T + 9.0*C + 4.0*C*C)/24.0
+                              + A2*(61.0 - 58.0*T + T*T + 600.0*C - c6)/720.0
+                              ) ) );
+        UTMEasting[i] = k0*v*A*( 1.0
+                               + A2*( (1.0 - T + C)/6.0
+                               + A2*(5.0 - 18.0*T + T*T + 72.0*C - c5)/120.0
+                               ) ) + 500000.0;
+        if (lat_deg[i] < 0.0){UTMNorthing[i] = UTMNorthing[i] + 10000000.0;}
+    }
+    return 0;
+}
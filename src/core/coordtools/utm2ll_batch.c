@@ -0,0 +1,118 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "gfast_core.h"
+
+/*!
+ * @brief Converts arrays of UTM northings and eastings in a given zone to
+ *        lat and lon.  This is the batch equivalent of
+ *        core_coordtools_utm2ll.  The footpoint latitude series constants
+ *        are computed once and each point requires one sin/cos pair for
+ *        the rectifying latitude and one for the footpoint latitude.
+ *        The loop is branch-free and therefore vectorizes.
+ *
+ * @param[in] n            number of points
+ * @param[in] zone         UTM zone
+ * @param[in] lnorthp      if true then the points are in the northern
+ *                         hemisphere.  \n
+ *                         if false then the points are in the southern
+ *                         hemisphere.
+ * @param[in] UTMNorthing  UTM north coordinates to convert to latitude (m)
+ *                         [n]
+ * @param[in] UTMEasting   UTM east coordinates to convert to longitude (m)
+ *                         [n]
+ *
+ * @param[out] lat_deg     corresponding latitudes (degrees) [n].  this may
+ *                         be the same array as UTMNorthing.
+ * @param[out] lon_deg     corresponding longitudes (degrees) [0,360) [n].
+ *                         this may be the same array as UTMEasting.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_coordtools_utm2ll_batch(const int n,
+                                 const int zone, const bool lnorthp,
+                                 const double *UTMNorthing,
+                                 const double *UTMEasting,
+                                 double *lat_deg, double *lon_deg)
+{
+    double C1, C1_2, c1, cm, cos2, cos4, D, D_2, lat, lat1, lon, M1, mu1,
+           p1, s1, sin2, sin4, sin6, sin8, sm, t1, T1, T1_2, v1, w;
+    int i;
+    // WGS84 parameters
+    const double a = 6378137.0000;
+    const double esq = 0.006694380069978522;
+    const double epsq = esq/(1.0 - esq);
+    const double k0 = 0.9996;
+    const double pi180 = M_PI/180.0;
+    const double pi180i = 180.0/M_PI;
+    // Footpoint latitude series coefficients
+    const double e1 = ( 1.0 - sqrt(1.0 - esq) ) / ( 1.0 + sqrt(1.0 - esq) );
+    const double e1_2 = e1*e1;
+    const double e1_3 = e1_2*e1;
+    const double e1_4 = e1_3*e1;
+    const double f2 = 3.0*e1/2.0 - 27.0/32.0*e1_3;
+    const double f4 = 21.0/16.0*e1_2 - 55.0/32.0*e1_4;
+    const double f6 = 151.0/96.0*e1_3;
+    const double f8 = 1097.0/512.0*e1_4;
+    const double muScal = 1.0/(k0*a*(1.0 - esq/4.0 - 3.0/64.0*esq*esq
+                                   - 5.0/256.0*esq*esq*esq));
+    const double falseNorthing = lnorthp ? 0.0 : 10000000.0;
+    const double lon0 = (abs(zone)*6.0 - 183.0)*pi180;
+    //------------------------------------------------------------------------//
+    if (n < 1){return 0;}
+    if (UTMNorthing == NULL || UTMEasting == NULL ||
+        lat_deg == NULL || lon_deg == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+#ifdef _OPENMP
+    #pragma omp simd private(C1, C1_2, c1, cm, cos2, cos4, D, D_2, lat, \
+                             lat1, lon, M1, mu1, p1, s1, sin2, sin4, sin6, \
+                             sin8, sm, t1, T1, T1_2, v1, w)
+#endif
+    for (i=0; i<n; i++)
+    {
+        M1 = UTMNorthing[i] - falseNorthing;
+        D = UTMEasting[i] - 500000.0;
+        // Footpoint latitude
+        mu1 = M1*muScal;
+        sm = sin(mu1);
+        cm = cos(mu1);
+        sin2 = 2.0*sm*cm;
+        cos2 = 1.0 - 2.0*sm*sm;
+        sin4 = 2.0*sin2*cos2;
+        cos4 = 1.0 - 2.0*sin2*sin2;
+        sin6 = sin4*cos2 + cos4*sin2;
+        sin8 = 2.0*sin4*cos4;
+        lat1 = mu1 + f2*sin2 + f4*sin4 + f6*sin6 + f8*sin8;
+        s1 = sin(lat1);
+        c1 = cos(lat1);
+        t1 = s1/c1;
+        T1 = t1*t1;
+        C1 = epsq*c1*c1;
+        w = 1.0 - esq*s1*s1;
+        v1 = a/sqrt(w);
+        p1 = a*(1.0 - esq)/(w*sqrt(w));
+        D = D/v1/k0;
+
+        C1_2 = C1*C1;
+        T1_2 = T1*T1;
+        D_2 = D*D;
+        lat = lat1 - (v1*t1/p1)*D_2*( 0.5
+                   - D_2*( (5.0 + 3.0*T1 + 10.0*C1 - 4.0*C1_2 - 9.0*epsq)/24.0
+                   - D_2*(61.0 + 90.0*T1 + 298.0*C1 + 45.0*T1_2
+                        - 252.0*epsq - 3.0*C1_2)/720.0 ) );
+        lon = lon0 + D*( 1.0
+                   - D_2*( (1.0 + 2.0*T1 + C1)/6.0
+                   - D_2*(5.0 - 2.0*C1 + 28.0*T1 - 3.0*C1_2 + 8.0*epsq
+                        + 24.0*T1_2)/120.0 ) )/c1;
+        lat_deg[i] = lat*pi180i;
+        lon_deg[i] = lon*pi180i;
+        if (lon_deg[i] < 0.0){lon_deg[i] = lon_deg[i] + 360.0;}
+    }
+    return 0;
+}
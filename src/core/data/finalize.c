@@ -15,6 +15,7 @@
 void core_data_finalize(struct GFAST_data_struct *gps_data)
 {
     int k;
+    core_data_finalizeGeometry(gps_data);
     if (gps_data->data != NULL)
     {
        for (k=0; k<gps_data->stream_length; k++)
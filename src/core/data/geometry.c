@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+#include "iscl/memory/memory.h"
+
+#define MAX_HYPODIST 16 /*!< Number of memoized distance tables.  This
+                             accommodates the PGD, CMT, and FF zones for
+                             several simultaneous events. */
+
+static int naturalZone(const double lon_deg);
+static void addZone(const int zone, int *nzones, int zoneIndex[61]);
+static void setSite(const int k, const double lat, const double lon,
+                    const double alt,
+                    struct GFAST_stationGeometry_struct *geometry);
+
+/*!
+ * @brief Builds the station geometry cache.  The UTM coordinates of every
+ *        site are precomputed in each site's natural UTM zone, the
+ *        neighboring zones, and any UTM zones fixed in the properties so
+ *        that the waveform processors and inversion drivers need not call
+ *        core_coordtools_ll2utm for receivers on every tick.
+ *
+ * @param[in] props          GFAST properties.  the PGD, CMT, and FF UTM
+ *                           zones are cached if they are specified.
+ *
+ * @param[in,out] gps_data   on input holds the site locations.
+ *                           on output the geometry cache is set.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_data_initializeGeometry(struct GFAST_props_struct props,
+                                 struct GFAST_data_struct *gps_data)
+{
+    struct GFAST_stationGeometry_struct *geometry;
+    int i, ierr, k, nsites, zone;
+    //------------------------------------------------------------------------//
+    core_data_finalizeGeometry(gps_data);
+    nsites = gps_data->stream_length;
+    if (nsites < 1 || gps_data->data == NULL)
+    {
+        LOG_ERRMSG("%s", "No sites for geometry");
+        return -1;
+    }
+    geometry = (struct GFAST_stationGeometry_struct *)
+               calloc(1, sizeof(struct GFAST_stationGeometry_struct));
+    // Figure out the zones to cache
+    for (i=0; i<61; i++){geometry->zoneIndex[i] =-1;}
+    for (k=0; k<nsites; k++)
+    {
+        zone = naturalZone(gps_data->data[k].sta_lon);
+        addZone(zone, &geometry->nzones, geometry->zoneIndex);
+        addZone(zone == 1 ? 60 : zone - 1,
+                &geometry->nzones, geometry->zoneIndex);
+        addZone(zone == 60 ? 1 : zone + 1,
+                &geometry->nzones, geometry->zoneIndex);
+    }
+    addZone(props.pgd_props.utm_zone, &geometry->nzones, geometry->zoneIndex);
+    addZone(props.cmt_props.utm_zone, &geometry->nzones, geometry->zoneIndex);
+    addZone(props.ff_props.utm_zone, &geometry->nzones, geometry->zoneIndex);
+    // Set space
+    geometry->nsites = nsites;
+    geometry->utmNorthing = memory_calloc64f(geometry->nzones*nsites);
+    geometry->utmEasting = memory_calloc64f(geometry->nzones*nsites);
+    geometry->sta_lat = memory_calloc64f(nsites);
+    geometry->sta_lon = memory_calloc64f(nsites);
+    geometry->sta_alt = memory_calloc64f(nsites);
+    geometry->maxHypoDist = MAX_HYPODIST;
+    geometry->hypoDist = (struct GFAST_hypoDistance_struct *)
+                         calloc((size_t) geometry->maxHypoDist,
+                                sizeof(struct GFAST_hypoDistance_struct));
+    for (i=0; i<geometry->maxHypoDist; i++)
+    {
+        geometry->hypoDist[i].distance = memory_calloc64f(nsites);
+    }
+    // Tabulate the UTM coordinates
+    for (k=0; k<nsites; k++)
+    {
+        geometry->sta_lat[k] = gps_data->data[k].sta_lat;
+        geometry->sta_lon[k] = gps_data->data[k].sta_lon;
+        geometry->sta_alt[k] = gps_data->data[k].sta_alt;
+    }
+    gps_data->geometry = geometry;
+    for (zone=1; zone<=60; zone++)
+    {
+        i = geometry->zoneIndex[zone];
+        if (i < 0){continue;}
+        ierr = core_coordtools_ll2utm_batch(nsites,
+                                            geometry->sta_lat,
+                                            geometry->sta_lon,
+                                            zone,
+                                            &geometry->utmNorthing[i*nsites],
+                                            &geometry->utmEasting[i*nsites]);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("Error computing UTM coordinates in zone %d", zone);
+            core_data_finalizeGeometry(gps_data);
+            return -1;
+        }
+    }
+    if (props.verbose > 2)
+    {
+        LOG_DEBUGMSG("Cached UTM coordinates of %d sites in %d zones",
+                     nsites, geometry->nzones);
+    }
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Releases the station geometry cache.
+ *
+ * @param[in,out] gps_data   on exit the geometry cache has been freed.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+void core_data_finalizeGeometry(struct GFAST_data_struct *gps_data)
+{
+    struct GFAST_stationGeometry_struct *geometry;
+    int i;
+    geometry = gps_data->geometry;
+    if (geometry == NULL){return;}
+    if (geometry->hypoDist != NULL)
+    {
+        for (i=0; i<geometry->maxHypoDist; i++)
+        {
+            memory_free64f(&geometry->hypoDist[i].distance);
+        }
+        free(geometry->hypoDist);
+    }
+    memory_free64f(&geometry->utmNorthing);
+    memory_free64f(&geometry->utmEasting);
+    memory_free64f(&geometry->sta_lat);
+    memory_free64f(&geometry->sta_lon);
+    memory_free64f(&geometry->sta_alt);
+    free(geometry);
+    gps_data->geometry = NULL;
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Gets the UTM coordinates of the k'th site.  If the site's
+ *        coordinates are cached for this zone and the site hasn't moved then
+ *        this is a table lookup.  Otherwise, the coordinates are computed.
+ *
+ * @param[in] geometry    station geometry cache.  this may be NULL.
+ * @param[in] k           site index
+ * @param[in] lat         site latitude (degrees)
+ * @param[in] lon         site longitude (degrees)
+ * @param[in] zone        UTM zone (1-60) in which to compute the coordinates.
+ *                        if -1 then the zone is estimated from lon.
+ *
+ * @param[out] northing   site UTM northing (m)
+ * @param[out] easting    site UTM easting (m)
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+void core_data_getSiteUTM(
+    const struct GFAST_stationGeometry_struct *geometry,
+    const int k, const double lat, const double lon, const int zone,
+    double *northing, double *easting)
+{
+    int i, zone_loc;
+    bool lnorthp;
+    if (geometry != NULL && k >= 0 && k < geometry->nsites &&
+        zone >= 1 && zone <= 60)
+    {
+        i = geometry->zoneIndex[zone];
+        if (i >= 0 && lat == geometry->sta_lat[k] &&
+            lon == geometry->sta_lon[k])
+        {
+            *northing = geometry->utmNorthing[i*geometry->nsites + k];
+            *easting = geometry->utmEasting[i*geometry->nsites + k];
+            return;
+        }
+    }
+    zone_loc = zone;
+    core_coordtools_ll2utm(lat, lon, northing, easting, &lnorthp, &zone_loc);
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Returns the memoized source-receiver hypocentral distances for the
+ *        given hypocenter.  The table is computed only when the hypocenter,
+ *        UTM zone, or site metadata changes.
+ *
+ * @param[in] gps_data    holds the site locations and geometry cache.
+ *                        if a site moved then its cached coordinates are
+ *                        refreshed and all memoized tables are invalidated.
+ * @param[in] ev_lat      source latitude (degrees) [-90,90]
+ * @param[in] ev_lon      source longitude (degrees) [0,360]
+ * @param[in] ev_dep      source depth (km) (positive down)
+ * @param[in] utm_zone    if not -12345 then this is the desired UTM zone.
+ *                        otherwise, the zone is estimated from the source.
+ *
+ * @param[out] ierr       0 indicates success
+ *
+ * @result the distance table.  the hypocentral distances are given in km.
+ *         NULL if there is no geometry cache.  the table is valid until the
+ *         next call.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+const struct GFAST_hypoDistance_struct *
+    core_data_getHypocentralDistances(struct GFAST_data_struct gps_data,
+                                      const double ev_lat,
+                                      const double ev_lon,
+                                      const double ev_dep,
+                                      const int utm_zone,
+                                      int *ierr)
+{
+    struct GFAST_stationGeometry_struct *geometry;
+    struct GFAST_hypoDistance_struct *hd;
+    double x2, y2;
+    int i, k, zoneIn;
+    bool lmoved, lnorthp;
+    //------------------------------------------------------------------------//
+    *ierr = 0;
+    geometry = gps_data.geometry;
+    if (geometry == NULL || geometry->nsites != gps_data.stream_length)
+    {
+        *ierr = 1;
+        return NULL;
+    }
+    // Refresh any sites whose metadata changed
+    lmoved = false;
+    for (k=0; k<gps_data.stream_length; k++)
+    {
+        if (gps_data.data[k].sta_lat != geometry->sta_lat[k] ||
+            gps_data.data[k].sta_lon != geometry->sta_lon[k] ||
+            gps_data.data[k].sta_alt != geometry->sta_alt[k])
+        {
+            setSite(k, gps_data.data[k].sta_lat, gps_data.data[k].sta_lon,
+                    gps_data.data[k].sta_alt, geometry);
+            lmoved = true;
+        }
+    }
+    if (lmoved)
+    {
+        for (i=0; i<geometry->maxHypoDist; i++)
+        {
+            geometry->hypoDist[i].lvalid = false;
+        }
+    }
+    // Look for the table
+    zoneIn = utm_zone;
+    if (zoneIn ==-12345){zoneIn =-1;}
+    geometry->useCounter = geometry->useCounter + 1;
+    hd = NULL;
+    for (i=0; i<geometry->maxHypoDist; i++)
+    {
+        if (geometry->hypoDist[i].lvalid &&
+            geometry->hypoDist[i].zoneIn == zoneIn &&
+            geometry->hypoDist[i].ev_lat == ev_lat &&
+            geometry->hypoDist[i].ev_lon == ev_lon &&
+            geometry->hypoDist[i].ev_dep == ev_dep)
+        {
+            geometry->hypoDist[i].lastUse = geometry->useCounter;
+            return &geometry->hypoDist[i];
+        }
+        if (hd == NULL || !geometry->hypoDist[i].lvalid ||
+            (hd->lvalid && geometry->hypoDist[i].lastUse < hd->lastUse))
+        {
+            hd = &geometry->hypoDist[i];
+        }
+    }
+    // Recycle the least recently used table
+    hd->ev_lat = ev_lat;
+    hd->ev_lon = ev_lon;
+    hd->ev_dep = ev_dep;
+    hd->zoneIn = zoneIn;
+    hd->zone = zoneIn;
+    core_coordtools_ll2utm(ev_lat, ev_lon,
+                           &hd->srcNorthing, &hd->srcEasting,
+                           &lnorthp, &hd->zone);
+    for (k=0; k<geometry->nsites; k++)
+    {
+        core_data_getSiteUTM(geometry, k,
+                             geometry->sta_lat[k], geometry->sta_lon[k],
+                             hd->zone, &y2, &x2);
+        // Remember source is + down and receiver is + up
+        hd->distance[k] = sqrt( pow(hd->srcEasting - x2, 2)
+                              + pow(hd->srcNorthing - y2, 2)
+                              + pow(ev_dep*1000.0 + geometry->sta_alt[k], 2));
+        hd->distance[k] = hd->distance[k]*1.e-3; // convert to km
+    }
+    hd->lastUse = geometry->useCounter;
+    hd->lvalid = true;
+    return hd;
+}
+//============================================================================//
+/*!
+ * @brief Tabulates the UTM coordinates of the k'th site in the cached zones.
+ */
+static void setSite(const int k, const double lat, const double lon,
+                    const double alt,
+                    struct GFAST_stationGeometry_struct *geometry)
+{
+    int i, zone, zone_loc;
+    bool lnorthp;
+    geometry->sta_lat[k] = lat;
+    geometry->sta_lon[k] = lon;
+    geometry->sta_alt[k] = alt;
+    for (zone=1; zone<=60; zone++)
+    {
+        i = geometry->zoneIndex[zone];
+        if (i < 0){continue;}
+        zone_loc = zone;
+        core_coordtools_ll2utm(lat, lon,
+                               &geometry->utmNorthing[i*geometry->nsites + k],
+                               &geometry->utmEasting[i*geometry->nsites + k],
+                               &lnorthp, &zone_loc);
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Adds the zone to the list of cached zones if it is valid and new.
+ */
+static void addZone(const int zone, int *nzones, int zoneIndex[61])
+{
+    if (zone < 1 || zone > 60){return;}
+    if (zoneIndex[zone] >= 0){return;}
+    zoneIndex[zone] = *nzones;
+    *nzones = *nzones + 1;
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Computes the UTM zone in which the longitude falls.  This matches
+ *        the zone selection in core_coordtools_ll2utm.
+ */
+static int naturalZone(const double lon_deg)
+{
+    double lon_deg_use;
+    lon_deg_use = lon_deg;
+    if (lon_deg_use > 180.0){lon_deg_use = lon_deg_use - 360.0;}
+    return (int) (fmod(floor((lon_deg_use + 180.0)/6.0), 60.0) + 0.5) + 1;
+}
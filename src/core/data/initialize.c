@@ -53,5 +53,12 @@ int core_data_initialize(struct GFAST_props_struct props,
         gps_data->data[k].ebuff = memory_calloc64f(mpts);
         gps_data->data[k].tbuff = memory_calloc64f(mpts);
     }
+    // Cache the station UTM coordinates
+    ierr = core_data_initializeGeometry(props, gps_data);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error initializing station geometry");
+        return -1;
+    }
     return 0;
 }
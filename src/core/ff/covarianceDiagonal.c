@@ -0,0 +1,528 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+#ifdef GFAST_USE_INTEL
+ #ifdef __clang__
+  #pragma clang diagnostic push
+  #pragma clang diagnostic ignored "-Weverything"
+ #endif
+ #include <mkl_lapacke.h>
+ #include <mkl_cblas.h>
+ #ifdef __clang__
+  #pragma clang diagnostic pop
+ #endif
+#else
+#include <lapacke.h>
+#include <cblas.h>
+#endif
+#include "iscl/memory/memory.h"
+
+#ifndef MIN
+#define MIN(x,y) (((x) < (y)) ? (x) : (y))
+#endif
+#define NPROBE_BLOCK 32 /*!< Max number of probes solved together */
+
+static int solveProbesCGLS(const int mrowsG, const int ncols,
+                           const int mrowsT, const double lampred,
+                           const double *__restrict__ WG,
+                           const int *__restrict__ rowPtr,
+                           const int *__restrict__ colIdx,
+                           const double *__restrict__ T,
+                           const int nb, const int maxit, const double tol,
+                           double *__restrict__ R,
+                           double *__restrict__ Y);
+static void applyBlockA(const int mrowsG, const int ncols, const int mrowsT,
+                        const double lampred,
+                        const double *__restrict__ WG,
+                        const int *__restrict__ rowPtr,
+                        const int *__restrict__ colIdx,
+                        const double *__restrict__ T,
+                        const int nb,
+                        const double *__restrict__ X,
+                        double *__restrict__ Y);
+static void applyBlockAT(const int mrowsG, const int ncols, const int mrowsT,
+                         const double lampred,
+                         const double *__restrict__ WG,
+                         const int *__restrict__ rowPtr,
+                         const int *__restrict__ colIdx,
+                         const double *__restrict__ T,
+                         const int nb,
+                         const double *__restrict__ X,
+                         double *__restrict__ Y);
+static void setRademacher(const int n, uint64_t *state, double *z);
+
+/*!
+ * @brief Computes the diagonal of the model covariance matrix
+ *        \f$ C = (U^T U)^{-1} = U^{-1} U^{-T} \f$ from the upper triangular
+ *        factor of the normal equations.
+ *
+ *        If nprobe is not positive then the diagonal is exact.  Here
+ *        \f$ U^{-1} \f$ is computed in place and \f$ C_{ii} \f$ is the
+ *        squared norm of the upper triangular part of its i'th row.
+ *
+ *        Otherwise, the diagonal is estimated from nprobe random vectors
+ *        \f$ z_k \f$ with entries of \f$ \pm 1 \f$.  Since
+ *        \f$ E[(U^{-1} z)(U^{-1} z)^T] = C \f$ the estimate is
+ *        \f$ C_{ii} \approx \frac{1}{p} \sum_k (U^{-1} z_k)_i^2 \f$.
+ *        This requires one triangular solve with nprobe right hand sides
+ *        so it costs \f$ O(p n^2) \f$ rather than \f$ O(n^3) \f$ and
+ *        leaves U unchanged.  The relative standard deviation of each
+ *        estimate is at most \f$ \sqrt{2/p} \f$.
+ *
+ * @param[in] ncols      number of unknowns
+ * @param[in] nprobe     number of random probing vectors.  if this is
+ *                       not positive then the diagonal is computed
+ *                       exactly.
+ * @param[in] seed       seed for the probing vectors
+ *
+ * @param[in,out] U      on input the upper triangular factor of the normal
+ *                       equations in row major format with leading
+ *                       dimension ncols.  on output, if nprobe is not
+ *                       positive, then this is its inverse
+ *                       [ncols x ncols]
+ *
+ * @param[out] diag      diagonal of the model covariance matrix [ncols]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_covarianceDiagonal(const int ncols, const int nprobe,
+                               const unsigned int seed,
+                               double *__restrict__ U,
+                               double *__restrict__ diag)
+{
+    double *Z, ci;
+    uint64_t state;
+    int i, ierr, k;
+    //------------------------------------------------------------------------//
+    if (ncols < 1 || U == NULL || diag == NULL)
+    {
+        if (ncols < 1){LOG_ERRMSG("Error invalid size %d", ncols);}
+        if (U == NULL){LOG_ERRMSG("%s", "Error U is NULL");}
+        if (diag == NULL){LOG_ERRMSG("%s", "Error diag is NULL");}
+        return -1;
+    }
+    // Exact diagonal from the rows of inv(U)
+    if (nprobe < 1)
+    {
+        ierr = LAPACKE_dtrtri(LAPACK_ROW_MAJOR, 'U', 'N', ncols, U, ncols);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("Error inverting triangular matrix %d", ierr);
+            return -1;
+        }
+        for (i=0; i<ncols; i++)
+        {
+            diag[i] = cblas_ddot(ncols-i, &U[i*ncols+i], 1,
+                                          &U[i*ncols+i], 1);
+        }
+        return 0;
+    }
+    // Estimate the diagonal from inv(U) Z
+    Z = memory_calloc64f(ncols*nprobe);
+    state = (uint64_t) seed;
+    setRademacher(ncols*nprobe, &state, Z);
+    cblas_dtrsm(CblasRowMajor, CblasLeft, CblasUpper, CblasNoTrans,
+                CblasNonUnit, ncols, nprobe, 1.0, U, ncols, Z, nprobe);
+    for (i=0; i<ncols; i++)
+    {
+        ci = 0.0;
+        for (k=0; k<nprobe; k++)
+        {
+            ci = ci + Z[i*nprobe+k]*Z[i*nprobe+k];
+        }
+        diag[i] = ci/(double) nprobe;
+    }
+    memory_free64f(&Z);
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Estimates the diagonal of the model covariance matrix
+ *        \f$ C = (A^T A)^{-1} \f$ of the regularized finite fault inversion
+ *        with \f$ A = [W G; \lambda T] \f$ without factoring the normal
+ *        equations.
+ *
+ *        For a random vector \f$ w \f$ with entries of \f$ \pm 1 \f$ the
+ *        least squares solution \f$ y = C A^T w \f$ of \f$ A y = w \f$
+ *        satisfies \f$ E[y y^T] = C A^T A C = C \f$.  The diagonal is
+ *        therefore estimated as \f$ \frac{1}{p} \sum_k y_k \odot y_k \f$
+ *        where each \f$ y_k \f$ is found with CGLS.  The relative
+ *        standard deviation of each estimate is at most \f$ \sqrt{2/p} \f$.
+ *
+ *        The probes are solved together in blocks so that each iteration
+ *        reads the weighted forward model once for the whole block rather
+ *        than once for each probe.  Each probe keeps its own CGLS
+ *        recurrence and stopping test.
+ *
+ * @note This costs roughly nprobe CGLS solves so it is only intended for
+ *       meshes where the normal equations cannot be factored.  The
+ *       tolerance should not be loosened for the probes.  CGLS resolves
+ *       the poorly determined slips last and these dominate the
+ *       covariance so an early stop underestimates the uncertainties.
+ *
+ * @param[in] mrowsG    number of rows in the weighted forward modeling
+ *                      matrix (3 times the number of sites)
+ * @param[in] ncols     number of unknowns (2*l2)
+ * @param[in] mrowsT    number of rows in the regularizer
+ * @param[in] lampred   regularization parameter \f$ \lambda \f$
+ * @param[in] WG        weighted forward modeling matrix in row major format
+ *                      with leading dimension ncols [mrowsG x ncols]
+ * @param[in] rowPtr    row pointers of the regularizer [mrowsT+1]
+ * @param[in] colIdx    column indices of the regularizer [rowPtr[mrowsT]]
+ * @param[in] T         non-zeros of the regularizer [rowPtr[mrowsT]]
+ * @param[in] nprobe    number of random probing vectors
+ * @param[in] seed      seed for the probing vectors
+ * @param[in] maxit     max number of CGLS iterations for each probe
+ * @param[in] tol       CGLS convergence tolerance for each probe.  this is
+ *                      relative to the norm of the probe's scaled
+ *                      \f$ A^T w \f$.
+ *
+ * @param[out] diag     estimated diagonal of the model covariance
+ *                      matrix [ncols]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_estimateCovarianceDiagonalCGLS(
+    const int mrowsG, const int ncols, const int mrowsT,
+    const double lampred,
+    const double *__restrict__ WG,
+    const int *__restrict__ rowPtr,
+    const int *__restrict__ colIdx,
+    const double *__restrict__ T,
+    const int nprobe, const unsigned int seed,
+    const int maxit, const double tol,
+    double *__restrict__ diag)
+{
+    double *R, *w, *Y;
+    uint64_t state;
+    int i, ierr, k, k0, mrows, nb;
+    //------------------------------------------------------------------------//
+    if (nprobe < 1 || mrowsG < 1 || ncols < 1 || mrowsT < 0 ||
+        maxit < 0 || tol < 0.0)
+    {
+        LOG_ERRMSG("Error invalid inputs %d %d %d %d %d %e",
+                   nprobe, mrowsG, ncols, mrowsT, maxit, tol);
+        return -1;
+    }
+    if (WG == NULL || rowPtr == NULL || colIdx == NULL || T == NULL ||
+        diag == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+    ierr = 0;
+    mrows = mrowsG + mrowsT;
+    nb = MIN(nprobe, NPROBE_BLOCK);
+    R = memory_calloc64f(mrows*nb);
+    Y = memory_calloc64f(ncols*nb);
+    w = memory_calloc64f(mrows);
+    memset(diag, 0, (size_t) ncols*sizeof(double));
+    state = (uint64_t) seed;
+    for (k0=0; k0<nprobe; k0=k0+NPROBE_BLOCK)
+    {
+        nb = MIN(nprobe - k0, NPROBE_BLOCK);
+        // Probes are the columns of R
+        for (k=0; k<nb; k++)
+        {
+            setRademacher(mrows, &state, w);
+            for (i=0; i<mrows; i++)
+            {
+                R[i*nb+k] = w[i];
+            }
+        }
+        ierr = solveProbesCGLS(mrowsG, ncols, mrowsT, lampred,
+                               WG, rowPtr, colIdx, T,
+                               nb, maxit, tol, R, Y);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error solving for probes");
+            goto ERROR;
+        }
+        for (i=0; i<ncols; i++)
+        {
+            for (k=0; k<nb; k++)
+            {
+                diag[i] = diag[i] + Y[i*nb+k]*Y[i*nb+k];
+            }
+        }
+    }
+    for (i=0; i<ncols; i++)
+    {
+        diag[i] = diag[i]/(double) nprobe;
+    }
+ERROR:;
+    memory_free64f(&R);
+    memory_free64f(&w);
+    memory_free64f(&Y);
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Solves the least squares problems \f$ A Y = R \f$ for nb
+ *        right hand sides from a zero start with column scaled CGLS.
+ *        The recurrences and stopping tests are those of core_ff_solveCGLS
+ *        applied to each column but the products with A are done for all
+ *        columns at once.  Converged columns are frozen.
+ *
+ * @param[in,out] R   on input the right hand sides.  on output the
+ *                    residuals.  this is row major with leading
+ *                    dimension nb [(mrowsG + mrowsT) x nb]
+ * @param[out] Y      solutions in row major format with leading dimension
+ *                    nb [ncols x nb]
+ *
+ * @result 0 indicates success.  a column that reaches maxit holds its
+ *         last iterate.
+ */
+static int solveProbesCGLS(const int mrowsG, const int ncols,
+                           const int mrowsT, const double lampred,
+                           const double *__restrict__ WG,
+                           const int *__restrict__ rowPtr,
+                           const int *__restrict__ colIdx,
+                           const double *__restrict__ T,
+                           const int nb, const int maxit, const double tol,
+                           double *__restrict__ R,
+                           double *__restrict__ Y)
+{
+    double *alpha, *D, *gamma, *gammaNew, *P, *Q, *S, *stol, beta, lam2;
+    bool *lactive;
+    int i, it, j, k, mrows, nactive;
+    //------------------------------------------------------------------------//
+    mrows = mrowsG + mrowsT;
+    D = memory_calloc64f(ncols);
+    P = memory_calloc64f(ncols*nb);
+    S = memory_calloc64f(ncols*nb);
+    Q = memory_calloc64f(mrows*nb);
+    alpha = memory_calloc64f(nb);
+    gamma = memory_calloc64f(nb);
+    gammaNew = memory_calloc64f(nb);
+    stol = memory_calloc64f(nb);
+    lactive = memory_calloc8l(nb);
+    // Scale the columns to unit norm
+    lam2 = lampred*lampred;
+    for (i=0; i<mrowsG; i++)
+    {
+        for (j=0; j<ncols; j++)
+        {
+            D[j] = D[j] + WG[i*ncols+j]*WG[i*ncols+j];
+        }
+    }
+    for (i=0; i<rowPtr[mrowsT]; i++)
+    {
+        D[colIdx[i]] = D[colIdx[i]] + lam2*T[i]*T[i];
+    }
+    for (j=0; j<ncols; j++)
+    {
+        D[j] = (D[j] > 0.0) ? 1.0/sqrt(D[j]) : 0.0;
+    }
+    // Scaled gradients S = D A^T R at the zero start
+    memset(Y, 0, (size_t) (ncols*nb)*sizeof(double));
+    applyBlockAT(mrowsG, ncols, mrowsT, lampred, WG, rowPtr, colIdx, T,
+                 nb, R, S);
+    for (j=0; j<ncols; j++)
+    {
+        for (k=0; k<nb; k++)
+        {
+            S[j*nb+k] = D[j]*S[j*nb+k];
+            P[j*nb+k] = S[j*nb+k];
+            gamma[k] = gamma[k] + S[j*nb+k]*S[j*nb+k];
+        }
+    }
+    nactive = 0;
+    for (k=0; k<nb; k++)
+    {
+        stol[k] = tol*sqrt(gamma[k]);
+        lactive[k] = (gamma[k] > 0.0 && sqrt(gamma[k]) > stol[k]);
+        if (lactive[k]){nactive = nactive + 1;}
+    }
+    // Conjugate gradient iterations.  S holds D P until the new gradient.
+    it = 0;
+    while (it < maxit && nactive > 0)
+    {
+        for (j=0; j<ncols; j++)
+        {
+            for (k=0; k<nb; k++)
+            {
+                S[j*nb+k] = D[j]*P[j*nb+k];
+            }
+        }
+        applyBlockA(mrowsG, ncols, mrowsT, lampred, WG, rowPtr, colIdx, T,
+                    nb, S, Q);
+        memset(alpha, 0, (size_t) nb*sizeof(double));
+        for (i=0; i<mrows; i++)
+        {
+            for (k=0; k<nb; k++)
+            {
+                alpha[k] = alpha[k] + Q[i*nb+k]*Q[i*nb+k];
+            }
+        }
+        for (k=0; k<nb; k++)
+        {
+            if (lactive[k] && alpha[k] > 0.0)
+            {
+                alpha[k] = gamma[k]/alpha[k];
+            }
+            else
+            {
+                if (lactive[k]){nactive = nactive - 1;}
+                lactive[k] = false;
+                alpha[k] = 0.0;
+            }
+        }
+        for (j=0; j<ncols; j++)
+        {
+            for (k=0; k<nb; k++)
+            {
+                Y[j*nb+k] = Y[j*nb+k] + alpha[k]*S[j*nb+k];
+            }
+        }
+        for (i=0; i<mrows; i++)
+        {
+            for (k=0; k<nb; k++)
+            {
+                R[i*nb+k] = R[i*nb+k] - alpha[k]*Q[i*nb+k];
+            }
+        }
+        applyBlockAT(mrowsG, ncols, mrowsT, lampred, WG, rowPtr, colIdx, T,
+                     nb, R, S);
+        memset(gammaNew, 0, (size_t) nb*sizeof(double));
+        for (j=0; j<ncols; j++)
+        {
+            for (k=0; k<nb; k++)
+            {
+                S[j*nb+k] = D[j]*S[j*nb+k];
+                gammaNew[k] = gammaNew[k] + S[j*nb+k]*S[j*nb+k];
+            }
+        }
+        for (j=0; j<ncols; j++)
+        {
+            for (k=0; k<nb; k++)
+            {
+                if (!lactive[k]){continue;}
+                beta = gammaNew[k]/gamma[k];
+                P[j*nb+k] = S[j*nb+k] + beta*P[j*nb+k];
+            }
+        }
+        for (k=0; k<nb; k++)
+        {
+            if (!lactive[k]){continue;}
+            gamma[k] = gammaNew[k];
+            if (sqrt(gamma[k]) <= stol[k])
+            {
+                lactive[k] = false;
+                nactive = nactive - 1;
+            }
+        }
+        it = it + 1;
+    }
+    memory_free64f(&D);
+    memory_free64f(&P);
+    memory_free64f(&S);
+    memory_free64f(&Q);
+    memory_free64f(&alpha);
+    memory_free64f(&gamma);
+    memory_free64f(&gammaNew);
+    memory_free64f(&stol);
+    memory_free8l(&lactive);
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Computes Y = [WG; lampred*T] X for nb columns.
+ */
+static void applyBlockA(const int mrowsG, const int ncols, const int mrowsT,
+                        const double lampred,
+                        const double *__restrict__ WG,
+                        const int *__restrict__ rowPtr,
+                        const int *__restrict__ colIdx,
+                        const double *__restrict__ T,
+                        const int nb,
+                        const double *__restrict__ X,
+                        double *__restrict__ Y)
+{
+    double tip;
+    int i, ip, k;
+    cblas_dgemm(CblasRowMajor, CblasNoTrans, CblasNoTrans,
+                mrowsG, nb, ncols, 1.0, WG, ncols, X, nb, 0.0, Y, nb);
+    memset(&Y[mrowsG*nb], 0, (size_t) (mrowsT*nb)*sizeof(double));
+    for (i=0; i<mrowsT; i++)
+    {
+        for (ip=rowPtr[i]; ip<rowPtr[i+1]; ip++)
+        {
+            tip = lampred*T[ip];
+            for (k=0; k<nb; k++)
+            {
+                Y[(mrowsG+i)*nb+k] = Y[(mrowsG+i)*nb+k]
+                                   + tip*X[colIdx[ip]*nb+k];
+            }
+        }
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Computes Y = [WG; lampred*T]^T X for nb columns.
+ */
+static void applyBlockAT(const int mrowsG, const int ncols, const int mrowsT,
+                         const double lampred,
+                         const double *__restrict__ WG,
+                         const int *__restrict__ rowPtr,
+                         const int *__restrict__ colIdx,
+                         const double *__restrict__ T,
+                         const int nb,
+                         const double *__restrict__ X,
+                         double *__restrict__ Y)
+{
+    double tip;
+    int i, ip, k;
+    cblas_dgemm(CblasRowMajor, CblasTrans, CblasNoTrans,
+                ncols, nb, mrowsG, 1.0, WG, ncols, X, nb, 0.0, Y, nb);
+    for (i=0; i<mrowsT; i++)
+    {
+        for (ip=rowPtr[i]; ip<rowPtr[i+1]; ip++)
+        {
+            tip = lampred*T[ip];
+            for (k=0; k<nb; k++)
+            {
+                Y[colIdx[ip]*nb+k] = Y[colIdx[ip]*nb+k]
+                                   + tip*X[(mrowsG+i)*nb+k];
+            }
+        }
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Fills z with random entries of +1 or -1 from a splitmix64
+ *        sequence.  The state is local to the caller so this is thread safe
+ *        and reproducible.
+ */
+static void setRademacher(const int n, uint64_t *state, double *z)
+{
+    uint64_t bits;
+    int i;
+    bits = 0;
+    for (i=0; i<n; i++)
+    {
+        if (i%64 == 0)
+        {
+            *state = *state + UINT64_C(0x9E3779B97F4A7C15);
+            bits = *state;
+            bits = (bits ^ (bits >> 30))*UINT64_C(0xBF58476D1CE4E5B9);
+            bits = (bits ^ (bits >> 27))*UINT64_C(0x94D049BB133111EB);
+            bits = bits ^ (bits >> 31);
+        }
+        z[i] = (bits & 1) ? 1.0 : -1.0;
+        bits = bits >> 1;
+    }
+    return;
+}
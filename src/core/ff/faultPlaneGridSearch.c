@@ -3,6 +3,7 @@
 #include <stdbool.h>
 #include <math.h>
 #include <string.h>
+#include <float.h>
 #include "gfast_core.h"
 #ifdef GFAST_USE_INTEL
  #ifdef __clang__
@@ -145,11 +146,120 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
                                  double *__restrict__ dslip_unc
                                  )
 {
-    double *diagWt, *G, *G2, *R, *S, *T, *UD, *UP, *WUD, *xrs, *yrs, *zrs,
-           asum, ds_unc, lampred, len0, ss_unc, st, M0, res, wid0, xden, xnum;
-    int i, ierr, ierr1, if_off, ifp, ij, io_off, j,
-        mrowsG, mrowsG2, mrowsT, ncolsG, ncolsG2, ncolsT, ng, ng2, nt;
-    bool lrmtx, lsslip_unc, ldslip_unc;
+    int ierr;
+    ierr = core_ff_cachedFaultPlaneGridSearch(NULL, l1, NULL,
+                                              FF_DIRECT_SOLVER, 0, 0.0,
+                                              -DBL_MAX, DBL_MAX, 0,
+                                              l1, l2, nstr, ndip, nfp,
+                                              verbose,
+                                              nObsOffset, eObsOffset,
+                                              uObsOffset,
+                                              nWts, eWts, uWts,
+                                              utmRecvEasting,
+                                              utmRecvNorthing,
+                                              staAlt,
+                                              fault_xutm, fault_yutm,
+                                              fault_alt,
+                                              length, width,
+                                              strike, dip,
+                                              sslip, dslip,
+                                              Mw, vr,
+                                              NN, EN, UN,
+                                              sslip_unc, dslip_unc);
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Performs the fault plane grid search of
+ *        core_ff_faultPlaneGridSearch.  If a Green's function cache is
+ *        provided then the unweighted forward modeling matrices and
+ *        regularizers are taken from the cache and only the rows of new
+ *        or moved sites and the columns of moved fault patches are
+ *        recomputed.  Additionally, the slip may be solved for with CGLS
+ *        in which case, if a cache is provided, each fault plane is started
+ *        from its solution in the previous call.
+ *
+ * @param[in,out] cache     if not NULL then on input holds the cached
+ *                          Green's functions and on output holds the
+ *                          Green's functions for these fault planes and
+ *                          sites.
+ * @param[in] nsites        total number of sites.  this is only accessed
+ *                          when the cache is not NULL.
+ * @param[in] luse          if true then the k'th site is in the inversion.
+ *                          the active sites must appear in the compacted
+ *                          arrays in the order of their site index.
+ *                          this is only accessed when the cache is not
+ *                          NULL [nsites]
+ * @param[in] solver        if FF_CGLS_SOLVER then the slip is found with
+ *                          core_ff_solveCGLS.  otherwise, the normal
+ *                          equations are factored.  if exact uncertainties
+ *                          are requested with CGLS and the slip is not
+ *                          bounded then the normal equations must be
+ *                          factored anyway so their solution is used.
+ * @param[in] maxit         max number of CGLS iterations
+ * @param[in] tol           CGLS convergence tolerance
+ * @param[in] slipMin       lower bound (m) on slip in CGLS.  use -DBL_MAX
+ *                          for no bound.
+ * @param[in] slipMax       upper bound (m) on slip in CGLS.  use DBL_MAX
+ *                          for no bound.
+ * @param[in] nprobe        if positive then the slip uncertainties are
+ *                          estimated from this many random probing
+ *                          vectors.  with CGLS this avoids factoring the
+ *                          normal equations.  otherwise, the uncertainties
+ *                          are exact.
+ *
+ * @note The remaining arguments are described in
+ *       core_ff_faultPlaneGridSearch.
+ *
+ * @result 0 indicates success.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_cachedFaultPlaneGridSearch(
+    struct GFAST_ffGreensCache_struct *cache,
+    const int nsites,
+    const bool *__restrict__ luse,
+    const enum ff_solver_type solver,
+    const int maxit, const double tol,
+    const double slipMin, const double slipMax,
+    const int nprobe,
+    const int l1, const int l2,
+    const int nstr, const int ndip,
+    const int nfp, const int verbose,
+    const double *__restrict__ nObsOffset,
+    const double *__restrict__ eObsOffset,
+    const double *__restrict__ uObsOffset,
+    const double *__restrict__ nWts,
+    const double *__restrict__ eWts,
+    const double *__restrict__ uWts,
+    const double *__restrict__ utmRecvEasting,
+    const double *__restrict__ utmRecvNorthing,
+    const double *__restrict__ staAlt,
+    const double *__restrict__ fault_xutm,
+    const double *__restrict__ fault_yutm,
+    const double *__restrict__ fault_alt,
+    const double *__restrict__ length,
+    const double *__restrict__ width,
+    const double *__restrict__ strike,
+    const double *__restrict__ dip,
+    double *__restrict__ sslip,
+    double *__restrict__ dslip,
+    double *__restrict__ Mw,
+    double *__restrict__ vr,
+    double *__restrict__ NN,
+    double *__restrict__ EN,
+    double *__restrict__ UN,
+    double *__restrict__ sslip_unc,
+    double *__restrict__ dslip_unc)
+{
+    struct GFAST_ffGreens_struct *greens;
+    double *cdiag, *diagWt, *G, *G2, *R, *S, *Sw, *T, *UD, *UP, *WUD,
+           *xrs, *yrs, *zrs,
+           asum, lampred, len0, st, M0, res, wid0, xden, xnum;
+    int *colIdxT, *rowPtrT, i, ierr, ierr1, if_off, ifp, ij, io_off, j,
+        mrowsG, mrowsT, ncolsG, ng, niter, nnzT;
+    bool lcgls, lfactor, lrmtx, lsslip_unc, ldslip_unc;
     //------------------------------------------------------------------------//
     //
     // Initialize
@@ -162,7 +272,11 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
     UP = NULL;
     T  = NULL;
     S  = NULL;
+    Sw = NULL;
     R  = NULL;
+    cdiag = NULL;
+    rowPtrT = NULL;
+    colIdxT = NULL;
     lrmtx = false;
     lsslip_unc = false;
     ldslip_unc = false;
@@ -206,18 +320,30 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
         if (dslip_unc != NULL){ldslip_unc = true;}
         lrmtx = true;
     } 
-    // Compute sizes of matrices in G2 S = UP where G2 = [G; T]
+    // The normal equations are factored by the direct solver or for exact
+    // uncertainties.  Since the factorization also yields the slip, CGLS is
+    // then only needed to enforce slip bounds.
+    lfactor = true;
+    if (solver == FF_CGLS_SOLVER && (!lrmtx || nprobe > 0)){lfactor = false;}
+    lcgls = false;
+    if (solver == FF_CGLS_SOLVER &&
+        (!lfactor || slipMin > -DBL_MAX || slipMax < DBL_MAX))
+    {
+        lcgls = true;
+    }
+    // Compute sizes of the forward model G and the sparse regularizer T
+    // in [G; T] S = UP
     mrowsG = 3*l1;
     ncolsG = 2*l2;
-    mrowsT = 2*ndip*nstr + 2*(2*ndip + nstr - 2);
-    ncolsT = 2*l2;
-    mrowsG2 = mrowsG + mrowsT;
-    ncolsG2 = ncolsG;
-    nt = mrowsT*ncolsT;
     ng = mrowsG*ncolsG;
-    ng2 = mrowsG2*ncolsG2;
+    ierr = core_ff_getRegularizerSize(nstr, ndip, &mrowsT, &nnzT);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error computing regularizer size");
+        return -1;
+    }
     // Set space
-    WUD = memory_calloc64f(mrowsG2);
+    WUD = memory_calloc64f(mrowsG);
     UD = memory_calloc64f(mrowsG);
     diagWt = memory_calloc64f(mrowsG);
     if (WUD == NULL || UD == NULL || diagWt == NULL)
@@ -264,6 +390,28 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
         LOG_ERRMSG("%s", "Error weighting observations");
         goto ERROR;
     }
+    // Bring the cached Green's functions up to date
+    if (cache != NULL)
+    {
+        if (luse == NULL)
+        {
+            LOG_ERRMSG("%s", "Error luse is NULL");
+            ierr =-1;
+            goto ERROR;
+        }
+        ierr = core_ff_updateGreensCache(cache, nsites, luse,
+                                         l1, l2, nstr, ndip, nfp,
+                                         verbose,
+                                         utmRecvEasting, utmRecvNorthing,
+                                         staAlt,
+                                         fault_xutm, fault_yutm, fault_alt,
+                                         length, width, strike, dip);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error updating Green's function cache");
+            goto ERROR;
+        }
+    }
     // Begin the grid search on fault planes
     ierr = 0;
     ISCL_time_tic();
@@ -273,27 +421,42 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
     }
 #ifdef PARALLEL_FF
     #pragma omp parallel \
-     private(asum, ds_unc, G, G2, i, ierr1, ifp, if_off, ij, io_off, j, \
-             lampred, len0, M0, R, res, S, ss_unc, st, T, UP, wid0, \
-             xrs, xden, xnum, yrs, zrs) \
-     shared(diagWt, dip, dslip, dslip_unc, EN, fault_alt, \
-            fault_xutm, fault_yutm, ldslip_unc, length, \
-            lrmtx, lsslip_unc, Mw, mrowsG, mrowsG2, ncolsG, ncolsG2, \
-            ng, ng2, NN, nt, sslip, sslip_unc, staAlt, strike, \
-            vr, WUD, UD, UN, utmRecvEasting, utmRecvNorthing, width) \
+     firstprivate(l1, l2, maxit, ndip, nfp, nprobe, nstr, slipMax, \
+                  slipMin, solver, tol, verbose) \
+     private(asum, cdiag, colIdxT, G, G2, greens, i, ierr1, ifp, if_off, \
+             ij, io_off, j, lampred, len0, M0, niter, R, res, rowPtrT, S, \
+             st, Sw, T, UP, wid0, xrs, xden, xnum, yrs, zrs) \
+     shared(cache, diagWt, dip, dslip, dslip_unc, EN, fault_alt, \
+            fault_xutm, fault_yutm, lcgls, ldslip_unc, length, lfactor, \
+            lrmtx, lsslip_unc, Mw, mrowsG, mrowsT, ncolsG, \
+            ng, nnzT, NN, nsites, luse, sslip, sslip_unc, staAlt, \
+            strike, vr, WUD, UD, UN, utmRecvEasting, utmRecvNorthing, \
+            width) \
      reduction(+:ierr) default(none)
     {
 #endif
-    R = NULL;
     G  = memory_calloc64f(ng);
-    G2 = memory_calloc64f(ng2);
-    S  = memory_calloc64f(ncolsG2);
-    T  = memory_calloc64f(nt);
+    G2 = memory_calloc64f(ng);
+    R  = NULL;
+    if (lfactor){R = memory_calloc64f(ncolsG*ncolsG);}
+    S  = memory_calloc64f(ncolsG);
+    Sw = NULL;
+    if (lcgls && lfactor){Sw = memory_calloc64f(ncolsG);}
+    cdiag = NULL;
+    if (lrmtx){cdiag = memory_calloc64f(ncolsG);}
+    T  = memory_calloc64f(nnzT);
+    rowPtrT = memory_calloc32i(mrowsT+1);
+    colIdxT = memory_calloc32i(nnzT);
     UP = memory_calloc64f(mrowsG);
-    xrs = memory_calloc64f(l1*l2);
-    yrs = memory_calloc64f(l1*l2);
-    zrs = memory_calloc64f(l1*l2);
-    if (lrmtx){R = memory_calloc64f(ncolsG2*ncolsG2);}
+    xrs = NULL;
+    yrs = NULL;
+    zrs = NULL;
+    if (cache == NULL)
+    {
+        xrs = memory_calloc64f(l1*l2);
+        yrs = memory_calloc64f(l1*l2);
+        zrs = memory_calloc64f(l1*l2);
+    }
 #ifdef PARALLEL_FF
     #pragma omp for
 #endif
@@ -303,38 +466,64 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
         // Set the offsets
         if_off = ifp*l2; // Offset the fault plane
         io_off = ifp*l1; // Offset the observations/estimates
-        // Null out G2, regularizer, and possibly R matrix
-        memset(G, 0, (size_t) ng*sizeof(double));
-        memset(G2, 0, (size_t) ng2*sizeof(double));
-        memset(T, 0, (size_t) nt*sizeof(double));
-        if (lrmtx)
+        // Get the forward modeling matrix and regularizer from the cache
+        if (cache != NULL)
         {
-            memset(R, 0, (size_t) (ncolsG2*ncolsG2)*sizeof(double));
-        }
-        // Compute the site/fault patch offsets
-        for (i=0; i<l2; i++)
-        {
-            for (j=0; j<l1; j++)
+            ierr1 = core_ff_getCachedForwardModel(cache, ifp, nsites, luse,
+                                                  l1, l2, mrowsT, nnzT,
+                                                  G, rowPtrT, colIdxT, T);
+            if (ierr1 != 0)
             {
-                ij = l1*i + j;
-                xrs[ij] = utmRecvEasting[j]  - fault_xutm[if_off+i];
-                yrs[ij] = utmRecvNorthing[j] - fault_yutm[if_off+i];
-                zrs[ij] = fault_alt[if_off+i]*1.e3 + staAlt[j];
+                LOG_ERRMSG("%s", "Error getting cached forward model");
+                ierr = ierr + 1;
+                continue;
             }
         }
-        // Compute the forward modeling matrix (which is in row major format)
-        ierr1 = core_ff_setForwardModel__okadagreenF(l1, l2,
-                                                     xrs, yrs, zrs,
-                                                     &strike[if_off],
-                                                     &dip[if_off],
-                                                     &width[if_off],
-                                                     &length[if_off],
-                                                     G);
-        if (ierr1 != 0)
+        else
         {
-            LOG_ERRMSG("%s", "Error setting forward model");
-            ierr = ierr + 1;
-            continue;
+            memset(G, 0, (size_t) ng*sizeof(double));
+            // Compute the site/fault patch offsets
+            for (i=0; i<l2; i++)
+            {
+                for (j=0; j<l1; j++)
+                {
+                    ij = l1*i + j;
+                    xrs[ij] = utmRecvEasting[j]  - fault_xutm[if_off+i];
+                    yrs[ij] = utmRecvNorthing[j] - fault_yutm[if_off+i];
+                    zrs[ij] = fault_alt[if_off+i]*1.e3 + staAlt[j];
+                }
+            }
+            // Compute the forward modeling matrix (row major format)
+            ierr1 = core_ff_setForwardModel__okadagreenF(l1, l2,
+                                                         xrs, yrs, zrs,
+                                                         &strike[if_off],
+                                                         &dip[if_off],
+                                                         &width[if_off],
+                                                         &length[if_off],
+                                                         G);
+            if (ierr1 != 0)
+            {
+                LOG_ERRMSG("%s", "Error setting forward model");
+                ierr = ierr + 1;
+                continue;
+            }
+            // Set the sparse regularizer
+            ierr1 = core_ff_setRegularizerCSR(l2,
+                                              nstr,
+                                              ndip,
+                                              mrowsT,
+                                              nnzT,
+                                              &width[if_off],
+                                              &length[if_off],
+                                              rowPtrT,
+                                              colIdxT,
+                                              T);
+            if (ierr1 != 0)
+            {
+                LOG_ERRMSG("%s", "Error setting regulizer");
+                ierr = ierr + 1;
+                continue;
+            }
         }
         // Weight the column major diagonal forward modeling matrix 
         ierr1 = core_ff_weightForwardModel(mrowsG, ncolsG,
@@ -347,20 +536,6 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
             ierr = ierr + 1;
             continue;
         }
-        // Set the regularizer (also in row major format)
-        ierr1 = core_ff_setRegularizer(l2,
-                                       nstr,
-                                       ndip,
-                                       nt,
-                                       &width[if_off],
-                                       &length[if_off],
-                                       T);
-        if (ierr1 != 0)
-        {
-            LOG_ERRMSG("%s", "Error setting regulizer");
-            ierr = ierr + 1;
-            continue;
-        }
         // Compute scale factor for regularizer
         asum = cblas_dasum(ng, G2, 1);
         len0 = length[if_off];
@@ -368,71 +543,106 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
         lampred = 1.0/pow( (double) l2*2.0, 2);
         lampred = lampred/(asum/(double) ng);
         lampred = lampred/4.0*len0*wid0/1.e6;
-        // Append lampred*T to G2
-        cblas_daxpy(nt, lampred, T, 1, &G2[ng], 1);
-        // Solve the least squares problem
-        ierr1 = linalg_lstsq_qr64f_work(LAPACK_ROW_MAJOR,
-                                        mrowsG2, ncolsG2, 1, lrmtx,
-                                        G2, WUD,
-                                        S, R);
+        // Solve the least squares problem [G2; lampred*T] S = [WUD; 0]
+        if (lcgls)
+        {
+            // Start from the previous solution on this plane
+            memset(S, 0, (size_t) ncolsG*sizeof(double));
+            greens = NULL;
+            if (cache != NULL)
+            {
+                greens = &cache->planes[cache->planeEntry[ifp]];
+                if (greens->lslip)
+                {
+                    memcpy(S, greens->slip, (size_t) ncolsG*sizeof(double));
+                }
+            }
+            ierr1 = core_ff_solveCGLS(mrowsG, ncolsG, mrowsT,
+                                      lampred,
+                                      G2, WUD, NULL,
+                                      rowPtrT, colIdxT, T,
+                                      maxit, tol, slipMin, slipMax,
+                                      S, &niter);
+            if (ierr1 < 0)
+            {
+                LOG_ERRMSG("%s", "Error solving least squares problem");
+                ierr = ierr + 1;
+                continue;
+            }
+            if (ierr1 == 1 && verbose > 1)
+            {
+                LOG_WARNMSG("CGLS did not converge in %d iterations", niter);
+            }
+            ierr1 = 0;
+            if (verbose > 2)
+            {
+                LOG_DEBUGMSG("Plane %d: %d CGLS iterations", ifp, niter);
+            }
+            if (greens != NULL)
+            {
+                memcpy(greens->slip, S, (size_t) ncolsG*sizeof(double));
+                greens->lslip = true;
+                greens->niter = niter;
+            }
+            // Exact uncertainties of bounded slip require the factored
+            // normal equations
+            if (lfactor)
+            {
+                ierr1 = core_ff_solveNormalEquations(mrowsG, ncolsG, mrowsT,
+                                                     lampred,
+                                                     G2, WUD,
+                                                     rowPtrT, colIdxT, T,
+                                                     R, Sw);
+            }
+        }
+        else
+        {
+            ierr1 = core_ff_solveNormalEquations(mrowsG, ncolsG, mrowsT,
+                                                 lampred,
+                                                 G2, WUD,
+                                                 rowPtrT, colIdxT, T,
+                                                 R, S);
+        }
         if (ierr1 != 0)
         {
             LOG_ERRMSG("%s", "Error solving least squares problem");
             ierr = ierr + 1;
             continue;
         }
-        // From the right matrix compute the covariance matrix: inv(G^T*G)
-        // Notice, because G = QR the inner term is G^T G = R^T Q^T Q R = R^T R
-        // Thus, we must simply solve C = inv(R^T R) = inv(R) inv(R^T).  Hence
-        // it is sufficient to compute Ri = inv(R) then multiply Ri*Ri^T.
-        // Futhermore, we only retain the diagonals so computing a full matrix
-        // matrix multiply is unnecessary.  What is necessary is instead taking
-        // the inner products which would produce the diagonal elements.
-        // Note, to finish the computation you need an estimate of the standard
-        // deviation and a confidence level.  For example, if you had a standard
-        // deviation of say, 8, and a confidence level of 95 percent you'd compute
-        // sslip_unc = sslip_unc*1.96*8.
+        // The model covariance matrix is C = inv(G^T G) where the normal
+        // equations are factored as G^T G = R^T R.  Only the diagonal is
+        // required.  Note, to finish the computation you need an estimate
+        // of the standard deviation and a confidence level.  For example,
+        // if you had a standard deviation of say, 8, and a confidence level
+        // of 95 percent you'd compute sslip_unc = sslip_unc*1.96*8.
         if (lrmtx)
         {
-            ierr1 = LAPACKE_dtrtri(LAPACK_ROW_MAJOR, 'U', 'N', ncolsG2,
-                                   R, ncolsG2);
+            if (lfactor)
+            {
+                ierr1 = core_ff_covarianceDiagonal(ncolsG, nprobe,
+                                                   (unsigned int) ifp + 1,
+                                                   R, cdiag);
+            }
+            else
+            {
+                ierr1 = core_ff_estimateCovarianceDiagonalCGLS(
+                                           mrowsG, ncolsG, mrowsT,
+                                           lampred, G2,
+                                           rowPtrT, colIdxT, T,
+                                           nprobe, (unsigned int) ifp + 1,
+                                           maxit, tol, cdiag);
+            }
             if (ierr1 != 0)
             {
-                LOG_ERRMSG("%s", "Error inverting triangular matrix!");
+                LOG_ERRMSG("%s", "Error computing slip covariance!");
                 ierr = ierr + 1;
                 continue;
             }
             // Unpack the uncertainties
-            if (lsslip_unc && ldslip_unc)
+            for (i=0; i<l2; i++)
             {
-                for (i=0; i<l2; i++)
-                {
-                    ss_unc = cblas_ddot(ncolsG2, &R[(2*i+0)*ncolsG2], 1,
-                                                 &R[(2*i+0)*ncolsG2], 1); 
-                    ds_unc = cblas_ddot(ncolsG2, &R[(2*i+1)*ncolsG2], 1,
-                                                 &R[(2*i+1)*ncolsG2], 1); 
-                    sslip_unc[if_off+i] = sqrt(ss_unc);
-                    dslip_unc[if_off+i] = sqrt(ds_unc);
-                }
-            }
-            // Unpack only desired uncertainties
-            else
-            {
-                for (i=0; i<l2; i++)
-                {
-                    if (ldslip_unc)
-                    {
-                        ss_unc = cblas_ddot(ncolsG2, &R[(2*i+0)*ncolsG2], 1,
-                                                     &R[(2*i+0)*ncolsG2], 1);
-                        sslip_unc[if_off+i] = sqrt(ss_unc);
-                    }
-                    if (ldslip_unc)
-                    {
-                        ds_unc = cblas_ddot(ncolsG2, &R[(2*i+1)*ncolsG2], 1,
-                                                     &R[(2*i+1)*ncolsG2], 1);
-                        sslip_unc[if_off+i] = sqrt(ds_unc);
-                    }
-                }
+                if (lsslip_unc){sslip_unc[if_off+i] = sqrt(cdiag[2*i+0]);}
+                if (ldslip_unc){dslip_unc[if_off+i] = sqrt(cdiag[2*i+1]);}
             }
         }
         // Compute the forward problem UP = G*S (ignoring regularizer)
@@ -486,7 +696,11 @@ int core_ff_faultPlaneGridSearch(const int l1, const int l2,
     memory_free64f(&G);
     memory_free64f(&G2);
     memory_free64f(&S);
+    memory_free64f(&Sw);
+    memory_free64f(&cdiag);
     memory_free64f(&T);
+    memory_free32i(&rowPtrT);
+    memory_free32i(&colIdxT);
     memory_free64f(&UP);
     memory_free64f(&xrs);
     memory_free64f(&yrs);
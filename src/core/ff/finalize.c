@@ -52,6 +52,7 @@ void core_ff_finalizeResults(struct GFAST_ffResults_struct *ff)
 {
     int ifp;
     if (ff == NULL){return;}
+    core_ff_finalizeGreensCache(ff);
     if (ff->nfp < 1){return;}
     for (ifp=0; ifp<ff->nfp; ifp++)
     {
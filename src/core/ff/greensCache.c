@@ -0,0 +1,657 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+#include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
+
+#define MAX_FF_EVENTS 2 /*!< Number of events whose fault planes are cached.
+                             The cache holds MAX_FF_EVENTS*nfp planes. */
+
+static void assignPlanes(const int l2, const int nfp,
+                         const double *__restrict__ fault_xutm,
+                         const double *__restrict__ fault_yutm,
+                         const double *__restrict__ fault_alt,
+                         const double *__restrict__ length,
+                         const double *__restrict__ width,
+                         const double *__restrict__ strike,
+                         const double *__restrict__ dip,
+                         struct GFAST_ffGreensCache_struct *cache);
+static int updatePlane(const int nsites, const bool *__restrict__ luse,
+                       const int *__restrict__ cidx,
+                       const int l1, const int l2,
+                       const int nstr, const int ndip,
+                       const int mrowsT, const int nnzT,
+                       const double *__restrict__ utmRecvEasting,
+                       const double *__restrict__ utmRecvNorthing,
+                       const double *__restrict__ staAlt,
+                       const double *__restrict__ fault_xutm,
+                       const double *__restrict__ fault_yutm,
+                       const double *__restrict__ fault_alt,
+                       const double *__restrict__ length,
+                       const double *__restrict__ width,
+                       const double *__restrict__ strike,
+                       const double *__restrict__ dip,
+                       int *__restrict__ icol, int *__restrict__ isite,
+                       double *__restrict__ pwork,
+                       double *__restrict__ xrs,
+                       double *__restrict__ yrs,
+                       double *__restrict__ zrs,
+                       double *__restrict__ Gwork,
+                       int *nchange, int *nnew,
+                       struct GFAST_ffGreens_struct *greens);
+
+/*!
+ * @brief Allocates the finite fault Green's function cache on the finite
+ *        fault results structure.  The space for each fault plane is
+ *        allocated on its first use.
+ *
+ * @param[in,out] ff     on input holds the number of fault planes and the
+ *                       fault plane dimensions and maximum number of
+ *                       observations.
+ *                       on output the Green's function cache is set.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_initializeGreensCache(struct GFAST_ffResults_struct *ff)
+{
+    struct GFAST_ffGreensCache_struct *cache;
+    //------------------------------------------------------------------------//
+    core_ff_finalizeGreensCache(ff);
+    if (ff->nfp < 1 || ff->fp == NULL)
+    {
+        LOG_ERRMSG("Invalid number of fault planes %d", ff->nfp);
+        return -1;
+    }
+    if (ff->fp[0].maxobs < 1 || ff->fp[0].nstr < 1 || ff->fp[0].ndip < 1)
+    {
+        LOG_ERRMSG("Invalid sites %d or fault patches %d x %d",
+                   ff->fp[0].maxobs, ff->fp[0].nstr, ff->fp[0].ndip);
+        return -1;
+    }
+    cache = (struct GFAST_ffGreensCache_struct *)
+            calloc(1, sizeof(struct GFAST_ffGreensCache_struct));
+    cache->nsites = ff->fp[0].maxobs;
+    cache->nstr = ff->fp[0].nstr;
+    cache->ndip = ff->fp[0].ndip;
+    cache->nfp = ff->nfp;
+    cache->maxPlanes = MAX_FF_EVENTS*ff->nfp;
+    cache->planes = (struct GFAST_ffGreens_struct *)
+                    calloc((size_t) cache->maxPlanes,
+                           sizeof(struct GFAST_ffGreens_struct));
+    cache->planeEntry = memory_calloc32i(ff->nfp);
+    ff->greens = cache;
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Frees the finite fault Green's function cache.
+ *
+ * @param[in,out] ff     on output the Green's function cache has been freed
+ *                       and set to NULL.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+void core_ff_finalizeGreensCache(struct GFAST_ffResults_struct *ff)
+{
+    struct GFAST_ffGreensCache_struct *cache;
+    struct GFAST_ffGreens_struct *greens;
+    int i;
+    if (ff == NULL || ff->greens == NULL){return;}
+    cache = ff->greens;
+    for (i=0; i<cache->maxPlanes; i++)
+    {
+        greens = &cache->planes[i];
+        memory_free64f(&greens->G);
+        memory_free64f(&greens->T);
+        memory_free64f(&greens->fault_xutm);
+        memory_free64f(&greens->fault_yutm);
+        memory_free64f(&greens->fault_alt);
+        memory_free64f(&greens->length);
+        memory_free64f(&greens->width);
+        memory_free64f(&greens->strike);
+        memory_free64f(&greens->dip);
+        memory_free64f(&greens->recvEasting);
+        memory_free64f(&greens->recvNorthing);
+        memory_free64f(&greens->staAlt);
+        memory_free8l(&greens->lsiteValid);
+        memory_free32i(&greens->rowPtrT);
+        memory_free32i(&greens->colIdxT);
+        memory_free64f(&greens->slip);
+    }
+    memory_free32i(&cache->planeEntry);
+    free(cache->planes);
+    free(cache);
+    ff->greens = NULL;
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Brings the cached Green's functions and regularizers up to date
+ *        for the given fault planes and active sites.  Each fault plane is
+ *        matched to the cached plane sharing the most fault patches.  Then
+ *        only the columns of the patches whose geometry changed and the
+ *        rows of the sites that are new to the plane or have moved are
+ *        recomputed.  The regularizer is recomputed only if a patch length
+ *        or width changed.
+ *
+ * @param[in,out] cache        on input holds the cached Green's functions.
+ *                             on output holds the Green's functions for
+ *                             these fault planes and sites.
+ * @param[in] nsites           total number of sites
+ * @param[in] luse             if true then the k'th site is in the
+ *                             inversion.  the active sites must appear in
+ *                             the compacted arrays in the order of their
+ *                             site index [nsites]
+ * @param[in] l1               number of active sites
+ * @param[in] l2               number of fault patches on each plane.
+ *                             this must be nstr*ndip.
+ * @param[in] nstr             number of fault patches along strike
+ * @param[in] ndip             number of fault patches down dip
+ * @param[in] nfp              number of fault planes
+ * @param[in] verbose          controls verbosity (< 3 is quiet)
+ * @param[in] utmRecvEasting   receiver UTM easting positions (m) [l1]
+ * @param[in] utmRecvNorthing  receiver UTM northing positions (m) [l1]
+ * @param[in] staAlt           station elevations above sea level (m) [l1]
+ * @param[in] fault_xutm       fault patch UTM eastings (m) [l2*nfp]
+ * @param[in] fault_yutm       fault patch UTM northings (m) [l2*nfp]
+ * @param[in] fault_alt        fault patch depths (km) [l2*nfp]
+ * @param[in] length           fault patch lengths (m) [l2*nfp]
+ * @param[in] width            fault patch widths (m) [l2*nfp]
+ * @param[in] strike           fault patch strikes (degrees) [l2*nfp]
+ * @param[in] dip              fault patch dips (degrees) [l2*nfp]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_updateGreensCache(struct GFAST_ffGreensCache_struct *cache,
+                              const int nsites,
+                              const bool *__restrict__ luse,
+                              const int l1, const int l2,
+                              const int nstr, const int ndip,
+                              const int nfp, const int verbose,
+                              const double *__restrict__ utmRecvEasting,
+                              const double *__restrict__ utmRecvNorthing,
+                              const double *__restrict__ staAlt,
+                              const double *__restrict__ fault_xutm,
+                              const double *__restrict__ fault_yutm,
+                              const double *__restrict__ fault_alt,
+                              const double *__restrict__ length,
+                              const double *__restrict__ width,
+                              const double *__restrict__ strike,
+                              const double *__restrict__ dip)
+{
+    struct GFAST_ffGreens_struct *greens;
+    double *Gwork, *pwork, *xrs, *yrs, *zrs;
+    int *cidx, *icol, *isite, ierr, ierr1, if_off, ifp, j, k, mrowsT,
+        nchange, nnew, nnzT;
+    //------------------------------------------------------------------------//
+    ierr = 0;
+    cidx = NULL;
+    if (cache == NULL || luse == NULL)
+    {
+        if (cache == NULL){LOG_ERRMSG("%s", "cache is NULL");}
+        if (luse == NULL){LOG_ERRMSG("%s", "luse is NULL");}
+        return -1;
+    }
+    if (nsites != cache->nsites || nstr != cache->nstr ||
+        ndip != cache->ndip || nfp != cache->nfp || l2 != nstr*ndip)
+    {
+        LOG_ERRMSG("Inconsistent cache size %d %d %d %d %d %d %d %d %d",
+                   nsites, cache->nsites, nstr, cache->nstr,
+                   ndip, cache->ndip, nfp, cache->nfp, l2);
+        return -1;
+    }
+    if (l1 < 1 || l1 > nsites)
+    {
+        LOG_ERRMSG("Error invalid number of sites: %d", l1);
+        return -1;
+    }
+    ierr = core_ff_getRegularizerSize(nstr, ndip, &mrowsT, &nnzT);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error getting regularizer size");
+        return -1;
+    }
+    // Map the site indices to the compacted arrays
+    cidx = memory_calloc32i(nsites);
+    j = 0;
+    for (k=0; k<nsites; k++)
+    {
+        cidx[k] =-1;
+        if (!luse[k]){continue;}
+        cidx[k] = j;
+        j = j + 1;
+    }
+    if (j != l1)
+    {
+        LOG_ERRMSG("Site mask has %d sites but expected %d", j, l1);
+        memory_free32i(&cidx);
+        return -1;
+    }
+    // Match the fault planes to cache entries
+    assignPlanes(l2, nfp,
+                 fault_xutm, fault_yutm, fault_alt,
+                 length, width, strike, dip, cache);
+#ifdef PARALLEL_FF
+    #pragma omp parallel \
+     firstprivate(l1, l2, mrowsT, ndip, nfp, nnzT, nsites, nstr, verbose) \
+     private(greens, Gwork, icol, ierr1, if_off, ifp, isite, nchange, nnew, \
+             pwork, xrs, yrs, zrs) \
+     shared(cache, cidx, dip, fault_alt, fault_xutm, fault_yutm, length, \
+            luse, staAlt, strike, utmRecvEasting, utmRecvNorthing, width) \
+     reduction(+:ierr) default(none)
+    {
+#endif
+    Gwork = memory_calloc64f(3*l1*2*l2);
+    pwork = memory_calloc64f(4*l2);
+    xrs = memory_calloc64f(l1*l2);
+    yrs = memory_calloc64f(l1*l2);
+    zrs = memory_calloc64f(l1*l2);
+    icol = memory_calloc32i(l2);
+    isite = memory_calloc32i(nsites);
+#ifdef PARALLEL_FF
+    #pragma omp for
+#endif
+    for (ifp=0; ifp<nfp; ifp++)
+    {
+        if_off = ifp*l2;
+        greens = &cache->planes[cache->planeEntry[ifp]];
+        ierr1 = updatePlane(nsites, luse, cidx, l1, l2, nstr, ndip,
+                            mrowsT, nnzT,
+                            utmRecvEasting, utmRecvNorthing, staAlt,
+                            &fault_xutm[if_off], &fault_yutm[if_off],
+                            &fault_alt[if_off],
+                            &length[if_off], &width[if_off],
+                            &strike[if_off], &dip[if_off],
+                            icol, isite, pwork, xrs, yrs, zrs, Gwork,
+                            &nchange, &nnew, greens);
+        if (ierr1 != 0)
+        {
+            LOG_ERRMSG("Error updating Green's functions on plane %d", ifp);
+            ierr = ierr + 1;
+            continue;
+        }
+        if (verbose > 2)
+        {
+            LOG_DEBUGMSG("Plane %d: recomputed %d patches and %d sites",
+                         ifp, nchange, nnew);
+        }
+    }
+    memory_free64f(&Gwork);
+    memory_free64f(&pwork);
+    memory_free64f(&xrs);
+    memory_free64f(&yrs);
+    memory_free64f(&zrs);
+    memory_free32i(&icol);
+    memory_free32i(&isite);
+#ifdef PARALLEL_FF
+    } // End the parallel region
+#endif
+    memory_free32i(&cidx);
+    if (ierr != 0){ierr = 1;}
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Copies the cached Green's functions of the active sites and the
+ *        compressed sparse row regularizer for the ifp'th fault plane.  The
+ *        cache must have been brought up to date with
+ *        core_ff_updateGreensCache.
+ *
+ * @param[in] cache     holds the cached Green's functions
+ * @param[in] ifp       fault plane index
+ * @param[in] nsites    total number of sites
+ * @param[in] luse      if true then the k'th site is in the inversion
+ *                      [nsites]
+ * @param[in] l1        number of active sites
+ * @param[in] l2        number of fault patches on each plane
+ * @param[in] mrowsT    number of rows in the regularizer
+ * @param[in] nnzT      number of non-zeros in the regularizer
+ *
+ * @param[out] G        unweighted forward modeling matrix in row major
+ *                      format with leading dimension 2*l2 [3*l1 x 2*l2]
+ * @param[out] rowPtrT  row pointers of the regularizer [mrowsT+1]
+ * @param[out] colIdxT  column indices of the regularizer [nnzT]
+ * @param[out] T        non-zeros of the regularizer [nnzT]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_getCachedForwardModel(
+    const struct GFAST_ffGreensCache_struct *cache,
+    const int ifp, const int nsites,
+    const bool *__restrict__ luse,
+    const int l1, const int l2,
+    const int mrowsT, const int nnzT,
+    double *__restrict__ G,
+    int *__restrict__ rowPtrT,
+    int *__restrict__ colIdxT,
+    double *__restrict__ T)
+{
+    const struct GFAST_ffGreens_struct *greens;
+    int j, k;
+    const size_t nrow = (size_t) (3*2*l2)*sizeof(double);
+    //------------------------------------------------------------------------//
+    if (cache == NULL || ifp < 0 || ifp >= cache->nfp ||
+        nsites != cache->nsites)
+    {
+        LOG_ERRMSG("%s", "Invalid cache or fault plane");
+        return -1;
+    }
+    greens = &cache->planes[cache->planeEntry[ifp]];
+    if (!greens->lvalid)
+    {
+        LOG_ERRMSG("Cached fault plane %d is not valid", ifp);
+        return -1;
+    }
+    j = 0;
+    for (k=0; k<nsites; k++)
+    {
+        if (!luse[k]){continue;}
+        if (j == l1 || !greens->lsiteValid[k])
+        {
+            LOG_ERRMSG("Site %d is not in the cache", k);
+            return -1;
+        }
+        memcpy(&G[3*j*2*l2], &greens->G[3*k*2*l2], nrow);
+        j = j + 1;
+    }
+    memcpy(rowPtrT, greens->rowPtrT, (size_t) (mrowsT+1)*sizeof(int));
+    memcpy(colIdxT, greens->colIdxT, (size_t) nnzT*sizeof(int));
+    memcpy(T, greens->T, (size_t) nnzT*sizeof(double));
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Assigns a cache entry to each fault plane.  A plane is given the
+ *        entry sharing the most fault patches with it and ties are broken
+ *        by recycling the least recently used entry.  Each entry is given
+ *        to at most one plane.
+ */
+static void assignPlanes(const int l2, const int nfp,
+                         const double *__restrict__ fault_xutm,
+                         const double *__restrict__ fault_yutm,
+                         const double *__restrict__ fault_alt,
+                         const double *__restrict__ length,
+                         const double *__restrict__ width,
+                         const double *__restrict__ strike,
+                         const double *__restrict__ dip,
+                         struct GFAST_ffGreensCache_struct *cache)
+{
+    struct GFAST_ffGreens_struct *greens;
+    int i, ibest, ie, if_off, ifp, nmatch, nbest;
+    cache->useCounter = cache->useCounter + 1;
+    for (ifp=0; ifp<nfp; ifp++)
+    {
+        if_off = ifp*l2;
+        ibest =-1;
+        nbest =-1;
+        for (ie=0; ie<cache->maxPlanes; ie++)
+        {
+            greens = &cache->planes[ie];
+            // Already taken by another plane
+            if (greens->lastUse == cache->useCounter){continue;}
+            nmatch = 0;
+            if (greens->lvalid)
+            {
+                for (i=0; i<l2; i++)
+                {
+                    if (greens->fault_xutm[i] == fault_xutm[if_off+i] &&
+                        greens->fault_yutm[i] == fault_yutm[if_off+i] &&
+                        greens->fault_alt[i]  == fault_alt[if_off+i]  &&
+                        greens->length[i]     == length[if_off+i]     &&
+                        greens->width[i]      == width[if_off+i]      &&
+                        greens->strike[i]     == strike[if_off+i]     &&
+                        greens->dip[i]        == dip[if_off+i])
+                    {
+                        nmatch = nmatch + 1;
+                    }
+                }
+            }
+            if (nmatch > nbest ||
+                (nmatch == nbest &&
+                 greens->lastUse < cache->planes[ibest].lastUse))
+            {
+                ibest = ie;
+                nbest = nmatch;
+            }
+        }
+        cache->planeEntry[ifp] = ibest;
+        cache->planes[ibest].lastUse = cache->useCounter;
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Updates the Green's functions and regularizer of one cached fault
+ *        plane.  Columns are recomputed for the changed patches at the
+ *        sites already in the cache and rows are recomputed for the new
+ *        sites at all patches.
+ */
+static int updatePlane(const int nsites, const bool *__restrict__ luse,
+                       const int *__restrict__ cidx,
+                       const int l1, const int l2,
+                       const int nstr, const int ndip,
+                       const int mrowsT, const int nnzT,
+                       const double *__restrict__ utmRecvEasting,
+                       const double *__restrict__ utmRecvNorthing,
+                       const double *__restrict__ staAlt,
+                       const double *__restrict__ fault_xutm,
+                       const double *__restrict__ fault_yutm,
+                       const double *__restrict__ fault_alt,
+                       const double *__restrict__ length,
+                       const double *__restrict__ width,
+                       const double *__restrict__ strike,
+                       const double *__restrict__ dip,
+                       int *__restrict__ icol, int *__restrict__ isite,
+                       double *__restrict__ pwork,
+                       double *__restrict__ xrs,
+                       double *__restrict__ yrs,
+                       double *__restrict__ zrs,
+                       double *__restrict__ Gwork,
+                       int *nchange, int *nnew,
+                       struct GFAST_ffGreens_struct *greens)
+{
+    double *pdip, *plen, *pstr, *pwid;
+    int i, ic, ierr, j, jc, k, l, nc, nold, nrow, r;
+    bool lreg;
+    const int ldg = 2*l2;
+    //------------------------------------------------------------------------//
+    *nchange = 0;
+    *nnew = 0;
+    if (l1 > nsites){return -1;}
+    // Space is set on first use
+    if (greens->G == NULL)
+    {
+        greens->G = memory_calloc64f(3*nsites*ldg);
+        greens->T = memory_calloc64f(nnzT);
+        greens->rowPtrT = memory_calloc32i(mrowsT+1);
+        greens->colIdxT = memory_calloc32i(nnzT);
+        greens->slip = memory_calloc64f(ldg);
+        greens->fault_xutm = memory_calloc64f(l2);
+        greens->fault_yutm = memory_calloc64f(l2);
+        greens->fault_alt = memory_calloc64f(l2);
+        greens->length = memory_calloc64f(l2);
+        greens->width = memory_calloc64f(l2);
+        greens->strike = memory_calloc64f(l2);
+        greens->dip = memory_calloc64f(l2);
+        greens->recvEasting = memory_calloc64f(nsites);
+        greens->recvNorthing = memory_calloc64f(nsites);
+        greens->staAlt = memory_calloc64f(nsites);
+        greens->lsiteValid = memory_calloc8l(nsites);
+    }
+    if (!greens->lvalid){array_zeros8l_work(nsites, greens->lsiteValid);}
+    // Find the patches that moved
+    pstr = &pwork[0];
+    pdip = &pwork[l2];
+    pwid = &pwork[2*l2];
+    plen = &pwork[3*l2];
+    lreg = !greens->lvalid;
+    nc = 0;
+    for (i=0; i<l2; i++)
+    {
+        if (greens->lvalid &&
+            greens->length[i] == length[i] && greens->width[i] == width[i] &&
+            greens->fault_xutm[i] == fault_xutm[i] &&
+            greens->fault_yutm[i] == fault_yutm[i] &&
+            greens->fault_alt[i] == fault_alt[i] &&
+            greens->strike[i] == strike[i] &&
+            greens->dip[i] == dip[i])
+        {
+            continue;
+        }
+        if (greens->length[i] != length[i] || greens->width[i] != width[i])
+        {
+            lreg = true;
+        }
+        greens->fault_xutm[i] = fault_xutm[i];
+        greens->fault_yutm[i] = fault_yutm[i];
+        greens->fault_alt[i] = fault_alt[i];
+        greens->length[i] = length[i];
+        greens->width[i] = width[i];
+        greens->strike[i] = strike[i];
+        greens->dip[i] = dip[i];
+        icol[nc] = i;
+        pstr[nc] = strike[i];
+        pdip[nc] = dip[i];
+        pwid[nc] = width[i];
+        plen[nc] = length[i];
+        nc = nc + 1;
+    }
+    // The previous slip is not a useful starting point for a new plane
+    if (nc == l2){greens->lslip = false;}
+    // Inactive sites will not get the new columns so they are stale
+    if (nc > 0)
+    {
+        for (k=0; k<nsites; k++)
+        {
+            if (!luse[k]){greens->lsiteValid[k] = false;}
+        }
+    }
+    // Split the active sites into those in the cache and new ones.  The
+    // cached sites are stored first and the new sites last in isite.
+    nold = 0;
+    *nnew = 0;
+    for (k=0; k<nsites; k++)
+    {
+        if (!luse[k]){continue;}
+        ic = cidx[k];
+        if (greens->lsiteValid[k] &&
+            greens->recvEasting[k] == utmRecvEasting[ic] &&
+            greens->recvNorthing[k] == utmRecvNorthing[ic] &&
+            greens->staAlt[k] == staAlt[ic])
+        {
+            isite[nold] = k;
+            nold = nold + 1;
+        }
+        else
+        {
+            *nnew = *nnew + 1;
+            isite[nsites-*nnew] = k;
+        }
+    }
+    greens->lvalid = false;
+    // Recompute the changed columns at the cached sites
+    if (nc > 0 && nold > 0)
+    {
+        for (l=0; l<nc; l++)
+        {
+            i = icol[l];
+            for (j=0; j<nold; j++)
+            {
+                k = isite[j];
+                xrs[l*nold+j] = greens->recvEasting[k]  - fault_xutm[i];
+                yrs[l*nold+j] = greens->recvNorthing[k] - fault_yutm[i];
+                zrs[l*nold+j] = fault_alt[i]*1.e3 + greens->staAlt[k];
+            }
+        }
+        ierr = core_ff_setForwardModel__okadagreenF(nold, nc,
+                                                    xrs, yrs, zrs,
+                                                    pstr, pdip, pwid, plen,
+                                                    Gwork);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing changed columns");
+            return -1;
+        }
+        for (j=0; j<nold; j++)
+        {
+            k = isite[j];
+            for (r=0; r<3; r++)
+            {
+                for (l=0; l<nc; l++)
+                {
+                    i = icol[l];
+                    greens->G[(3*k+r)*ldg+2*i+0]
+                       = Gwork[(3*j+r)*2*nc+2*l+0];
+                    greens->G[(3*k+r)*ldg+2*i+1]
+                       = Gwork[(3*j+r)*2*nc+2*l+1];
+                }
+            }
+        }
+    }
+    // Compute all the columns at the new sites
+    if (*nnew > 0)
+    {
+        nrow = *nnew;
+        for (i=0; i<l2; i++)
+        {
+            for (j=0; j<nrow; j++)
+            {
+                k = isite[nsites-1-j];
+                jc = cidx[k];
+                xrs[i*nrow+j] = utmRecvEasting[jc]  - fault_xutm[i];
+                yrs[i*nrow+j] = utmRecvNorthing[jc] - fault_yutm[i];
+                zrs[i*nrow+j] = fault_alt[i]*1.e3 + staAlt[jc];
+            }
+        }
+        ierr = core_ff_setForwardModel__okadagreenF(nrow, l2,
+                                                    xrs, yrs, zrs,
+                                                    strike, dip,
+                                                    width, length,
+                                                    Gwork);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing new rows");
+            return -1;
+        }
+        for (j=0; j<nrow; j++)
+        {
+            k = isite[nsites-1-j];
+            jc = cidx[k];
+            memcpy(&greens->G[3*k*ldg], &Gwork[3*j*ldg],
+                   (size_t) (3*ldg)*sizeof(double));
+            greens->recvEasting[k] = utmRecvEasting[jc];
+            greens->recvNorthing[k] = utmRecvNorthing[jc];
+            greens->staAlt[k] = staAlt[jc];
+            greens->lsiteValid[k] = true;
+        }
+    }
+    // Update the regularizer
+    if (lreg)
+    {
+        ierr = core_ff_setRegularizerCSR(l2, nstr, ndip, mrowsT, nnzT,
+                                         width, length,
+                                         greens->rowPtrT, greens->colIdxT,
+                                         greens->T);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error setting regularizer");
+            return -1;
+        }
+    }
+    greens->lvalid = true;
+    *nchange = nc;
+    return 0;
+}
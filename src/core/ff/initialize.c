@@ -111,6 +111,12 @@ int core_ff_initialize(struct GFAST_ff_props_struct props,
         ff->fp[ifp].Uinp       = memory_calloc64f(maxobs);
         ff->fp[ifp].fault_ptr  = memory_calloc32i(nstr_ndip + 1);
     }
+    // Green's function cache
+    if (core_ff_initializeGreensCache(ff) != 0)
+    {
+        LOG_ERRMSG("%s", "Error initializing Green's function cache");
+        return -1;
+    }
     return 0;
 } 
     
@@ -88,9 +88,9 @@ int core_ff_meshFaultPlane(const double ev_lat,
            fact_len, fact_wid,
            fault_X, fault_X1, fault_X2, fault_X3, fault_X4,
            fault_Y, fault_Y1, fault_Y2, fault_Y3, fault_Y4,
-           fault_Z, latF, len, lonF, wid,
+           fault_Z, len, wid,
            x0, xdoff, xsoff, y0, ydoff, ysoff, z0;
-    int i, j, k, zone_loc;
+    int i, ierr, j, k, zone_loc;
     bool lnorthp;
     const double pi180 = M_PI/180.0;
     //------------------------------------------------------------------------//
@@ -204,27 +204,20 @@ int core_ff_meshFaultPlane(const double ev_lat,
             fault_X4 = (x0 + di*xsoff + (dj + 1.0)*xdoff)*1.e3; //km->m
             fault_Y4 = (y0 + di*ysoff + (dj + 1.0)*ydoff)*1.e3; //km->m
 
-            // Convert from UTMs back to lat/lon 
             fault_X = fault_X*1000.0; // km -> m
             fault_Y = fault_Y*1000.0; // km -> m
-            core_coordtools_utm2ll(zone_loc, lnorthp,
-                                   fault_Y, fault_X,
-                                   &latF, &lonF);
             k = j*nstr + i;
             fault_ptr[k+1] = 4*(k + 1);
-            // Generate output
-            core_coordtools_utm2ll(zone_loc, lnorthp,
-                                   fault_Y1, fault_X1,
-                                   &lat_vtx[4*k+0], &lon_vtx[4*k+0]);
-            core_coordtools_utm2ll(zone_loc, lnorthp,
-                                   fault_Y2, fault_X2,
-                                   &lat_vtx[4*k+1], &lon_vtx[4*k+1]);
-            core_coordtools_utm2ll(zone_loc, lnorthp,
-                                   fault_Y3, fault_X3,
-                                   &lat_vtx[4*k+2], &lon_vtx[4*k+2]);
-            core_coordtools_utm2ll(zone_loc, lnorthp,
-                                   fault_Y4, fault_X4,
-                                   &lat_vtx[4*k+3], &lon_vtx[4*k+3]);
+            // Generate output - the vertex UTMs are converted to lat/lon
+            // in one batch after the mesh is built
+            lat_vtx[4*k+0] = fault_Y1;
+            lon_vtx[4*k+0] = fault_X1;
+            lat_vtx[4*k+1] = fault_Y2;
+            lon_vtx[4*k+1] = fault_X2;
+            lat_vtx[4*k+2] = fault_Y3;
+            lon_vtx[4*k+2] = fault_X3;
+            lat_vtx[4*k+3] = fault_Y4;
+            lon_vtx[4*k+3] = fault_X4;
             dep_vtx[4*k+0] = fault_Z; //depF;
             dep_vtx[4*k+1] = fault_Z; //depF;
             dep_vtx[4*k+2] = fault_Z; //depF;
@@ -239,5 +232,14 @@ int core_ff_meshFaultPlane(const double ev_lat,
             width[k] = dwid*1.e3;  // km -> m
         } // Loop on strike 
     } // Loop on dip
+    // Convert from UTMs back to lat/lon
+    ierr = core_coordtools_utm2ll_batch(4*nstr*ndip, zone_loc, lnorthp,
+                                        lat_vtx, lon_vtx,
+                                        lat_vtx, lon_vtx);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error converting fault vertices to lat/lon");
+        return -1;
+    }
     return 0;
 }
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <float.h>
 #ifdef __clang__
 #pragma clang diagnostic push
 #pragma clang diagnostic ignored "-Wdocumentation"
@@ -113,6 +114,58 @@ int core_ff_readIni(const char *propfilename,
         LOG_ERRMSG("%s", "Error cannot shrink fault width");
         goto ERROR;
     }
+    setVarName(group, "ff_solver\0", var);
+    ff_props->solver = (enum ff_solver_type)
+                       iniparser_getint(ini, var, FF_DIRECT_SOLVER);
+    if (ff_props->solver != FF_DIRECT_SOLVER &&
+        ff_props->solver != FF_CGLS_SOLVER)
+    {
+        LOG_ERRMSG("Error invalid slip solver %d", ff_props->solver);
+        goto ERROR;
+    }
+    setVarName(group, "ff_cgls_tol\0", var);
+    ff_props->cgls_tol = iniparser_getdouble(ini, var, 1.e-6);
+    if (ff_props->cgls_tol <= 0.0)
+    {
+        LOG_ERRMSG("%s", "Error CGLS tolerance must be positive");
+        goto ERROR;
+    }
+    setVarName(group, "ff_cgls_maxit\0", var);
+    ff_props->cgls_maxit = iniparser_getint(ini, var, 200);
+    if (ff_props->cgls_maxit < 1)
+    {
+        LOG_ERRMSG("%s", "Error CGLS needs at least one iteration");
+        goto ERROR;
+    }
+    setVarName(group, "ff_min_slip\0", var);
+    ff_props->min_slip = iniparser_getdouble(ini, var, -DBL_MAX);
+    setVarName(group, "ff_max_slip\0", var);
+    ff_props->max_slip = iniparser_getdouble(ini, var, DBL_MAX);
+    if (ff_props->min_slip > ff_props->max_slip)
+    {
+        LOG_ERRMSG("Error min slip %f exceeds max slip %f",
+                   ff_props->min_slip, ff_props->max_slip);
+        goto ERROR;
+    }
+    if (ff_props->solver != FF_CGLS_SOLVER &&
+        (ff_props->min_slip > -DBL_MAX || ff_props->max_slip < DBL_MAX))
+    {
+        LOG_WARNMSG("%s", "Slip bounds are only used by the CGLS solver");
+    }
+    setVarName(group, "ff_unc_nprobe\0", var);
+    ff_props->unc_nprobe = iniparser_getint(ini, var, 0);
+    if (ff_props->unc_nprobe < 0)
+    {
+        LOG_ERRMSG("%s", "Error number of uncertainty probes is negative");
+        goto ERROR;
+    }
+    if (ff_props->solver == FF_CGLS_SOLVER && ff_props->unc_nprobe == 0 &&
+        ff_props->min_slip == -DBL_MAX && ff_props->max_slip == DBL_MAX)
+    {
+        LOG_WARNMSG("%s",
+                    "Exact uncertainties factor the normal equations so the "
+                    "direct solver will be used - set ff_unc_nprobe for CGLS");
+    }
     ierr = 0;
     ERROR:;
     iniparser_freedict(ini);
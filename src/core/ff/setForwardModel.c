@@ -6,17 +6,12 @@
 #define eps 6.1232e-14 /*!< A close number for okadaGreenF */
 // Poisson's ratio
 #define nu 0.25 /*!< Poisson's ratio for okadaGreenF */
+// Number of fault patches tabulated at once
+#define OKADA_PATCH_BLOCK 64 /*!< Patch block size for okadaGreenF */
 #ifndef M_PI
 #define M_PI 3.14159265358979323846
 #endif
 
-#ifdef _OPENMP
-#pragma omp declare simd
-#endif
-static inline void __ss_ds(const double cos_dip, const double sin_dip,
-                           const double xi, const double eta, const double q,
-                           double *ux_ss, double *uy_ss, double *uz_ss,
-                           double *ux_ds, double *uy_ds, double *uz_ds);
 #ifdef _OPENMP
 #pragma omp declare simd
 #endif
@@ -34,9 +29,33 @@ static inline void __ss_ds_withDip(const double cos_dip, const double sin_dip,
                                    double *ux_ss, double *uy_ss, double *uz_ss,
                                    double *ux_ds, double *uy_ds, double *uz_ds);
 
+static void okadaDipping(const int l1, const int l2, const int i,
+                         const double cos_strike, const double sin_strike,
+                         const double cos_dip, const double sin_dip,
+                         const double dOff, const double eOff,
+                         const double nOff, const double xOff,
+                         const double yOff, const double W, const double L,
+                         const double *__restrict__ e,
+                         const double *__restrict__ n,
+                         const double *__restrict__ depth,
+                         double *__restrict__ G);
+static void okadaVertical(const int l1, const int l2, const int i,
+                          const double cos_strike, const double sin_strike,
+                          const double sin_dip,
+                          const double dOff, const double xOff,
+                          const double W, const double L,
+                          const double *__restrict__ e,
+                          const double *__restrict__ n,
+                          const double *__restrict__ depth,
+                          double *__restrict__ G);
+
 /*!
  * @brief This program computes the Green's functions from Okada's formulation
- *        for slip on fault patches at a set of station locations
+ *        for slip on fault patches at a set of station locations.
+ *        The strike and dip trigonometry and the patch geometry are
+ *        computed once per patch and stored by blocks of patches.  Each
+ *        patch is then evaluated at all stations with a branch-free loop
+ *        specialized for vertical or dipping patches.
  *
  * @param[in] l1      number of station locations
  * @param[in] l2      number of fault locations
@@ -69,19 +88,14 @@ int core_ff_setForwardModel__okadagreenF(const int l1, const int l2,
                                          const double *__restrict__ L,
                                          double *__restrict__ G)
 {
-    double cos_dip, cos_strike, d, dip1, ec, 
-           g1, g1n, g2, g2n, g3, g3n, g4, g4n, g5, g6,
-           nc, p, q,
-           ux_ss_1, uy_ss_1, uz_ss_1,  ux_ds_1, uy_ds_1, uz_ds_1,
-           ux_ss_2, uy_ss_2, uz_ss_2,  ux_ds_2, uy_ds_2, uz_ds_2,
-           ux_ss_3, uy_ss_3, uz_ss_3,  ux_ds_3, uy_ds_3, uz_ds_3,
-           ux_ss_4, uy_ss_4, uz_ss_4,  ux_ds_4, uy_ds_4, uz_ds_4,
-           strike1, sin_dip, sin_strike, x, y;
-    int i, j, ij, indx;
-    bool ldip;
+    double cosDip[OKADA_PATCH_BLOCK], cosStr[OKADA_PATCH_BLOCK],
+           dOff[OKADA_PATCH_BLOCK], eOff[OKADA_PATCH_BLOCK],
+           nOff[OKADA_PATCH_BLOCK], sinDip[OKADA_PATCH_BLOCK],
+           sinStr[OKADA_PATCH_BLOCK], xOff[OKADA_PATCH_BLOCK],
+           yOff[OKADA_PATCH_BLOCK], dip1, strike1;
+    int i, i0, ib, nb;
+    bool lvert[OKADA_PATCH_BLOCK];
     const double pi180 = M_PI/180.0;
-    const double one_twopi = 1.0/(2.0*M_PI);
-    const bool lverif = false;
     //------------------------------------------------------------------------//
     if (l1 < 1 || l2 < 1)
     {
@@ -89,299 +103,229 @@ int core_ff_setForwardModel__okadagreenF(const int l1, const int l2,
         if (l2 < 1){LOG_ERRMSG("%s", "Error no fault patches");}
         return -1;
     }
-    // classify the job
-    ldip = false;
-    for (i=0; i<l2; i++)
+    // Loop on blocks of fault patches
+    for (i0=0; i0<l2; i0=i0+OKADA_PATCH_BLOCK)
     {
-        if (cos(dip[i]*pi180) > eps){ldip = true;}
-    }
-    // This is the non-vertical fault case
-    indx = 0;
-    if (ldip) 
-    {
-        // Loop on the observations
-        for (j=0; j<l1; j++)
+        nb = l2 - i0;
+        if (nb > OKADA_PATCH_BLOCK){nb = OKADA_PATCH_BLOCK;}
+        // Tabulate the patch trigonometry and corner offsets
+        for (ib=0; ib<nb; ib++)
         {
-            // Loop on faults
-            for (i=0; i<l2; i++)
+            i = i0 + ib;
+            strike1 = strike[i]*pi180;
+            dip1 = dip[i]*pi180;
+            cosStr[ib] = cos(strike1);
+            sinStr[ib] = sin(strike1);
+            cosDip[ib] = cos(dip1);
+            sinDip[ib] = sin(dip1);
+            // Classify the patch
+            lvert[ib] = false;
+            if (!(cosDip[ib] > eps))
             {
-                ij = l1*i + j;
-
-                strike1 = strike[i]*pi180;
-                dip1 = dip[i]*pi180;
-                cos_strike = cos(strike1);
-                sin_strike = sin(strike1);
-                cos_dip = cos(dip1);
-                sin_dip = sin(dip1);
-
-                d = depth[ij] + sin_dip*W[i]*0.5;
-                ec = e[ij] + cos_strike*cos_dip*W[i]*0.5;
-                nc = n[ij] - sin_strike*cos_dip*W[i]*0.5;
-                x = cos_strike*nc + sin_strike*ec + L[i]*0.5;
-                y = sin_strike*nc - cos_strike*ec + cos_dip*W[i];
-
-                p = y*cos_dip + d*sin_dip;
-                q = y*sin_dip - d*cos_dip;
-
-               __ss_ds_withDip(cos_dip, sin_dip,
-                               x, p, q,
-                               &ux_ss_1, &uy_ss_1, &uz_ss_1,
-                               &ux_ds_1, &uy_ds_1, &uz_ds_1);
-               __ss_ds_withDip(cos_dip, sin_dip,
-                               x, p-W[i], q,
-                               &ux_ss_2, &uy_ss_2, &uz_ss_2,
-                               &ux_ds_2, &uy_ds_2, &uz_ds_2);
-               __ss_ds_withDip(cos_dip, sin_dip,
-                               x-L[i], p, q,
-                               &ux_ss_3, &uy_ss_3, &uz_ss_3,
-                               &ux_ds_3, &uy_ds_3, &uz_ds_3);
-               __ss_ds_withDip(cos_dip, sin_dip,
-                               x-L[i], p-W[i], q,
-                               &ux_ss_4, &uy_ss_4, &uz_ss_4,
-                               &ux_ds_4, &uy_ds_4, &uz_ds_4);
-
-                g1 =-one_twopi*( ux_ss_1 - ux_ss_2 - ux_ss_3 + ux_ss_4);
-                g2 =-one_twopi*( ux_ds_1 - ux_ds_2 - ux_ds_3 + ux_ds_4);
-                g3 =-one_twopi*( uy_ss_1 - uy_ss_2 - uy_ss_3 + uy_ss_4);
-                g4 =-one_twopi*( uy_ds_1 - uy_ds_2 - uy_ds_3 + uy_ds_4);
-                g5 =-one_twopi*( uz_ss_1 - uz_ss_2 - uz_ss_3 + uz_ss_4);
-                g6 =-one_twopi*( uz_ds_1 - uz_ds_2 - uz_ds_3 + uz_ds_4);
-
-                g1n = sin_strike*g1 - cos_strike*g3;
-                g3n = cos_strike*g1 + sin_strike*g3;
-
-                g2n = sin_strike*g2 - cos_strike*g4;
-                g4n = cos_strike*g2 + sin_strike*g4;
-
-                indx = 3*2*j*l2 + 2*i;
-                G[indx+0] = g1n;
-                G[indx+1] = g2n;
-
-                //indx = 3*(j+1)*l2 + 2*i;
-                G[indx+2*l2+0] = g3n;
-                G[indx+2*l2+1] = g4n;
-
-                //indx = 3*(j+2)*l2 + 2*i;
-                G[indx+4*l2+0] = g5;
-                G[indx+4*l2+1] = g6;
-            } // Loop on faults (i)
-        } // Loop on observations (j)
-    }
-    // This is the vertical fault case
-    else
-    {
-        // Loop on the observations
-        for (j=0; j<l1; j++)
+                cosDip[ib] = 0.0;
+                lvert[ib] = true;
+            }
+            dOff[ib] = sinDip[ib]*W[i]*0.5;
+            eOff[ib] = cosStr[ib]*cosDip[ib]*W[i]*0.5;
+            nOff[ib] = sinStr[ib]*cosDip[ib]*W[i]*0.5;
+            xOff[ib] = L[i]*0.5;
+            yOff[ib] = cosDip[ib]*W[i];
+        }
+        // Evaluate the patches at all the stations
+        for (ib=0; ib<nb; ib++)
         {
-            // Loop on faults
-            for (i=0; i<l2; i++)
+            i = i0 + ib;
+            if (lvert[ib])
             {
-                ij = l1*i + j;
-
-                strike1 = strike[i]*pi180;
-                dip1 = dip[i]*pi180;
-                cos_strike = cos(strike1);
-                sin_strike = sin(strike1);
-                cos_dip = 0.0; //cos(dip1);
-                sin_dip = sin(dip1);
-
-                d = depth[ij] + sin_dip*W[i]*0.5;
-                ec = e[ij] + cos_strike*cos_dip*W[i]*0.5;
-                nc = n[ij] - sin_strike*cos_dip*W[i]*0.5;
-                x = cos_strike*nc + sin_strike*ec + L[i]*0.5;
-                y = sin_strike*nc - cos_strike*ec + cos_dip*W[i];
-
-                p = y*cos_dip + d*sin_dip;
-                q = y*sin_dip - d*cos_dip;
-
-               __ss_ds_zeroDip(sin_dip,
-                               x, p, q,
-                               &ux_ss_1, &uy_ss_1, &uz_ss_1,
-                               &ux_ds_1, &uy_ds_1, &uz_ds_1);
-               __ss_ds_zeroDip(sin_dip,
-                               x, p-W[i], q,
-                               &ux_ss_2, &uy_ss_2, &uz_ss_2,
-                               &ux_ds_2, &uy_ds_2, &uz_ds_2);
-               __ss_ds_zeroDip(sin_dip,
-                               x-L[i], p, q,
-                               &ux_ss_3, &uy_ss_3, &uz_ss_3,
-                               &ux_ds_3, &uy_ds_3, &uz_ds_3);
-               __ss_ds_zeroDip(sin_dip,
-                               x-L[i], p-W[i], q,
-                               &ux_ss_4, &uy_ss_4, &uz_ss_4,
-                               &ux_ds_4, &uy_ds_4, &uz_ds_4);
-
+                okadaVertical(l1, l2, i,
+                              cosStr[ib], sinStr[ib], sinDip[ib],
+                              dOff[ib], xOff[ib],
+                              W[i], L[i],
+                              e, n, depth, G);
+            }
+            else
+            {
+                okadaDipping(l1, l2, i,
+                             cosStr[ib], sinStr[ib],
+                             cosDip[ib], sinDip[ib],
+                             dOff[ib], eOff[ib], nOff[ib],
+                             xOff[ib], yOff[ib],
+                             W[i], L[i],
+                             e, n, depth, G);
+            }
+        } // Loop on patches in block
+    } // Loop on patch blocks
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Evaluates the Green's functions for the i'th dipping fault patch
+ *        at all l1 stations.  The station offsets for the patch are
+ *        contiguous so the loop over stations vectorizes.
+ */
+static void okadaDipping(const int l1, const int l2, const int i,
+                         const double cos_strike, const double sin_strike,
+                         const double cos_dip, const double sin_dip,
+                         const double dOff, const double eOff,
+                         const double nOff, const double xOff,
+                         const double yOff, const double W, const double L,
+                         const double *__restrict__ e,
+                         const double *__restrict__ n,
+                         const double *__restrict__ depth,
+                         double *__restrict__ G)
+{
+    int j;
+    const double one_twopi = 1.0/(2.0*M_PI);
+    const int ioff = l1*i;
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (j=0; j<l1; j++)
+    {
+        // Temporaries are declared here so they are private to each lane
+        double d, ec, g1, g1n, g2, g2n, g3, g3n, g4, g4n, g5, g6,
+               nc, p, q,
+               ux_ss_1, uy_ss_1, uz_ss_1,  ux_ds_1, uy_ds_1, uz_ds_1,
+               ux_ss_2, uy_ss_2, uz_ss_2,  ux_ds_2, uy_ds_2, uz_ds_2,
+               ux_ss_3, uy_ss_3, uz_ss_3,  ux_ds_3, uy_ds_3, uz_ds_3,
+               ux_ss_4, uy_ss_4, uz_ss_4,  ux_ds_4, uy_ds_4, uz_ds_4,
+               x, y;
+        int indx, ij;
+        ij = ioff + j;
+        d = depth[ij] + dOff;
+        ec = e[ij] + eOff;
+        nc = n[ij] - nOff;
+        x = cos_strike*nc + sin_strike*ec + xOff;
+        y = sin_strike*nc - cos_strike*ec + yOff;
+
+        p = y*cos_dip + d*sin_dip;
+        q = y*sin_dip - d*cos_dip;
+
+        __ss_ds_withDip(cos_dip, sin_dip,
+                        x, p, q,
+                        &ux_ss_1, &uy_ss_1, &uz_ss_1,
+                        &ux_ds_1, &uy_ds_1, &uz_ds_1);
+        __ss_ds_withDip(cos_dip, sin_dip,
+                        x, p-W, q,
+                        &ux_ss_2, &uy_ss_2, &uz_ss_2,
+                        &ux_ds_2, &uy_ds_2, &uz_ds_2);
+        __ss_ds_withDip(cos_dip, sin_dip,
+                        x-L, p, q,
+                        &ux_ss_3, &uy_ss_3, &uz_ss_3,
+                        &ux_ds_3, &uy_ds_3, &uz_ds_3);
+        __ss_ds_withDip(cos_dip, sin_dip,
+                        x-L, p-W, q,
+                        &ux_ss_4, &uy_ss_4, &uz_ss_4,
+                        &ux_ds_4, &uy_ds_4, &uz_ds_4);
 
-                g1 =-one_twopi*( ux_ss_1 - ux_ss_2 - ux_ss_3 + ux_ss_4);
-                g2 =-one_twopi*( ux_ds_1 - ux_ds_2 - ux_ds_3 + ux_ds_4);
-                g3 =-one_twopi*( uy_ss_1 - uy_ss_2 - uy_ss_3 + uy_ss_4);
-                g4 =-one_twopi*( uy_ds_1 - uy_ds_2 - uy_ds_3 + uy_ds_4);
-                g5 =-one_twopi*( uz_ss_1 - uz_ss_2 - uz_ss_3 + uz_ss_4);
-                g6 =-one_twopi*( uz_ds_1 - uz_ds_2 - uz_ds_3 + uz_ds_4);
+        g1 =-one_twopi*( ux_ss_1 - ux_ss_2 - ux_ss_3 + ux_ss_4);
+        g2 =-one_twopi*( ux_ds_1 - ux_ds_2 - ux_ds_3 + ux_ds_4);
+        g3 =-one_twopi*( uy_ss_1 - uy_ss_2 - uy_ss_3 + uy_ss_4);
+        g4 =-one_twopi*( uy_ds_1 - uy_ds_2 - uy_ds_3 + uy_ds_4);
+        g5 =-one_twopi*( uz_ss_1 - uz_ss_2 - uz_ss_3 + uz_ss_4);
+        g6 =-one_twopi*( uz_ds_1 - uz_ds_2 - uz_ds_3 + uz_ds_4);
 
-                g1n = sin_strike*g1 - cos_strike*g3;
-                g3n = cos_strike*g1 + sin_strike*g3;
+        g1n = sin_strike*g1 - cos_strike*g3;
+        g3n = cos_strike*g1 + sin_strike*g3;
 
-                g2n = sin_strike*g2 - cos_strike*g4;
-                g4n = cos_strike*g2 + sin_strike*g4;
+        g2n = sin_strike*g2 - cos_strike*g4;
+        g4n = cos_strike*g2 + sin_strike*g4;
 
-                indx = 3*2*j*l2 + 2*i;
-                G[indx+0] = g1n;
-                G[indx+1] = g2n;
+        indx = 3*2*j*l2 + 2*i;
+        G[indx+0] = g1n;
+        G[indx+1] = g2n;
 
-                //indx = 3*(j+1)*l2 + 2*i;
-                G[indx+2*l2+0] = g3n;
-                G[indx+2*l2+1] = g4n;
+        G[indx+2*l2+0] = g3n;
+        G[indx+2*l2+1] = g4n;
 
-                //indx = 3*(j+2)*l2 + 2*i;
-                G[indx+4*l2+0] = g5;
-                G[indx+4*l2+1] = g6;
-            } // Loop on faults (i)
-        } // Loop on observations (j)
+        G[indx+4*l2+0] = g5;
+        G[indx+4*l2+1] = g6;
     }
-    // Verification loop - should only exist for debugging purposes
-    if (lverif)
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Evaluates the Green's functions for the i'th vertical fault patch
+ *        at all l1 stations.  Since cos(dip) is zero the along-dip corner
+ *        offsets vanish and p and q simplify.
+ */
+static void okadaVertical(const int l1, const int l2, const int i,
+                          const double cos_strike, const double sin_strike,
+                          const double sin_dip,
+                          const double dOff, const double xOff,
+                          const double W, const double L,
+                          const double *__restrict__ e,
+                          const double *__restrict__ n,
+                          const double *__restrict__ depth,
+                          double *__restrict__ G)
+{
+    int j;
+    const double one_twopi = 1.0/(2.0*M_PI);
+    const int ioff = l1*i;
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (j=0; j<l1; j++)
     {
-        indx = 0;
-        // Loop on the observations
-        for (j=0; j<l1; j++)
-        {
-            // Loop on faults
-            for (i=0; i<l2; i++)
-            {
-                ij = l1*i + j;
-
-                strike1 = strike[i]*pi180;
-                dip1 = dip[i]*pi180;
-                cos_strike = cos(strike1);
-                sin_strike = sin(strike1);
-                cos_dip = cos(dip1);
-                sin_dip = sin(dip1);
-
-                d = depth[ij] + sin_dip*W[i]*0.5;
-                ec = e[ij] + cos_strike*cos_dip*W[i]*0.5;
-                nc = n[ij] - sin_strike*cos_dip*W[i]*0.5;
-                x = cos_strike*nc + sin_strike*ec + L[i]*0.5;
-                y = sin_strike*nc - cos_strike*ec + cos_dip*W[i];
-
-                p = y*cos_dip + d*sin_dip;
-                q = y*sin_dip - d*cos_dip;
-
-                __ss_ds(cos_dip, sin_dip,
+        // Temporaries are declared here so they are private to each lane
+        double d, ec, g1, g1n, g2, g2n, g3, g3n, g4, g4n, g5, g6,
+               nc, p, q,
+               ux_ss_1, uy_ss_1, uz_ss_1,  ux_ds_1, uy_ds_1, uz_ds_1,
+               ux_ss_2, uy_ss_2, uz_ss_2,  ux_ds_2, uy_ds_2, uz_ds_2,
+               ux_ss_3, uy_ss_3, uz_ss_3,  ux_ds_3, uy_ds_3, uz_ds_3,
+               ux_ss_4, uy_ss_4, uz_ss_4,  ux_ds_4, uy_ds_4, uz_ds_4,
+               x, y;
+        int indx, ij;
+        ij = ioff + j;
+        d = depth[ij] + dOff;
+        ec = e[ij];
+        nc = n[ij];
+        x = cos_strike*nc + sin_strike*ec + xOff;
+        y = sin_strike*nc - cos_strike*ec;
+
+        p = d*sin_dip;
+        q = y*sin_dip;
+
+        __ss_ds_zeroDip(sin_dip,
                         x, p, q,
                         &ux_ss_1, &uy_ss_1, &uz_ss_1,
                         &ux_ds_1, &uy_ds_1, &uz_ds_1);
-                __ss_ds(cos_dip, sin_dip,
-                        x, p-W[i], q,
+        __ss_ds_zeroDip(sin_dip,
+                        x, p-W, q,
                         &ux_ss_2, &uy_ss_2, &uz_ss_2,
                         &ux_ds_2, &uy_ds_2, &uz_ds_2);
-                __ss_ds(cos_dip, sin_dip,
-                        x-L[i], p, q,
+        __ss_ds_zeroDip(sin_dip,
+                        x-L, p, q,
                         &ux_ss_3, &uy_ss_3, &uz_ss_3,
                         &ux_ds_3, &uy_ds_3, &uz_ds_3);
-                __ss_ds(cos_dip, sin_dip,
-                        x-L[i], p-W[i], q,
+        __ss_ds_zeroDip(sin_dip,
+                        x-L, p-W, q,
                         &ux_ss_4, &uy_ss_4, &uz_ss_4,
                         &ux_ds_4, &uy_ds_4, &uz_ds_4);
 
-                g1 =-one_twopi*( ux_ss_1 - ux_ss_2 - ux_ss_3 + ux_ss_4);
-                g2 =-one_twopi*( ux_ds_1 - ux_ds_2 - ux_ds_3 + ux_ds_4);
-                g3 =-one_twopi*( uy_ss_1 - uy_ss_2 - uy_ss_3 + uy_ss_4);
-                g4 =-one_twopi*( uy_ds_1 - uy_ds_2 - uy_ds_3 + uy_ds_4);
-                g5 =-one_twopi*( uz_ss_1 - uz_ss_2 - uz_ss_3 + uz_ss_4);
-                g6 =-one_twopi*( uz_ds_1 - uz_ds_2 - uz_ds_3 + uz_ds_4);
-
-                g1n = sin_strike*g1 - cos_strike*g3;
-                g3n = cos_strike*g1 + sin_strike*g3;
+        g1 =-one_twopi*( ux_ss_1 - ux_ss_2 - ux_ss_3 + ux_ss_4);
+        g2 =-one_twopi*( ux_ds_1 - ux_ds_2 - ux_ds_3 + ux_ds_4);
+        g3 =-one_twopi*( uy_ss_1 - uy_ss_2 - uy_ss_3 + uy_ss_4);
+        g4 =-one_twopi*( uy_ds_1 - uy_ds_2 - uy_ds_3 + uy_ds_4);
+        g5 =-one_twopi*( uz_ss_1 - uz_ss_2 - uz_ss_3 + uz_ss_4);
+        g6 =-one_twopi*( uz_ds_1 - uz_ds_2 - uz_ds_3 + uz_ds_4);
 
-                g2n = sin_strike*g2 - cos_strike*g4;
-                g4n = cos_strike*g2 + sin_strike*g4;
+        g1n = sin_strike*g1 - cos_strike*g3;
+        g3n = cos_strike*g1 + sin_strike*g3;
 
-                indx = 3*2*j*l2 + 2*i;
-                if (fabs(G[indx+0] - g1n) > eps ||
-                    fabs(G[indx+1] - g2n) > eps)
-                {
-                    LOG_WARNMSG("%s", "g1n g2n failed");
-                    G[indx+0] = g1n;
-                    G[indx+1] = g2n;
-                }
+        g2n = sin_strike*g2 - cos_strike*g4;
+        g4n = cos_strike*g2 + sin_strike*g4;
 
-                //indx = 3*(j+1)*l2 + 2*i;
-                if (fabs(G[indx+2*l2+0]) - g3n > eps ||
-                    fabs(G[indx+2*l2+1]) - g4n > eps)
-                {
-                    LOG_WARNMSG("%s", "g3n g4n failed");
-                    G[indx+2*l2+0] = g3n;
-                    G[indx+2*l2+1] = g4n;
-                }
+        indx = 3*2*j*l2 + 2*i;
+        G[indx+0] = g1n;
+        G[indx+1] = g2n;
 
-                //indx = 3*(j+2)*l2 + 2*i;
-                if (fabs(G[indx+4*l2+0]) - g5 > eps ||
-                    fabs(G[indx+4*l2+1]) - g6 > eps)
-                {
-                    LOG_WARNMSG("%s", "g5 g6 failed");
-                    G[indx+4*l2+0] = g5;
-                    G[indx+4*l2+1] = g6;
-                }
-            } // Loop on faults (i)
-        } // Loop on observations (j) 
-    } // End check on verification
-    return 0;
-}
+        G[indx+2*l2+0] = g3n;
+        G[indx+2*l2+1] = g4n;
 
-#ifdef _OPENMP
-#pragma omp declare simd
-#endif
-static inline void __ss_ds(const double cos_dip, const double sin_dip,
-                           const double xi, const double eta, const double q,
-                           double *ux_ss, double *uy_ss, double *uz_ss,
-                           double *ux_ds, double *uy_ds, double *uz_ds)
-{
-    double atan_xeqr, db, I1, I2, I3, I4, I5, log_rpeta, pow_rpdb2, R, X, yb;
-    R = sqrt(xi*xi + eta*eta + q*q);
-    yb = eta*cos_dip + q*sin_dip;
-    db = eta*sin_dip - q*cos_dip;
-    X = sqrt(xi*xi + q*q);
-    log_rpeta = log(R + eta);
-    pow_rpdb2 = pow(R + db, 2);
-    atan_xeqr = atan(xi*eta/(q*R));
-    if (cos_dip > eps)
-    {
-        I5 = (1.0 - 2.0*nu)*2.0/cos_dip
-            *atan( ( eta*(X + q*cos_dip) + X*(R + X)*sin_dip )
-                  /(xi*(R + X)*cos_dip));
-        I4 = (1.0 - 2.0*nu)/cos_dip*(log(R+db) - sin_dip*log_rpeta);
-        I3 = (1.0 - 2.0*nu)*(yb/cos_dip/(R+db) - log_rpeta) 
-           + sin_dip/cos_dip*I4;
-        I2 = (1.0 - 2.0*nu)*(-log_rpeta) - I3;
-        I1 = (1.0 - 2.0*nu)*(-xi/cos_dip/(R+db)) 
-           - sin_dip/cos_dip*I5;
+        G[indx+4*l2+0] = g5;
+        G[indx+4*l2+1] = g6;
     }
-    else
-    {
-        I5 =-(1.0 - 2.0*nu)*xi*sin_dip/(R + db);
-        I4 =-(1.0 - 2.0*nu)*q/(R + db);
-        I3 = (1.0 - 2.0*nu)/2.0*( eta/(R+db) + yb*q/pow_rpdb2 - log_rpeta );
-        I2 = (1.0 - 2.0*nu)*(-log_rpeta) - I3; 
-        I1 =-(1.0 - 2.0*nu)/2.0*xi*q/pow_rpdb2;
-    }
-    *ux_ss = xi*q/(R*(R+eta)) 
-           + atan_xeqr
-           + I1*sin_dip; 
-    *uy_ss = yb*q/(R*(R + eta))
-           + q*cos_dip/(R + eta)
-           + I2*sin_dip;
-    *uz_ss = db*q/(R*(R + eta))
-           + q*sin_dip/(R + eta)
-           + I4*sin_dip;
-    *ux_ds = q/R
-           - I3*sin_dip*cos_dip;
-    *uy_ds = yb*q/(R*(R + xi))
-           + cos_dip*atan_xeqr
-           - I1*sin_dip*cos_dip;
-    *uz_ds = db*q/(R*(R + xi))
-           + sin_dip*atan_xeqr
-           - I5*sin_dip*cos_dip;
     return;
 }
 
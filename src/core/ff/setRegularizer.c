@@ -168,3 +168,208 @@ int core_ff_setRegularizer(const int l2, const int nstr,
     }
     return 0;
 }
+//============================================================================//
+/*!
+ * @brief Sets the fault patches and weights of the second order difference
+ *        on the i'th, j'th fault patch in order of increasing patch.  As in
+ *        core_ff_setRegularizer a later weight on the same patch replaces
+ *        an earlier one.
+ */
+static int laplacianRow(const int l2, const int nstr,
+                        const int j, const int i,
+                        const double len02i, const double wid02i,
+                        int *__restrict__ patches,
+                        double *__restrict__ weights)
+{
+    double wts[5];
+    int indx[5], k, n;
+    indx[0] = (j - 1)*nstr + i;     // Backward along dip (up dip)
+    indx[1] =       j*nstr + i - 1; // Backward along strike
+    indx[2] =       j*nstr + i;     // Grid index
+    indx[3] =       j*nstr + i + 1; // Forward along strike
+    indx[4] = (j + 1)*nstr + i;     // Forward along dip (down dip)
+    wts[0] = wid02i;
+    wts[1] = len02i;
+    wts[2] =-2.0*(len02i + wid02i);
+    wts[3] = len02i;
+    wts[4] = wid02i;
+    n = 0;
+    for (k=0; k<5; k++)
+    {
+        if (indx[k] < 0 || indx[k] >= l2){continue;}
+        if (n > 0 && patches[n-1] == indx[k])
+        {
+            weights[n-1] = wts[k];
+            continue;
+        }
+        patches[n] = indx[k];
+        weights[n] = wts[k];
+        n = n + 1;
+    }
+    return n;
+}
+//============================================================================//
+/*!
+ * @brief Computes the number of rows and non-zeros in the compressed
+ *        sparse row regularizer of core_ff_setRegularizerCSR.
+ *
+ * @param[in] nstr     number of faults along strike
+ * @param[in] ndip     number of faults down dip
+ *
+ * @param[out] mrowsT  number of rows in the regularizer
+ * @param[out] nnzT    number of non-zeros in the regularizer
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_getRegularizerSize(const int nstr, const int ndip,
+                               int *mrowsT, int *nnzT)
+{
+    double weights[5];
+    int i, j, l2, nbc, nnz, patches[5];
+    //------------------------------------------------------------------------//
+    *mrowsT = 0;
+    *nnzT = 0;
+    if (nstr < 1 || ndip < 1)
+    {
+        LOG_ERRMSG("Error invalid fault dimensions %d %d", nstr, ndip);
+        return -1;
+    }
+    l2 = nstr*ndip;
+    nnz = 0;
+    nbc = 0;
+    for (j=0; j<ndip; j++)
+    {
+        for (i=0; i<nstr; i++)
+        {
+            nnz = nnz + 2*laplacianRow(l2, nstr, j, i, 1.0, 1.0,
+                                       patches, weights);
+            if (j == ndip - 1 || i == 0 || i == nstr - 1){nbc = nbc + 2;}
+        }
+    }
+    *mrowsT = 2*l2 + 2*(2*ndip + nstr - 2);
+    if (nbc > *mrowsT - 2*l2)
+    {
+        LOG_ERRMSG("Error too many boundary conditions %d", nbc);
+        *mrowsT = 0;
+        return -1;
+    }
+    *nnzT = nnz + nbc;
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Computes the regularizer of core_ff_setRegularizer in compressed
+ *        sparse row format.  Each row of the second order difference
+ *        operator has at most five non-zeros and each boundary condition
+ *        row has one so, unlike the dense regularizer, the storage grows
+ *        linearly with the number of fault patches.
+ *
+ * @param[in] l2       total number of faults in plane (nstr*ndip)
+ * @param[in] nstr     number of faults along strike
+ * @param[in] ndip     number of faults down dip
+ * @param[in] mrowsT   number of rows in T.  this is computed by
+ *                     core_ff_getRegularizerSize.
+ * @param[in] nnzT     number of non-zeros in T.  this is computed by
+ *                     core_ff_getRegularizerSize.
+ * @param[in] width    width of fault patches (km) [l2]
+ * @param[in] length   length of fault patches (km) [l2]
+ *
+ * @param[out] rowPtr  the non-zeros of the i'th row of T begin at
+ *                     rowPtr[i] and end at rowPtr[i+1] - 1 [mrowsT+1]
+ * @param[out] colIdx  column indices of the non-zeros.  the column indices
+ *                     increase within each row [nnzT]
+ * @param[out] T       values of the non-zeros in the second order
+ *                     Tikhonov regularizer [nnzT]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_setRegularizerCSR(const int l2, const int nstr,
+                              const int ndip,
+                              const int mrowsT, const int nnzT,
+                              const double *__restrict__ width,
+                              const double *__restrict__ length,
+                              int *__restrict__ rowPtr,
+                              int *__restrict__ colIdx,
+                              double *__restrict__ T)
+{
+    double len02i, lnwidi, weights[5], wid02i;
+    int i, ierr, j, k, l, m, mrowsRef, n, nnz, nnzRef, p, patches[5];
+    //------------------------------------------------------------------------//
+    //
+    // Error handling
+    ierr = core_ff_getRegularizerSize(nstr, ndip, &mrowsRef, &nnzRef);
+    if (ierr != 0 || l2 != nstr*ndip || mrowsT != mrowsRef ||
+        nnzT != nnzRef)
+    {
+        LOG_ERRMSG("Error inconsistent sizes %d %d %d %d %d %d %d",
+                   l2, nstr, ndip, mrowsT, mrowsRef, nnzT, nnzRef);
+        return -1;
+    }
+    if (width == NULL || length == NULL || rowPtr == NULL ||
+        colIdx == NULL || T == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+    // Fill in the second order difference operator
+    nnz = 0;
+    for (j=0; j<ndip; j++)
+    {
+        for (i=0; i<nstr; i++)
+        {
+            l = j*nstr + i; // Fault patch number
+            wid02i = 1.0/(width[l]*width[l])*1.e6;   // 1/dy^2; km^2 -> m^2
+            len02i = 1.0/(length[l]*length[l])*1.e6; // 1/dx^2; km^2 -> m^2
+            n = laplacianRow(l2, nstr, j, i, len02i, wid02i,
+                             patches, weights);
+            for (m=0; m<2; m++)
+            {
+                k = j*nstr*2 + i*2 + m; // Row number
+                rowPtr[k] = nnz;
+                for (p=0; p<n; p++)
+                {
+                    colIdx[nnz] = 2*patches[p] + m;
+                    T[nnz] = weights[p];
+                    nnz = nnz + 1;
+                }
+            } // Loop on m
+        } // Loop on strike
+    } // Loop on dip
+    // Now apply boundary conditions s.t. the fault ends excluding
+    // the free surface are penalized if they slip
+    k = 2*l2;
+    for (j=0; j<ndip; j++)
+    {
+        for (i=0; i<nstr; i++)
+        {
+            if (j != ndip - 1 && i != 0 && i != nstr - 1){continue;}
+            l = j*nstr + i;
+            lnwidi = 1.0/(width[l]*length[l])*1.e6; // 1/dx/dy; km^2 -> m^2
+            for (m=0; m<2; m++)
+            {
+                rowPtr[k] = nnz;
+                colIdx[nnz] = 2*l + m;
+                T[nnz] = 100.0*lnwidi;
+                nnz = nnz + 1;
+                k = k + 1;
+            }
+        }
+    }
+    // Rows without boundary conditions are empty
+    for (; k<=mrowsT; k++)
+    {
+        rowPtr[k] = nnz;
+    }
+    if (nnz != nnzT)
+    {
+        LOG_ERRMSG("Error lost count %d %d", nnz, nnzT);
+        return -1;
+    }
+    return 0;
+}
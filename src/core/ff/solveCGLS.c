@@ -0,0 +1,325 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <string.h>
+#include <float.h>
+#include <math.h>
+#include "gfast_core.h"
+#ifdef GFAST_USE_INTEL
+ #ifdef __clang__
+  #pragma clang diagnostic push
+  #pragma clang diagnostic ignored "-Weverything"
+ #endif
+ #include <mkl_cblas.h>
+ #ifdef __clang__
+  #pragma clang diagnostic pop
+ #endif
+#else
+#include <cblas.h>
+#endif
+#include "iscl/memory/memory.h"
+
+static void applyA(const int mrowsG, const int ncols, const int mrowsT,
+                   const double lampred,
+                   const double *__restrict__ WG,
+                   const int *__restrict__ rowPtr,
+                   const int *__restrict__ colIdx,
+                   const double *__restrict__ T,
+                   const double *__restrict__ x,
+                   double *__restrict__ y);
+static void applyAT(const int mrowsG, const int ncols, const int mrowsT,
+                    const double lampred,
+                    const double *__restrict__ WG,
+                    const int *__restrict__ rowPtr,
+                    const int *__restrict__ colIdx,
+                    const double *__restrict__ T,
+                    const double *__restrict__ x,
+                    double *__restrict__ y);
+
+/*!
+ * @brief Solves the regularized finite fault inversion
+ *         \f[
+ *           \left [ \begin{array}{c} W G \\ \lambda T \end{array} \right ] s
+ *         = \left [ \begin{array}{c} W u \\ b_T \end{array} \right ]
+ *         \f]
+ *        with column scaled conjugate gradients on the least squares
+ *        problem (CGLS).  Each iteration costs two products with the
+ *        weighted forward model and two with the sparse regularizer so,
+ *        when started from the previous solution of a slowly changing
+ *        problem, only a few iterations are required.
+ *
+ * @note If bounds are given then the slips leaving the bounds are fixed
+ *       at the bound and the problem is solved again on the remaining
+ *       slips.  The result satisfies the bounds but a fixed slip is not
+ *       released so this is not the exact bound constrained minimizer.
+ *
+ * @param[in] mrowsG    number of rows in the weighted forward modeling
+ *                      matrix (3 times the number of sites)
+ * @param[in] ncols     number of unknowns (2*l2)
+ * @param[in] mrowsT    number of rows in the regularizer
+ * @param[in] lampred   regularization parameter \f$ \lambda \f$
+ * @param[in] WG        weighted forward modeling matrix in row major format
+ *                      with leading dimension ncols [mrowsG x ncols]
+ * @param[in] Wu        weighted observations [mrowsG]
+ * @param[in] WuT       if not NULL then this is the right hand side
+ *                      \f$ b_T \f$ of the regularizer rows.  otherwise,
+ *                      these are zero [mrowsT]
+ * @param[in] rowPtr    row pointers of the regularizer [mrowsT+1]
+ * @param[in] colIdx    column indices of the regularizer [rowPtr[mrowsT]]
+ * @param[in] T         non-zeros of the regularizer [rowPtr[mrowsT]]
+ * @param[in] maxit     max number of iterations
+ * @param[in] tol       the iteration stops when the norm of the scaled
+ *                      normal equations residual falls below tol times
+ *                      its norm at the zero solution
+ * @param[in] slipMin   lower bound on each slip.  use -DBL_MAX for no
+ *                      lower bound.
+ * @param[in] slipMax   upper bound on each slip.  use DBL_MAX for no
+ *                      upper bound.
+ *
+ * @param[in,out] S     on input the starting solution.
+ *                      on output the regularized least squares solution
+ *                      [ncols]
+ *
+ * @param[out] niter    if not NULL then this is the number of iterations
+ *
+ * @result 0 indicates success.
+ *         1 indicates the iteration limit was reached before
+ *         convergence.  S holds the last iterate.
+ *         -1 indicates an error.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_solveCGLS(const int mrowsG, const int ncols, const int mrowsT,
+                      const double lampred,
+                      const double *__restrict__ WG,
+                      const double *__restrict__ Wu,
+                      const double *__restrict__ WuT,
+                      const int *__restrict__ rowPtr,
+                      const int *__restrict__ colIdx,
+                      const double *__restrict__ T,
+                      const int maxit, const double tol,
+                      const double slipMin, const double slipMax,
+                      double *__restrict__ S, int *niter)
+{
+    double *D, *p, *q, *r, *s, *t, alpha, beta, delta, gamma, gammaNew,
+           lam2, stol;
+    bool *lfree, lbounds;
+    int i, ierr, it, j, mrows, nclip;
+    //------------------------------------------------------------------------//
+    if (niter != NULL){*niter = 0;}
+    if (mrowsG < 1 || ncols < 1 || mrowsT < 0 || maxit < 0 || tol < 0.0 ||
+        slipMin > slipMax)
+    {
+        LOG_ERRMSG("Error invalid inputs %d %d %d %d %e %e %e",
+                   mrowsG, ncols, mrowsT, maxit, tol, slipMin, slipMax);
+        return -1;
+    }
+    if (WG == NULL || Wu == NULL || rowPtr == NULL || colIdx == NULL ||
+        T == NULL || S == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+    ierr = 0;
+    it = 0;
+    mrows = mrowsG + mrowsT;
+    lbounds = (slipMin > -DBL_MAX || slipMax < DBL_MAX);
+    D = memory_calloc64f(ncols);
+    p = memory_calloc64f(ncols);
+    s = memory_calloc64f(ncols);
+    t = memory_calloc64f(ncols);
+    q = memory_calloc64f(mrows);
+    r = memory_calloc64f(mrows);
+    lfree = memory_calloc8l(ncols);
+    // Scale the columns to unit norm
+    lam2 = lampred*lampred;
+    for (i=0; i<mrowsG; i++)
+    {
+#ifdef _OPENMP
+        #pragma omp simd
+#endif
+        for (j=0; j<ncols; j++)
+        {
+            D[j] = D[j] + WG[i*ncols+j]*WG[i*ncols+j];
+        }
+    }
+    for (i=0; i<rowPtr[mrowsT]; i++)
+    {
+        D[colIdx[i]] = D[colIdx[i]] + lam2*T[i]*T[i];
+    }
+    for (j=0; j<ncols; j++)
+    {
+        lfree[j] = true;
+        if (D[j] > 0.0)
+        {
+            D[j] = 1.0/sqrt(D[j]);
+        }
+        else
+        {
+            D[j] = 0.0;
+            lfree[j] = false;
+        }
+    }
+    // The tolerance is relative to the scaled A^T b
+    memcpy(r, Wu, (size_t) mrowsG*sizeof(double));
+    if (WuT != NULL)
+    {
+        memcpy(&r[mrowsG], WuT, (size_t) mrowsT*sizeof(double));
+    }
+    else
+    {
+        memset(&r[mrowsG], 0, (size_t) mrowsT*sizeof(double));
+    }
+    applyAT(mrowsG, ncols, mrowsT, lampred, WG, rowPtr, colIdx, T, r, s);
+    gamma = 0.0;
+    for (j=0; j<ncols; j++)
+    {
+        gamma = gamma + D[j]*s[j]*D[j]*s[j];
+    }
+    stol = tol*sqrt(gamma);
+    if (gamma == 0.0)
+    {
+        memset(S, 0, (size_t) ncols*sizeof(double));
+        goto ERROR;
+    }
+    // Project the starting solution onto the bounds
+    for (j=0; j<ncols; j++)
+    {
+        S[j] = fmin(fmax(S[j], slipMin), slipMax);
+    }
+    while (true)
+    {
+        // Residual r = b - A x and scaled gradient s = D A^T r
+        applyA(mrowsG, ncols, mrowsT, lampred, WG,
+               rowPtr, colIdx, T, S, r);
+        for (i=0; i<mrowsG; i++)
+        {
+            r[i] = Wu[i] - r[i];
+        }
+        for (i=mrowsG; i<mrows; i++)
+        {
+            r[i] =-r[i];
+            if (WuT != NULL){r[i] = r[i] + WuT[i-mrowsG];}
+        }
+        applyAT(mrowsG, ncols, mrowsT, lampred, WG,
+                rowPtr, colIdx, T, r, s);
+        gamma = 0.0;
+        for (j=0; j<ncols; j++)
+        {
+            s[j] = lfree[j] ? D[j]*s[j] : 0.0;
+            gamma = gamma + s[j]*s[j];
+            p[j] = s[j];
+        }
+        // Conjugate gradient iterations
+        while (it < maxit && sqrt(gamma) > stol)
+        {
+            for (j=0; j<ncols; j++)
+            {
+                t[j] = D[j]*p[j];
+            }
+            applyA(mrowsG, ncols, mrowsT, lampred, WG,
+                   rowPtr, colIdx, T, t, q);
+            delta = cblas_ddot(mrows, q, 1, q, 1);
+            if (delta <= 0.0){break;}
+            alpha = gamma/delta;
+            cblas_daxpy(ncols, alpha, t, 1, S, 1);
+            cblas_daxpy(mrows, -alpha, q, 1, r, 1);
+            applyAT(mrowsG, ncols, mrowsT, lampred, WG,
+                    rowPtr, colIdx, T, r, s);
+            gammaNew = 0.0;
+            for (j=0; j<ncols; j++)
+            {
+                s[j] = lfree[j] ? D[j]*s[j] : 0.0;
+                gammaNew = gammaNew + s[j]*s[j];
+            }
+            beta = gammaNew/gamma;
+            gamma = gammaNew;
+            for (j=0; j<ncols; j++)
+            {
+                p[j] = s[j] + beta*p[j];
+            }
+            it = it + 1;
+        }
+        if (!lbounds){break;}
+        // Fix the slips that left the bounds and solve for the rest
+        nclip = 0;
+        for (j=0; j<ncols; j++)
+        {
+            if (!lfree[j]){continue;}
+            if (S[j] < slipMin || S[j] > slipMax)
+            {
+                S[j] = fmin(fmax(S[j], slipMin), slipMax);
+                lfree[j] = false;
+                nclip = nclip + 1;
+            }
+        }
+        if (nclip == 0){break;}
+    }
+    if (sqrt(gamma) > stol){ierr = 1;}
+ERROR:;
+    if (niter != NULL){*niter = it;}
+    memory_free64f(&D);
+    memory_free64f(&p);
+    memory_free64f(&s);
+    memory_free64f(&t);
+    memory_free64f(&q);
+    memory_free64f(&r);
+    memory_free8l(&lfree);
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Computes y = [WG; lampred*T] x.
+ */
+static void applyA(const int mrowsG, const int ncols, const int mrowsT,
+                   const double lampred,
+                   const double *__restrict__ WG,
+                   const int *__restrict__ rowPtr,
+                   const int *__restrict__ colIdx,
+                   const double *__restrict__ T,
+                   const double *__restrict__ x,
+                   double *__restrict__ y)
+{
+    double yi;
+    int i, ip;
+    cblas_dgemv(CblasRowMajor, CblasNoTrans, mrowsG, ncols,
+                1.0, WG, ncols, x, 1, 0.0, y, 1);
+    for (i=0; i<mrowsT; i++)
+    {
+        yi = 0.0;
+        for (ip=rowPtr[i]; ip<rowPtr[i+1]; ip++)
+        {
+            yi = yi + T[ip]*x[colIdx[ip]];
+        }
+        y[mrowsG+i] = lampred*yi;
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Computes y = [WG; lampred*T]^T x.
+ */
+static void applyAT(const int mrowsG, const int ncols, const int mrowsT,
+                    const double lampred,
+                    const double *__restrict__ WG,
+                    const int *__restrict__ rowPtr,
+                    const int *__restrict__ colIdx,
+                    const double *__restrict__ T,
+                    const double *__restrict__ x,
+                    double *__restrict__ y)
+{
+    double xi;
+    int i, ip;
+    cblas_dgemv(CblasRowMajor, CblasTrans, mrowsG, ncols,
+                1.0, WG, ncols, x, 1, 0.0, y, 1);
+    for (i=0; i<mrowsT; i++)
+    {
+        xi = lampred*x[mrowsG+i];
+        for (ip=rowPtr[i]; ip<rowPtr[i+1]; ip++)
+        {
+            y[colIdx[ip]] = y[colIdx[ip]] + T[ip]*xi;
+        }
+    }
+    return;
+}
@@ -0,0 +1,128 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_core.h"
+#ifdef GFAST_USE_INTEL
+ #ifdef __clang__
+  #pragma clang diagnostic push
+  #pragma clang diagnostic ignored "-Weverything"
+ #endif
+ #include <mkl_lapacke.h>
+ #include <mkl_cblas.h>
+ #ifdef __clang__
+  #pragma clang diagnostic pop
+ #endif
+#else
+#include <lapacke.h>
+#include <cblas.h>
+#endif
+
+/*!
+ * @brief Solves the regularized finite fault inversion
+ *         \f[
+ *           \left [ \begin{array}{c} W G \\ \lambda T \end{array} \right ] s
+ *         = \left [ \begin{array}{c} W u \\ 0 \end{array} \right ]
+ *         \f]
+ *        with the normal equations
+ *        \f$ (G^T W^T W G + \lambda^2 T^T T) s = G^T W^T W u \f$.
+ *        The regularizer is never expanded into a dense matrix.  Since
+ *        each row of T has at most five non-zeros the product
+ *        \f$ T^T T \f$ is accumulated directly from the compressed sparse
+ *        row storage at a cost proportional to the number of non-zeros.
+ *        The system is then solved with a Cholesky factorization.
+ *
+ * @param[in] mrowsG    number of rows in the weighted forward modeling
+ *                      matrix (3 times the number of sites)
+ * @param[in] ncols     number of unknowns (2*l2)
+ * @param[in] mrowsT    number of rows in the regularizer
+ * @param[in] lampred   regularization parameter \f$ \lambda \f$
+ * @param[in] WG        weighted forward modeling matrix in row major format
+ *                      with leading dimension ncols [mrowsG x ncols]
+ * @param[in] Wu        weighted observations [mrowsG]
+ * @param[in] rowPtr    row pointers of the regularizer [mrowsT+1]
+ * @param[in] colIdx    column indices of the regularizer.  these must
+ *                      increase within each row [rowPtr[mrowsT]]
+ * @param[in] T         non-zeros of the regularizer [rowPtr[mrowsT]]
+ *
+ * @param[out] U        upper triangular Cholesky factor of the normal
+ *                      equations matrix in row major format with leading
+ *                      dimension ncols.  the strictly lower triangle is
+ *                      zero.  since \f$ U^T U = R^T R \f$ this can be used
+ *                      in place of the right matrix of a QR factorization
+ *                      [ncols x ncols]
+ * @param[out] S        the regularized least squares solution [ncols]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_ff_solveNormalEquations(const int mrowsG, const int ncols,
+                                 const int mrowsT, const double lampred,
+                                 const double *__restrict__ WG,
+                                 const double *__restrict__ Wu,
+                                 const int *__restrict__ rowPtr,
+                                 const int *__restrict__ colIdx,
+                                 const double *__restrict__ T,
+                                 double *__restrict__ U,
+                                 double *__restrict__ S)
+{
+    double lam2, tp;
+    int i, ierr, ip, iq, j, ip0, ip1;
+    //------------------------------------------------------------------------//
+    if (mrowsG < 1 || ncols < 1 || mrowsT < 0)
+    {
+        LOG_ERRMSG("Error invalid sizes %d %d %d", mrowsG, ncols, mrowsT);
+        return -1;
+    }
+    if (WG == NULL || Wu == NULL || rowPtr == NULL || colIdx == NULL ||
+        T == NULL || U == NULL || S == NULL)
+    {
+        LOG_ERRMSG("%s", "Error null input arrays");
+        return -1;
+    }
+    // Upper triangle of G^T W^T W G
+    cblas_dsyrk(CblasRowMajor, CblasUpper, CblasTrans,
+                ncols, mrowsG, 1.0, WG, ncols, 0.0, U, ncols);
+    // Add lambda^2 T^T T.  The columns increase in each row so the
+    // outer product of a row only touches the upper triangle.
+    lam2 = lampred*lampred;
+    for (i=0; i<mrowsT; i++)
+    {
+        ip0 = rowPtr[i];
+        ip1 = rowPtr[i+1];
+        for (ip=ip0; ip<ip1; ip++)
+        {
+            tp = lam2*T[ip];
+            j = colIdx[ip]*ncols;
+            for (iq=ip; iq<ip1; iq++)
+            {
+                U[j+colIdx[iq]] = U[j+colIdx[iq]] + tp*T[iq];
+            }
+        }
+    }
+    // RHS G^T W^T W u
+    cblas_dgemv(CblasRowMajor, CblasTrans, mrowsG, ncols,
+                1.0, WG, ncols, Wu, 1, 0.0, S, 1);
+    // The row major upper triangle is the column major lower triangle so
+    // factoring A = L L^T in column major order yields U = L^T in place
+    ierr = LAPACKE_dpotrf(LAPACK_COL_MAJOR, 'L', ncols, U, ncols);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("Error factoring normal equations %d", ierr);
+        return -1;
+    }
+    ierr = LAPACKE_dpotrs(LAPACK_COL_MAJOR, 'L', ncols, 1,
+                          U, ncols, S, ncols);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("Error solving normal equations %d", ierr);
+        return -1;
+    }
+    // Null out the strictly lower triangle
+    for (i=1; i<ncols; i++)
+    {
+        memset(&U[i*ncols], 0, (size_t) i*sizeof(double));
+    }
+    return 0;
+}
@@ -271,6 +271,9 @@ int core_properties_initialize(const char *propfilename,
     // Only write summary HDF5 files?
     props->lh5SummaryOnly = iniparser_getboolean(ini, "general:H5SummaryOnly\0",
                                                  false);
+    // Save the trace buffer to HDF5?
+    props->lh5TraceBuffer = iniparser_getboolean(ini, "general:H5TraceBuffer\0",
+                                                 false);
     // ANSS informaiton
     s = iniparser_getstring(ini, "general:anssNetwork\0", "UW\0");
     strcpy(props->anssNetwork, s);
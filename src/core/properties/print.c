@@ -129,6 +129,14 @@ void core_properties_print(struct GFAST_props_struct props)
     {
         LOG_DEBUGMSG("%s GFAST will save all steps to HDF5", lspace);
     }
+    if (props.lh5TraceBuffer)
+    {
+        LOG_DEBUGMSG("%s GFAST will save the trace buffer to HDF5", lspace);
+    }
+    else
+    {
+        LOG_DEBUGMSG("%s GFAST will keep the trace buffer in memory", lspace);
+    }
     //--------------------------------pgd-------------------------------------//
     LOG_DEBUGMSG("%s GFAST PGD source receiver distance tolerance %f (km)",
                lspace, props.pgd_props.dist_tol);
@@ -144,6 +152,11 @@ void core_properties_print(struct GFAST_props_struct props)
                lspace, props.pgd_props.window_vel);
     LOG_DEBUGMSG("%s GFAST Number of sites required to compute PGD is %d",
                lspace, props.pgd_props.min_sites);
+    if (props.pgd_props.iqr_sketch_min > 0)
+    {
+        LOG_DEBUGMSG("%s GFAST PGD IQR is sketched with at least %d sites",
+                   lspace, props.pgd_props.iqr_sketch_min);
+    }
     if (props.pgd_props.ngridSearch_lats > 1)
     {
         LOG_DEBUGMSG("%s GFAST PGD latitude grid spacing %f",
@@ -176,6 +189,13 @@ void core_properties_print(struct GFAST_props_struct props)
     {
         LOG_DEBUGMSG("%s GFAST will invert for all 6 MT terms", lspace);
     }
+    if (props.cmt_props.ladaptive)
+    {
+        LOG_DEBUGMSG("%s GFAST CMT adaptive search refinements %d",
+                   lspace, props.cmt_props.adaptive_nrefine);
+        LOG_DEBUGMSG("%s GFAST CMT adaptive search max evaluations %d",
+                   lspace, props.cmt_props.adaptive_maxEvals);
+    }
     if (props.cmt_props.ngridSearch_lats > 1)
     {   
         LOG_DEBUGMSG("%s GFAST CMT latitude grid spacing %f",
@@ -201,6 +221,25 @@ void core_properties_print(struct GFAST_props_struct props)
                 lspace, props.ff_props.flen_pct);
     LOG_DEBUGMSG("%s GFAST fault width safety factor %.2f pct",
                 lspace, props.ff_props.fwid_pct); 
+    if (props.ff_props.solver == FF_CGLS_SOLVER)
+    {
+        LOG_DEBUGMSG("%s GFAST will solve for slip with CGLS", lspace);
+        LOG_DEBUGMSG("%s GFAST CGLS tolerance %e and max iterations %d",
+                    lspace, props.ff_props.cgls_tol,
+                    props.ff_props.cgls_maxit);
+        LOG_DEBUGMSG("%s GFAST slip bounds [%e, %e] (m)",
+                    lspace, props.ff_props.min_slip,
+                    props.ff_props.max_slip);
+    }
+    else
+    {
+        LOG_DEBUGMSG("%s GFAST will solve for slip directly", lspace);
+    }
+    if (props.ff_props.unc_nprobe > 0)
+    {
+        LOG_DEBUGMSG("%s GFAST will estimate slip uncertainties with %d probes",
+                    lspace, props.ff_props.unc_nprobe);
+    }
     LOG_DEBUGMSG("%s", "\n");
     return;
 }
@@ -2,24 +2,6 @@
 #include <stdlib.h>
 #include <math.h>
 #include "gfast_core.h"
-#ifdef GFAST_USE_INTEL
- #ifdef __clang__
-  #pragma clang diagnostic push
-  #pragma clang diagnostic ignored "-Weverything"
- #endif
- #include <mkl_lapacke.h>
- #include <mkl_cblas.h>
- #ifdef __clang__
-  #pragma clang diagnostic pop
- #endif
-#else
-#include <lapacke.h>
-#include <cblas.h>
-#endif
-#include "iscl/linalg/linalg.h"
-#include "iscl/memory/memory.h"
-#include "iscl/statistics/statistics.h"
-#include "iscl/time/time.h"
 
 /*!
  * @brief Computes the predicted magnitude using PGD and Pd from
@@ -36,6 +18,9 @@
  *                     e^{-\frac{\Delta^2}{8 \min(\Delta^2) }}
  *                  \right ] \f]
  *        where \f$ \Delta \f$ is the epicentral distance.
+ *        Since there is one unknown the least squares problem at each depth
+ *        is solved in closed form with core_scaling_pgd_evaluateDepth.
+ *        This is the single epicenter case of core_scaling_pgd_gridSearch.
  *
  * @param[in] l1               number of sites
  * @param[in] ndeps            number of source depths
@@ -90,241 +75,30 @@ int core_scaling_pgd_depthGridSearch(const int l1, const int ndeps,
                                      double *__restrict__ iqr,
                                      double *__restrict__ Uest)
 {
-    double *b, *G, *r, *repi, *UP, *W, *Wb, *WG, *wres, pct[2], M1[1],
-           est, srcDepth, xden, xnum;
-    int i, idep, ierr, ierr1;
-    const double A =-6.687;
-    const double B = 1.500;
-    const double C =-0.214;
-    const double q[2] = {25.0, 75.0}; 
-    const int nq = 2;
-    //const double A = -4.434; /* TODO remove with approval */
-    //const double B = 1.047;  /* TODO remove with approval */
-    //const double C = -0.138; /* TODO remove with approval */
+    int ierr;
     //------------------------------------------------------------------------//
-    //
-    // Initialize
-    ierr = 0;
-    repi = NULL;
-    r = NULL;
-    wres = NULL;
-    b = NULL;
-    G = NULL;
-    UP = NULL;
-    W  = NULL;
-    Wb = NULL;
-    WG = NULL;
-    // Error check
-    if (l1 < 1)
-    {
-        LOG_ERRMSG("Error invalid number of input stations: %d", l1);
-        ierr = 1;
-        goto ERROR;
-    }
-    if (ndeps < 1)
-    {
-        LOG_ERRMSG("Error invalid number of source depths: %d", ndeps);
-        ierr = 1;
-        goto ERROR;
-    }
-    if (srcDepths == NULL || utmRecvEasting == NULL || 
-        utmRecvNorthing == NULL || staAlt == NULL || 
-        d == NULL || M == NULL || VR == NULL || Uest == NULL || srdist == NULL)
-    {
-        if (srcDepths == NULL){LOG_ERRMSG("%s", "srcDepths is NULL!");}
-        if (utmRecvEasting == NULL)
-        {
-            LOG_ERRMSG("%s", "utmRecvEasting is NULL!");
-        }
-        if (utmRecvNorthing == NULL)
-        {
-            LOG_ERRMSG("%s", "utmRecvNorthing is NULL!");
-        }
-        if (staAlt == NULL){LOG_ERRMSG("%s", "staAlt is NULL");}
-        if (d == NULL){LOG_ERRMSG("%s", "d is NULL");}
-        if (M == NULL){LOG_ERRMSG("%s", "M is NULL");}
-        if (VR == NULL){LOG_ERRMSG("%s", "VR is NULL");}
-        if (Uest == NULL){LOG_ERRMSG("%s", "Uest is NULL");}
-        if (srdist == NULL){LOG_ERRMSG("%s", "srdist is NULL");}
-        ierr = 1;
-        goto ERROR;
-    }
-    // Initialize result to nothing
-#ifdef _OPENMP
-    #pragma omp simd
-#endif
-    for (idep=0; idep<ndeps; idep++)
-    {
-        M[idep] = 0.0;
-        VR[idep] = 0.0;
-    }
-#ifdef _OPENMP
-    #pragma omp simd
-#endif
-    for (i=0; i<l1*ndeps; i++)
-    {
-        Uest[i] = 0.0;
-    }
-    // Set space
-    b    = memory_calloc64f(l1);
-    W    = memory_calloc64f(l1);
-    Wb   = memory_calloc64f(l1);
-    repi = memory_calloc64f(l1);
-    // Compute the epicentral distances (km)
-    for (i=0; i<l1; i++)
-    {
-        repi[i] = sqrt( pow(utmSrcEasting  - utmRecvEasting[i], 2)
-                      + pow(utmSrcNorthing - utmRecvNorthing[i], 2) );
-        repi[i] = repi[i]*1.e-3; // m -> km
-    }
-    // Set the RHS log10(d) - A
-    ierr = core_scaling_pgd_setRHS(l1,
-                                   dist_tol, disp_def,
-                                   A, d,
-                                   b);
+    ierr = core_scaling_pgd_gridSearch(l1, ndeps, 1, 1,
+                                       verbose,
+                                       dist_tol,
+                                       disp_def,
+                                       0,
+                                       &utmSrcEasting,
+                                       &utmSrcNorthing,
+                                       srcDepths,
+                                       utmRecvEasting,
+                                       utmRecvNorthing,
+                                       staAlt,
+                                       d,
+                                       wts,
+                                       srdist,
+                                       M,
+                                       VR,
+                                       iqr,
+                                       Uest);
     if (ierr != 0)
     {
-        LOG_ERRMSG("%s", "Error creating RHS");
-        goto ERROR;
-    }
-    // Compute the diagonal data weights
-    ierr = core_scaling_pgd_setDiagonalWeightMatrix(l1,
-                                                    repi,
-                                                    wts,
-                                                    W);
-    if (ierr != 0)
-    {
-        LOG_ERRMSG("%s", "Error setting diagonal weight matrix");
-        goto ERROR;
-    }
-    // Weight the observations
-    ierr = core_scaling_pgd_weightObservations(l1,
-                                               W,
-                                               b,
-                                               Wb);
-    if (ierr < 0)
-    {
-        LOG_ERRMSG("%s", "Error weighting observations");
-        goto ERROR;
-    }
-    // Grid search on source depths
-    ISCL_time_tic();
-    if (verbose > 2)
-    {   
-        LOG_DEBUGMSG("%s", "Beginning search on depths...");
-    }
-#ifdef PARALLEL_PGD
-    #pragma omp parallel \
-     firstprivate(A, B, C) \
-     private(i, idep, ierr1, est, G, M1, pct, r, srcDepth, UP, WG) \
-     private(wres, xden, xnum) \
-     shared(b, d, iqr, M, q, repi, srdist, \
-            srcDepths, staAlt, utmRecvEasting, utmRecvNorthing, \
-            Uest, verbose, VR, W, Wb) \
-     reduction(+:ierr) default(none)
-    {
-#endif
-    G    = memory_calloc64f(l1*1);
-    r    = memory_calloc64f(l1);
-    UP   = memory_calloc64f(l1);
-    WG   = memory_calloc64f(l1*1);
-    wres = memory_calloc64f(l1);
-#ifdef PARALLEL_PGD
-    #pragma omp for 
-#endif
-    for (idep=0; idep<ndeps; idep++)
-    {
-        // Compute radial distance
-        srcDepth = srcDepths[idep];
-        for (i=0; i<l1; i++)
-        {
-            r[i] = sqrt( pow(utmSrcEasting  - utmRecvEasting[i], 2)
-                       + pow(utmSrcNorthing - utmRecvNorthing[i], 2)
-                       + pow(srcDepth*1000.0 - staAlt[i], 2) )*1.e-3;
-            srdist[idep*l1+i] = r[i];
-        }
-        // Generate the over-determined system: [B + C*log10(r)]*m = RHS 
-        ierr1 = core_scaling_pgd_setForwardModel(l1,
-                                                 B, C, r,
-                                                 G);
-        if (ierr1 != 0)
-        {
-            LOG_ERRMSG("%s", "Error creating G matrix");
-            ierr = ierr + 1;
-            continue;
-        }
-        // Weight the forward modeling matrix
-        ierr1 = core_scaling_pgd_weightForwardModel(l1, 
-                                                    W,
-                                                    G,
-                                                    WG);
-        if (ierr1 < 0)
-        {
-            LOG_ERRMSG("%s", "Error weighting forward modeling matrix");
-            ierr = ierr + 1;
-        }
-        // Solve the weighted least squares problem (M = lstsq(W*G,W*b)[0])
-        ierr1 = linalg_lstsq_qr64f_work(LAPACK_COL_MAJOR,
-                                        l1, 1, 1, false, WG, Wb,
-                                        M1, NULL);
-        if (ierr1 != 0)
-        {
-            LOG_ERRMSG("%s", "Error solving the least-squares problem");
-            ierr = ierr + 1;
-            continue;
-        }
-        // Compute the estimates: UP = G*M
-        cblas_dgemv(CblasColMajor, CblasNoTrans,
-                    l1, 1, 1.0, G, l1, M1, 1, 0.0, UP, 1);
-        // Compute the variance reduction
-        xnum = 0.0;
-        xden = 0.0;
-        for (i=0; i<l1; i++)
-        {
-            est = pow(10.0, UP[i] + A);
-            Uest[idep*l1+i] = est;
-            wres[i] = W[i]*(d[i] - est);
-            xnum = xnum + sqrt(wres[i]*wres[i]);
-            xden = xden + sqrt(pow(W[i]*d[i], 2));
-        }
-        // Compute the interquartile range which will later be used as a penalty
-        ierr1 = statistics_percentile64f_work(l1, wres, nq, q,
-                                              STATS_PERCENTILE_LINEAR, pct);
-        iqr[idep] = pct[1] - pct[0];
-        if (ierr1 != 0)
-        {   
-            LOG_ERRMSG("%s", "Error computing interquartile range");
-            iqr[idep] = 1.0;
-        }
-        // Copy results
-        M[idep] = M1[0];
-        VR[idep] = (1.0 - xnum/xden)*100.0;
-    } // Loop on depths
-    memory_free64f(&G);
-    memory_free64f(&r);
-    memory_free64f(&UP);
-    memory_free64f(&WG);
-    memory_free64f(&wres);
-#ifdef PARALLEL_PGD
-    }
-#endif
-    if (ierr != 0)
-    {
-        LOG_ERRMSG("%s", "Errors detected during grid search");
-        ierr = 1;
-    }
-    else
-    {   
-        if (verbose > 2)
-        {
-            LOG_DEBUGMSG("Grid-search time: %f (s)", time_toc());
-        }
+        LOG_ERRMSG("%s", "Error in depth grid search");
+        return 1;
     }
-ERROR:; // An error was encountered
-    // Free space
-    memory_free64f(&repi);
-    memory_free64f(&b);
-    memory_free64f(&W);
-    memory_free64f(&Wb);
-    return ierr;
+    return 0;
 }
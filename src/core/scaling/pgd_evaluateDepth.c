@@ -0,0 +1,119 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "gfast_core.h"
+
+/*!
+ * @brief Solves the weighted one-parameter PGD scaling problem
+ *         \f[
+ *            W \left [B + C \log_{10}(r) \right ] m
+ *          = W \left \{ \log_{10}(d) - A \right \}
+ *         \f]
+ *        at a single source depth.  Since the forward model is a single
+ *        column the least squares solution is the closed form
+ *         \f[
+ *            m = \frac{ (W G) \cdot (W b) }{ (W G) \cdot (W G) }
+ *         \f]
+ *        which is accumulated in the same pass that computes the
+ *        source-receiver distances and forward model.  A second pass
+ *        computes the estimates, weighted residuals, and variance
+ *        reduction.
+ *
+ * @param[in] l1               number of sites
+ * @param[in] A                PGD scaling intercept
+ * @param[in] B                PGD scaling magnitude coefficient
+ * @param[in] C                PGD scaling distance coefficient
+ * @param[in] srcDepth         source depth (km)
+ * @param[in] utmSrcEasting    source UTM easting position (m)
+ * @param[in] utmSrcNorthing   source UTM northing position (m)
+ * @param[in] utmRecvEasting   receiver UTM easting position (m) [l1]
+ * @param[in] utmRecvNorthing  receiver UTM northing position (m) [l1]
+ * @param[in] staAlt           station elevation (m) [l1]
+ * @param[in] d                site peak ground displacements (cm) [l1]
+ * @param[in] W                diagonal data weights [l1]
+ * @param[in] Wb               weighted right hand side W*(log10(d) - A) [l1]
+ * @param[in] xden             variance reduction denominator
+ *                             \f$ \sum_i |W_i d_i| \f$
+ *
+ * @param[out] G               workspace holding the forward model [l1]
+ * @param[out] srdist          source receiver distances (km) [l1]
+ * @param[out] Uest            estimated peak ground displacements (cm) [l1]
+ * @param[out] wres            weighted residuals W*(d - Uest) [l1]
+ * @param[out] M               magnitude
+ * @param[out] VR              variance reduction (percentage)
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_scaling_pgd_evaluateDepth(const int l1,
+                                   const double A,
+                                   const double B,
+                                   const double C,
+                                   const double srcDepth,
+                                   const double utmSrcEasting,
+                                   const double utmSrcNorthing,
+                                   const double *__restrict__ utmRecvEasting,
+                                   const double *__restrict__ utmRecvNorthing,
+                                   const double *__restrict__ staAlt,
+                                   const double *__restrict__ d,
+                                   const double *__restrict__ W,
+                                   const double *__restrict__ Wb,
+                                   const double xden,
+                                   double *__restrict__ G,
+                                   double *__restrict__ srdist,
+                                   double *__restrict__ Uest,
+                                   double *__restrict__ wres,
+                                   double *M, double *VR)
+{
+    double den, dx, dy, dz, est, m, num, wg, xnum;
+    int i;
+    const double srcDepthM = srcDepth*1000.0;
+    //------------------------------------------------------------------------//
+    *M = 0.0;
+    *VR = 0.0;
+    if (l1 < 1)
+    {
+        LOG_ERRMSG("Error invalid number of stations: %d", l1);
+        return -1;
+    }
+    // Distances, forward model, and normal equations
+    num = 0.0;
+    den = 0.0;
+#ifdef _OPENMP
+    #pragma omp simd private(dx, dy, dz, wg) reduction(+:num, den)
+#endif
+    for (i=0; i<l1; i++)
+    {
+        dx = utmSrcEasting  - utmRecvEasting[i];
+        dy = utmSrcNorthing - utmRecvNorthing[i];
+        dz = srcDepthM - staAlt[i];
+        srdist[i] = sqrt(dx*dx + dy*dy + dz*dz)*1.e-3;
+        G[i] = B + C*log10(srdist[i]);
+        wg = W[i]*G[i];
+        num = num + wg*Wb[i];
+        den = den + wg*wg;
+    }
+    if (!(den > 0.0))
+    {
+        LOG_ERRMSG("%s", "Error weighted forward model is null");
+        return -1;
+    }
+    m = num/den;
+    // Estimates and weighted residuals
+    xnum = 0.0;
+#ifdef _OPENMP
+    #pragma omp simd private(est) reduction(+:xnum)
+#endif
+    for (i=0; i<l1; i++)
+    {
+        est = pow(10.0, G[i]*m + A);
+        Uest[i] = est;
+        wres[i] = W[i]*(d[i] - est);
+        xnum = xnum + fabs(wres[i]);
+    }
+    *M = m;
+    *VR = (1.0 - xnum/xden)*100.0;
+    return 0;
+}
@@ -54,6 +54,8 @@ void core_scaling_pgd_finalizeResults(
     memory_free64f(&pgd->UP);
     memory_free64f(&pgd->UPinp);
     memory_free64f(&pgd->srcDepths);
+    memory_free64f(&pgd->srcLats);
+    memory_free64f(&pgd->srcLons);
     memory_free64f(&pgd->srdist);
     memory_free8l(&pgd->lsiteUsed);
     memset(pgd, 0, sizeof(struct GFAST_pgdResults_struct));
@@ -2,10 +2,16 @@
 #include <stdlib.h>
 #include <math.h>
 #include "gfast_core.h"
+#include "iscl/memory/memory.h"
 #include "iscl/time/time.h"
 
 /*!
  * @brief PGD scaling full grid search (lat, lon, depth) driver.
+ *        The right hand side is computed once and the data weights once
+ *        per epicenter.  Every (lon, lat, depth) node is then evaluated
+ *        in a single flattened loop over the shared station arrays so
+ *        that the work is evenly distributed over the threads regardless
+ *        of the grid's shape.
  *
  * @param[in] l1               Number of sites.
  * @param[in] ndeps            Number of source depths.
@@ -15,6 +21,10 @@
  * @param[in] dist_tol         Displacement tolerance (cm).  If the displacment
  *                             is less than dist_tol it will be set to dist_tol.
  * @param[in] disp_def         Displacement default (cm) if d < dist_tol.
+ * @param[in] iqr_sketch_min   If positive then the interquartile range of
+ *                             at least this many residuals is approximated
+ *                             with a streaming sketch.  Otherwise it is
+ *                             computed exactly.
  * @param[in] utmSrcNorthings  Source UTM northing positions (m).  This is an 
  *                             array of dimension [nlat*nlon] with leading
  *                             dimension nlats.
@@ -53,8 +63,9 @@
  * @param[out] iqr             The interquartile range computed from the
  *                             difference of the 75th percentile of the 
  *                             weighted residuals and the 25th percentile
- *                             of the weighted residuals at each depth [ndeps].
- *                             The (ilat,ilon,idepth)idep'th is given by 
+ *                             of the weighted residuals at each node
+ *                             [ndeps*nlat*nlon].
+ *                             The (ilat,ilon,idep)'th is given by 
  *                             ilon*nlats*ndeps + ilat*ndeps + idep.
  * @param[out] Uest            The PGD estimate peak ground displacements.  This
  *                             is an array of dimension [nlons*nlats*ndeps*l1].
@@ -71,6 +82,7 @@ int core_scaling_pgd_gridSearch(const int l1, const int ndeps,
                                 const int verbose,
                                 const double dist_tol,
                                 const double disp_def,
+                                const int iqr_sketch_min,
                                 const double *__restrict__ utmSrcEastings,
                                 const double *__restrict__ utmSrcNorthings,
                                 const double *__restrict__ srcDepths,
@@ -85,7 +97,19 @@ int core_scaling_pgd_gridSearch(const int l1, const int ndeps,
                                 double *__restrict__ iqr,
                                 double *__restrict__ Uest)
 {
-    int ierr, ierr1, ilat, ilatLon, ilon;
+    double *b, *G, *W, *Wb, *wres, *work, *xden;
+    int i, idep, ierr, ierr1, ilatLon, iloc, nlatLon, nloc;
+    const double A =-6.687;
+    const double B = 1.500;
+    const double C =-0.214;
+    //------------------------------------------------------------------------//
+    //
+    // Initialize
+    ierr = 0;
+    b = NULL;
+    W = NULL;
+    Wb = NULL;
+    xden = NULL;
     // Error check
     if (l1 < 1 || ndeps < 1 || nlats < 1 || nlons < 1)
     {
@@ -109,8 +133,9 @@ int core_scaling_pgd_gridSearch(const int l1, const int ndeps,
     }
     if (utmSrcEastings == NULL || utmSrcNorthings == NULL ||
         srcDepths == NULL || utmRecvEasting == NULL ||
-        utmRecvNorthing == NULL || staAlt == NULL ||
-        d == NULL || M == NULL || VR == NULL || Uest == NULL || srdist == NULL)
+        utmRecvNorthing == NULL || staAlt == NULL || d == NULL ||
+        M == NULL || VR == NULL || iqr == NULL || Uest == NULL ||
+        srdist == NULL)
     {
         if (utmSrcEastings == NULL)
         {
@@ -133,53 +158,164 @@ int core_scaling_pgd_gridSearch(const int l1, const int ndeps,
         if (d == NULL){LOG_ERRMSG("%s", "d is NULL");}
         if (M == NULL){LOG_ERRMSG("%s", "M is NULL");}
         if (VR == NULL){LOG_ERRMSG("%s", "VR is NULL");}
+        if (iqr == NULL){LOG_ERRMSG("%s", "iqr is NULL");}
         if (Uest == NULL){LOG_ERRMSG("%s", "Uest is NULL");}
         if (srdist == NULL){LOG_ERRMSG("%s", "srdist is NULL");}
         return -1;
     }
-    // Loop on the longitudes (eastings)
-    ierr = 0;
+    nlatLon = nlats*nlons;
+    nloc = nlatLon*ndeps;
+    // Initialize result to nothing
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (iloc=0; iloc<nloc; iloc++)
+    {
+        M[iloc] = 0.0;
+        VR[iloc] = 0.0;
+        iqr[iloc] = 0.0;
+    }
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (i=0; i<l1*nloc; i++)
+    {
+        Uest[i] = 0.0;
+    }
+    // Set space
+    b    = memory_calloc64f(l1);
+    W    = memory_calloc64f(l1*nlatLon);
+    Wb   = memory_calloc64f(l1*nlatLon);
+    xden = memory_calloc64f(nlatLon);
+    // Set the RHS log10(d) - A which is independent of the source
+    ierr = core_scaling_pgd_setRHS(l1,
+                                   dist_tol, disp_def,
+                                   A, d,
+                                   b);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error creating RHS");
+        goto ERROR;
+    }
+    // The data weights and variance reduction denominator only depend on
+    // the epicenter
+    for (ilatLon=0; ilatLon<nlatLon; ilatLon++)
+    {
+        // Use Wb to hold the epicentral distances (km) until it is set
+        for (i=0; i<l1; i++)
+        {
+            Wb[ilatLon*l1+i]
+               = sqrt( pow(utmSrcEastings[ilatLon]  - utmRecvEasting[i], 2)
+                     + pow(utmSrcNorthings[ilatLon] - utmRecvNorthing[i], 2) );
+            Wb[ilatLon*l1+i] = Wb[ilatLon*l1+i]*1.e-3; // m -> km
+        }
+        // Compute the diagonal data weights
+        ierr = core_scaling_pgd_setDiagonalWeightMatrix(l1,
+                                                        &Wb[ilatLon*l1],
+                                                        wts,
+                                                        &W[ilatLon*l1]);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error setting diagonal weight matrix");
+            goto ERROR;
+        }
+        // Weight the observations
+        ierr = core_scaling_pgd_weightObservations(l1,
+                                                   &W[ilatLon*l1],
+                                                   b,
+                                                   &Wb[ilatLon*l1]);
+        if (ierr < 0)
+        {
+            LOG_ERRMSG("%s", "Error weighting observations");
+            goto ERROR;
+        }
+        ierr = 0;
+        xden[ilatLon] = 0.0;
+        for (i=0; i<l1; i++)
+        {
+            xden[ilatLon] = xden[ilatLon] + fabs(W[ilatLon*l1+i]*d[i]);
+        }
+    }
+    // Grid search on all source locations
+    ISCL_time_tic();
+    if (verbose > 2)
+    {
+        LOG_DEBUGMSG("Beginning search on %d locations...", nloc);
+    }
 #ifdef PARALLEL_PGD
-    #pragma omp parallel for collapse(2) \
-     private(ilatLon, ilat, ilon) \
-     reduction(+:ierr), shared(srdist, M, VR, iqr, Uest) \
-     default(none)
+    #pragma omp parallel \
+     firstprivate(A, B, C, l1, ndeps) \
+     private(idep, ierr1, ilatLon, iloc, G, work, wres) \
+     shared(d, iqr, M, nloc, srdist, srcDepths, staAlt, \
+            utmRecvEasting, utmRecvNorthing, utmSrcEastings, \
+            utmSrcNorthings, Uest, VR, W, Wb, xden) \
+     reduction(+:ierr) default(none)
+    {
 #endif
-    for (ilon=0; ilon<nlons; ilon++)
+    G    = memory_calloc64f(l1);
+    wres = memory_calloc64f(l1);
+    work = memory_calloc64f(l1);
+#ifdef PARALLEL_PGD
+    #pragma omp for
+#endif
+    for (iloc=0; iloc<nloc; iloc++)
     {
-        // Scan through the latitudes (northings)
-        for (ilat=0; ilat<nlats; ilat++)
+        // iloc = ilon*nlats*ndeps + ilat*ndeps + idep
+        ilatLon = iloc/ndeps;
+        idep = iloc - ilatLon*ndeps;
+        // Solve [B + C*log10(r)]*m = RHS in the weighted least squares sense
+        ierr1 = core_scaling_pgd_evaluateDepth(l1, A, B, C,
+                                               srcDepths[idep],
+                                               utmSrcEastings[ilatLon],
+                                               utmSrcNorthings[ilatLon],
+                                               utmRecvEasting,
+                                               utmRecvNorthing,
+                                               staAlt, d,
+                                               &W[ilatLon*l1],
+                                               &Wb[ilatLon*l1],
+                                               xden[ilatLon],
+                                               G,
+                                               &srdist[iloc*l1],
+                                               &Uest[iloc*l1],
+                                               wres,
+                                               &M[iloc], &VR[iloc]);
+        if (ierr1 != 0)
         {
-            ilatLon = ilon*nlats + ilat;
-            ierr1 = core_scaling_pgd_depthGridSearch(l1, ndeps,
-                                                     verbose,
-                                                     dist_tol,
-                                                     disp_def,
-                                                     utmSrcEastings[ilatLon],
-                                                     utmSrcNorthings[ilatLon],
-                                                     srcDepths,
-                                                     utmRecvEasting,
-                                                     utmRecvNorthing,
-                                                     staAlt,
-                                                     d,
-                                                     wts,
-                                                     &srdist[ilatLon*ndeps*l1],
-                                                     &M[ilatLon*ndeps],
-                                                     &VR[ilatLon*ndeps],
-                                                     &iqr[ilatLon*ndeps],
-                                                     &Uest[ilatLon*ndeps*l1]);
-            if (ierr1 != 0)
-            {
-                LOG_ERRMSG("Error calling depthGridSearch %d %d", ilat, ilon);
-                ierr = ierr + 1;
-            }
-        } // loop on latitudes 
-    } // loop on longitudes
-    // Check if i encountered an error
+            LOG_ERRMSG("%s", "Error solving the least-squares problem");
+            ierr = ierr + 1;
+            continue;
+        }
+        // Compute the interquartile range which will later be used as a penalty
+        ierr1 = core_scaling_pgd_interquartileRange(l1, iqr_sketch_min,
+                                                    wres, work, &iqr[iloc]);
+        if (ierr1 != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing interquartile range");
+            iqr[iloc] = 1.0;
+        }
+    } // Loop on locations
+    memory_free64f(&G);
+    memory_free64f(&wres);
+    memory_free64f(&work);
+#ifdef PARALLEL_PGD
+    }
+#endif
     if (ierr != 0)
     {
         LOG_ERRMSG("%s", "Error in gridsearch");
-        return -2;
+        ierr =-2;
+    }
+    else
+    {
+        if (verbose > 2)
+        {
+            LOG_DEBUGMSG("Grid-search time: %f (s)", time_toc());
+        }
     }
-    return 0;
+ERROR:; // An error was encountered
+    memory_free64f(&b);
+    memory_free64f(&W);
+    memory_free64f(&Wb);
+    memory_free64f(&xden);
+    return ierr;
 }
@@ -39,7 +39,7 @@ int core_scaling_pgd_initialize(struct GFAST_pgd_props_struct pgd_props,
             LOG_ERRMSG("No lats in PGD grid search %d",
                        pgd_props.ngridSearch_lats);
         }
-        if (pgd->nlats < 1)
+        if (pgd->nlons < 1)
         {
             LOG_ERRMSG("No lons in PGD grid search %d",
                        pgd_props.ngridSearch_lons);
@@ -86,6 +86,8 @@ int core_scaling_pgd_initialize(struct GFAST_pgd_props_struct pgd_props,
     pgd->mpgd_vr    = memory_calloc64f(nloc);
     pgd->dep_vr_pgd = memory_calloc64f(nloc);
     pgd->srcDepths  = memory_calloc64f(pgd->ndeps);
+    pgd->srcLats    = memory_calloc64f(pgd->nlats);
+    pgd->srcLons    = memory_calloc64f(pgd->nlons);
     pgd->iqr        = memory_calloc64f(nloc);
     pgd->UP         = memory_calloc64f(pgd->nsites*nloc);
     pgd->srdist     = memory_calloc64f(pgd->nsites*nloc);
@@ -0,0 +1,245 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include "gfast_core.h"
+
+static double selectKth(const int n, const int k, double *__restrict__ x);
+static double minValue(const int n, const double *__restrict__ x);
+static double p2InterquartileRange(const int n, const double *__restrict__ x);
+
+/*!
+ * @brief Computes the interquartile range, i.e., the difference between the
+ *        75th and 25th percentiles, of the weighted residuals.  The
+ *        percentiles are linearly interpolated between order statistics
+ *        as in numpy.percentile.  Rather than sorting, the order statistics
+ *        are found with a quickselect on a copy of the data so the cost is
+ *        linear in the number of observations.
+ *
+ * @param[in] n        number of observations
+ * @param[in] nsketch  if positive and n >= max(nsketch, 5) then the
+ *                     percentiles are approximated with a single-pass
+ *                     P-squared streaming sketch that requires no
+ *                     workspace.
+ *                     otherwise the exact percentiles are computed.
+ * @param[in] x        observations [n]
+ *
+ * @param[out] work    workspace for the exact computation [n].
+ *                     this is not accessed by the sketch.
+ * @param[out] iqr     the 75th percentile minus the 25th percentile
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_scaling_pgd_interquartileRange(const int n, const int nsketch,
+                                        const double *__restrict__ x,
+                                        double *__restrict__ work,
+                                        double *iqr)
+{
+    double f25, f75, p25, p75, q25, q25p1, q75, q75p1;
+    int i25, i75;
+    //------------------------------------------------------------------------//
+    *iqr = 0.0;
+    if (n < 1 || x == NULL)
+    {
+        if (n < 1){LOG_ERRMSG("Invalid number of observations %d", n);}
+        if (x == NULL){LOG_ERRMSG("%s", "x is NULL");}
+        return -1;
+    }
+    if (n == 1){return 0;}
+    // The sketch needs five observations to seed its markers
+    if (nsketch > 0 && n >= nsketch && n >= 5)
+    {
+        *iqr = p2InterquartileRange(n, x);
+        return 0;
+    }
+    if (work == NULL)
+    {
+        LOG_ERRMSG("%s", "work is NULL");
+        return -1;
+    }
+    // Fractional indices of the percentiles in the sorted data
+    p25 = 0.25*(double) (n - 1);
+    p75 = 0.75*(double) (n - 1);
+    i25 = (int) p25;
+    i75 = (int) p75;
+    f25 = p25 - (double) i25;
+    f75 = p75 - (double) i75;
+    // After selection everything right of i75 is >= x[i75] so the next
+    // order statistic is the minimum of the right partition
+    memcpy(work, x, (size_t) n*sizeof(double));
+    q75 = selectKth(n, i75, work);
+    q75p1 = q75;
+    if (i75 + 1 < n){q75p1 = minValue(n - i75 - 1, &work[i75+1]);}
+    // Similarly for the lower quartile in the left partition
+    q25 = selectKth(i75 + 1, i25, work);
+    q25p1 = q75p1;
+    if (i25 < i75){q25p1 = minValue(i75 - i25, &work[i25+1]);}
+    *iqr = (q75 + f75*(q75p1 - q75)) - (q25 + f25*(q25p1 - q25));
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Partially orders x so that x[k] is the k'th smallest element,
+ *        elements left of k are no greater, and elements right of k are
+ *        no smaller.
+ */
+static double selectKth(const int n, const int k, double *__restrict__ x)
+{
+    double pivot, temp;
+    int i, j, left, mid, right;
+    left = 0;
+    right = n - 1;
+    while (right > left)
+    {
+        // Median of three pivot
+        mid = left + (right - left)/2;
+        if (x[mid] < x[left]){temp = x[mid]; x[mid] = x[left]; x[left] = temp;}
+        if (x[right] < x[left])
+        {
+            temp = x[right]; x[right] = x[left]; x[left] = temp;
+        }
+        if (x[right] < x[mid])
+        {
+            temp = x[right]; x[right] = x[mid]; x[mid] = temp;
+        }
+        pivot = x[mid];
+        i = left;
+        j = right;
+        while (i <= j)
+        {
+            while (x[i] < pivot){i = i + 1;}
+            while (x[j] > pivot){j = j - 1;}
+            if (i <= j)
+            {
+                temp = x[i]; x[i] = x[j]; x[j] = temp;
+                i = i + 1;
+                j = j - 1;
+            }
+        }
+        if (k <= j)
+        {
+            right = j;
+        }
+        else if (k >= i)
+        {
+            left = i;
+        }
+        else
+        {
+            break;
+        }
+    }
+    return x[k];
+}
+//============================================================================//
+/*!
+ * @brief Returns the minimum value of x.
+ */
+static double minValue(const int n, const double *__restrict__ x)
+{
+    double xmin;
+    int i;
+    xmin = x[0];
+    for (i=1; i<n; i++)
+    {
+        if (x[i] < xmin){xmin = x[i];}
+    }
+    return xmin;
+}
+//============================================================================//
+/*!
+ * @brief Estimates the interquartile range with the P-squared algorithm of
+ *        Jain and Chlamtac (1985).  Five markers are tracked for each
+ *        quartile and their heights are adjusted with a piecewise parabolic
+ *        prediction as each observation streams in.
+ */
+static double p2InterquartileRange(const int n, const double *__restrict__ x)
+{
+    double d, dwant[2][5], h[2][5], hp, nmark[2][5], np[2][5], temp;
+    int i, iq, j, k, l, m;
+    const double p[2] = {0.25, 0.75};
+    // Initialize the markers with the first five observations
+    for (iq=0; iq<2; iq++)
+    {
+        for (j=0; j<5; j++){h[iq][j] = x[j];}
+        for (j=1; j<5; j++)
+        {
+            for (l=j; l>0 && h[iq][l-1] > h[iq][l]; l--)
+            {
+                temp = h[iq][l];
+                h[iq][l] = h[iq][l-1];
+                h[iq][l-1] = temp;
+            }
+        }
+        for (j=0; j<5; j++){nmark[iq][j] = (double) (j + 1);}
+        np[iq][0] = 1.0;
+        np[iq][1] = 1.0 + 2.0*p[iq];
+        np[iq][2] = 1.0 + 4.0*p[iq];
+        np[iq][3] = 3.0 + 2.0*p[iq];
+        np[iq][4] = 5.0;
+        dwant[iq][0] = 0.0;
+        dwant[iq][1] = p[iq]/2.0;
+        dwant[iq][2] = p[iq];
+        dwant[iq][3] = (1.0 + p[iq])/2.0;
+        dwant[iq][4] = 1.0;
+    }
+    // Stream the remaining observations
+    for (i=5; i<n; i++)
+    {
+        for (iq=0; iq<2; iq++)
+        {
+            // Find the cell containing the observation
+            if (x[i] < h[iq][0])
+            {
+                h[iq][0] = x[i];
+                k = 0;
+            }
+            else if (x[i] >= h[iq][4])
+            {
+                h[iq][4] = x[i];
+                k = 3;
+            }
+            else
+            {
+                for (k=0; k<3; k++)
+                {
+                    if (x[i] < h[iq][k+1]){break;}
+                }
+            }
+            for (j=k+1; j<5; j++){nmark[iq][j] = nmark[iq][j] + 1.0;}
+            for (j=0; j<5; j++){np[iq][j] = np[iq][j] + dwant[iq][j];}
+            // Adjust the interior markers
+            for (j=1; j<4; j++)
+            {
+                d = np[iq][j] - nmark[iq][j];
+                if ((d >= 1.0 && nmark[iq][j+1] - nmark[iq][j] > 1.0) ||
+                    (d <=-1.0 && nmark[iq][j-1] - nmark[iq][j] <-1.0))
+                {
+                    m = (d >= 0.0) ? 1 :-1;
+                    // Parabolic prediction
+                    hp = h[iq][j] + (double) m
+                        /(nmark[iq][j+1] - nmark[iq][j-1])
+                        *( (nmark[iq][j] - nmark[iq][j-1] + (double) m)
+                          *(h[iq][j+1] - h[iq][j])
+                          /(nmark[iq][j+1] - nmark[iq][j])
+                         + (nmark[iq][j+1] - nmark[iq][j] - (double) m)
+                          *(h[iq][j] - h[iq][j-1])
+                          /(nmark[iq][j] - nmark[iq][j-1]) );
+                    // Fall back to linear if it isn't monotonic
+                    if (!(h[iq][j-1] < hp && hp < h[iq][j+1]))
+                    {
+                        hp = h[iq][j] + (double) m
+                            *(h[iq][j+m] - h[iq][j])
+                            /(nmark[iq][j+m] - nmark[iq][j]);
+                    }
+                    h[iq][j] = hp;
+                    nmark[iq][j] = nmark[iq][j] + (double) m;
+                }
+            }
+        }
+    }
+    return h[1][2] - h[0][2];
+}
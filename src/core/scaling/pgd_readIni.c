@@ -141,6 +141,14 @@ int core_scaling_pgd_readIni(const char *propfilename,
         LOG_ERRMSG("%s", "Error at least one site needed to estimate PGD!");
         goto ERROR;
     }
+    setVarName(group, "pgd_iqr_sketch_min\0", var);
+    pgd_props->iqr_sketch_min = iniparser_getint(ini, var, 0);
+    if (pgd_props->iqr_sketch_min < 0)
+    {
+        LOG_ERRMSG("Error IQR sketch minimum %d must be non-negative",
+                   pgd_props->iqr_sketch_min);
+        goto ERROR;
+    }
     ierr = 0;
     ERROR:;
     iniparser_freedict(ini);
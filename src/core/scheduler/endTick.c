@@ -0,0 +1,36 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "gfast_core.h"
+#include "iscl/time/time.h"
+
+/*!
+ * @brief Ends the current tick.  This records how long the tick ran and
+ *        advances the scheduler to the next deadline.
+ *
+ * @param[in,out] scheduler  on input holds the start time of the tick.
+ *                           on output holds the tick's run time, the
+ *                           updated statistics, and the next deadline.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_scheduler_endTick(struct GFAST_scheduler_struct *scheduler)
+{
+    double runTime;
+    //------------------------------------------------------------------------//
+    //
+    if (!scheduler->linit)
+    {
+        LOG_ERRMSG("%s", "Scheduler not initialized");
+        return -1;
+    }
+    runTime = time_timeStamp() - scheduler->tstart;
+    if (runTime < 0.0){runTime = 0.0;}
+    scheduler->runTime = runTime;
+    scheduler->sumRunTime = scheduler->sumRunTime + runTime;
+    if (runTime > scheduler->maxRunTime){scheduler->maxRunTime = runTime;}
+    scheduler->tdeadline = scheduler->tdeadline + scheduler->interval;
+    return 0;
+}
@@ -0,0 +1,42 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_core.h"
+
+/*!
+ * @brief Initializes the tick scheduler.
+ *
+ * @param[in] interval     time (s) between successive ticks.  this must
+ *                         be positive.
+ * @param[in] t0           epochal time (UTC seconds) of the first tick's
+ *                         deadline.
+ * @param[in] lrealTime    if true then the scheduler will sleep until each
+ *                         deadline.  otherwise, the deadlines are simulated
+ *                         and the scheduler will not sleep (e.g. playback).
+ *
+ * @param[out] scheduler   initialized tick scheduler
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_scheduler_initialize(const double interval,
+                              const double t0,
+                              const bool lrealTime,
+                              struct GFAST_scheduler_struct *scheduler)
+{
+    //------------------------------------------------------------------------//
+    //
+    memset(scheduler, 0, sizeof(struct GFAST_scheduler_struct));
+    if (interval <= 0.0)
+    {
+        LOG_ERRMSG("Invalid tick interval %f", interval);
+        return -1;
+    }
+    scheduler->interval = interval;
+    scheduler->tdeadline = t0;
+    scheduler->lrealTime = lrealTime;
+    scheduler->linit = true;
+    return 0;
+}
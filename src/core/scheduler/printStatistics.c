@@ -0,0 +1,57 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_core.h"
+
+/*!
+ * @brief Convenience function that prints the tick scheduler's timing
+ *        statistics to the info log.
+ *
+ * @param[in] scheduler     tick scheduler whose statistics will be printed
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+void core_scheduler_printStatistics(struct GFAST_scheduler_struct scheduler)
+{
+    const char *lspace = "       \0";
+    char line[128], msg[1024];
+    double avgLateness, avgRunTime;
+    //------------------------------------------------------------------------//
+    //
+    avgLateness = 0.0;
+    avgRunTime = 0.0;
+    if (scheduler.nticks > 0)
+    {
+        avgLateness = scheduler.sumLateness/(double) scheduler.nticks;
+        avgRunTime = scheduler.sumRunTime/(double) scheduler.nticks;
+    }
+    memset(msg, 0, 1024*sizeof(char));
+    sprintf(msg, "\n%s  Scheduler statistics:\n", lspace);
+
+    memset(line, 0, 128*sizeof(char));
+    sprintf(line, "%s  Tick interval %f (s)\n", lspace, scheduler.interval);
+    strcat(msg, line);
+
+    memset(line, 0, 128*sizeof(char));
+    sprintf(line, "%s  Number of ticks %d\n", lspace, scheduler.nticks);
+    strcat(msg, line);
+
+    memset(line, 0, 128*sizeof(char));
+    sprintf(line, "%s  Number of missed deadlines %d\n",
+            lspace, scheduler.nmissed);
+    strcat(msg, line);
+
+    memset(line, 0, 128*sizeof(char));
+    sprintf(line, "%s  Average/max lateness %f/%f (s)\n",
+            lspace, avgLateness, scheduler.maxLateness);
+    strcat(msg, line);
+
+    memset(line, 0, 128*sizeof(char));
+    sprintf(line, "%s  Average/max run time %f/%f (s)\n",
+            lspace, avgRunTime, scheduler.maxRunTime);
+    strcat(msg, line);
+
+    LOG_INFOMSG("%s", msg);
+    return;
+}
@@ -0,0 +1,88 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <errno.h>
+#include <time.h>
+#include "gfast_core.h"
+#include "iscl/time/time.h"
+
+/*!
+ * @brief Blocks until the scheduler's next deadline and begins a tick.
+ *        In real-time mode the calling thread sleeps on an absolute
+ *        deadline rather than polling the clock.  If the deadline(s) have
+ *        already passed then the scheduler skips ahead to the most recent
+ *        deadline and counts the skipped deadlines as missed.
+ *
+ * @param[in,out] scheduler  on input holds the next deadline.
+ *                           on output holds the start time and lateness
+ *                           of this tick and the updated statistics.
+ *
+ * @param[out] ierr          0 indicates success
+ *
+ * @result the epochal time (UTC seconds) of the tick's deadline.  this is
+ *         the time the caller should process.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+double core_scheduler_waitForNextTick(struct GFAST_scheduler_struct *scheduler,
+                                      int *ierr)
+{
+    struct timespec deadline;
+    double lateness, now, tsec;
+    int ierrSleep, nskip;
+    //------------------------------------------------------------------------//
+    //
+    *ierr = 0;
+    if (!scheduler->linit)
+    {
+        LOG_ERRMSG("%s", "Scheduler not initialized");
+        *ierr = 1;
+        return 0.0;
+    }
+    now = time_timeStamp();
+    lateness = 0.0;
+    if (scheduler->lrealTime)
+    {
+        // Sleep until the deadline - restart the sleep on signal interrupts
+        if (now < scheduler->tdeadline)
+        {
+            tsec = floor(scheduler->tdeadline);
+            deadline.tv_sec = (time_t) tsec;
+            deadline.tv_nsec = (long) ((scheduler->tdeadline - tsec)*1.e9);
+            if (deadline.tv_nsec > 999999999){deadline.tv_nsec = 999999999;}
+            while (true)
+            {
+                ierrSleep = clock_nanosleep(CLOCK_REALTIME, TIMER_ABSTIME,
+                                            &deadline, NULL);
+                if (ierrSleep != EINTR){break;}
+            }
+            if (ierrSleep != 0)
+            {
+                LOG_ERRMSG("clock_nanosleep failed with error %d", ierrSleep);
+                *ierr = 1;
+                return scheduler->tdeadline;
+            }
+            now = time_timeStamp();
+        }
+        lateness = now - scheduler->tdeadline;
+        // Skip ahead to the latest deadline that has passed
+        if (lateness >= scheduler->interval)
+        {
+            nskip = (int) (lateness/scheduler->interval);
+            scheduler->nmissed = scheduler->nmissed + nskip;
+            scheduler->tdeadline = scheduler->tdeadline
+                                 + (double) nskip*scheduler->interval;
+            lateness = now - scheduler->tdeadline;
+            LOG_WARNMSG("Missed %d tick deadline(s)", nskip);
+        }
+        if (lateness < 0.0){lateness = 0.0;}
+    }
+    // Update the statistics
+    scheduler->tstart = now;
+    scheduler->lateness = lateness;
+    scheduler->sumLateness = scheduler->sumLateness + lateness;
+    if (lateness > scheduler->maxLateness){scheduler->maxLateness = lateness;}
+    scheduler->nticks = scheduler->nticks + 1;
+    return scheduler->tdeadline;
+}
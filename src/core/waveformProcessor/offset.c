@@ -4,25 +4,6 @@
 #include <math.h>
 #include "gfast_core.h"
 
-#ifndef MAX
-#define MAX(x,y) (((x) > (y)) ? (x) : (y))
-#endif
-#ifndef MIN
-#define MIN(x,y) (((x) < (y)) ? (x) : (y))
-#endif
-
-static bool __getAverageOffset(const int npts,
-                               const double dt, 
-                               const double ev_time,
-                               const double swave_time,
-                               const double epoch,
-                               const double *__restrict__ ubuff,
-                               const double *__restrict__ nbuff,
-                               const double *__restrict__ ebuff,
-                               double *uOffset,
-                               double *nOffset,
-                               double *eOffset);
-
 /*!
  * @brief Estimates the average offset for each GPS precise point positiion
  *        data stream with the additional requirement that the shear wave
@@ -59,6 +40,14 @@ static bool __getAverageOffset(const int npts,
  * @param[in] gps_data         contains the most up-to-date precise point
  *                             positions for each site
  *
+ * @param[in,out] offState     if not NULL then this is the event's running
+ *                             offset state and must hold a window for
+ *                             svel_window.  on input holds the running sums
+ *                             from the S wave arrival at each site.  on
+ *                             output these include the samples in gps_data
+ *                             that arrived since the previous call.
+ *                             if NULL then the offsets are computed from
+ *                             all samples after the S wave arrival.
  * @param[in,out] offset_data  on input holds a logical mask if a site is to
  *                             be ignored.
  *                             on output holds the average offset at each 
@@ -83,12 +72,14 @@ int core_waveformProcessor_offset(const int utm_zone,
                                   const double ev_dep,
                                   const double ev_time,
                                   struct GFAST_data_struct gps_data,
+                                  struct GFAST_offsetState_struct *offState,
                                   struct GFAST_offsetData_struct *offset_data,
                                   int *ierr)
 {
+    const struct GFAST_hypoDistance_struct *hd;
     double currentTime, distance, effectiveHypoDist, eOffset, epoch, nOffset,
-           swave_time, uOffset, x1, x2, y1, y2;
-    int k, nsites, zone_loc;
+           peakDisp, swave_time, uOffset, x1, x2, y1, y2;
+    int ierrDist, ierrSite, iwin, j, k, nsites, zone_loc;
     bool lnorthp, luse;
     //------------------------------------------------------------------------//
     //
@@ -124,12 +115,46 @@ int core_waveformProcessor_offset(const int utm_zone,
         }
         return nsites;
     }
+    // Find the running sums for this window velocity
+    iwin =-1;
+    if (offState != NULL)
+    {
+        if (offState->nsites != offset_data->nsites)
+        {
+            LOG_ERRMSG("Inconsistent state size %d %d",
+                       offState->nsites, offset_data->nsites);
+            *ierr = 1;
+            return nsites;
+        }
+        for (j=0; j<offState->nwin; j++)
+        {
+            if (fabs(offState->svel[j] - svel_window) < 1.e-10)
+            {
+                iwin = j;
+                break;
+            }
+        }
+        if (iwin < 0)
+        {
+            LOG_WARNMSG("No running sums for window velocity %f",
+                        svel_window);
+        }
+    }
     // Get the source location
     zone_loc = utm_zone;
     if (zone_loc ==-12345){zone_loc =-1;} // Get UTM zone from source lat/lon
     GFAST_core_coordtools_ll2utm(ev_lat, ev_lon,
                                  &y1, &x1,
                                  &lnorthp, &zone_loc);
+    // Use the memoized source-receiver distances if available
+    hd = NULL;
+    if (gps_data.geometry != NULL)
+    {
+        hd = GFAST_core_data_getHypocentralDistances(gps_data,
+                                                     ev_lat, ev_lon, ev_dep,
+                                                     utm_zone, &ierrDist);
+        if (ierrDist != 0){hd = NULL;}
+    }
     // Loop on streams and if they satisfy the S wave mask get their offsets 
     for (k=0; k<gps_data.stream_length; k++)
     {
@@ -147,16 +172,24 @@ int core_waveformProcessor_offset(const int utm_zone,
         offset_data->lactive[k] = false;
         if (offset_data->lmask[k]){continue;}
         //if (gps_data.data[k].lskip_cmt){continue;} // Not in inversion
-        // Get the recevier UTM
-        GFAST_core_coordtools_ll2utm(gps_data.data[k].sta_lat,
-                                     gps_data.data[k].sta_lon,
-                                     &y2, &x2,
-                                     &lnorthp, &zone_loc);
-        // Get the distance - remember source is + down and receiver is + up
-        distance = sqrt( pow(x1 - x2, 2)
-                       + pow(y1 - y2, 2)
-                       + pow(ev_dep*1000.0 + gps_data.data[k].sta_alt, 2));
-        distance = distance*1.e-3; // convert to km
+        if (hd != NULL)
+        {
+            distance = hd->distance[k];
+        }
+        else
+        {
+            // Get the recevier UTM
+            GFAST_core_coordtools_ll2utm(gps_data.data[k].sta_lat,
+                                         gps_data.data[k].sta_lon,
+                                         &y2, &x2,
+                                         &lnorthp, &zone_loc);
+            // Get the distance - remember source is + down and receiver
+            // is + up
+            distance = sqrt( pow(x1 - x2, 2)
+                           + pow(y1 - y2, 2)
+                           + pow(ev_dep*1000.0 + gps_data.data[k].sta_alt, 2));
+            distance = distance*1.e-3; // convert to km
+        }
         // Apply an S wave window mask to preclude likely outliers in the
         // ensuing CMT/finite fault inversions
         epoch = gps_data.data[k].tbuff[0]; //gps_data.data[k].epoch
@@ -167,17 +200,17 @@ int core_waveformProcessor_offset(const int utm_zone,
         {
             swave_time = ev_time + distance/svel_window;
             // Compute the average offset beginning after the S wave mask
-            luse = __getAverageOffset(gps_data.data[k].npts,
-                                      gps_data.data[k].dt, 
-                                      ev_time,
-                                      swave_time,
-                                      epoch,
-                                      gps_data.data[k].ubuff,
-                                      gps_data.data[k].nbuff,
-                                      gps_data.data[k].ebuff,
-                                      &uOffset,
-                                      &nOffset,
-                                      &eOffset);
+            ierrSite = core_waveformProcessor_updateSite(k, ev_time,
+                                                         &gps_data.data[k],
+                                                         false, 1,
+                                                         &swave_time, &iwin,
+                                                         NULL, offState,
+                                                         &peakDisp,
+                                                         &uOffset,
+                                                         &nOffset,
+                                                         &eOffset);
+            if (ierrSite != 0){*ierr = 1;}
+            luse = !isnan(uOffset) && !isnan(nOffset) && !isnan(eOffset);
             // Only use average offset if it isn't all NaN's
             if (luse)
             {
@@ -194,118 +227,3 @@ int core_waveformProcessor_offset(const int utm_zone,
     } // Loop on data streams
     return nsites; 
 }
-//============================================================================//
-/*!
- * @brief Computes the average offset on all components beginning at the
- *        S wave time and running to the end of the observed
- *
- * @param[in] npts        number of points in time series
- * @param[in] dt          sampling period (s) of time series
- * @param[in] ev_time     epoch (s) of origin time (UTC)
- * @param[in] swave_time  epoch (s) of s wave arrival (UTC)
- * @param[in] epoch       epoch (s) of trace start time (UTC)
- * @param[in] ubuff       vertical precise point position data [npts]
- * @param[in] nbuff       north precise point position data [npts]
- * @param[in] ebuff       east precise point position data [npts]
- *
- * @param[out] uOffset    offset in vertical position
- * @param[out] nOffset    offset in north position
- * @param[out] eOffset    offset in east position
- *
- * @result if true then uOffset, nOffset, and eOffset are not NaN's and can
- *         be used in the inversion
- *
- * @author Ben Baker (ISTI)
- *
- */
-static bool __getAverageOffset(const int npts,
-                               const double dt,
-                               const double ev_time,
-                               const double swave_time,
-                               const double epoch,
-                               const double *__restrict__ ubuff,
-                               const double *__restrict__ nbuff,
-                               const double *__restrict__ ebuff,
-                               double *uOffset,
-                               double *nOffset,
-                               double *eOffset)
-{
-    double diffT, de, dn, du, e0, n0, u0, eOffsetNan, nOffsetNan, uOffsetNan;
-    int i, iavg, iavg1, indx0;
-    bool luse;
-    //------------------------------------------------------------------------//
-    //
-    // Initialize result 
-    *uOffset = (double) NAN;
-    *nOffset = (double) NAN;
-    *eOffset = (double) NAN;
-    luse = false;
-    // This is a bad input
-    if (ev_time > swave_time)
-    {
-        LOG_ERRMSG("%s", "event origin time exceeds S wave arrival");
-        return luse;
-    }
-    // This might compromise the offset
-    if (epoch > ev_time)
-    {
-        LOG_WARNMSG("%s",
-                    "Warning trace start-time is after event origint time");
-    }
-    // Set the initial position
-    u0 = 0.0;
-    n0 = 0.0;
-    e0 = 0.0;
-    // Estimate the origin time index
-    diffT = ev_time - epoch;
-    if (diffT < 0.0){return luse;} // This will be a disaster
-    indx0 = MAX(0, (int) (diffT/dt + 0.5));
-    indx0 = MIN(npts-1, indx0);
-    u0 = ubuff[indx0];
-    n0 = nbuff[indx0];
-    e0 = ebuff[indx0];
-    // Prevent a nonsensical difference
-    if (isnan(u0) || isnan(n0) || isnan(e0)){return luse;}
-    // Estimate the S wave arrival time index
-    diffT = swave_time - epoch;
-    if (diffT < 0.0){return luse;}
-    indx0 = MAX(0, (int) (diffT/dt + 0.5));
-    indx0 = MIN(npts-1, indx0);
-    // Compute the average from the S wave arrival to the end of the data
-    uOffsetNan = 0.0;
-    nOffsetNan = 0.0;
-    eOffsetNan = 0.0;
-    iavg = 0;
-    // Compute the average over the window
-    for (i=indx0; i<npts; i++)
-    {
-        luse = false;
-        du = 0.0;
-        dn = 0.0;
-        de = 0.0;
-        iavg1 = 0;
-        //if (!isnan(ubuff[i]) && !isnan(nbuff[i]) && !isnan(ebuff[i]) &&
-        //    ubuff[i] >-999.0 && nbuff[i] >-999.0 && ebuff[i] >-999.0)
-        if (!isnan(ubuff[i]) && !isnan(nbuff[i]) && !isnan(ebuff[i]))
-        {
-            luse = true;
-        }
-        if (luse){du = ubuff[i] - u0;}
-        if (luse){dn = nbuff[i] - n0;}
-        if (luse){de = ebuff[i] - e0;}
-        if (luse){iavg1 = 1;}
-        uOffsetNan = uOffsetNan + du;
-        nOffsetNan = nOffsetNan + dn;
-        eOffsetNan = eOffsetNan + de;
-        iavg = iavg + iavg1;
-    } // Loop on data points
-    // There's data - average it and use this result
-    if (iavg > 0)
-    {
-        *uOffset = uOffsetNan/(double) iavg;
-        *nOffset = nOffsetNan/(double) iavg;
-        *eOffset = eOffsetNan/(double) iavg;
-        luse = true;
-    }
-    return luse;
-}
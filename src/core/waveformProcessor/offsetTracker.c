@@ -0,0 +1,262 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+#include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
+
+static void freeState(struct GFAST_offsetState_struct *state);
+static int resetState(const double ev_time, const int nsites,
+                      const int nwin, const double *svel,
+                      struct GFAST_offsetState_struct *state);
+
+/*!
+ * @brief Returns the running offset state for the given event.  If the
+ *        event is new then a state is created.  If the origin time, number
+ *        of sites, or window velocities changed then the state is reset so
+ *        that the offsets are recomputed from the origin.
+ *
+ * @param[in] SA           shakeAlert event whose state is desired
+ * @param[in] nsites       number of GPS sites
+ * @param[in] nwin         number of shear wave window velocities
+ * @param[in] svel         shear wave window velocities (km/s) for which
+ *                         running sums will be kept [nwin]
+ *
+ * @param[in,out] tracker  on input holds the states of the active events
+ *                         and the latency given to them.
+ *                         on output holds a valid state for SA.
+ *
+ * @param[out] ierr        0 indicates success
+ *
+ * @result pointer to the event's state in the tracker.  NULL if an error
+ *         occurred.  the pointer is invalidated by subsequent calls to
+ *         this function or to the prune function.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+struct GFAST_offsetState_struct *
+    core_waveformProcessor_getOffsetState(
+    struct GFAST_shakeAlert_struct SA,
+    const int nsites,
+    const int nwin,
+    const double *svel,
+    struct GFAST_offsetTracker_struct *tracker,
+    int *ierr)
+{
+    struct GFAST_offsetState_struct *states;
+    int i, iwin;
+    bool lreset;
+    //------------------------------------------------------------------------//
+    *ierr = 0;
+    for (i=0; i<tracker->nstates; i++)
+    {
+        if (strcasecmp(tracker->states[i].eventid, SA.eventid) == 0)
+        {
+            lreset = false;
+            if (fabs(tracker->states[i].ev_time - SA.time) > 1.e-5 ||
+                tracker->states[i].nsites != nsites ||
+                tracker->states[i].nwin != nwin)
+            {
+                lreset = true;
+            }
+            else
+            {
+                for (iwin=0; iwin<nwin; iwin++)
+                {
+                    if (tracker->states[i].svel[iwin] != svel[iwin])
+                    {
+                        lreset = true;
+                    }
+                }
+            }
+            if (lreset)
+            {
+                *ierr = resetState(SA.time, nsites, nwin, svel,
+                                   &tracker->states[i]);
+                if (*ierr != 0){return NULL;}
+            }
+            tracker->states[i].latency = tracker->latency;
+            return &tracker->states[i];
+        }
+    }
+    // New event - append a state
+    states = (struct GFAST_offsetState_struct *)
+             calloc((size_t) (tracker->nstates + 1),
+                    sizeof(struct GFAST_offsetState_struct));
+    if (tracker->nstates > 0)
+    {
+        memcpy(states, tracker->states,
+               (size_t) tracker->nstates
+              *sizeof(struct GFAST_offsetState_struct));
+    }
+    free(tracker->states);
+    tracker->states = states;
+    i = tracker->nstates;
+    tracker->nstates = tracker->nstates + 1;
+    strncpy(tracker->states[i].eventid, SA.eventid,
+            sizeof(tracker->states[i].eventid) - 1);
+    *ierr = resetState(SA.time, nsites, nwin, svel, &tracker->states[i]);
+    if (*ierr != 0)
+    {
+        LOG_ERRMSG("Error creating offset state for %s", SA.eventid);
+        return NULL;
+    }
+    tracker->states[i].latency = tracker->latency;
+    return &tracker->states[i];
+}
+//============================================================================//
+/*!
+ * @brief Removes the offset states of events that are no longer in the
+ *        active events list.
+ *
+ * @param[in] events       the active events list
+ *
+ * @param[in,out] tracker  on input holds the offset states.
+ *                         on output states of expired or cancelled events
+ *                         have been freed.
+ *
+ * @result the number of states removed
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_waveformProcessor_pruneOffsetStates(
+    struct GFAST_activeEvents_struct events,
+    struct GFAST_offsetTracker_struct *tracker)
+{
+    int i, iev, j, nrem;
+    bool lfound;
+    //------------------------------------------------------------------------//
+    nrem = 0;
+    j = 0;
+    for (i=0; i<tracker->nstates; i++)
+    {
+        lfound = false;
+        for (iev=0; iev<events.nev; iev++)
+        {
+            if (strcasecmp(tracker->states[i].eventid,
+                           events.SA[iev].eventid) == 0)
+            {
+                lfound = true;
+                break;
+            }
+        }
+        if (!lfound)
+        {
+            freeState(&tracker->states[i]);
+            nrem = nrem + 1;
+            continue;
+        }
+        if (j != i)
+        {
+            memcpy(&tracker->states[j], &tracker->states[i],
+                   sizeof(struct GFAST_offsetState_struct));
+        }
+        j = j + 1;
+    }
+    tracker->nstates = j;
+    if (tracker->nstates == 0)
+    {
+        free(tracker->states);
+        tracker->states = NULL;
+    }
+    return nrem;
+}
+//============================================================================//
+/*!
+ * @brief Frees the offset tracker.
+ *
+ * @param[in,out] tracker  on input holds the offset states.
+ *                         on output all memory has been released.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+void core_waveformProcessor_finalizeOffsetTracker(
+    struct GFAST_offsetTracker_struct *tracker)
+{
+    int i;
+    for (i=0; i<tracker->nstates; i++)
+    {
+        freeState(&tracker->states[i]);
+    }
+    free(tracker->states);
+    memset(tracker, 0, sizeof(struct GFAST_offsetTracker_struct));
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Resets the state so that the offsets will be computed anew from
+ *        the origin time.
+ */
+static int resetState(const double ev_time, const int nsites,
+                      const int nwin, const double *svel,
+                      struct GFAST_offsetState_struct *state)
+{
+    int i, n;
+    if (nsites < 1 || nwin < 1)
+    {
+        LOG_ERRMSG("Invalid number of sites or windows %d %d", nsites, nwin);
+        return -1;
+    }
+    for (i=0; i<nwin; i++)
+    {
+        if (svel[i] <= 0.0)
+        {
+            LOG_ERRMSG("Invalid window velocity %f", svel[i]);
+            return -1;
+        }
+    }
+    n = nwin*nsites;
+    if (state->nsites != nsites || state->nwin != nwin)
+    {
+        freeState(state);
+        state->svel = memory_calloc64f(nwin);
+        state->u0 = memory_calloc64f(nsites);
+        state->n0 = memory_calloc64f(nsites);
+        state->e0 = memory_calloc64f(nsites);
+        state->uSum = memory_calloc64f(n);
+        state->nSum = memory_calloc64f(n);
+        state->eSum = memory_calloc64f(n);
+        state->tstart = memory_calloc64f(n);
+        state->tnext = memory_calloc64f(n);
+        state->nsum = memory_calloc32i(n);
+        state->nsites = nsites;
+        state->nwin = nwin;
+    }
+    array_copy64f_work(nwin, svel, state->svel);
+    array_set64f_work(nsites, (double) NAN, state->u0);
+    array_set64f_work(nsites, (double) NAN, state->n0);
+    array_set64f_work(nsites, (double) NAN, state->e0);
+    array_zeros64f_work(n, state->uSum);
+    array_zeros64f_work(n, state->nSum);
+    array_zeros64f_work(n, state->eSum);
+    array_set64f_work(n, (double) NAN, state->tstart);
+    array_set64f_work(n, ev_time, state->tnext);
+    array_zeros32i_work(n, state->nsum);
+    state->ev_time = ev_time;
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Releases the arrays on the state but retains the event ID.
+ */
+static void freeState(struct GFAST_offsetState_struct *state)
+{
+    memory_free64f(&state->svel);
+    memory_free64f(&state->u0);
+    memory_free64f(&state->n0);
+    memory_free64f(&state->e0);
+    memory_free64f(&state->uSum);
+    memory_free64f(&state->nSum);
+    memory_free64f(&state->eSum);
+    memory_free64f(&state->tstart);
+    memory_free64f(&state->tnext);
+    memory_free32i(&state->nsum);
+    state->nsites = 0;
+    state->nwin = 0;
+    return;
+}
@@ -2,24 +2,8 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <math.h>
-#include <float.h>
 #include "gfast_core.h"
 
-#define PD_MAX_NAN -DBL_MAX
-#ifndef MAX
-#define MAX(x,y) (((x) > (y)) ? (x) : (y))
-#endif
-#ifndef MIN
-#define MIN(x,y) (((x) < (y)) ? (x) : (y))
-#endif
-
-static double __getPeakDisplacement(const int npts,
-                                    const double dt,
-                                    const double ev_time,
-                                    const double epoch,
-                                    const double *__restrict__ ubuff,
-                                    const double *__restrict__ nbuff,
-                                    const double *__restrict__ ebuff);
 /*!
  * @brief Computes the peak displacement for each GPS precise point position
  *        data stream with the additional requirement that the shear wave
@@ -41,6 +25,14 @@ static double __getPeakDisplacement(const int npts,
  * @param[in] gps_data      contains the most up-to-date precise point 
  *                          positions for each site 
  *
+ * @param[in,out] pdState   if not NULL then this is the event's incremental
+ *                          state.  on input holds the running peak
+ *                          displacement and the time of the next unprocessed
+ *                          sample at each site.  on output these have been
+ *                          updated with the new samples in gps_data so that
+ *                          each call only touches samples that arrived since
+ *                          the previous call.  if NULL then the peak
+ *                          displacement is computed from all samples.
  * @param[in,out] pgd_data  on input holds a logical mask if a site is to
  *                          be ignored.
  *                          on output holds the peak ground displacement
@@ -64,12 +56,14 @@ int core_waveformProcessor_peakDisplacement(
     const double ev_dep,
     const double ev_time,
     struct GFAST_data_struct gps_data,
+    struct GFAST_peakDisplacementState_struct *pdState,
     struct GFAST_peakDisplacementData_struct *pgd_data,
     int *ierr)
 {
+    const struct GFAST_hypoDistance_struct *hd;
     double currentTime, distance, effectiveHypoDist, epoch,
            peakDisp, x1, x2, y1, y2;
-    int k, nsites, zone_loc;
+    int ierrDist, ierrSite, k, nsites, zone_loc;
     bool lnorthp;
     //------------------------------------------------------------------------//
     //
@@ -93,12 +87,28 @@ int core_waveformProcessor_peakDisplacement(
         }
         return nsites;
     }
+    if (pdState != NULL && pdState->nsites != pgd_data->nsites)
+    {
+        LOG_ERRMSG("Inconsistent state size %d %d",
+                   pdState->nsites, pgd_data->nsites);
+        *ierr = 1;
+        return nsites;
+    }
     // Get the source location
     zone_loc = utm_zone;
     if (zone_loc ==-12345){zone_loc =-1;} // Get UTM zone from source lat/lon
     GFAST_core_coordtools_ll2utm(ev_lat, ev_lon,
                                  &y1, &x1,
                                  &lnorthp, &zone_loc);
+    // Use the memoized source-receiver distances if available
+    hd = NULL;
+    if (gps_data.geometry != NULL)
+    {
+        hd = GFAST_core_data_getHypocentralDistances(gps_data,
+                                                     ev_lat, ev_lon, ev_dep,
+                                                     utm_zone, &ierrDist);
+        if (ierrDist != 0){hd = NULL;}
+    }
     // Loop on streams and if they satisfy the S wave mask get their PGD
     for (k=0; k<gps_data.stream_length; k++)
     {
@@ -111,16 +121,24 @@ int core_waveformProcessor_peakDisplacement(
         pgd_data->wt[k] = 0.0; // Assume no weight
         pgd_data->lactive[k] = false; // Assume site is not active in inversion
         if (pgd_data->lmask[k]){continue;} // Not in inversion
-        // Get the recevier UTM
-        GFAST_core_coordtools_ll2utm(gps_data.data[k].sta_lat,
-                                     gps_data.data[k].sta_lon,
-                                     &y2, &x2,
-                                     &lnorthp, &zone_loc);
-        // Get the distance - remember source is + down and receiver is + up
-        distance = sqrt( pow(x1 - x2, 2)
-                       + pow(y1 - y2, 2)
-                       + pow(ev_dep*1000.0 + gps_data.data[k].sta_alt, 2));
-        distance = distance*1.e-3; // convert to km
+        if (hd != NULL)
+        {
+            distance = hd->distance[k];
+        }
+        else
+        {
+            // Get the recevier UTM
+            GFAST_core_coordtools_ll2utm(gps_data.data[k].sta_lat,
+                                         gps_data.data[k].sta_lon,
+                                         &y2, &x2,
+                                         &lnorthp, &zone_loc);
+            // Get the distance - remember source is + down and receiver
+            // is + up
+            distance = sqrt( pow(x1 - x2, 2)
+                           + pow(y1 - y2, 2)
+                           + pow(ev_dep*1000.0 + gps_data.data[k].sta_alt, 2));
+            distance = distance*1.e-3; // convert to km
+        }
         // Apply an S wave window mask to preclude likely outliers in
         // the ensuing PGD inversion 
         epoch = gps_data.data[k].tbuff[0]; //gps_data.data[k].epoch;
@@ -130,13 +148,13 @@ int core_waveformProcessor_peakDisplacement(
         if (distance < effectiveHypoDist)
         {
             // Compute the peak displacement max(norm(u + n + e, 2))
-            peakDisp = __getPeakDisplacement(gps_data.data[k].npts,
-                                             gps_data.data[k].dt,
-                                             ev_time,
-                                             epoch,
-                                             gps_data.data[k].ubuff,
-                                             gps_data.data[k].nbuff,
-                                             gps_data.data[k].ebuff);
+            ierrSite = core_waveformProcessor_updateSite(k, ev_time,
+                                                         &gps_data.data[k],
+                                                         true, 0, NULL, NULL,
+                                                         pdState, NULL,
+                                                         &peakDisp,
+                                                         NULL, NULL, NULL);
+            if (ierrSite != 0){*ierr = 1;}
             // If it isn't a NaN then retain it for processing
             if (!isnan(peakDisp))
             {
@@ -149,73 +167,3 @@ int core_waveformProcessor_peakDisplacement(
     } // Loop on data streams
     return nsites;
 }
-//============================================================================//
-/*!
- * @brief Waveform processor to estimate the peak displacement observed
- *        on a 3 channel GPS stream where the peak displacement at any
- *        sample is Euclidean norm of it's displacement.
- *
- * @param[in] npts             number of points in time series
- * @param[in] dt               sampling period (s) of GPS buffers
- * @param[in] ev_time          epochal UTC origin time (s)
- * @param[in] epoch            epochal UTC start time (s) of GPS traces
- * @param[in] ubuff            vertical position [npts]
- * @param[in] nbuff            north position [npts]
- * @param[in] ebuff            east position [npts]
- *
- * @result the peak displacement observed on a trace.  this has the same
- *         units as ubuff, nbuff, and ebuff.
- *
- * @author Brendan Crowell (PNSN) and Ben Baker (ISTI)
- *
- * @date May 2016
- *
- */
-static double __getPeakDisplacement(const int npts,
-                                    const double dt,
-                                    const double ev_time,
-                                    const double epoch,
-                                    const double *__restrict__ ubuff,
-                                    const double *__restrict__ nbuff,
-                                    const double *__restrict__ ebuff)
-{
-    double diffT, peakDisplacement_i, peakDisplacement, e0, n0, u0;
-    int i, indx0;
-    //------------------------------------------------------------------------//
-    //
-    // Set the initial position
-    u0 = 0.0;
-    n0 = 0.0;
-    e0 = 0.0;
-    diffT = ev_time - epoch;
-    indx0 = MAX(0, (int) (diffT/dt + 0.5));
-    indx0 = MIN(npts-1, indx0);
-    // Compute the offset
-    diffT = ev_time - epoch;
-    u0 = ubuff[indx0];
-    n0 = nbuff[indx0];
-    e0 = ebuff[indx0];
-    // Prevent a problem
-    if (isnan(u0) || isnan(n0) || isnan(e0))
-    {
-        return (double) NAN;
-    }
-    // Compute the maximum peak ground displacement 
-    peakDisplacement = PD_MAX_NAN;
-    for (i=indx0; i<npts; i++)
-    {
-        peakDisplacement_i = PD_MAX_NAN;
-        if (!isnan(ubuff[i]) && !isnan(nbuff[i]) && !isnan(ebuff[i]) )
-        {
-            peakDisplacement_i = sqrt( pow(ubuff[i] - u0, 2)
-                                     + pow(nbuff[i] - n0, 2)
-                                     + pow(ebuff[i] - e0, 2));
-        }
-        peakDisplacement = fmax(peakDisplacement_i, peakDisplacement);
-    } // Loop on data points
-    if (fabs(peakDisplacement - PD_MAX_NAN)/fabs(PD_MAX_NAN) < 1.e-10)
-    {
-         peakDisplacement = (double) NAN;
-    }
-    return peakDisplacement;
-}
@@ -0,0 +1,343 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+
+static void nullOffsetSite(const int k, struct GFAST_offsetData_struct *data);
+static void nullPeakDisplacementSite(
+    const int k, struct GFAST_peakDisplacementData_struct *data);
+static int getWindow(const double svel_window, const int iskip,
+                     const struct GFAST_offsetState_struct *offState);
+
+/*!
+ * @brief Fused waveform processor.  This computes the peak displacement
+ *        for the PGD scaling and the average offsets for the CMT and
+ *        finite fault inversions in one pass over the GPS streams.  The
+ *        source and receiver UTM coordinates and hypocentral distances are
+ *        computed once per site and shared when the UTM zones agree, and
+ *        each site's buffers are read once for all three products by
+ *        core_waveformProcessor_updateSite.  The results are identical to
+ *        calling core_waveformProcessor_peakDisplacement and
+ *        core_waveformProcessor_offset for the CMT and FF.
+ *
+ * @param[in] pgd_props         PGD properties.  the UTM zone and shear wave
+ *                              window velocity are used.
+ * @param[in] cmt_props         CMT properties.  the UTM zone and shear wave
+ *                              window velocity are used.
+ * @param[in] ff_props          finite fault properties.  the UTM zone and
+ *                              shear wave window velocity are used.
+ * @param[in] ev_lat            source hypocentral latitude (degrees) [-90,90]
+ * @param[in] ev_lon            source hypocentral longitude (degrees) [0,360]
+ * @param[in] ev_dep            source hypocentral depth (km) (this is positive
+ *                              down from the free surface)
+ * @param[in] ev_time           source origin time in seconds since epoch (UTC)
+ * @param[in] gps_data          contains the most up-to-date precise point
+ *                              positions for each site.  if the station
+ *                              geometry is cached then the memoized
+ *                              hypocentral distances are used.
+ *
+ * @param[in,out] pdState       if not NULL then this is the event's
+ *                              incremental peak displacement state.
+ * @param[in,out] offState      if not NULL then this is the event's running
+ *                              offset state.  the CMT and FF use the
+ *                              windows matching their window velocities.
+ * @param[in,out] pgd_data      on input holds a logical mask if a site is to
+ *                              be ignored.
+ *                              on output holds the peak ground displacement
+ *                              at each site satisfying the S velocity window
+ *                              mask.
+ * @param[in,out] cmt_data      on input holds a logical mask if a site is to
+ *                              be ignored.
+ *                              on output holds the average offsets for the
+ *                              CMT inversion.
+ * @param[in,out] ff_data       on input holds a logical mask if a site is to
+ *                              be ignored.
+ *                              on output holds the average offsets for the
+ *                              finite fault inversion.
+ *
+ * @param[out] nsites_pgd       number of sites with a peak displacement
+ * @param[out] nsites_cmt       number of sites with a CMT offset
+ * @param[out] nsites_ff        number of sites with a finite fault offset
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_waveformProcessor_peakDisplacementAndOffsets(
+    const struct GFAST_pgd_props_struct pgd_props,
+    const struct GFAST_cmt_props_struct cmt_props,
+    const struct GFAST_ff_props_struct ff_props,
+    const double ev_lat,
+    const double ev_lon,
+    const double ev_dep,
+    const double ev_time,
+    struct GFAST_data_struct gps_data,
+    struct GFAST_peakDisplacementState_struct *pdState,
+    struct GFAST_offsetState_struct *offState,
+    struct GFAST_peakDisplacementData_struct *pgd_data,
+    struct GFAST_offsetData_struct *cmt_data,
+    struct GFAST_offsetData_struct *ff_data,
+    int *nsites_pgd, int *nsites_cmt, int *nsites_ff)
+{
+    struct GFAST_offsetData_struct *odata[2];
+    const struct GFAST_hypoDistance_struct *hd[3];
+    double dist[3], eOffset[2], nOffset[2], svel[3], swave[2], uOffset[2],
+           x1[3], x2[3], y1[3], y2[3], currentTime, dt, epoch, peakDisp;
+    int iw[2], iwin[2], map[2], zone[3], zoneIn[3],
+        ic, ierr, jc, k, noff, npts, zone_loc;
+    bool lactive[3], lnorthp;
+    //------------------------------------------------------------------------//
+    //
+    // Error handling
+    ierr = 0;
+    *nsites_pgd = 0;
+    *nsites_cmt = 0;
+    *nsites_ff = 0;
+    odata[0] = cmt_data;
+    odata[1] = ff_data;
+    for (ic=0; ic<2; ic++)
+    {
+        if (odata[ic]->ubuff == NULL || odata[ic]->nbuff == NULL ||
+            odata[ic]->ebuff == NULL || odata[ic]->wtu == NULL ||
+            odata[ic]->wtn == NULL || odata[ic]->wte == NULL ||
+            odata[ic]->lactive == NULL)
+        {
+            LOG_ERRMSG("%s", "Error offset_data pointers not initialized");
+            return -1;
+        }
+    }
+    if (gps_data.stream_length != pgd_data->nsites ||
+        gps_data.stream_length != cmt_data->nsites ||
+        gps_data.stream_length != ff_data->nsites)
+    {
+        LOG_ERRMSG("Inconsistent structure sizes %d %d %d %d",
+                   gps_data.stream_length, pgd_data->nsites,
+                   cmt_data->nsites, ff_data->nsites);
+        // For safety cut the inversions off at the knees
+        for (k=0; k<pgd_data->nsites; k++)
+        {
+            nullPeakDisplacementSite(k, pgd_data);
+        }
+        for (ic=0; ic<2; ic++)
+        {
+            for (k=0; k<odata[ic]->nsites; k++)
+            {
+                nullOffsetSite(k, odata[ic]);
+            }
+        }
+        return -1;
+    }
+    if ((pdState != NULL && pdState->nsites != gps_data.stream_length) ||
+        (offState != NULL && offState->nsites != gps_data.stream_length))
+    {
+        LOG_ERRMSG("%s", "Inconsistent state sizes");
+        return -1;
+    }
+    // Find the running sums for the CMT and FF.  If both share a window
+    // velocity but only one window exists then the FF is computed in full.
+    iwin[0] = getWindow(cmt_props.window_vel, -1, offState);
+    iwin[1] = getWindow(ff_props.window_vel, iwin[0], offState);
+    // Get the source location in each distinct UTM zone
+    zone[0] = pgd_props.utm_zone;
+    zone[1] = cmt_props.utm_zone;
+    zone[2] = ff_props.utm_zone;
+    svel[0] = pgd_props.window_vel;
+    svel[1] = cmt_props.window_vel;
+    svel[2] = ff_props.window_vel;
+    for (jc=0; jc<3; jc++)
+    {
+        if (zone[jc] ==-12345){zone[jc] =-1;} // UTM zone from source lat/lon
+        zoneIn[jc] = zone[jc];
+        if (jc > 0 && zoneIn[jc] == zoneIn[0])
+        {
+            zone[jc] = zone[0];
+            y1[jc] = y1[0];
+            x1[jc] = x1[0];
+            continue;
+        }
+        if (jc > 1 && zoneIn[jc] == zoneIn[1])
+        {
+            zone[jc] = zone[1];
+            y1[jc] = y1[1];
+            x1[jc] = x1[1];
+            continue;
+        }
+        GFAST_core_coordtools_ll2utm(ev_lat, ev_lon,
+                                     &y1[jc], &x1[jc],
+                                     &lnorthp, &zone[jc]);
+    }
+    // Look up the memoized hypocentral distances
+    for (jc=0; jc<3; jc++)
+    {
+        hd[jc] = NULL;
+        if (gps_data.geometry == NULL){continue;}
+        hd[jc] = GFAST_core_data_getHypocentralDistances(gps_data,
+                                                         ev_lat, ev_lon,
+                                                         ev_dep, zoneIn[jc],
+                                                         &ierr);
+        if (ierr != 0){hd[jc] = NULL;}
+        ierr = 0;
+    }
+    // Loop on streams
+    for (k=0; k<gps_data.stream_length; k++)
+    {
+        // Make sure I have the latest/greatest site location and null out
+        // the results
+        pgd_data->sta_lat[k] = gps_data.data[k].sta_lat;
+        pgd_data->sta_lon[k] = gps_data.data[k].sta_lon;
+        pgd_data->sta_alt[k] = gps_data.data[k].sta_alt;
+        nullPeakDisplacementSite(k, pgd_data);
+        for (ic=0; ic<2; ic++)
+        {
+            odata[ic]->sta_lat[k] = gps_data.data[k].sta_lat;
+            odata[ic]->sta_lon[k] = gps_data.data[k].sta_lon;
+            odata[ic]->sta_alt[k] = gps_data.data[k].sta_alt;
+            nullOffsetSite(k, odata[ic]);
+        }
+        lactive[0] = !pgd_data->lmask[k];
+        lactive[1] = !cmt_data->lmask[k];
+        lactive[2] = !ff_data->lmask[k];
+        if (!lactive[0] && !lactive[1] && !lactive[2]){continue;}
+        // Get the distances - remember source is + down and receiver is + up
+        for (jc=0; jc<3; jc++)
+        {
+            if (hd[jc] != NULL)
+            {
+                dist[jc] = hd[jc]->distance[k];
+                continue;
+            }
+            if (jc > 0 && zoneIn[jc] == zoneIn[0])
+            {
+                dist[jc] = dist[0];
+                continue;
+            }
+            if (jc > 1 && zoneIn[jc] == zoneIn[1])
+            {
+                dist[jc] = dist[1];
+                continue;
+            }
+            zone_loc = zone[jc];
+            GFAST_core_coordtools_ll2utm(gps_data.data[k].sta_lat,
+                                         gps_data.data[k].sta_lon,
+                                         &y2[jc], &x2[jc],
+                                         &lnorthp, &zone_loc);
+            dist[jc] = sqrt( pow(x1[jc] - x2[jc], 2)
+                           + pow(y1[jc] - y2[jc], 2)
+                           + pow(ev_dep*1000.0 + gps_data.data[k].sta_alt, 2));
+            dist[jc] = dist[jc]*1.e-3; // convert to km
+        }
+        // Apply the S wave window masks
+        npts = gps_data.data[k].npts;
+        dt = gps_data.data[k].dt;
+        epoch = gps_data.data[k].tbuff[0];
+        currentTime = epoch + (npts - 1)*dt;
+        for (jc=0; jc<3; jc++)
+        {
+            if (lactive[jc] && dist[jc] >= (currentTime - ev_time)*svel[jc])
+            {
+                lactive[jc] = false;
+            }
+        }
+        if (!lactive[0] && !lactive[1] && !lactive[2]){continue;}
+        // Compute the peak displacement and the active offsets in one
+        // pass over the buffers
+        noff = 0;
+        for (ic=0; ic<2; ic++)
+        {
+            if (!lactive[ic+1]){continue;}
+            swave[noff] = ev_time + dist[ic+1]/svel[ic+1];
+            iw[noff] = iwin[ic];
+            map[noff] = ic;
+            noff = noff + 1;
+        }
+        ierr = core_waveformProcessor_updateSite(k, ev_time,
+                                                 &gps_data.data[k],
+                                                 lactive[0], noff, swave, iw,
+                                                 pdState, offState,
+                                                 &peakDisp,
+                                                 uOffset, nOffset, eOffset);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("Error updating site %d", k);
+            return -1;
+        }
+        // Save the peak displacement
+        if (!isnan(peakDisp))
+        {
+            pgd_data->pd[k] = peakDisp; // meters
+            pgd_data->wt[k] = 1.0;
+            pgd_data->lactive[k] = true;
+            *nsites_pgd = *nsites_pgd + 1;
+        }
+        // Save the offsets
+        for (jc=0; jc<noff; jc++)
+        {
+            if (isnan(uOffset[jc]) || isnan(nOffset[jc]) ||
+                isnan(eOffset[jc]))
+            {
+                continue;
+            }
+            ic = map[jc];
+            odata[ic]->ubuff[k] = uOffset[jc]; // meters
+            odata[ic]->nbuff[k] = nOffset[jc];
+            odata[ic]->ebuff[k] = eOffset[jc];
+            odata[ic]->wtu[k] = 1.0;
+            odata[ic]->wtn[k] = 1.0;
+            odata[ic]->wte[k] = 1.0;
+            odata[ic]->lactive[k] = true;
+        }
+        if (cmt_data->lactive[k]){*nsites_cmt = *nsites_cmt + 1;}
+        if (ff_data->lactive[k]){*nsites_ff = *nsites_ff + 1;}
+    } // Loop on data streams
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Nulls out the k'th site's peak displacement.
+ */
+static void nullPeakDisplacementSite(
+    const int k, struct GFAST_peakDisplacementData_struct *data)
+{
+    data->pd[k] = 0.0;
+    data->wt[k] = 0.0;
+    data->lactive[k] = false;
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Nulls out the k'th site's offsets.
+ */
+static void nullOffsetSite(const int k, struct GFAST_offsetData_struct *data)
+{
+    data->ubuff[k] = 0.0;
+    data->nbuff[k] = 0.0;
+    data->ebuff[k] = 0.0;
+    data->wtu[k] = 0.0;
+    data->wtn[k] = 0.0;
+    data->wte[k] = 0.0;
+    data->lactive[k] = false;
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Finds the running offset window with the given velocity that
+ *        isn't the iskip'th window.
+ *
+ * @result the window index or -1 if there is no such window
+ */
+static int getWindow(const double svel_window, const int iskip,
+                     const struct GFAST_offsetState_struct *offState)
+{
+    int j;
+    if (offState == NULL){return -1;}
+    for (j=0; j<offState->nwin; j++)
+    {
+        if (j != iskip && fabs(offState->svel[j] - svel_window) < 1.e-10)
+        {
+            return j;
+        }
+    }
+    return -1;
+}
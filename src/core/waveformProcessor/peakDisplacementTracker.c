@@ -0,0 +1,210 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+#include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
+
+static void freeState(struct GFAST_peakDisplacementState_struct *state);
+static int resetState(const double ev_time, const int nsites,
+                      struct GFAST_peakDisplacementState_struct *state);
+
+/*!
+ * @brief Returns the incremental peak displacement state for the given
+ *        event.  If the event is new then a state is created.  If the
+ *        origin time or number of sites changed then the state is reset
+ *        so that the peak displacement is recomputed from the origin.
+ *
+ * @param[in] SA           shakeAlert event whose state is desired
+ * @param[in] nsites       number of GPS sites
+ *
+ * @param[in,out] tracker  on input holds the states of the active events
+ *                         and the latency given to them.
+ *                         on output holds a valid state for SA.
+ *
+ * @param[out] ierr        0 indicates success
+ *
+ * @result pointer to the event's state in the tracker.  NULL if an error
+ *         occurred.  the pointer is invalidated by subsequent calls to
+ *         this function or to the prune function.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+struct GFAST_peakDisplacementState_struct *
+    core_waveformProcessor_getPeakDisplacementState(
+    struct GFAST_shakeAlert_struct SA,
+    const int nsites,
+    struct GFAST_peakDisplacementTracker_struct *tracker,
+    int *ierr)
+{
+    struct GFAST_peakDisplacementState_struct *states;
+    int i;
+    //------------------------------------------------------------------------//
+    *ierr = 0;
+    for (i=0; i<tracker->nstates; i++)
+    {
+        if (strcasecmp(tracker->states[i].eventid, SA.eventid) == 0)
+        {
+            if (fabs(tracker->states[i].ev_time - SA.time) > 1.e-5 ||
+                tracker->states[i].nsites != nsites)
+            {
+                *ierr = resetState(SA.time, nsites, &tracker->states[i]);
+                if (*ierr != 0){return NULL;}
+            }
+            tracker->states[i].latency = tracker->latency;
+            return &tracker->states[i];
+        }
+    }
+    // New event - append a state
+    states = (struct GFAST_peakDisplacementState_struct *)
+             calloc((size_t) (tracker->nstates + 1),
+                    sizeof(struct GFAST_peakDisplacementState_struct));
+    if (tracker->nstates > 0)
+    {
+        memcpy(states, tracker->states,
+               (size_t) tracker->nstates
+              *sizeof(struct GFAST_peakDisplacementState_struct));
+    }
+    free(tracker->states);
+    tracker->states = states;
+    i = tracker->nstates;
+    tracker->nstates = tracker->nstates + 1;
+    strncpy(tracker->states[i].eventid, SA.eventid,
+            sizeof(tracker->states[i].eventid) - 1);
+    *ierr = resetState(SA.time, nsites, &tracker->states[i]);
+    if (*ierr != 0)
+    {
+        LOG_ERRMSG("Error creating state for %s", SA.eventid);
+        return NULL;
+    }
+    tracker->states[i].latency = tracker->latency;
+    return &tracker->states[i];
+}
+//============================================================================//
+/*!
+ * @brief Removes the states of events that are no longer in the active
+ *        events list.
+ *
+ * @param[in] events       the active events list
+ *
+ * @param[in,out] tracker  on input holds the peak displacement states.
+ *                         on output states of expired or cancelled events
+ *                         have been freed.
+ *
+ * @result the number of states removed
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_waveformProcessor_prunePeakDisplacementStates(
+    struct GFAST_activeEvents_struct events,
+    struct GFAST_peakDisplacementTracker_struct *tracker)
+{
+    int i, iev, j, nrem;
+    bool lfound;
+    //------------------------------------------------------------------------//
+    nrem = 0;
+    j = 0;
+    for (i=0; i<tracker->nstates; i++)
+    {
+        lfound = false;
+        for (iev=0; iev<events.nev; iev++)
+        {
+            if (strcasecmp(tracker->states[i].eventid,
+                           events.SA[iev].eventid) == 0)
+            {
+                lfound = true;
+                break;
+            }
+        }
+        if (!lfound)
+        {
+            freeState(&tracker->states[i]);
+            nrem = nrem + 1;
+            continue;
+        }
+        if (j != i)
+        {
+            memcpy(&tracker->states[j], &tracker->states[i],
+                   sizeof(struct GFAST_peakDisplacementState_struct));
+        }
+        j = j + 1;
+    }
+    tracker->nstates = j;
+    if (tracker->nstates == 0)
+    {
+        free(tracker->states);
+        tracker->states = NULL;
+    }
+    return nrem;
+}
+//============================================================================//
+/*!
+ * @brief Frees the peak displacement tracker.
+ *
+ * @param[in,out] tracker  on input holds the peak displacement states.
+ *                         on output all memory has been released.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+void core_waveformProcessor_finalizePeakDisplacementTracker(
+    struct GFAST_peakDisplacementTracker_struct *tracker)
+{
+    int i;
+    for (i=0; i<tracker->nstates; i++)
+    {
+        freeState(&tracker->states[i]);
+    }
+    free(tracker->states);
+    memset(tracker, 0, sizeof(struct GFAST_peakDisplacementTracker_struct));
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Resets the state so that the peak displacement will be computed
+ *        anew from the origin time.
+ */
+static int resetState(const double ev_time, const int nsites,
+                      struct GFAST_peakDisplacementState_struct *state)
+{
+    if (nsites < 1)
+    {
+        LOG_ERRMSG("Invalid number of sites %d", nsites);
+        return -1;
+    }
+    if (state->nsites != nsites)
+    {
+        freeState(state);
+        state->peakDisp = memory_calloc64f(nsites);
+        state->u0 = memory_calloc64f(nsites);
+        state->n0 = memory_calloc64f(nsites);
+        state->e0 = memory_calloc64f(nsites);
+        state->tnext = memory_calloc64f(nsites);
+        state->nsites = nsites;
+    }
+    array_set64f_work(nsites, (double) NAN, state->peakDisp);
+    array_set64f_work(nsites, (double) NAN, state->u0);
+    array_set64f_work(nsites, (double) NAN, state->n0);
+    array_set64f_work(nsites, (double) NAN, state->e0);
+    array_set64f_work(nsites, ev_time, state->tnext);
+    state->ev_time = ev_time;
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Releases the arrays on the state but retains the event ID.
+ */
+static void freeState(struct GFAST_peakDisplacementState_struct *state)
+{
+    memory_free64f(&state->peakDisp);
+    memory_free64f(&state->u0);
+    memory_free64f(&state->n0);
+    memory_free64f(&state->e0);
+    memory_free64f(&state->tnext);
+    state->nsites = 0;
+    return;
+}
@@ -0,0 +1,332 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h>
+#include <math.h>
+#include "gfast_core.h"
+
+#ifndef MAX
+#define MAX(x,y) (((x) > (y)) ? (x) : (y))
+#endif
+#ifndef MIN
+#define MIN(x,y) (((x) < (y)) ? (x) : (y))
+#endif
+#define NOFF_MAX 2 /*!< Max number of offset windows (CMT and FF) */
+
+/*!
+ * @brief Computes the peak displacement and the average offsets at a site
+ *        in one pass over the site's buffers.  This is the per-site update
+ *        shared by core_waveformProcessor_peakDisplacement,
+ *        core_waveformProcessor_offset, and
+ *        core_waveformProcessor_peakDisplacementAndOffsets.
+ *
+ *        The peak displacement is the maximum of the Euclidean norm of
+ *        the displacement from the position at the origin time.  The
+ *        average offsets are the mean displacements from the S wave time
+ *        to the end of the buffer.  If the running states are given then
+ *        only the samples from the first unknown sample of the previous
+ *        call are visited.  Known samples after an unknown sample are used
+ *        in this call's averages but are held out of the running sums so
+ *        that a gap back-filled by a late packet is not missed.  Unknown
+ *        samples older than the state's latency are taken to be missing
+ *        for good so that a permanent gap does not pin the next sample.
+ *
+ * @param[in] k             site index in the running states
+ * @param[in] ev_time       source origin time in seconds since epoch (UTC)
+ * @param[in] data          precise point positions at this site
+ * @param[in] lpgd          if true then compute the peak displacement
+ * @param[in] noff          number of offset windows to compute.  this
+ *                          cannot exceed 2.
+ * @param[in] swave         epochal S wave time (UTC) of each offset
+ *                          window [noff]
+ * @param[in] iwin          index of each offset window in offState or -1
+ *                          if the window has no running sums [noff]
+ *
+ * @param[in,out] pdState   if not NULL then the event's incremental peak
+ *                          displacement state.  on output the k'th site
+ *                          includes the new samples.
+ * @param[in,out] offState  if not NULL then the event's running offset
+ *                          state.  on output the k'th site of the windows
+ *                          in iwin include the new samples.
+ *
+ * @param[out] peakDisp     peak displacement (meters).  NaN if it was not
+ *                          requested or cannot be computed.
+ * @param[out] uOffset      up offset (meters) in each window.  NaN if it
+ *                          cannot be computed [noff]
+ * @param[out] nOffset      north offset (meters) in each window [noff]
+ * @param[out] eOffset      east offset (meters) in each window [noff]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+int core_waveformProcessor_updateSite(
+    const int k,
+    const double ev_time,
+    const struct GFAST_waveform3CData_struct *data,
+    const bool lpgd,
+    const int noff,
+    const double *__restrict__ swave,
+    const int *__restrict__ iwin,
+    struct GFAST_peakDisplacementState_struct *pdState,
+    struct GFAST_offsetState_struct *offState,
+    double *peakDisp,
+    double *__restrict__ uOffset,
+    double *__restrict__ nOffset,
+    double *__restrict__ eOffset)
+{
+    const double *__restrict__ ebuff;
+    const double *__restrict__ nbuff;
+    const double *__restrict__ ubuff;
+    double ro[3], rp[3], sum[NOFF_MAX][3], tail[NOFF_MAX][3],
+           de, dn, dt, du, epoch, pd2;
+    int igap[NOFF_MAX], ioff[NOFF_MAX], nsum[NOFF_MAX], ntail[NOFF_MAX],
+        i, i1, ic, igapPd, ilate, indx0, indxS, ipgd, j, n, npts;
+    bool lpdState, loffsets, loffState, lref, lstate;
+    //------------------------------------------------------------------------//
+    //
+    // Error handling
+    *peakDisp = (double) NAN;
+    for (i=0; i<3; i++)
+    {
+        ro[i] = 0.0;
+        rp[i] = 0.0;
+    }
+    if (noff < 0 || noff > NOFF_MAX)
+    {
+        LOG_ERRMSG("Invalid number of offset windows %d", noff);
+        return -1;
+    }
+    for (ic=0; ic<noff; ic++)
+    {
+        uOffset[ic] = (double) NAN;
+        nOffset[ic] = (double) NAN;
+        eOffset[ic] = (double) NAN;
+        if (iwin[ic] >= 0 && offState == NULL)
+        {
+            LOG_ERRMSG("%s", "Error offState is NULL");
+            return -1;
+        }
+    }
+    npts = data->npts;
+    if (npts < 1 || (!lpgd && noff == 0)){return 0;}
+    dt = data->dt;
+    epoch = data->tbuff[0];
+    ubuff = data->ubuff;
+    nbuff = data->nbuff;
+    ebuff = data->ebuff;
+    // Get the index of the origin
+    indx0 = MAX(0, (int) ((ev_time - epoch)/dt + 0.5));
+    lstate = true;
+    if (indx0 > npts - 1)
+    {
+        // Origin isn't in the buffer yet so don't commit to a reference
+        indx0 = npts - 1;
+        lstate = false;
+    }
+    lref = !isnan(ubuff[indx0]) && !isnan(nbuff[indx0]) &&
+           !isnan(ebuff[indx0]);
+    // Offsets require the trace to begin before the origin
+    loffsets = noff > 0;
+    if (loffsets && epoch > ev_time)
+    {
+        LOG_WARNMSG("%s",
+                    "Warning trace start-time is after event origint time");
+        loffsets = false;
+    }
+    // Set the reference position, starting sample, and accumulator of the
+    // peak displacement.  A running state keeps the position it locked in.
+    ipgd = npts;
+    igapPd = npts;
+    pd2 =-1.0;
+    lpdState = lpgd && pdState != NULL && lstate;
+    if (lpdState && !isnan(pdState->u0[k]) && !isnan(pdState->n0[k]) &&
+        !isnan(pdState->e0[k]))
+    {
+        rp[0] = pdState->u0[k];
+        rp[1] = pdState->n0[k];
+        rp[2] = pdState->e0[k];
+        ipgd = MAX(indx0, (int) ((pdState->tnext[k] - epoch)/dt + 0.5));
+        if (!isnan(pdState->peakDisp[k]))
+        {
+            pd2 = pdState->peakDisp[k]*pdState->peakDisp[k];
+        }
+    }
+    else if (lpgd && lref)
+    {
+        rp[0] = ubuff[indx0];
+        rp[1] = nbuff[indx0];
+        rp[2] = ebuff[indx0];
+        ipgd = indx0;
+        if (lpdState)
+        {
+            pdState->u0[k] = rp[0];
+            pdState->n0[k] = rp[1];
+            pdState->e0[k] = rp[2];
+            pdState->peakDisp[k] = (double) NAN;
+            pdState->tnext[k] = epoch + (double) indx0*dt;
+        }
+    }
+    else
+    {
+        lpdState = false;
+    }
+    // Set the reference position of the offsets
+    loffState = false;
+    for (ic=0; ic<noff; ic++)
+    {
+        if (loffsets && iwin[ic] >= 0 && lstate){loffState = true;}
+    }
+    if (loffState && !isnan(offState->u0[k]) && !isnan(offState->n0[k]) &&
+        !isnan(offState->e0[k]))
+    {
+        ro[0] = offState->u0[k];
+        ro[1] = offState->n0[k];
+        ro[2] = offState->e0[k];
+    }
+    else if (loffsets && lref)
+    {
+        ro[0] = ubuff[indx0];
+        ro[1] = nbuff[indx0];
+        ro[2] = ebuff[indx0];
+        if (loffState)
+        {
+            offState->u0[k] = ro[0];
+            offState->n0[k] = ro[1];
+            offState->e0[k] = ro[2];
+            for (i=0; i<offState->nwin; i++)
+            {
+                offState->tstart[i*offState->nsites + k] = (double) NAN;
+            }
+        }
+    }
+    else
+    {
+        loffsets = false;
+    }
+    // Set the starting samples and accumulators of the offsets
+    for (ic=0; ic<noff; ic++)
+    {
+        ioff[ic] = npts;
+        igap[ic] = npts;
+        sum[ic][0] = 0.0;
+        sum[ic][1] = 0.0;
+        sum[ic][2] = 0.0;
+        nsum[ic] = 0;
+        tail[ic][0] = 0.0;
+        tail[ic][1] = 0.0;
+        tail[ic][2] = 0.0;
+        ntail[ic] = 0;
+        if (!loffsets){continue;}
+        indxS = MAX(0, (int) ((swave[ic] - epoch)/dt + 0.5));
+        indxS = MIN(npts - 1, indxS);
+        ioff[ic] = indxS;
+        if (iwin[ic] < 0 || !lstate){continue;}
+        // (Re)start the sums at the S wave
+        j = iwin[ic]*offState->nsites + k;
+        if (isnan(offState->tstart[j]) ||
+            fabs(offState->tstart[j] - swave[ic]) > 1.e-5)
+        {
+            offState->tstart[j] = swave[ic];
+            offState->tnext[j] = epoch + (double) indxS*dt;
+            offState->uSum[j] = 0.0;
+            offState->nSum[j] = 0.0;
+            offState->eSum[j] = 0.0;
+            offState->nsum[j] = 0;
+        }
+        ioff[ic] = MAX(0, (int) ((offState->tnext[j] - epoch)/dt + 0.5));
+        sum[ic][0] = offState->uSum[j];
+        sum[ic][1] = offState->nSum[j];
+        sum[ic][2] = offState->eSum[j];
+        nsum[ic] = offState->nsum[j];
+    }
+    // Unknown samples before ilate are committed as missing
+    ilate = 0;
+    if (lpdState && pdState->latency > 0.0)
+    {
+        ilate = MAX(0, npts - (int) (pdState->latency/dt + 0.5));
+    }
+    if (loffState && offState->latency > 0.0)
+    {
+        ilate = MAX(ilate, npts - (int) (offState->latency/dt + 0.5));
+    }
+    // Walk the new samples once for all products
+    i1 = ipgd;
+    for (ic=0; ic<noff; ic++){i1 = MIN(i1, ioff[ic]);}
+    for (i=i1; i<npts; i++)
+    {
+        if (isnan(ubuff[i]) || isnan(nbuff[i]) || isnan(ebuff[i]))
+        {
+            // Revisit the unknown samples next time since they may yet
+            // arrive
+            if (i < ilate){continue;}
+            if (i >= ipgd){igapPd = MIN(i, igapPd);}
+            for (ic=0; ic<noff; ic++)
+            {
+                if (i >= ioff[ic]){igap[ic] = MIN(i, igap[ic]);}
+            }
+            continue;
+        }
+        if (i >= ipgd)
+        {
+            du = ubuff[i] - rp[0];
+            dn = nbuff[i] - rp[1];
+            de = ebuff[i] - rp[2];
+            pd2 = fmax(du*du + dn*dn + de*de, pd2);
+        }
+        du = ubuff[i] - ro[0];
+        dn = nbuff[i] - ro[1];
+        de = ebuff[i] - ro[2];
+        // Samples after a gap are held out of the running sums
+        for (ic=0; ic<noff; ic++)
+        {
+            if (i < ioff[ic]){continue;}
+            if (i < igap[ic])
+            {
+                sum[ic][0] = sum[ic][0] + du;
+                sum[ic][1] = sum[ic][1] + dn;
+                sum[ic][2] = sum[ic][2] + de;
+                nsum[ic] = nsum[ic] + 1;
+            }
+            else
+            {
+                tail[ic][0] = tail[ic][0] + du;
+                tail[ic][1] = tail[ic][1] + dn;
+                tail[ic][2] = tail[ic][2] + de;
+                ntail[ic] = ntail[ic] + 1;
+            }
+        }
+    }
+    // Save the peak displacement
+    if (lpdState)
+    {
+        if (pd2 >= 0.0){pdState->peakDisp[k] = sqrt(pd2);}
+        if (ipgd < npts){pdState->tnext[k] = epoch + (double) igapPd*dt;}
+    }
+    if (pd2 >= 0.0){*peakDisp = sqrt(pd2);}
+    // Save the offsets
+    for (ic=0; ic<noff; ic++)
+    {
+        if (!loffsets){continue;}
+        if (iwin[ic] >= 0 && lstate)
+        {
+            j = iwin[ic]*offState->nsites + k;
+            offState->uSum[j] = sum[ic][0];
+            offState->nSum[j] = sum[ic][1];
+            offState->eSum[j] = sum[ic][2];
+            offState->nsum[j] = nsum[ic];
+            if (ioff[ic] < npts)
+            {
+                offState->tnext[j] = epoch + (double) igap[ic]*dt;
+            }
+        }
+        n = nsum[ic] + ntail[ic];
+        if (n > 0)
+        {
+            uOffset[ic] = (sum[ic][0] + tail[ic][0])/(double) n;
+            nOffset[ic] = (sum[ic][1] + tail[ic][1])/(double) n;
+            eOffset[ic] = (sum[ic][2] + tail[ic][2])/(double) n;
+        }
+    }
+    return 0;
+}
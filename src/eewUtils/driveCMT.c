@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <math.h>
+#include <float.h>
 #include "gfast_eewUtils.h"
 #include <stdbool.h>
 #include "gfast_core.h"
@@ -9,6 +10,27 @@
 
 static int __verify_cmt_structs(struct GFAST_offsetData_struct cmt_data,
                                 struct GFAST_cmtResults_struct *cmt);
+static int __adaptiveDepthSearch(struct GFAST_cmt_props_struct cmt_props,
+                                 const int l1,
+                                 const double utmSrcEasting,
+                                 const double utmSrcNorthing,
+                                 const double *__restrict__ utmRecvEasting,
+                                 const double *__restrict__ utmRecvNorthing,
+                                 const double *__restrict__ staAlt,
+                                 const double *__restrict__ nOffset,
+                                 const double *__restrict__ eOffset,
+                                 const double *__restrict__ uOffset,
+                                 const double *__restrict__ nWts,
+                                 const double *__restrict__ eWts,
+                                 const double *__restrict__ uWts,
+                                 struct GFAST_cmtResults_struct *cmt,
+                                 bool *__restrict__ lsearched,
+                                 double *__restrict__ nEst,
+                                 double *__restrict__ eEst,
+                                 double *__restrict__ uEst);
+static int __decomposeSearched(const int nlld,
+                               const bool *__restrict__ lsearched,
+                               struct GFAST_cmtResults_struct *cmt);
 
 /*!
  * @brief Drives the CMT estimation.
@@ -17,13 +39,18 @@ static int __verify_cmt_structs(struct GFAST_offsetData_struct cmt_data,
  * @param[in] SA_lat     event latitude (degrees) [-90,90]
  * @param[in] SA_lon     event longitude (degrees) [0,360]
  * @param[in] SA_dep     event depth (km)
+ * @param[in] geometry   cached station UTM coordinates.  if NULL then the
+ *                       receiver UTM coordinates are computed.
  * @param[in] cmt_data   cmt offset data to invert
  *
  * @param[in,out] cmt    on input contains the depths for the grid search
  *                       on output contains the corresponding variance
  *                       reduction, moment tensors, nodal planes at each
  *                       depth in the CMT grid search, and optimal depth
- *                       index.
+ *                       index.  if cmt_props.ladaptive is true then only
+ *                       the depths visited by the adaptive search are
+ *                       set.  the other depths are zero with an objective
+ *                       function of DBL_MAX.
  *
  * @result 0 indicates success
  *         1 indicates an error on the cmt structure
@@ -38,20 +65,22 @@ int eewUtils_driveCMT(struct GFAST_cmt_props_struct cmt_props,
                       const double SA_lat,
                       const double SA_lon,
                       const double SA_dep,
+                      const struct GFAST_stationGeometry_struct *geometry,
                       struct GFAST_offsetData_struct cmt_data,
                       struct GFAST_cmtResults_struct *cmt)
 {
     double *utmRecvEasting, *utmRecvNorthing, *staAlt,
            *eOffset, *eEst, *eWts, *nOffset, *nEst, *nWts,
            *uOffset, *uEst, *uWts,
-           DC_pct, eres, nres, sum_res2, ures,
+           eres, nres, sum_res2, ures,
            utmSrcEasting, utmSrcNorthing, wte, wtn, wtu, x1, y1, x2, y2;
-    int i, idep, ierr, ierr1, ilat, ilon, indx, k, l1, nlld, zone_loc;
-    bool *luse, lnorthp;
+    int i, ierr, indx, k, l1, nlld, zone_loc;
+    bool *lsearched, *luse, lnorthp;
     //------------------------------------------------------------------------//
     //
     // Verify the input data structure makes sense
     ierr = CMT_SUCCESS;
+    lsearched = NULL;
     luse = NULL;
     utmRecvEasting = NULL;
     utmRecvNorthing = NULL;
@@ -145,6 +174,7 @@ int eewUtils_driveCMT(struct GFAST_cmt_props_struct cmt_props,
     nEst    = memory_calloc64f(l1*cmt->ndeps);
     eEst    = memory_calloc64f(l1*cmt->ndeps);
     uEst    = memory_calloc64f(l1*cmt->ndeps);
+    lsearched = memory_calloc8l(nlld);
     // Get the source location
     zone_loc = cmt_props.utm_zone; // Use input UTM zone
     if (zone_loc ==-12345){zone_loc =-1;} // Figure it out
@@ -159,10 +189,10 @@ int eewUtils_driveCMT(struct GFAST_cmt_props_struct cmt_props,
     {
         if (!luse[k]){continue;}
         // Get the recevier UTM
-        core_coordtools_ll2utm(cmt_data.sta_lat[k],
-                               cmt_data.sta_lon[k],
-                               &y2, &x2,
-                               &lnorthp, &zone_loc);
+        core_data_getSiteUTM(geometry, k,
+                             cmt_data.sta_lat[k],
+                             cmt_data.sta_lon[k],
+                             zone_loc, &y2, &x2);
         // Copy the pertinent data
         uOffset[l1] = cmt_data.ubuff[k];
         nOffset[l1] = cmt_data.nbuff[k];
@@ -180,26 +210,73 @@ int eewUtils_driveCMT(struct GFAST_cmt_props_struct cmt_props,
     { 
         LOG_DEBUGMSG("Inverting for CMT with %d sites", l1);
     }
-    ierr = core_cmt_gridSearch(l1,
-                               cmt->ndeps, cmt->nlats, cmt->nlons,
-                               cmt_props.verbose,
-                               cmt_props.ldeviatoric,
-                               &utmSrcEasting,
-                               &utmSrcNorthing,
-                               cmt->srcDepths,
-                               utmRecvEasting,
-                               utmRecvNorthing,
-                               staAlt,
-                               nOffset,
-                               eOffset,
-                               uOffset,
-                               nWts,
-                               eWts,
-                               uWts,
-                               nEst,
-                               eEst,
-                               uEst,
-                               cmt->mts);
+    for (indx=0; indx<nlld; indx++){lsearched[indx] = true;}
+    if (cmt_props.ladaptive)
+    {
+        ierr = __adaptiveDepthSearch(cmt_props, l1,
+                                     utmSrcEasting,
+                                     utmSrcNorthing,
+                                     utmRecvEasting,
+                                     utmRecvNorthing,
+                                     staAlt,
+                                     nOffset,
+                                     eOffset,
+                                     uOffset,
+                                     nWts,
+                                     eWts,
+                                     uWts,
+                                     cmt, lsearched,
+                                     nEst,
+                                     eEst,
+                                     uEst);
+    }
+    else if (cmt->greens != NULL)
+    {
+        ierr = core_cmt_cachedDepthGridSearch(cmt->greens,
+                                              cmt_data.nsites, luse,
+                                              l1, cmt->ndeps,
+                                              cmt_props.verbose,
+                                              cmt_props.ldeviatoric,
+                                              utmSrcEasting,
+                                              utmSrcNorthing,
+                                              cmt->srcDepths,
+                                              utmRecvEasting,
+                                              utmRecvNorthing,
+                                              staAlt,
+                                              nOffset,
+                                              eOffset,
+                                              uOffset,
+                                              nWts,
+                                              eWts,
+                                              uWts,
+                                              nEst,
+                                              eEst,
+                                              uEst,
+                                              cmt->mts);
+    }
+    else
+    {
+        ierr = core_cmt_gridSearch(l1,
+                                   cmt->ndeps, cmt->nlats, cmt->nlons,
+                                   cmt_props.verbose,
+                                   cmt_props.ldeviatoric,
+                                   &utmSrcEasting,
+                                   &utmSrcNorthing,
+                                   cmt->srcDepths,
+                                   utmRecvEasting,
+                                   utmRecvNorthing,
+                                   staAlt,
+                                   nOffset,
+                                   eOffset,
+                                   uOffset,
+                                   nWts,
+                                   eWts,
+                                   uWts,
+                                   nEst,
+                                   eEst,
+                                   uEst,
+                                   cmt->mts);
+    }
 /*
     ierr = core_cmt_depthGridSearch(l1, cmt->ndeps,
                                     cmt_props.verbose,
@@ -239,75 +316,71 @@ int eewUtils_driveCMT(struct GFAST_cmt_props_struct cmt_props,
         cmt->lsiteUsed[k] = true;
         i = i + 1;
     }
-    // Extract results and weight objective fn by percent double couple
-    ierr = 0;
+    // Compute the residual norms and save the estimates at each grid point
 #ifdef PARALLEL_CMT
-    #pragma omp parallel for collapse(3) \
-     private(DC_pct, eres, i, idep, ierr1, ilat, ilon, indx, k, sum_res2, nres, ures) \
-     shared(cmt, eOffset, eEst, l1, luse, nOffset, nEst, uOffset, uEst) \
-     reduction(+:ierr), default(none) 
+    #pragma omp parallel for \
+     private(eres, i, indx, k, sum_res2, nres, ures) \
+     shared(cmt, eOffset, eEst, l1, lsearched, luse, nlld, nOffset, nEst, \
+            uOffset, uEst) \
+     default(none)
 #endif
-    for (ilon=0; ilon<cmt->nlons; ilon++)
+    for (indx=0; indx<nlld; indx++)
     {
-        for (ilat=0; ilat<cmt->nlats; ilat++)
+        // Depths skipped by the adaptive search have no estimates
+        if (!lsearched[indx])
         {
-            for (idep=0; idep<cmt->ndeps; idep++)
+            cmt->objfn[indx] = DBL_MAX;
+            for (k=0; k<cmt->nsites; k++)
             {
-                // Get location in arrays
-                indx = ilon*cmt->ndeps*cmt->nlats
-                     + ilat*cmt->ndeps 
-                     + idep;
-                // Compute the L2 norm
-                sum_res2 = 0.0;
+                cmt->NN[indx*cmt->nsites+k] = 0.0;
+                cmt->EN[indx*cmt->nsites+k] = 0.0;
+                cmt->UN[indx*cmt->nsites+k] = 0.0;
+            }
+            continue;
+        }
+        // Compute the L2 norm
+        sum_res2 = 0.0;
 #ifdef _OPENMP
-                #pragma omp simd reduction(+:sum_res2)
+        #pragma omp simd reduction(+:sum_res2)
 #endif
-                for (i=0; i<l1; i++)
-                {
-                    nres = nOffset[i] - nEst[indx*l1+i];
-                    eres = eOffset[i] - eEst[indx*l1+i];
-                    ures = uOffset[i] - uEst[indx*l1+i];
-                    sum_res2 = sum_res2 + nres*nres + eres*eres + ures*ures;
-                }
-                sum_res2 = sqrt(sum_res2);
-                // Decompose the moment tensor
-                ierr1 = core_cmt_decomposeMomentTensor(1, &cmt->mts[6*idep],
-                                                       &DC_pct,
-                                                       &cmt->Mw[idep],
-                                                       &cmt->str1[idep],
-                                                       &cmt->str2[idep],
-                                                       &cmt->dip1[idep],
-                                                       &cmt->dip2[idep],
-                                                       &cmt->rak1[idep],
-                                                       &cmt->rak2[idep]);
-                if (ierr1 != 0)
-                {
-                    LOG_ERRMSG("%s", "Error decomposing mt");
-                    ierr = ierr + 1;
-                    continue;
-                }
-                // Prefer results with larger double couple percentages
-                cmt->l2[indx] = 0.5*sqrt(sum_res2);
-                cmt->pct_dc[indx] = DC_pct;
-                cmt->objfn[indx] = sum_res2/DC_pct;
-                // Save the data
-                i = 0;
-                for (k=0; k<cmt->nsites; k++)
-                {
-                    cmt->NN[indx*cmt->nsites+k] = 0.0;
-                    cmt->EN[indx*cmt->nsites+k] = 0.0;
-                    cmt->UN[indx*cmt->nsites+k] = 0.0;
-                    if (luse[k])
-                    {
-                        cmt->NN[indx*cmt->nsites+k] = nEst[indx*l1+i];
-                        cmt->EN[indx*cmt->nsites+k] = eEst[indx*l1+i];
-                        cmt->UN[indx*cmt->nsites+k] = uEst[indx*l1+i];
-                        i = i + 1;
-                    }
-               }
-           } // Loop on depths
-       } // loop on latiudes
-    } // loop on longitudes
+        for (i=0; i<l1; i++)
+        {
+            nres = nOffset[i] - nEst[indx*l1+i];
+            eres = eOffset[i] - eEst[indx*l1+i];
+            ures = uOffset[i] - uEst[indx*l1+i];
+            sum_res2 = sum_res2 + nres*nres + eres*eres + ures*ures;
+        }
+        cmt->objfn[indx] = sqrt(sum_res2);
+        // Save the data
+        i = 0;
+        for (k=0; k<cmt->nsites; k++)
+        {
+            cmt->NN[indx*cmt->nsites+k] = 0.0;
+            cmt->EN[indx*cmt->nsites+k] = 0.0;
+            cmt->UN[indx*cmt->nsites+k] = 0.0;
+            if (luse[k])
+            {
+                cmt->NN[indx*cmt->nsites+k] = nEst[indx*l1+i];
+                cmt->EN[indx*cmt->nsites+k] = eEst[indx*l1+i];
+                cmt->UN[indx*cmt->nsites+k] = uEst[indx*l1+i];
+                i = i + 1;
+            }
+        }
+    } // Loop on grid points
+    // Decompose all the searched moment tensors in the grid at once
+    ierr = __decomposeSearched(nlld, lsearched, cmt);
+    // Prefer results with larger double couple percentages
+    for (indx=0; indx<nlld; indx++)
+    {
+        cmt->l2[indx] = 0.0;
+        if (!lsearched[indx]){continue;}
+        sum_res2 = cmt->objfn[indx];
+        // Moment tensors that couldn't be decomposed can't be optimal
+        cmt->objfn[indx] = DBL_MAX;
+        if (ierr < 0 || cmt->pct_dc[indx] <= 0.0){continue;}
+        cmt->l2[indx] = 0.5*sqrt(sum_res2);
+        cmt->objfn[indx] = sum_res2/cmt->pct_dc[indx];
+    }
     if (ierr != 0)
     {
         LOG_ERRMSG("%s", "Error decomposing moment tensor");
@@ -320,6 +393,7 @@ int eewUtils_driveCMT(struct GFAST_cmt_props_struct cmt_props,
         LOG_WARNMSG("%s", "NEED to unpack opt_indx and make a cmt->opt_dep");
     }
 ERROR:;
+    memory_free8l(&lsearched);
     memory_free8l(&luse);
     memory_free64f(&utmRecvNorthing);
     memory_free64f(&utmRecvEasting);
@@ -466,4 +540,264 @@ static int __verify_cmt_structs(struct GFAST_offsetData_struct cmt_data,
 ERROR:;
     return ierr;
 }
-
+//============================================================================//
+/*!
+ * @brief Searches the CMT depth grid coarse-to-fine with
+ *        core_cmt_adaptiveGridSearch.  The coarse grid is every
+ *        2^nrefine'th depth so that each refinement halves the spacing
+ *        until the full depth grid is reached.  The results at the
+ *        evaluated depths are scattered onto the depth grid.
+ *
+ * @param[in] cmt_props        CMT inversion parameters
+ * @param[in] l1               number of sites
+ * @param[in] utmSrcEasting    source UTM easting (m)
+ * @param[in] utmSrcNorthing   source UTM northing (m)
+ * @param[in] utmRecvEasting   receiver UTM eastings (m) [l1]
+ * @param[in] utmRecvNorthing  receiver UTM northings (m) [l1]
+ * @param[in] staAlt           station elevations (m) [l1]
+ * @param[in] nOffset          observed north offsets (m) [l1]
+ * @param[in] eOffset          observed east offsets (m) [l1]
+ * @param[in] uOffset          observed vertical offsets (m) [l1]
+ * @param[in] nWts             data weights on north offsets [l1]
+ * @param[in] eWts             data weights on east offsets [l1]
+ * @param[in] uWts             data weights on vertical offsets [l1]
+ *
+ * @param[in,out] cmt          on input holds the depth grid.  on output
+ *                             holds the moment tensors at the evaluated
+ *                             depths.
+ *
+ * @param[out] lsearched       if true then the idep'th depth was
+ *                             evaluated [ndeps]
+ * @param[out] nEst            estimated north offsets at the evaluated
+ *                             depths [l1*ndeps]
+ * @param[out] eEst            estimated east offsets at the evaluated
+ *                             depths [l1*ndeps]
+ * @param[out] uEst            estimated vertical offsets at the evaluated
+ *                             depths [l1*ndeps]
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+static int __adaptiveDepthSearch(struct GFAST_cmt_props_struct cmt_props,
+                                 const int l1,
+                                 const double utmSrcEasting,
+                                 const double utmSrcNorthing,
+                                 const double *__restrict__ utmRecvEasting,
+                                 const double *__restrict__ utmRecvNorthing,
+                                 const double *__restrict__ staAlt,
+                                 const double *__restrict__ nOffset,
+                                 const double *__restrict__ eOffset,
+                                 const double *__restrict__ uOffset,
+                                 const double *__restrict__ nWts,
+                                 const double *__restrict__ eWts,
+                                 const double *__restrict__ uWts,
+                                 struct GFAST_cmtResults_struct *cmt,
+                                 bool *__restrict__ lsearched,
+                                 double *__restrict__ nEst,
+                                 double *__restrict__ eEst,
+                                 double *__restrict__ uEst)
+{
+    double *depths, *evalDepths, *evalEastings, *evalNorthings, *evalMts,
+           *evalObjfn, *evalN, *evalE, *evalU, dz;
+    int i, idep, ierr, iopt, j, maxEvals, ncoarse, ndeps, nevals, nrefine,
+        stride;
+    //------------------------------------------------------------------------//
+    ndeps = cmt->ndeps;
+    nrefine = cmt_props.adaptive_nrefine;
+    stride = 1;
+    if (ndeps > 1){stride = 1 << nrefine;}
+    if (nrefine < 0 || (ndeps - 1)%stride != 0)
+    {
+        LOG_ERRMSG("%d depths cannot be refined %d times", ndeps, nrefine);
+        return -1;
+    }
+    ncoarse = (ndeps - 1)/stride + 1;
+    maxEvals = cmt_props.adaptive_maxEvals;
+    if (maxEvals > ndeps){maxEvals = ndeps;}
+    if (maxEvals < ncoarse){maxEvals = ncoarse;}
+    depths = memory_calloc64f(ncoarse);
+    evalEastings  = memory_calloc64f(maxEvals);
+    evalNorthings = memory_calloc64f(maxEvals);
+    evalDepths    = memory_calloc64f(maxEvals);
+    evalObjfn     = memory_calloc64f(maxEvals);
+    evalMts       = memory_calloc64f(6*maxEvals);
+    evalN         = memory_calloc64f(l1*maxEvals);
+    evalE         = memory_calloc64f(l1*maxEvals);
+    evalU         = memory_calloc64f(l1*maxEvals);
+    for (j=0; j<ncoarse; j++){depths[j] = cmt->srcDepths[j*stride];}
+    ierr = core_cmt_adaptiveGridSearch(l1, 1, 1, ncoarse,
+                                       nrefine, maxEvals,
+                                       cmt_props.verbose,
+                                       cmt_props.ldeviatoric,
+                                       utmSrcEasting, utmSrcNorthing,
+                                       0.0, 0.0, depths,
+                                       utmRecvEasting,
+                                       utmRecvNorthing,
+                                       staAlt,
+                                       nOffset, eOffset, uOffset,
+                                       nWts, eWts, uWts,
+                                       &nevals, &iopt,
+                                       evalEastings,
+                                       evalNorthings,
+                                       evalDepths,
+                                       evalMts, evalObjfn,
+                                       evalN, evalE, evalU);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error in adaptive CMT search");
+        goto ERROR;
+    }
+    // Put the evaluated depths back on the depth grid
+    for (idep=0; idep<ndeps; idep++){lsearched[idep] = false;}
+    dz = 0.0;
+    if (ndeps > 1){dz = cmt->srcDepths[1] - cmt->srcDepths[0];}
+    for (j=0; j<nevals; j++)
+    {
+        idep = 0;
+        if (ndeps > 1)
+        {
+            idep = (int) lround((evalDepths[j] - cmt->srcDepths[0])/dz);
+        }
+        if (idep < 0 || idep >= ndeps ||
+            fabs(cmt->srcDepths[idep] - evalDepths[j]) > 1.e-6*fabs(dz))
+        {
+            LOG_ERRMSG("Depth %f is not on the CMT depth grid",
+                       evalDepths[j]);
+            ierr = 1;
+            goto ERROR;
+        }
+        lsearched[idep] = true;
+        for (i=0; i<6; i++){cmt->mts[6*idep+i] = evalMts[6*j+i];}
+        for (i=0; i<l1; i++)
+        {
+            nEst[idep*l1+i] = evalN[j*l1+i];
+            eEst[idep*l1+i] = evalE[j*l1+i];
+            uEst[idep*l1+i] = evalU[j*l1+i];
+        }
+    }
+    if (cmt_props.verbose > 2)
+    {
+        LOG_DEBUGMSG("Adaptive CMT search evaluated %d of %d depths",
+                     nevals, ndeps);
+    }
+ERROR:;
+    memory_free64f(&depths);
+    memory_free64f(&evalEastings);
+    memory_free64f(&evalNorthings);
+    memory_free64f(&evalDepths);
+    memory_free64f(&evalObjfn);
+    memory_free64f(&evalMts);
+    memory_free64f(&evalN);
+    memory_free64f(&evalE);
+    memory_free64f(&evalU);
+    return ierr;
+}
+//============================================================================//
+/*!
+ * @brief Decomposes the moment tensors at the depths that were searched.
+ *        When the adaptive search skipped depths the searched moment
+ *        tensors are gathered so that only they are decomposed.  The
+ *        skipped depths are zeroed.
+ *
+ * @param[in] nlld        number of grid points
+ * @param[in] lsearched   if true then the moment tensor at this grid point
+ *                        was estimated [nlld]
+ *
+ * @param[in,out] cmt     on input holds the moment tensors.  on output
+ *                        holds the double couple percentages, magnitudes,
+ *                        and nodal planes at the searched grid points.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+static int __decomposeSearched(const int nlld,
+                               const bool *__restrict__ lsearched,
+                               struct GFAST_cmtResults_struct *cmt)
+{
+    double *dec, *mts;
+    int i, ierr, indx, j, ns;
+    //------------------------------------------------------------------------//
+    ns = 0;
+    for (indx=0; indx<nlld; indx++)
+    {
+        if (lsearched[indx]){ns = ns + 1;}
+    }
+    if (ns == nlld)
+    {
+        if (cmt->decompWork != NULL)
+        {
+            return core_cmt_decomposeMomentTensor_work(nlld, cmt->mts,
+                                                       CMT_DECOMP_LWORK*nlld,
+                                                       cmt->decompWork,
+                                                       cmt->pct_dc,
+                                                       cmt->Mw,
+                                                       cmt->str1, cmt->str2,
+                                                       cmt->dip1, cmt->dip2,
+                                                       cmt->rak1, cmt->rak2);
+        }
+        return core_cmt_decomposeMomentTensor(nlld, cmt->mts,
+                                              cmt->pct_dc,
+                                              cmt->Mw,
+                                              cmt->str1, cmt->str2,
+                                              cmt->dip1, cmt->dip2,
+                                              cmt->rak1, cmt->rak2);
+    }
+    // Gather the searched moment tensors
+    mts = memory_calloc64f(6*ns);
+    dec = memory_calloc64f(8*ns);
+    j = 0;
+    for (indx=0; indx<nlld; indx++)
+    {
+        if (!lsearched[indx]){continue;}
+        for (i=0; i<6; i++){mts[6*j+i] = cmt->mts[6*indx+i];}
+        j = j + 1;
+    }
+    if (cmt->decompWork != NULL)
+    {
+        ierr = core_cmt_decomposeMomentTensor_work(ns, mts,
+                                                   CMT_DECOMP_LWORK*nlld,
+                                                   cmt->decompWork,
+                                                   &dec[0], &dec[ns],
+                                                   &dec[2*ns], &dec[3*ns],
+                                                   &dec[4*ns], &dec[5*ns],
+                                                   &dec[6*ns], &dec[7*ns]);
+    }
+    else
+    {
+        ierr = core_cmt_decomposeMomentTensor(ns, mts,
+                                              &dec[0], &dec[ns],
+                                              &dec[2*ns], &dec[3*ns],
+                                              &dec[4*ns], &dec[5*ns],
+                                              &dec[6*ns], &dec[7*ns]);
+    }
+    // Scatter the results back onto the grid
+    j = 0;
+    for (indx=0; indx<nlld; indx++)
+    {
+        cmt->pct_dc[indx] = 0.0;
+        cmt->Mw[indx] = 0.0;
+        cmt->str1[indx] = 0.0;
+        cmt->str2[indx] = 0.0;
+        cmt->dip1[indx] = 0.0;
+        cmt->dip2[indx] = 0.0;
+        cmt->rak1[indx] = 0.0;
+        cmt->rak2[indx] = 0.0;
+        if (!lsearched[indx]){continue;}
+        cmt->pct_dc[indx] = dec[j];
+        cmt->Mw[indx]   = dec[ns+j];
+        cmt->str1[indx] = dec[2*ns+j];
+        cmt->str2[indx] = dec[3*ns+j];
+        cmt->dip1[indx] = dec[4*ns+j];
+        cmt->dip2[indx] = dec[5*ns+j];
+        cmt->rak1[indx] = dec[6*ns+j];
+        cmt->rak2[indx] = dec[7*ns+j];
+        j = j + 1;
+    }
+    memory_free64f(&mts);
+    memory_free64f(&dec);
+    return ierr;
+}
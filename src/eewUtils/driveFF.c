@@ -16,6 +16,8 @@ static int __verify_ff_structs(struct GFAST_offsetData_struct ff_data,
  * @param[in] ff_props    finite fault inversion parameters
  * @param[in] SA_lat      event latitude (degrees)
  * @param[in] SA_lon      event longitude (degrees) 
+ * @param[in] geometry    cached station UTM coordinates.  if NULL then
+ *                        the receiver UTM coordinates are computed.
  * @param[in] ff_data     offset data for the finite fault inversion
  *
  * @param[in,out] ff      on input contains space for the finite fault
@@ -37,6 +39,7 @@ static int __verify_ff_structs(struct GFAST_offsetData_struct ff_data,
 int eewUtils_driveFF(struct GFAST_ff_props_struct ff_props,
                      const double SA_lat,
                      const double SA_lon,
+                     const struct GFAST_stationGeometry_struct *geometry,
                      struct GFAST_offsetData_struct ff_data,
                      struct GFAST_ffResults_struct *ff)
 {
@@ -184,10 +187,10 @@ int eewUtils_driveFF(struct GFAST_ff_props_struct ff_props,
     {
         if (!luse[k]){continue;}
         // Get the recevier UTM
-        core_coordtools_ll2utm(ff_data.sta_lat[k],
-                               ff_data.sta_lon[k],
-                               &y2, &x2,
-                               &lnorthp, &zone_loc);
+        core_data_getSiteUTM(geometry, k,
+                             ff_data.sta_lat[k],
+                             ff_data.sta_lon[k],
+                             zone_loc, &y2, &x2);
         // Copy the pertinent data
         uOffset[l1] = ff_data.ubuff[k];
         nOffset[l1] = ff_data.nbuff[k];
@@ -271,20 +274,30 @@ int eewUtils_driveFF(struct GFAST_ff_props_struct ff_props,
                      nfp, l1);
     }
     // Perform the finite fault inversion
-    ierr = core_ff_faultPlaneGridSearch(l1, l2,
-                                        nstr, ndip, nfp,
-                                        ff_props.verbose,
-                                        nOffset, eOffset, uOffset,
-                                        nWts, eWts, uWts,
-                                        utmRecvEasting, utmRecvNorthing,
-                                        staAlt,
-                                        fault_xutm, fault_yutm, fault_alt,
-                                        length, width,
-                                        strike, dip,
-                                        sslip, dslip,
-                                        Mw, vr,
-                                        NN, EN, UN,
-                                        sslip_unc, dslip_unc);
+    ierr = core_ff_cachedFaultPlaneGridSearch(ff->greens,
+                                              ff_data.nsites, luse,
+                                              ff_props.solver,
+                                              ff_props.cgls_maxit,
+                                              ff_props.cgls_tol,
+                                              ff_props.min_slip,
+                                              ff_props.max_slip,
+                                              ff_props.unc_nprobe,
+                                              l1, l2,
+                                              nstr, ndip, nfp,
+                                              ff_props.verbose,
+                                              nOffset, eOffset, uOffset,
+                                              nWts, eWts, uWts,
+                                              utmRecvEasting,
+                                              utmRecvNorthing,
+                                              staAlt,
+                                              fault_xutm, fault_yutm,
+                                              fault_alt,
+                                              length, width,
+                                              strike, dip,
+                                              sslip, dslip,
+                                              Mw, vr,
+                                              NN, EN, UN,
+                                              sslip_unc, dslip_unc);
     if (ierr != 0)
     {
         LOG_ERRMSG("%s", "Error performing finite fault grid search");
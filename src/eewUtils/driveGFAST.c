@@ -28,6 +28,14 @@
  * @param[in,out] h5traceBuffer  Holds the requisite information for reading.
  * @param[in,out] pgd_data       Workspace for the PGD data in the PGD
  *                               inversion.
+ * @param[in,out] pgdTracker     Holds the incremental peak displacement
+ *                               state of each event so that only new samples
+ *                               are processed on each call.  States of
+ *                               events no longer in the list are released.
+ * @param[in,out] offsetTracker  Holds the running offset sums of each event
+ *                               for the CMT and finite fault window
+ *                               velocities.  States of events no longer in
+ *                               the list are released.
  * @param[in,out] cmt_data       Workspace for the offset data in the CMT 
  *                               inversion.
  * @param[in,out] ff_data        Workspace for the offset data in the finite
@@ -52,6 +60,8 @@ int eewUtils_driveGFAST(const double currentTime,
                         struct GFAST_data_struct *gps_data,
                         struct h5traceBuffer_struct *h5traceBuffer,
                         struct GFAST_peakDisplacementData_struct *pgd_data,
+                        struct GFAST_peakDisplacementTracker_struct *pgdTracker,
+                        struct GFAST_offsetTracker_struct *offsetTracker,
                         struct GFAST_offsetData_struct *cmt_data,
                         struct GFAST_offsetData_struct *ff_data,
                         struct GFAST_pgdResults_struct *pgd,
@@ -60,18 +70,24 @@ int eewUtils_driveGFAST(const double currentTime,
                         struct GFAST_xmlMessages_struct *xmlMessages)
 {
     struct GFAST_shakeAlert_struct SA;
+    struct GFAST_peakDisplacementState_struct *pdState;
+    struct GFAST_offsetState_struct *offState;
     char errorLogFileName[PATH_MAX], infoLogFileName[PATH_MAX], 
          debugLogFileName[PATH_MAX], warnLogFileName[PATH_MAX];
     char *cmtQML, *ffXML, *pgdXML;
-    double t1, t2;
+    double svel[2], t1, t2;
     int h5k, ierr, iev, ipf, nPop, nRemoved,
         nsites_cmt, nsites_ff, nsites_pgd,
-        nstrdip, pgdOpt, shakeAlertMode;
+        nstrdip, pgdDep, pgdLat, pgdLatLon, pgdLon, pgdOpt,
+        shakeAlertMode;
     bool lcmtSuccess, lffSuccess, lfinalize, lpgdSuccess;
     //------------------------------------------------------------------------//
     //
-    // Nothing to do 
+    // Release the peak displacement states of departed events
     ierr = 0;
+    core_waveformProcessor_prunePeakDisplacementStates(*events, pgdTracker);
+    core_waveformProcessor_pruneOffsetStates(*events, offsetTracker);
+    // Nothing to do 
     if (events->nev <= 0){return 0;}
     // Figure out the mode for generating shakeAlert messages
     shakeAlertMode = 1;
@@ -140,54 +156,46 @@ printf("copying data\n");
             continue;
         }
 printf("waveform processing\n");
-        // Extract the peak displacement from the waveform buffer
-        nsites_pgd = GFAST_core_waveformProcessor_peakDisplacement(
-                                    props.pgd_props.utm_zone,
-                                    props.pgd_props.window_vel,
-                                    SA.lat,
-                                    SA.lon,
-                                    SA.dep,
-                                    SA.time,
-                                    *gps_data,
-                                    pgd_data,
-                                    &ierr);
+        // Get the incremental peak displacement and running offset states
+        pdState = core_waveformProcessor_getPeakDisplacementState(
+                                    SA, pgd_data->nsites, pgdTracker, &ierr);
         if (ierr != 0)
         {
-            LOG_ERRMSG("%s", "Error processing peak displacement");
-            continue;
+            LOG_WARNMSG("%s", "Computing peak displacement without state");
+            pdState = NULL;
         }
-printf("waveform prcoessing 2\n");
-        // Extract the offset for the CMT inversion from the buffer 
-        nsites_cmt = GFAST_core_waveformProcessor_offset(
-                                    props.cmt_props.utm_zone,
-                                    props.cmt_props.window_vel,
-                                    SA.lat,
-                                    SA.lon,
-                                    SA.dep,
-                                    SA.time,
-                                    *gps_data,
-                                    cmt_data,
-                                    &ierr);
+        svel[0] = props.cmt_props.window_vel;
+        svel[1] = props.ff_props.window_vel;
+        offState = core_waveformProcessor_getOffsetState(
+                                    SA, cmt_data->nsites, 2, svel,
+                                    offsetTracker, &ierr);
         if (ierr != 0)
         {
-            LOG_ERRMSG("%s", "Error processing CMT offset");
-            continue;
+            LOG_WARNMSG("%s", "Computing offsets without state");
+            offState = NULL;
         }
-printf("waveform processing 3\n");
-        // Extract the offset for the FF inversion from the buffer 
-        nsites_ff = GFAST_core_waveformProcessor_offset(
-                                    props.ff_props.utm_zone,
-                                    props.ff_props.window_vel,
+        // Extract the peak displacement and the CMT and FF offsets from
+        // the waveform buffer
+        ierr = GFAST_core_waveformProcessor_peakDisplacementAndOffsets(
+                                    props.pgd_props,
+                                    props.cmt_props,
+                                    props.ff_props,
                                     SA.lat,
                                     SA.lon,
                                     SA.dep,
                                     SA.time,
                                     *gps_data,
+                                    pdState,
+                                    offState,
+                                    pgd_data,
+                                    cmt_data,
                                     ff_data,
-                                    &ierr);
+                                    &nsites_pgd,
+                                    &nsites_cmt,
+                                    &nsites_ff);
         if (ierr != 0)
         {
-            LOG_ERRMSG("%s", "Error processing FF offset");
+            LOG_ERRMSG("%s", "Error processing waveforms");
             continue;
         }
 printf("pgd scaling..\n");
@@ -202,6 +210,7 @@ printf("pgd scaling..\n");
             lpgdSuccess = true;
             ierr = eewUtils_drivePGD(props.pgd_props,
                                      SA.lat, SA.lon, SA.dep,
+                                     gps_data->geometry,
                                      *pgd_data,
                                      pgd);
             if (ierr != PGD_SUCCESS)
@@ -221,6 +230,7 @@ printf("pgd scaling..\n");
             lcmtSuccess = true;
             ierr = eewUtils_driveCMT(props.cmt_props,
                                      SA.lat, SA.lon, SA.dep,
+                                     gps_data->geometry,
                                      *cmt_data,
                                      cmt);
             if (ierr != CMT_SUCCESS || cmt->opt_indx < 0)
@@ -248,6 +258,7 @@ printf("pgd scaling..\n");
             lffSuccess = true;
             ierr = eewUtils_driveFF(props.ff_props,
                                     SA.lat, SA.lon, //SA.dep,
+                                    gps_data->geometry,
                                     *ff_data,
                                     ff);
             if (ierr != FF_SUCCESS)
@@ -277,7 +288,13 @@ printf("pgd scaling..\n");
                 {
                     LOG_DEBUGMSG("%s", "Generating pgd XML");
                 }
-                pgdOpt = array_argmax64f(pgd->ndeps, pgd->dep_vr_pgd, &ierr);
+                pgdOpt = array_argmax64f(pgd->nlons*pgd->nlats*pgd->ndeps,
+                                         pgd->dep_vr_pgd, &ierr);
+                // Unpack the optimal (lon, lat, depth) grid point
+                pgdLatLon = pgdOpt/pgd->ndeps;
+                pgdDep = pgdOpt - pgdLatLon*pgd->ndeps;
+                pgdLon = pgdLatLon/pgd->nlats;
+                pgdLat = pgdLatLon - pgdLon*pgd->nlats;
                 pgdXML = eewUtils_makeXML__pgd(props.opmode, //shakeAlertMode,
                                                "GFAST\0",
                                                GFAST_VERSION,
@@ -285,9 +302,9 @@ printf("pgd scaling..\n");
                                                "new\0",
                                                GFAST_VERSION,
                                                SA.eventid,
-                                               SA.lat,
-                                               SA.lon,
-                                               pgd->srcDepths[pgdOpt],
+                                               pgd->srcLats[pgdLat],
+                                               pgd->srcLons[pgdLon],
+                                               pgd->srcDepths[pgdDep],
                                                pgd->mpgd[pgdOpt],
                                                SA.time,
                                                &ierr);
@@ -493,6 +510,9 @@ printf("pgd scaling..\n");
         {
             LOG_WARNMSG("%s", "Strange - check removeExpiredEvents");
         }
+        core_waveformProcessor_prunePeakDisplacementStates(*events,
+                                                           pgdTracker);
+        core_waveformProcessor_pruneOffsetStates(*events, offsetTracker);
     }
     return ierr;
 }
@@ -9,19 +9,25 @@
 
 /*!
  * @brief Driver for estimating earthquake magnitude from peak
- *        ground displacement
+ *        ground displacement.  The grid search is performed over depth
+ *        and, if pgd->nlats or pgd->nlons exceeds 1, over a grid of
+ *        epicenters centered on the event location with spacing
+ *        pgd_props.dLat and pgd_props.dLon.
  *
  * @param[in] pgd_props  PGD inversion parameters
  * @param[in] SA_lat     event latitude (degrees) [-90,90]
  * @param[in] SA_lon     event longitude (degrees) [0,360]
  * @param[in] SA_dep     event depth (km)
+ * @param[in] geometry   cached station UTM coordinates.  if NULL then the
+ *                       receiver UTM coordinates are computed.
  * @param[in] pgd_data   data structure holding the peak ground displacement
  *                       data, weights, and logical mask indicating site is
  *                       a candidate for inversion
  *
  * @param[out] pgd       results of the PGD estimation grid-search, 
- *                       the variance reduction at each depth in the grid
- *                       search, and the sites used in the inversion
+ *                       the variance reduction at each location in the grid
+ *                       search, the epicenters in the grid search, and
+ *                       the sites used in the inversion
  *
  * @result 0 indicates success
  *         1 indicates an error on the input pgd structure
@@ -38,12 +44,15 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
                       const double SA_lat,
                       const double SA_lon,
                       const double SA_dep,
+                      const struct GFAST_stationGeometry_struct *geometry,
                       struct GFAST_peakDisplacementData_struct pgd_data,
                       struct GFAST_pgdResults_struct *pgd)
 {
-    double *d, *srdist, *staAlt, *Uest, *utmRecvEasting, *utmRecvNorthing, *wts,
-           iqrMin, utmSrcEasting, utmSrcNorthing, x1, x2, y1, y2;
-    int i, idep, ierr, j, k, l1, nloc, zone_loc;
+    double *d, *srcLats, *srcLons, *srdist, *staAlt, *Uest,
+           *utmRecvEasting, *utmRecvNorthing, *utmSrcEastings,
+           *utmSrcNorthings, *wts, iqrMin, x1, x2, y1, y2;
+    int i, ierr, ilat, ilatLon, iloc, ilon, j, k, l1, nlatLon, nloc,
+        zone_loc;
     bool *luse, lnorthp;
     //------------------------------------------------------------------------//
     //
@@ -56,6 +65,10 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
     staAlt = NULL;
     Uest = NULL;
     srdist = NULL;
+    srcLats = NULL;
+    srcLons = NULL;
+    utmSrcNorthings = NULL;
+    utmSrcEastings = NULL;
     luse = NULL;
     // Verify the input data structure makes sense
     if (pgd_data.nsites < 1)
@@ -90,16 +103,28 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
         goto ERROR;
     }
     // Verify the output data structures 
-    if (pgd->ndeps < 1)
+    if (pgd->ndeps < 1 || pgd->nlats < 1 || pgd->nlons < 1)
     {
-        LOG_ERRMSG("%s", "No depths in PGD gridsearch!");
+        if (pgd->ndeps < 1)
+        {
+            LOG_ERRMSG("%s", "No depths in PGD gridsearch!");
+        }
+        if (pgd->nlats < 1)
+        {
+            LOG_ERRMSG("%s", "No lats in PGD gridsearch!");
+        }
+        if (pgd->nlons < 1)
+        {
+            LOG_ERRMSG("%s", "No lons in PGD gridsearch!");
+        }
         ierr = PGD_STRUCT_ERROR;
         goto ERROR;
     }
     if (pgd->mpgd == NULL || pgd->mpgd_vr == NULL ||
         pgd->srcDepths == NULL || pgd->UP == NULL ||
         pgd->UPinp == NULL || pgd->srdist == NULL ||
-        pgd->lsiteUsed == NULL)
+        pgd->lsiteUsed == NULL || pgd->srcLats == NULL ||
+        pgd->srcLons == NULL)
     {
         if (pgd->mpgd == NULL)
         {
@@ -129,6 +154,14 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
         {
             LOG_ERRMSG("%s", "pgd->lsiteUsed is NULL");
         }
+        if (pgd->srcLats == NULL)
+        {
+            LOG_ERRMSG("%s", "pgd->srcLats is NULL");
+        }
+        if (pgd->srcLons == NULL)
+        {
+            LOG_ERRMSG("%s", "pgd->srcLons is NULL");
+        }
         ierr = PGD_STRUCT_ERROR;
         goto ERROR;
     }
@@ -147,7 +180,8 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
         LOG_WARNMSG("%s", "Warning hypocenter isn't in grid search!");
     }
     // Null out results
-    nloc = pgd->ndeps*pgd->nlats*pgd->nlons;
+    nlatLon = pgd->nlats*pgd->nlons;
+    nloc = pgd->ndeps*nlatLon;
     array_zeros64f_work(pgd->nsites, pgd->UPinp);
     array_zeros8l_work( pgd->nsites, pgd->lsiteUsed);
     array_zeros64f_work(nloc, pgd->mpgd);
@@ -181,26 +215,58 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
     utmRecvEasting  = memory_calloc64f(l1);
     staAlt          = memory_calloc64f(l1);
     wts             = memory_calloc64f(l1);
-    Uest            = memory_calloc64f(l1*pgd->ndeps);
-    srdist          = memory_calloc64f(l1*pgd->ndeps);
+    Uest            = memory_calloc64f(l1*nloc);
+    srdist          = memory_calloc64f(l1*nloc);
+    srcLats         = memory_calloc64f(nlatLon);
+    srcLons         = memory_calloc64f(nlatLon);
+    utmSrcNorthings = memory_calloc64f(nlatLon);
+    utmSrcEastings  = memory_calloc64f(nlatLon);
     // Get the source location
     zone_loc = pgd_props.utm_zone;
     if (zone_loc ==-12345){zone_loc =-1;} // Estimate UTM zone from source lon
     core_coordtools_ll2utm(SA_lat, SA_lon,
                            &y1, &x1,
                            &lnorthp, &zone_loc);
-    utmSrcNorthing = y1; 
-    utmSrcEasting = x1;
+    // Center the epicentral grid on the source.  Note that readIni makes
+    // the number of lats and lons odd.
+    for (ilat=0; ilat<pgd->nlats; ilat++)
+    {
+        pgd->srcLats[ilat] = SA_lat
+                           + (double) (ilat - pgd->nlats/2)*pgd_props.dLat;
+    }
+    for (ilon=0; ilon<pgd->nlons; ilon++)
+    {
+        pgd->srcLons[ilon] = SA_lon
+                           + (double) (ilon - pgd->nlons/2)*pgd_props.dLon;
+    }
+    for (ilon=0; ilon<pgd->nlons; ilon++)
+    {
+        for (ilat=0; ilat<pgd->nlats; ilat++)
+        {
+            ilatLon = ilon*pgd->nlats + ilat;
+            srcLats[ilatLon] = pgd->srcLats[ilat];
+            srcLons[ilatLon] = pgd->srcLons[ilon];
+        }
+    }
+    // Project every epicenter into the source's UTM zone
+    ierr = core_coordtools_ll2utm_batch(nlatLon, srcLats, srcLons, zone_loc,
+                                        utmSrcNorthings, utmSrcEastings);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error projecting epicentral grid");
+        ierr = PGD_COMPUTE_ERROR;
+        goto ERROR;
+    }
     // Loop on the receivers, get distances, and data
     l1 = 0;
     for (k=0; k<pgd_data.nsites; k++)
     {   
         if (!pgd_data.lactive[k] || pgd_data.wt[k] <= 0.0){continue;}
         // Get the recevier UTM
-        core_coordtools_ll2utm(pgd_data.sta_lat[k],
-                               pgd_data.sta_lon[k],
-                               &y2, &x2,
-                               &lnorthp, &zone_loc);
+        core_data_getSiteUTM(geometry, k,
+                             pgd_data.sta_lat[k],
+                             pgd_data.sta_lon[k],
+                             zone_loc, &y2, &x2);
         // Copy information to data structures for grid search
         d[l1] = pgd_data.pd[k]*100.0; // convert peak ground displacement to cm
         wts[l1] = pgd_data.wt[k];
@@ -212,25 +278,28 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
     // Invert!
     if (pgd_props.verbose > 2)
     {   
-        LOG_DEBUGMSG("Inverting for PGD with %d sites", l1);
+        LOG_DEBUGMSG("Inverting for PGD with %d sites at %d locations",
+                     l1, nloc);
     }   
-    ierr = core_scaling_pgd_depthGridSearch(l1, pgd->ndeps,
-                                            pgd_props.verbose,
-                                            pgd_props.dist_tol,
-                                            pgd_props.disp_def,
-                                            utmSrcEasting,
-                                            utmSrcNorthing,
-                                            pgd->srcDepths,
-                                            utmRecvEasting,
-                                            utmRecvNorthing,
-                                            staAlt,
-                                            d,
-                                            wts,
-                                            srdist,
-                                            pgd->mpgd,
-                                            pgd->mpgd_vr,
-                                            pgd->iqr,
-                                            Uest);
+    ierr = core_scaling_pgd_gridSearch(l1, pgd->ndeps,
+                                       pgd->nlats, pgd->nlons,
+                                       pgd_props.verbose,
+                                       pgd_props.dist_tol,
+                                       pgd_props.disp_def,
+                                       pgd_props.iqr_sketch_min,
+                                       utmSrcEastings,
+                                       utmSrcNorthings,
+                                       pgd->srcDepths,
+                                       utmRecvEasting,
+                                       utmRecvNorthing,
+                                       staAlt,
+                                       d,
+                                       wts,
+                                       srdist,
+                                       pgd->mpgd,
+                                       pgd->mpgd_vr,
+                                       pgd->iqr,
+                                       Uest);
     if (ierr != 0)
     {   
         if (pgd_props.verbose > 0)
@@ -248,20 +317,20 @@ int eewUtils_drivePGD(const struct GFAST_pgd_props_struct pgd_props,
         pgd->UPinp[i] = d[k];
         k = k + 1;
     }
-    iqrMin = array_min64f(pgd->ndeps, pgd->iqr, &ierr);
+    iqrMin = array_min64f(nloc, pgd->iqr, &ierr);
     // Extract the estimates and compute weighted objective function
-    for (idep=0; idep<pgd->ndeps; idep++)
+    for (iloc=0; iloc<nloc; iloc++)
     {
-        pgd->dep_vr_pgd[idep] = pgd->mpgd[idep]*iqrMin/pgd->iqr[idep];
+        pgd->dep_vr_pgd[iloc] = pgd->mpgd[iloc]*iqrMin/pgd->iqr[iloc];
         j = 0;
         for (i=0; i<pgd->nsites; i++)
         {
-            pgd->UP[idep*pgd->nsites+i] = 0.0;
-            pgd->srdist[idep*pgd->nsites+i] = 0.0;
+            pgd->UP[iloc*pgd->nsites+i] = 0.0;
+            pgd->srdist[iloc*pgd->nsites+i] = 0.0;
             if (luse[i])
             {
-                pgd->UP[idep*pgd->nsites+i] = Uest[idep*l1+j];
-                pgd->srdist[idep*pgd->nsites+i] = srdist[idep*l1+j];
+                pgd->UP[iloc*pgd->nsites+i] = Uest[iloc*l1+j];
+                pgd->srdist[iloc*pgd->nsites+i] = srdist[iloc*l1+j];
                 j = j + 1;
             }
         }
@@ -274,6 +343,10 @@ ERROR:;
     memory_free64f(&wts);
     memory_free64f(&Uest);
     memory_free64f(&srdist);
+    memory_free64f(&srcLats);
+    memory_free64f(&srcLons);
+    memory_free64f(&utmSrcNorthings);
+    memory_free64f(&utmSrcEastings);
     memory_free8l(&luse);
     return ierr;
 }
@@ -2,6 +2,7 @@
 #include <stdlib.h>
 #include <stdbool.h>
 #include <string.h>
+#include <pthread.h>
 #include "gfast.h"
 #include "iscl/iscl/iscl.h"
 #include "iscl/memory/memory.h"
@@ -9,9 +10,33 @@
 #include "iscl/time/time.h"
 
 #define MAX_MESSAGES 1024
+/* Snapshots the acquisition thread can hand off before it must buffer
+   ring reads in the queue's backlog */
+#define TB2_QUEUE_SLOTS 16
+/* Wait times after which the waveform processor stops waiting for a
+   missing sample */
+#define NWAIT_LATENCY 5.0
+
+struct acquisition_struct
+{
+    struct ewRing_struct *ringInfo; /*!< Earthworm ring to drain */
+    struct tb2Queue_struct *queue;  /*!< Snapshot queue to fill */
+    const struct snclIndex_struct
+        *snclIndex;                 /*!< Maps SNCLs to the queue's traces */
+    double waitTime;                /*!< Time (s) between ring reads */
+    double t0;                      /*!< Epochal time (UTC) on which the
+                                         ring read deadlines are aligned.
+                                         the first read is at t0 + waitTime */
+    int ierr;                       /*!< Set by the acquisition thread
+                                         if it exits with an error */
+    bool lacquire;                  /*!< Cleared by the processing thread
+                                         to stop the acquisition thread */
+};
 
 static int settb2DataFromGFAST(struct GFAST_data_struct gpsData,
+                               struct snclIndex_struct *snclIndex,
                                struct tb2Data_struct *tb2Data);
+static void *acquisitionThread(void *args);
 
 /*!
  * @brief GFAST earthquake early warning driver routine
@@ -28,31 +53,40 @@ int main(int argc, char **argv)
     struct tb2Data_struct tb2Data;
     struct GFAST_offsetData_struct cmt_data, ff_data;
     struct GFAST_peakDisplacementData_struct pgd_data;
+    struct GFAST_peakDisplacementTracker_struct pgdTracker;
+    struct GFAST_offsetTracker_struct offsetTracker;
     struct GFAST_data_struct gps_data;
     struct GFAST_pgdResults_struct pgd;
     struct GFAST_props_struct props;
     struct GFAST_shakeAlert_struct SA;
     struct GFAST_xmlMessages_struct xmlMessages;
     struct ewRing_struct ringInfo;
-    char *msgs;
+    struct GFAST_scheduler_struct scheduler;
+    struct tb2Queue_struct tb2Queue;
+    struct snclIndex_struct snclIndex;
+    struct acquisition_struct acquisition;
+    pthread_t acquisitionThreadID;
     char *amqMessage;
-    double t0, t1, tbeg;
+    double t0, t1, tdata, tprocessed;
     const enum opmode_type opmode = REAL_TIME_EEW;
     const bool useTopic = true;   // Don't want durable queues
     const bool clientAck = false; // Let session acknowledge transacations
     const bool luseListener = false; // C can't trigger so turn this off
     double tstatus, tstatus0, tstatus1;
     void *messageQueue = NULL;
-    int ierr, im, msWait, nTracebufs2Read;
-    bool lacquire, lnewEvent;
-    const int rdwt = 2; // H5 file is read/write
+    int ierr, im, islot, msWait, nskipped;
+    bool lacquire, lacquisitionThread, lnewEvent;
+    int rdwt;
     char errorLogFileName[PATH_MAX];
     char infoLogFileName[PATH_MAX];
     char debugLogFileName[PATH_MAX];
     char warnLogFileName[PATH_MAX];
     // Initialize 
     ierr = 0;
-    msgs = NULL;
+    lacquisitionThread = false;
+    tdata =-1.0;
+    tprocessed =-1.0;
+    nskipped = 0;
     memset(&props,    0, sizeof(struct GFAST_props_struct));
     memset(&gps_data, 0, sizeof(struct GFAST_data_struct));
     memset(&events, 0, sizeof(struct GFAST_activeEvents_struct));
@@ -60,12 +94,18 @@ int main(int argc, char **argv)
     memset(&cmt, 0, sizeof(struct GFAST_cmtResults_struct));
     memset(&ff, 0, sizeof(struct GFAST_ffResults_struct));
     memset(&pgd_data, 0, sizeof( struct GFAST_peakDisplacementData_struct));
+    memset(&pgdTracker, 0, sizeof(struct GFAST_peakDisplacementTracker_struct));
+    memset(&offsetTracker, 0, sizeof(struct GFAST_offsetTracker_struct));
     memset(&cmt_data, 0, sizeof(struct GFAST_offsetData_struct));
     memset(&ff_data, 0, sizeof(struct GFAST_offsetData_struct));
     memset(&ringInfo, 0, sizeof(struct ewRing_struct)); 
     memset(&xmlMessages, 0, sizeof(struct GFAST_xmlMessages_struct));
     memset(&h5traceBuffer, 0, sizeof(struct h5traceBuffer_struct));
     memset(&tb2Data, 0, sizeof(struct tb2Data_struct));
+    memset(&scheduler, 0, sizeof(struct GFAST_scheduler_struct));
+    memset(&tb2Queue, 0, sizeof(struct tb2Queue_struct));
+    memset(&snclIndex, 0, sizeof(struct snclIndex_struct));
+    memset(&acquisition, 0, sizeof(struct acquisition_struct));
     ISCL_iscl_init(); // Fire up the computational library
     // Read the program properties
     ierr = GFAST_core_properties_initialize(propfilename, opmode, &props);
@@ -75,6 +115,8 @@ int main(int argc, char **argv)
         goto ERROR;
     }
     if (props.verbose > 2){GFAST_core_properties_print(props);}
+    pgdTracker.latency = NWAIT_LATENCY*props.waitTime;
+    offsetTracker.latency = NWAIT_LATENCY*props.waitTime;
     // Initialize the stations locations/names/sampling periods for the module
     if (props.verbose > 0)
     {   
@@ -95,7 +137,9 @@ int main(int argc, char **argv)
         LOG_ERRMSG("%s: Error setting the H5 tracebuffer\n", fcnm);
         goto ERROR;
     }
-    // Initialize the tracebuffer h5 archive
+    // Initialize the tracebuffer.  Only write the HDF5 file if requested.
+    rdwt = 3; // Memory only
+    if (props.lh5TraceBuffer){rdwt = 2;} // H5 file is read/write
     ierr = traceBuffer_h5_initialize(rdwt, true, "./\0", "work.h5\0", 
                                      &h5traceBuffer);
     if (ierr != 0)
@@ -151,12 +195,26 @@ int main(int argc, char **argv)
         goto ERROR;
     }
     // Set up the SNCL's to target
-    ierr = settb2DataFromGFAST(gps_data, &tb2Data);
+    ierr = settb2DataFromGFAST(gps_data, &snclIndex, &tb2Data);
     if (ierr != 0)
     {
         LOG_ERRMSG("%s: Error setting tb2Data\n", fcnm);
         goto ERROR;
     }
+    ierr = traceBuffer_h5_setTb2DataMap(&snclIndex, &h5traceBuffer);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s: Error mapping traces to tb2Data\n", fcnm);
+        goto ERROR;
+    }
+    // Set the queue through which the acquisition thread hands off data
+    ierr = traceBuffer_ewrr_initializetb2Queue(TB2_QUEUE_SLOTS, tb2Data,
+                                               &tb2Queue);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s: Error initializing tb2Queue\n", fcnm);
+        goto ERROR;
+    }
     // Connect to the earthworm ring
     ierr = traceBuffer_ewrr_initialize(props.ew_props.gpsRingName,
                                        10,
@@ -169,99 +227,83 @@ int main(int argc, char **argv)
         LOG_ERRMSG("%s: Error flusing the ring\n", fcnm);
         goto ERROR;
     }
-    // Begin the acquisition loop
+    // Begin the acquisition - the ring is drained on its own thread so that
+    // a slow inversion can't stall data ingest
     LOG_INFOMSG("%s: Beginning the acquisition...\n", fcnm);
+    acquisition.ringInfo = &ringInfo;
+    acquisition.snclIndex = &snclIndex;
+    acquisition.queue = &tb2Queue;
+    acquisition.waitTime = props.waitTime;
+    acquisition.t0 = (double) (long) (ISCL_time_timeStamp() + 0.5);
+    acquisition.ierr = 0;
+    acquisition.lacquire = true;
+    ierr = pthread_create(&acquisitionThreadID, NULL,
+                          acquisitionThread, &acquisition);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s: Error creating acquisition thread\n", fcnm);
+        goto ERROR;
+    }
+    lacquisitionThread = true;
     amqMessage = NULL;
-    t0 = (double) (long) (ISCL_time_timeStamp() + 0.5);
-    tbeg = t0; 
+    t0 = acquisition.t0;
     tstatus = t0;
     tstatus0 = t0;
+    // Run through the machine every waitTime seconds.  The ticks fall half
+    // way between the ring reads so that each tick's snapshot has been
+    // published by the time it is processed.
+    ierr = core_scheduler_initialize(props.waitTime,
+                                     t0 + 1.5*props.waitTime,
+                                     true, &scheduler);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s: Error initializing the scheduler\n", fcnm);
+        goto ERROR;
+    }
     lacquire = true;
     while(lacquire)
     {
         // Initialize the iteration
         amqMessage = NULL;
-        // Run through the machine every second
-        t1 = (double) (long) (ISCL_time_timeStamp() + 0.5);
-        if (t1 - t0 < props.waitTime){continue;}
-        t0 = t1;
-        tstatus1 = t0;
+        // Sleep until the next tick
+        t1 = core_scheduler_waitForNextTick(&scheduler, &ierr);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s: Error waiting for next tick\n", fcnm);
+            goto ERROR;
+        }
+        tstatus1 = t1;
         if (tstatus1 - tstatus0 > 3600.0)
         {
             LOG_DEBUGMSG("%s: GFAST has been running for %d hours\n",
                        fcnm, (int) ((tstatus1 - tstatus)/3600.0));
+            core_scheduler_printStatistics(scheduler);
+            LOG_DEBUGMSG("%s: Skipped %d ticks without new data\n",
+                         fcnm, nskipped);
             tstatus0 = tstatus1;
         } 
-//printf("start\n");
-double tbeger = ISCL_time_timeStamp();
-double tbeger0 = tbeger;
-        // Read my messages off the ring
-        memory_free8c(&msgs); //ISCL_memory_free__char(&msgs);
-        msgs = traceBuffer_ewrr_getMessagesFromRing(MAX_MESSAGES,
-                                                    false,
-                                                    &ringInfo,
-                                                    &nTracebufs2Read,
-                                                    &ierr);
-        if (ierr < 0 || (msgs == NULL && nTracebufs2Read > 0))
+        // Make sure the acquisition thread is still alive
+        if (!__atomic_load_n(&acquisition.lacquire, __ATOMIC_ACQUIRE))
         {
-            if (ierr ==-1)
-            {
-                LOG_ERRMSG("%s: Terminate message received from ring\n", fcnm);
-                ierr = 1;
-            }
-            else if (ierr ==-2)
-            {
-                LOG_ERRMSG("%s: Read error encountered on ring\n", fcnm);
-                ierr = 1;
-            }
-            else if (ierr ==-3)
-            {
-                LOG_ERRMSG("%s: Ring info structure never initialized\n", fcnm);
-                ierr = 1;
-            }
-            else if (msgs == NULL)
-            {
-                LOG_ERRMSG("%s: Message allocation error\n", fcnm);
-                ierr = 1;
-            }
+            LOG_ERRMSG("%s: Acquisition thread stopped\n", fcnm);
+            ierr = 1;
             goto ERROR;
         }
-        if (nTracebufs2Read == 0)
+        // Update the hdf5 buffers with the snapshots acquired since last tick.
+        // The processing time is that of the newest snapshot in the buffer.
+        while ((islot = traceBuffer_ewrr_tb2QueuePeek(&tb2Queue)) >= 0)
         {
-            //LOG_WARNMSG("%s: No data acquired\n", fcnm);
-        }
-//printf("scrounge %8.4f\n", ISCL_time_timeStamp() - tbeger);
-tbeger = ISCL_time_timeStamp();
-        // Unpackage the tracebuf2 messages
-        ierr = traceBuffer_ewrr_unpackTraceBuf2Messages(nTracebufs2Read,
-                                                        msgs, &tb2Data);
-        memory_free8c(&msgs);
-        if (ierr != 0)
-        {
-            LOG_ERRMSG("%s: Error unpacking tracebuf2 messages\n", fcnm);
-            goto ERROR;
-        }
-//printf("end %d %8.4f\n", nTracebufs2Read, ISCL_time_timeStamp() - tbeger);
-//tbeger = ISCL_time_timeStamp();
-//printf("end %d %8.4f\n", nTracebufs2Read, ISCL_time_timeStamp() - tbeger);
-tbeger = ISCL_time_timeStamp();
-        // Update the hdf5 buffers
-        ierr = traceBuffer_h5_setData(t1,
-                                      tb2Data,
-                                      h5traceBuffer);
-        if (ierr != 0)
-        {
-            LOG_ERRMSG("%s: Error setting data in H5 file\n", fcnm);
-            goto ERROR;
+            tdata = tb2Queue.times[islot];
+            ierr = traceBuffer_h5_setData(tb2Queue.times[islot],
+                                          tb2Queue.slots[islot],
+                                          h5traceBuffer);
+            traceBuffer_ewrr_tb2QueueRelease(&tb2Queue);
+            if (ierr != 0)
+            {
+                LOG_ERRMSG("%s: Error setting data in H5 file\n", fcnm);
+                goto ERROR;
+            }
         }
-//printf("update %8.4f\n", ISCL_time_timeStamp() - tbeger);
-//printf("full %8.4f\n", ISCL_time_timeStamp() - tbeger0);
-// early quit
- if (t1 - tbeg > 6200 && false)
-{
-//printf("premature shut down\n");
-//break;
-} 
         // Check my mail for an event
         msWait = props.activeMQ_props.msWaitForMessage;
         amqMessage = GFAST_activeMQ_consumer_getMessage(messageQueue,
@@ -330,18 +372,35 @@ printf("%s\n", amqMessage);
             free(amqMessage);
             amqMessage = NULL;
         } // End check on ActiveMQ message
-        // Are there events to process?
-        if (events.nev < 1){continue;} 
+        // Are there events and data to process?
+        if (events.nev < 1 || tdata < 0.0)
+        {
+            core_scheduler_endTick(&scheduler);
+            continue;
+        }
+        // A late acquisition tick leaves nothing new to process.  Running
+        // the inversions again would only repeat the last tick's messages.
+        if (tdata <= tprocessed)
+        {
+            nskipped = nskipped + 1;
+            LOG_WARNMSG("%s: No new data since %f; skipping tick (%d)\n",
+                        fcnm, tprocessed, nskipped);
+            core_scheduler_endTick(&scheduler);
+            continue;
+        }
+        tprocessed = tdata;
         if (props.verbose > 2)
         {
             LOG_DEBUGMSG("%s: Processing events...\n", fcnm);
         }
-        ierr = eewUtils_driveGFAST(t1, //currentTime,
+        ierr = eewUtils_driveGFAST(tdata, //currentTime,
                                    props,
                                    &events,
                                    &gps_data,
                                    &h5traceBuffer,
                                    &pgd_data,
+                                   &pgdTracker,
+                                   &offsetTracker,
                                    &cmt_data,
                                    &ff_data,
                                    &pgd,
@@ -384,10 +443,19 @@ printf("%s\n", amqMessage);
 //break;
 if (events.nev == 0){break;}
          }
+         core_scheduler_endTick(&scheduler);
     }
 ERROR:;
-    memory_free8c(&msgs);
+    if (scheduler.linit){core_scheduler_printStatistics(scheduler);}
+    if (lacquisitionThread)
+    {
+        __atomic_store_n(&acquisition.lacquire, false, __ATOMIC_RELEASE);
+        pthread_join(acquisitionThreadID, NULL);
+        if (acquisition.ierr != 0 && ierr == 0){ierr = acquisition.ierr;}
+    }
+    if (tb2Queue.linit){traceBuffer_ewrr_freetb2Queue(&tb2Queue);}
     traceBuffer_ewrr_freetb2Data(&tb2Data);
+    traceBuffer_sncl_finalize(&snclIndex);
     traceBuffer_ewrr_finalize(&ringInfo);
     activeMQ_consumer_finalize(messageQueue); 
     core_cmt_finalize(&props.cmt_props,
@@ -396,6 +464,8 @@ ERROR:;
     core_ff_finalize(&props.ff_props,
                      &ff_data,
                      &ff);
+    core_waveformProcessor_finalizePeakDisplacementTracker(&pgdTracker);
+    core_waveformProcessor_finalizeOffsetTracker(&offsetTracker);
     core_scaling_pgd_finalize(&props.pgd_props,
                               &pgd_data,
                               &pgd);
@@ -416,6 +486,7 @@ ERROR:;
  *
  * @param[in] gpsData      holds the GPS SNCL's GFAST is interested in
  *
+ * @param[out] snclIndex   on output maps each SNCL to its trace in tb2Data
  * @param[out] tb2Data     on output has space allocated and has a target
  *                         list of SNCL's for message reading from the 
  *                         earthworm data ring 
@@ -426,6 +497,7 @@ ERROR:;
  *
  */
 static int settb2DataFromGFAST(struct GFAST_data_struct gpsData,
+                               struct snclIndex_struct *snclIndex,
                                struct tb2Data_struct *tb2Data)
 {
     const char *fcnm = "settb2DataFromH5TraceBuffer\0";
@@ -444,6 +516,11 @@ static int settb2DataFromGFAST(struct GFAST_data_struct gpsData,
     tb2Data->traces = (struct tb2Trace_struct *)
                       calloc( (size_t) tb2Data->ntraces,
                               sizeof(struct tb2Trace_struct) );
+    if (traceBuffer_sncl_initialize(tb2Data->ntraces, snclIndex) != 0)
+    {
+        LOG_ERRMSG("%s: Error initializing SNCL index\n", fcnm);
+        return -1;
+    }
     it = 0;
     for (k=0; k<gpsData.stream_length; k++)
     {
@@ -453,6 +530,17 @@ static int settb2DataFromGFAST(struct GFAST_data_struct gpsData,
             strcpy(tb2Data->traces[it].stnm, gpsData.data[k].stnm);
             strcpy(tb2Data->traces[it].chan, gpsData.data[k].chan[i]);
             strcpy(tb2Data->traces[it].loc,  gpsData.data[k].loc); 
+            if (traceBuffer_sncl_insert(gpsData.data[k].netw,
+                                        gpsData.data[k].stnm,
+                                        gpsData.data[k].chan[i],
+                                        gpsData.data[k].loc,
+                                        snclIndex) != it)
+            {
+                LOG_ERRMSG("%s: Duplicate or invalid SNCL %s.%s.%s.%s\n",
+                           fcnm, gpsData.data[k].netw, gpsData.data[k].stnm,
+                           gpsData.data[k].chan[i], gpsData.data[k].loc);
+                return -1;
+            }
             it = it + 1;
         }
     }
@@ -464,3 +552,135 @@ static int settb2DataFromGFAST(struct GFAST_data_struct gpsData,
     tb2Data->linit = true;
     return 0;
 }
+//============================================================================//
+/*!
+ * @brief Acquisition thread.  Drains the earthworm ring every waitTime
+ *        seconds, unpacks the tracebuf2 messages, and publishes the
+ *        unpacked data as a snapshot on the tb2 queue for the processing
+ *        thread.  Should the queue be full then the ring is still drained
+ *        and the reads are appended to the queue's backlog, which is
+ *        published as one snapshot once a slot frees up.  Hence, the ring
+ *        can't wrap however long a tick takes and the backlog grows by
+ *        one read (at most MAX_MESSAGES messages) per stalled tick.
+ *
+ * @param[in,out] args    acquisition_struct holding the ring, queue, and
+ *                        the run flag.  on exit, ierr is non-zero if the
+ *                        thread stopped because of an error.
+ *
+ * @result NULL
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+static void *acquisitionThread(void *args)
+{
+    struct acquisition_struct *acquisition;
+    struct GFAST_scheduler_struct scheduler;
+    struct tb2Queue_struct *queue;
+    const char *msgs;
+    double t0, t1;
+    int ierr, islot, nTracebufs2Read;
+    //------------------------------------------------------------------------//
+    //
+    acquisition = (struct acquisition_struct *) args;
+    msgs = NULL;
+    t0 = acquisition->t0;
+    ierr = core_scheduler_initialize(acquisition->waitTime,
+                                     t0 + acquisition->waitTime,
+                                     true, &scheduler);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error initializing acquisition scheduler");
+        goto ERROR;
+    }
+    while (__atomic_load_n(&acquisition->lacquire, __ATOMIC_ACQUIRE))
+    {
+        t1 = core_scheduler_waitForNextTick(&scheduler, &ierr);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error waiting for next tick");
+            goto ERROR;
+        }
+        // Always drain the ring so that it can't wrap during a long tick
+        msgs = traceBuffer_ewrr_getMessagesFromRing(MAX_MESSAGES,
+                                                    false,
+                                                    acquisition->ringInfo,
+                                                    &nTracebufs2Read,
+                                                    &ierr);
+        if (ierr < 0 || (msgs == NULL && nTracebufs2Read > 0))
+        {
+            if (ierr ==-1)
+            {
+                LOG_ERRMSG("%s", "Terminate message received from ring");
+            }
+            else if (ierr ==-2)
+            {
+                LOG_ERRMSG("%s", "Read error encountered on ring");
+            }
+            else if (ierr ==-3)
+            {
+                LOG_ERRMSG("%s", "Ring info structure never initialized");
+            }
+            else if (msgs == NULL)
+            {
+                LOG_ERRMSG("%s", "Message allocation error");
+            }
+            ierr = 1;
+            goto ERROR;
+        }
+        // Get a slot to unpack into
+        queue = acquisition->queue;
+        islot = traceBuffer_ewrr_tb2QueueReserve(queue);
+        if (islot >= 0 && !queue->lbacklog)
+        {
+            ierr = traceBuffer_ewrr_unpackTraceBuf2Messages(
+                       nTracebufs2Read, msgs,
+                       acquisition->ringInfo->msgOffset,
+                       acquisition->snclIndex,
+                       false,
+                       &queue->slots[islot]);
+            if (ierr != 0)
+            {
+                LOG_ERRMSG("%s", "Error unpacking tracebuf2 messages");
+                goto ERROR;
+            }
+            // Hand the snapshot to the processing thread
+            queue->times[islot] = t1;
+            traceBuffer_ewrr_tb2QueuePublish(queue);
+        }
+        else
+        {
+            // Append to the reads that are waiting on a free slot
+            ierr = traceBuffer_ewrr_unpackTraceBuf2Messages(
+                       nTracebufs2Read, msgs,
+                       acquisition->ringInfo->msgOffset,
+                       acquisition->snclIndex,
+                       queue->lbacklog,
+                       &queue->backlog);
+            if (ierr != 0)
+            {
+                LOG_ERRMSG("%s", "Error unpacking tracebuf2 messages");
+                goto ERROR;
+            }
+            if (islot < 0 && !queue->lbacklog)
+            {
+                LOG_WARNMSG("%s", "tb2Queue full; buffering ring reads");
+            }
+            queue->lbacklog = true;
+            if (islot < 0)
+            {
+                queue->noverflow = queue->noverflow + 1;
+            }
+            else
+            {
+                traceBuffer_ewrr_tb2QueuePublishBacklog(queue, t1);
+            }
+        }
+        core_scheduler_endTick(&scheduler);
+    }
+ERROR:;
+    if (scheduler.linit){core_scheduler_printStatistics(scheduler);}
+    if (ierr != 0){acquisition->ierr = ierr;}
+    __atomic_store_n(&acquisition->lacquire, false, __ATOMIC_RELEASE);
+    return NULL;
+}
@@ -21,10 +21,13 @@ int main(int argc, char *argv[])
     struct h5traceBuffer_struct h5traceBuffer;
     struct GFAST_offsetData_struct cmt_data, ff_data;
     struct GFAST_peakDisplacementData_struct pgd_data;
+    struct GFAST_peakDisplacementTracker_struct pgdTracker;
+    struct GFAST_offsetTracker_struct offsetTracker;
     struct GFAST_pgdResults_struct pgd;
     struct GFAST_props_struct props;
     struct GFAST_shakeAlert_struct SA;
     struct GFAST_xmlMessages_struct xmlMessages;
+    struct GFAST_scheduler_struct scheduler;
     char errorLogFileName[PATH_MAX];
     char infoLogFileName[PATH_MAX];
     char debugLogFileName[PATH_MAX];
@@ -63,10 +66,13 @@ int main(int argc, char *argv[])
     memset(&cmt, 0, sizeof(struct GFAST_cmtResults_struct));
     memset(&ff, 0, sizeof(struct GFAST_ffResults_struct));
     memset(&pgd_data, 0, sizeof( struct GFAST_peakDisplacementData_struct));
+    memset(&pgdTracker, 0, sizeof(struct GFAST_peakDisplacementTracker_struct));
+    memset(&offsetTracker, 0, sizeof(struct GFAST_offsetTracker_struct));
     memset(&cmt_data, 0, sizeof(struct GFAST_offsetData_struct));
     memset(&ff_data, 0, sizeof(struct GFAST_offsetData_struct));
     memset(&xmlMessages, 0, sizeof(struct GFAST_xmlMessages_struct));
     memset(&h5traceBuffer, 0, sizeof(struct h5traceBuffer_struct)); 
+    memset(&scheduler, 0, sizeof(struct GFAST_scheduler_struct));
     // Read the properties file
     LOG_INFOMSG("%s: Reading the properties file...\n", fcnm);
     ierr = GFAST_core_properties_initialize(propfilename, opmode, &props);
@@ -162,6 +168,13 @@ int main(int argc, char *argv[])
     }
     t0sim = SA.time;
     tbeg = time_timeStamp();
+    // Simulate the ticks - there's no reason to sleep in playback
+    ierr = core_scheduler_initialize(dtmax, t0sim, false, &scheduler);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s: Error initializing the scheduler\n", fcnm);
+        goto ERROR;
+    }
     // Loop on time steps in simulation
     for (kt=0; kt<ntsim; kt++)
     {
@@ -217,13 +230,20 @@ int main(int argc, char *argv[])
             }
         }
         // Compute the current time
-        currentTime = t0sim + (double) kt*dtmax;
+        currentTime = core_scheduler_waitForNextTick(&scheduler, &ierr);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s: Error advancing the scheduler\n", fcnm);
+            break;
+        }
         ierr = eewUtils_driveGFAST(currentTime,
                                    props,
                                    &events,
                                    &gps_data,
                                    &h5traceBuffer,
                                    &pgd_data,
+                                   &pgdTracker,
+                                   &offsetTracker,
                                    &cmt_data,
                                    &ff_data,
                                    &pgd,
@@ -262,8 +282,10 @@ int main(int argc, char *argv[])
              if (xmlMessages.pgdXML != NULL){free(xmlMessages.pgdXML);}
              memset(&xmlMessages, 0, sizeof(struct GFAST_xmlMessages_struct));
          }
+         core_scheduler_endTick(&scheduler);
     }
     LOG_INFOMSG("%s: Simultation time: %f\n", fcnm, time_timeStamp() - tbeg);
+    if (props.verbose > 0){core_scheduler_printStatistics(scheduler);}
 ERROR:;
     if (elarms_xml_message != NULL){free(elarms_xml_message);}
     core_cmt_finalize(&props.cmt_props,
@@ -272,6 +294,8 @@ ERROR:;
     core_ff_finalize(&props.ff_props,
                      &ff_data,
                      &ff);
+    core_waveformProcessor_finalizePeakDisplacementTracker(&pgdTracker);
+    core_waveformProcessor_finalizeOffsetTracker(&offsetTracker);
     core_scaling_pgd_finalize(&props.pgd_props,
                               &pgd_data,
                               &pgd);
@@ -249,7 +249,7 @@ int hdf5_copyPGDResults(const enum data2h5_enum job,
         cblas_dcopy((int) nloc, pgd->mpgd_vr, 1, h5_pgd->mpgd_vr.p, 1);
 
         h5_pgd->dep_vr_pgd.len = nloc;
-        h5_pgd->dep_vr_pgd.p = (double *)calloc(ndeps, sizeof(double));
+        h5_pgd->dep_vr_pgd.p = (double *)calloc(nloc, sizeof(double));
         cblas_dcopy((int) nloc, pgd->dep_vr_pgd, 1, h5_pgd->dep_vr_pgd.p, 1);
 
         h5_pgd->UP.len = nsites*nloc; //ndeps;
@@ -4,6 +4,7 @@
 #include <string.h>
 #include "gfast_traceBuffer.h"
 #include "gfast_core.h"
+#include "iscl/memory/memory.h"
 /*!
  * @brief Disconnects from the ring and clears the earthworm ring structure.
  *
@@ -30,6 +31,8 @@ int traceBuffer_ewrr_finalize(struct ewRing_struct *ringInfo)
     {
         free(ringInfo->getLogo);
     }
+    memory_free8c(&ringInfo->msgArena);
+    memory_free32i(&ringInfo->msgOffset);
     tport_detach(&ringInfo->region);
     memset(ringInfo, 0, sizeof(struct ewRing_struct));
     return 0;
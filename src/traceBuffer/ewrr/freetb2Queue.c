@@ -0,0 +1,39 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_traceBuffer.h"
+#include "gfast_core.h"
+#include "iscl/memory/memory.h"
+
+/*!
+ * @brief Releases memory on the tb2 snapshot queue.
+ *
+ * @param[in,out] queue     On input the initialized queue. <br>
+ *                          On output the structure has been cleared.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+void traceBuffer_ewrr_freetb2Queue(struct tb2Queue_struct *queue)
+{
+    int i;
+    if (!queue->linit)
+    {
+        LOG_WARNMSG("%s", "Structure never set");
+        return;
+    }
+    if (queue->slots != NULL)
+    {
+        for (i=0; i<queue->nslots; i++)
+        {
+            traceBuffer_ewrr_freetb2Data(&queue->slots[i]);
+        }
+        free(queue->slots);
+    }
+    traceBuffer_ewrr_freetb2Data(&queue->backlog);
+    memory_free64f(&queue->times);
+    memset(queue, 0, sizeof(struct tb2Queue_struct));
+    return;
+}
@@ -29,6 +29,8 @@ void traceBfufer_ewrr_freetb2Trace(const bool clearSNCL,
     memory_free32i(&trace->chunkPtr);
     trace->nchunks = 0;
     trace->npts = 0;
+    trace->maxpts = 0;
+    trace->maxchunks = 0;
     trace->dt = 0.0;
     if (clearSNCL)
     {
@@ -8,19 +8,20 @@
 
 /*!
  * @brief Reads the tracebuffer2 messages from the Earthworm ring specified
- *        on ringInfo.
+ *        on ringInfo.  The messages are copied straight off the ring into
+ *        the message arena on ringInfo where they are packed at their
+ *        actual length.  The arena is retained between calls and only grows
+ *        when a read exceeds its capacity.
  *
- * @param[in] messageBlock   Block allocator size.  Instead of reallocating
- *                           memory every loop iteration in the acquisition
- *                           one can allocate in a chunk of messages (e.g.
- *                           200 messages at a time i.e. messageBlock = 200).
- *                           If this number is too small there will be 
- *                           overhead in memory reallocation, if this number
- *                           is too big a lot of unnecessary space will be
- *                           allocated. 
- * @param[in] showWarnings   If true then the print warnings about having read
- *                           maximum number of messages.
- * @param[in] ringInfo       Earthworm ring reader structure.
+ * @param[in] messageBlock   Block allocator size.  The arena and its offset
+ *                           table are initially sized to hold this many
+ *                           messages and then grow geometrically.
+ * @param[in] showWarnings   If true then the print warnings about having to
+ *                           grow the message arena.
+ * @param[in,out] ringInfo   Earthworm ring reader structure.  On output the
+ *                           msgOffset table holds the start index of each
+ *                           message in the arena [nRead+1].  The length of
+ *                           the k'th message is msgOffset[k+1] - msgOffset[k].
  *
  * @param[out] nRead         Number of traceBuffer2 messages read.
  *
@@ -33,60 +34,57 @@
  *                             initalized. <br> 
  *                          -4 Indicates tracebuf2 type is unknown.
  *
- * @result An array of [nRead] traceBuffer2 messages read from the Earthworm
- *         ring.  The k'th message start index (for k=1,2,...,nRead) is given
- *         by: (k - 1)*MAX_TRACEBUF_SIZE [nRead*MAX_TRACEBUF_SIZE]
+ * @result The message arena holding the [nRead] traceBuffer2 messages read
+ *         from the Earthworm ring.  The k'th message (for k=0,1,...,nRead-1)
+ *         begins at ringInfo->msgOffset[k].  This memory is owned by
+ *         ringInfo and is released by traceBuffer_ewrr_finalize.  It is
+ *         overwritten by the next read.
  *
  * @author Ben Baker
  *
  * @copyright ISTI distribted under Apache 2.
  *
  */
-char *traceBuffer_ewrr_getMessagesFromRing(const int messageBlock,
-                                           const bool showWarnings,
-                                           struct ewRing_struct *ringInfo,
-                                           int *nRead, int *ierr)
+const char *traceBuffer_ewrr_getMessagesFromRing(const int messageBlock,
+                                                 const bool showWarnings,
+                                                 struct ewRing_struct *ringInfo,
+                                                 int *nRead, int *ierr)
 {
     MSG_LOGO gotLogo; 
     TRACE2_HEADER traceHeader;
-    char *msg, *msgs, *msgWork;
+    char *msgWork;
+    int *offsetWork;
     unsigned char sequenceNumber;
     long gotSize;
-    int kdx, nblock, ncopy, nwork, retval;
-    //size_t nbytes; //, npcopy;
+    int kdx, nwork, retval;
     //------------------------------------------------------------------------//
     //  
     // Make sure this is initialized
     *ierr = 0;
     *nRead = 0;
-    msg = NULL;
-    msgs = NULL;
     if (!ringInfo->linit)
     {
         LOG_ERRMSG("%s", "Error ringInfo not initialized");
         *ierr =-3;
-        return msgs;
+        return NULL;
     }
-    // Avoid a segfault
-/*
-    if (maxMessages < 1 || msg == NULL)
-    {
-        if (maxMessages < 1){LOG_ERRMSG("%s", "Error no space");}
-        if (msgs == NULL){LOG_ERRMSG("%s", "Error messages is NULL");}
-        return -4;
-    }
-*/
     if (messageBlock < 1)
     {
         LOG_ERRMSG("%s", "messageBlock allocator must be postiive");
         *ierr =-4;
-        return msgs;
+        return ringInfo->msgArena;
     }
-    // Set space
+    // Set space on the first read
     memset(&gotLogo, 0, sizeof(MSG_LOGO));
-    msgs = memory_calloc8c(MAX_TRACEBUF_SIZ*messageBlock);
-    msg  = memory_calloc8c(MAX_TRACEBUF_SIZ);
-    nblock = 1;
+    if (ringInfo->msgArena == NULL)
+    {
+        ringInfo->nArena = MAX_TRACEBUF_SIZ*messageBlock;
+        ringInfo->msgArena = memory_calloc8c(ringInfo->nArena);
+        ringInfo->maxMessages = messageBlock;
+        ringInfo->msgOffset = memory_calloc32i(ringInfo->maxMessages + 1);
+    }
+    kdx = 0;
+    ringInfo->msgOffset[0] = 0;
     // Unpack the ring
     while (true)
     {
@@ -97,12 +95,27 @@ char *traceBuffer_ewrr_getMessagesFromRing(const int messageBlock,
             LOG_ERRMSG("Receiving kill signal from ring %s",
                        ringInfo->ewRingName);
             *ierr =-1;
-            return msgs;
+            return ringInfo->msgArena;
+        }
+        // Make sure the largest possible message will fit
+        if (ringInfo->nArena - kdx < MAX_TRACEBUF_SIZ)
+        {
+            if (showWarnings)
+            {
+                LOG_WARNMSG("%s", "Growing message arena");
+            }
+            nwork = 2*ringInfo->nArena;
+            msgWork = memory_calloc8c(nwork);
+            memcpy(msgWork, ringInfo->msgArena, (size_t) kdx);
+            memory_free8c(&ringInfo->msgArena);
+            ringInfo->msgArena = msgWork;
+            ringInfo->nArena = nwork;
         }
-        // Copy from the memory
+        // Copy from the ring straight onto the arena
         retval = tport_copyfrom(&ringInfo->region,
                                 ringInfo->getLogo, ringInfo->nlogo,
-                                &gotLogo, &gotSize, msg, MAX_TRACEBUF_SIZ,
+                                &gotLogo, &gotSize,
+                                &ringInfo->msgArena[kdx], MAX_TRACEBUF_SIZ,
                                 &sequenceNumber);
         // Classify my message
         retval = traceBuffer_ewrr_classifyGetRetval(retval);
@@ -110,59 +123,43 @@ char *traceBuffer_ewrr_getMessagesFromRing(const int messageBlock,
         {
             LOG_ERRMSG("%s", "An error was encountered getting message");
             *ierr =-2;
-            return msgs;
+            return ringInfo->msgArena;
         }
+        // End of ring - time to leave
+        if (retval == 0){break;}
         // Verify i want this message
-        if (gotLogo.type == ringInfo->traceBuffer2Type)
+        if (gotLogo.type != ringInfo->traceBuffer2Type){continue;}
+        if (gotSize < (long) sizeof(TRACE2_HEADER) ||
+            gotSize > MAX_TRACEBUF_SIZ)
         {
-            // Get the header
-            memcpy(&traceHeader, msg, sizeof(TRACE2_HEADER));
-            *ierr = WaveMsg2MakeLocal(&traceHeader);
-            if (*ierr < 0)
-            {
-                LOG_ERRMSG("%s", "Error flipping bytes");
-                *ierr =-2;
-                return msgs;
-            }
-            //nbytes = sizeof(int); 
-            //if (strcasecmp(traceHeader.datatype, "s2\0") == 0 ||
-            //    strcasecmp(traceHeader.datatype, "i2\0") == 0)
-            //{
-            //    nbytes = sizeof(short);
-            //}
-            //npcopy = (size_t) ( sizeof(TRACE2_HEADER)*sizeof(char)
-            //                  + (size_t) (traceHeader.nsamp)*nbytes);
-            // Copy the message
-            kdx = *nRead*MAX_TRACEBUF_SIZ;
-            memcpy(&msgs[kdx], msg, MAX_TRACEBUF_SIZ*sizeof(char));
-            // Reallocate space 
-            *nRead = *nRead + 1;
-            if (*nRead == messageBlock*nblock)
-            {
-                if (showWarnings)
-                {
-                    LOG_WARNMSG("%s", "Reallocating msgs block");
-                }
-                // get workspace sizes
-                nwork = MAX_TRACEBUF_SIZ*(*nRead + nblock*messageBlock);
-                ncopy = MAX_TRACEBUF_SIZ*(*nRead);
-                // set workspace and copy old messages
-                msgWork = memory_calloc8c(ncopy);
-                memcpy(msgWork, msgs, (size_t) ncopy);
-                // resize msgs
-                memory_free8c(&msgs);
-                msgs = memory_calloc8c(nwork);
-                // copy back and free workspace
-                memcpy(msgs, msgWork, (size_t) ncopy);
-                memory_free8c(&msgWork);
-                // Update block alloc
-                nblock = nblock + 1;
-            }
+            LOG_WARNMSG("Skipping message of invalid size %ld", gotSize);
+            continue;
         }
-        // End of ring - time to leave
-        if (retval == GET_NONE){break;}
+        // Check the header
+        memcpy(&traceHeader, &ringInfo->msgArena[kdx],
+               sizeof(TRACE2_HEADER));
+        *ierr = WaveMsg2MakeLocal(&traceHeader);
+        if (*ierr < 0)
+        {
+            LOG_ERRMSG("%s", "Error flipping bytes");
+            *ierr =-2;
+            return ringInfo->msgArena;
+        }
+        // Keep the message
+        kdx = kdx + (int) gotSize;
+        *nRead = *nRead + 1;
+        if (*nRead == ringInfo->maxMessages)
+        {
+            nwork = 2*ringInfo->maxMessages;
+            offsetWork = memory_calloc32i(nwork + 1);
+            memcpy(offsetWork, ringInfo->msgOffset,
+                   (size_t) (*nRead)*sizeof(int));
+            memory_free32i(&ringInfo->msgOffset);
+            ringInfo->msgOffset = offsetWork;
+            ringInfo->maxMessages = nwork;
+        }
+        ringInfo->msgOffset[*nRead] = kdx;
     }
-    memory_free8c(&msg);
     if (ringInfo->msWait > 0){sleep_ew(ringInfo->msWait);}
-    return msgs;
+    return ringInfo->msgArena;
 }
@@ -0,0 +1,101 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_traceBuffer.h"
+#include "gfast_core.h"
+#include "iscl/memory/memory.h"
+
+/*!
+ * @brief Initializes the queue through which the acquisition thread hands
+ *        unpacked tracebuf2 snapshots to the processing thread.
+ *
+ * @param[in] nslots    number of slots in the queue.  at most nslots-1
+ *                      snapshots can be pending.  this must be at least 2.
+ * @param[in] tb2Data   holds the SNCL's to retain from each ring read.  each
+ *                      slot in the queue receives a copy of this SNCL list.
+ *
+ * @param[out] queue    on successful output contains nslots initialized
+ *                      tb2Data structures ready to be unpacked into as well
+ *                      as the producer's backlog.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_ewrr_initializetb2Queue(const int nslots,
+                                        struct tb2Data_struct tb2Data,
+                                        struct tb2Queue_struct *queue)
+{
+    struct tb2Data_struct *slot;
+    int i, k;
+    //------------------------------------------------------------------------//
+    //
+    memset(queue, 0, sizeof(struct tb2Queue_struct));
+    if (nslots < 2)
+    {
+        LOG_ERRMSG("Invalid number of slots %d", nslots);
+        return -1;
+    }
+    if (!tb2Data.linit || tb2Data.ntraces < 1)
+    {
+        LOG_ERRMSG("%s", "tb2Data has no traces");
+        return -1;
+    }
+    queue->slots = (struct tb2Data_struct *)
+                   calloc( (size_t) nslots, sizeof(struct tb2Data_struct) );
+    queue->times = memory_calloc64f(nslots);
+    if (queue->slots == NULL || queue->times == NULL)
+    {
+        LOG_ERRMSG("%s", "Error allocating queue slots");
+        goto ERROR;
+    }
+    // The last pass sets the backlog
+    for (i=0; i<=nslots; i++)
+    {
+        slot = &queue->backlog;
+        if (i < nslots){slot = &queue->slots[i];}
+        slot->traces = (struct tb2Trace_struct *)
+                       calloc( (size_t) tb2Data.ntraces,
+                               sizeof(struct tb2Trace_struct) );
+        if (slot->traces == NULL)
+        {
+            LOG_ERRMSG("Error allocating traces for slot %d", i);
+            goto ERROR;
+        }
+        for (k=0; k<tb2Data.ntraces; k++)
+        {
+            strcpy(slot->traces[k].netw, tb2Data.traces[k].netw);
+            strcpy(slot->traces[k].stnm, tb2Data.traces[k].stnm);
+            strcpy(slot->traces[k].chan, tb2Data.traces[k].chan);
+            strcpy(slot->traces[k].loc,  tb2Data.traces[k].loc);
+        }
+        slot->ntraces = tb2Data.ntraces;
+        slot->linit = true;
+    }
+    queue->nslots = nslots;
+    queue->head = 0;
+    queue->tail = 0;
+    queue->lbacklog = false;
+    queue->linit = true;
+    return 0;
+ERROR:;
+    // Release the copies made before the failure
+    if (queue->slots != NULL)
+    {
+        for (i=0; i<nslots; i++)
+        {
+            if (queue->slots[i].linit)
+            {
+                traceBuffer_ewrr_freetb2Data(&queue->slots[i]);
+            }
+        }
+        free(queue->slots);
+    }
+    if (queue->backlog.linit){traceBuffer_ewrr_freetb2Data(&queue->backlog);}
+    memory_free64f(&queue->times);
+    memset(queue, 0, sizeof(struct tb2Queue_struct));
+    return -1;
+}
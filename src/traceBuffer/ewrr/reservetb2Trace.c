@@ -0,0 +1,72 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_traceBuffer.h"
+#include "gfast_core.h"
+#include "iscl/memory/memory.h"
+
+/*!
+ * @brief Makes sure the staging buffers on the tb2Trace_struct can hold
+ *        at least maxpts samples and maxchunks chunks.  The buffers are
+ *        grown geometrically so that repeated appends are amortized O(1).
+ *        Existing samples and chunk pointers are preserved.
+ *
+ * @param[in] maxpts      required number of samples
+ * @param[in] maxchunks   required number of chunks
+ *
+ * @param[in,out] trace   on input contains the staging buffers.
+ *                        on output the staging buffers are at least
+ *                        maxpts and maxchunks in length.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_ewrr_reservetb2Trace(const int maxpts, const int maxchunks,
+                                     struct tb2Trace_struct *trace)
+{
+    double *times;
+    int *chunkPtr, *data, n;
+    //------------------------------------------------------------------------//
+    if (maxpts < 0 || maxchunks < 0)
+    {
+        LOG_ERRMSG("Invalid sizes %d %d", maxpts, maxchunks);
+        return -1;
+    }
+    if (maxpts > trace->maxpts)
+    {
+        n = 2*trace->maxpts;
+        if (n < maxpts){n = maxpts;}
+        data = memory_calloc32i(n);
+        times = memory_calloc64f(n);
+        if (trace->npts > 0)
+        {
+            memcpy(data, trace->data, (size_t) trace->npts*sizeof(int));
+            memcpy(times, trace->times,
+                   (size_t) trace->npts*sizeof(double));
+        }
+        memory_free32i(&trace->data);
+        memory_free64f(&trace->times);
+        trace->data = data;
+        trace->times = times;
+        trace->maxpts = n;
+    }
+    if (maxchunks > trace->maxchunks)
+    {
+        n = 2*trace->maxchunks;
+        if (n < maxchunks){n = maxchunks;}
+        chunkPtr = memory_calloc32i(n + 1);
+        if (trace->nchunks > 0)
+        {
+            memcpy(chunkPtr, trace->chunkPtr,
+                   (size_t) (trace->nchunks + 1)*sizeof(int));
+        }
+        memory_free32i(&trace->chunkPtr);
+        trace->chunkPtr = chunkPtr;
+        trace->maxchunks = n;
+    }
+    return 0;
+}
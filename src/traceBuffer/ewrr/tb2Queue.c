@@ -0,0 +1,130 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include "gfast_traceBuffer.h"
+
+/*!
+ * @brief Returns the slot into which the producer (acquisition) thread may
+ *        unpack the next snapshot.  The slot is not visible to the consumer
+ *        until traceBuffer_ewrr_tb2QueuePublish() is called.
+ *
+ * @param[in] queue     initialized tb2 snapshot queue
+ *
+ * @result the index of queue->slots to write to.  if -1 then the queue
+ *         is full.
+ *
+ * @note This may only be called from the single producer thread.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_ewrr_tb2QueueReserve(struct tb2Queue_struct *queue)
+{
+    int head, next, tail;
+    head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    tail = __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE);
+    next = (head + 1)%queue->nslots;
+    if (next == tail){return -1;}
+    return head;
+}
+//============================================================================//
+/*!
+ * @brief Makes the reserved slot visible to the consumer (processing)
+ *        thread.
+ *
+ * @param[in,out] queue  on output the head of the queue has advanced
+ *
+ * @note This may only be called from the single producer thread.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+void traceBuffer_ewrr_tb2QueuePublish(struct tb2Queue_struct *queue)
+{
+    int head;
+    head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    __atomic_store_n(&queue->head, (head + 1)%queue->nslots, __ATOMIC_RELEASE);
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Returns the oldest published snapshot.
+ *
+ * @param[in] queue     initialized tb2 snapshot queue
+ *
+ * @result the index of queue->slots to read from.  if -1 then the queue
+ *         is empty.
+ *
+ * @note This may only be called from the single consumer thread.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_ewrr_tb2QueuePeek(struct tb2Queue_struct *queue)
+{
+    int head, tail;
+    tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    head = __atomic_load_n(&queue->head, __ATOMIC_ACQUIRE);
+    if (head == tail){return -1;}
+    return tail;
+}
+//============================================================================//
+/*!
+ * @brief Returns the oldest published snapshot's slot to the producer.
+ *
+ * @param[in,out] queue  on output the tail of the queue has advanced
+ *
+ * @note This may only be called from the single consumer thread.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+void traceBuffer_ewrr_tb2QueueRelease(struct tb2Queue_struct *queue)
+{
+    int tail;
+    tail = __atomic_load_n(&queue->tail, __ATOMIC_RELAXED);
+    __atomic_store_n(&queue->tail, (tail + 1)%queue->nslots, __ATOMIC_RELEASE);
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Publishes the reads accumulated in the backlog while the queue was
+ *        full.  The backlog is exchanged with the reserved slot so no data
+ *        is copied and the slot's buffers become the next backlog.
+ *
+ * @param[in,out] queue  on input the producer has reserved a slot with
+ *                       traceBuffer_ewrr_tb2QueueReserve() and holds reads
+ *                       in the backlog.
+ *                       on output the backlog has been published and the
+ *                       head of the queue has advanced.
+ * @param[in] time       epochal time (UTC seconds) of the newest read in
+ *                       the backlog
+ *
+ * @note This may only be called from the single producer thread.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+void traceBuffer_ewrr_tb2QueuePublishBacklog(struct tb2Queue_struct *queue,
+                                             const double time)
+{
+    struct tb2Data_struct work;
+    int head;
+    head = __atomic_load_n(&queue->head, __ATOMIC_RELAXED);
+    work = queue->slots[head];
+    queue->slots[head] = queue->backlog;
+    queue->backlog = work;
+    queue->times[head] = time;
+    queue->lbacklog = false;
+    traceBuffer_ewrr_tb2QueuePublish(queue);
+    return;
+}
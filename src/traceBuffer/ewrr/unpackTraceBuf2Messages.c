@@ -2,38 +2,79 @@
 #include <stdlib.h>
 #include <string.h>
 #include <math.h>
+#include <stdint.h>
 #include "gfast_traceBuffer.h"
 #include "gfast_core.h"
 #include "iscl/array/array.h"
 #include "iscl/memory/memory.h"
-#include "iscl/sorting/sorting.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define UNPACK_USE_X86 1
+#endif
 
 static void fastUnpackI4(const int npts, const int lswap,
+                         const double t0, const double dt,
                          const char *__restrict__ msg,
-                         int *__restrict__ resp);
+                         int *__restrict__ resp,
+                         double *__restrict__ times);
 static void fastUnpackI2(const int npts, const int lswap,
+                         const double t0, const double dt,
                          const char *__restrict__ msg,
-                         int *__restrict__ resp);
-static int fastUnpack(const int npts, const int lswap,
-                      const int type,
-                      const char *__restrict__ msg,
-                      int *__restrict__ resp);
+                         int *__restrict__ resp,
+                         double *__restrict__ times);
+#ifdef UNPACK_USE_X86
+static void fastUnpackI4_avx2(const int npts, const int lswap,
+                              const double t0, const double dt,
+                              const char *__restrict__ msg,
+                              int *__restrict__ resp,
+                              double *__restrict__ times);
+static void fastUnpackI2_avx2(const int npts, const int lswap,
+                              const double t0, const double dt,
+                              const char *__restrict__ msg,
+                              int *__restrict__ resp,
+                              double *__restrict__ times);
+static void fastUnpackI4_sse41(const int npts, const int lswap,
+                               const double t0, const double dt,
+                               const char *__restrict__ msg,
+                               int *__restrict__ resp,
+                               double *__restrict__ times);
+static void fastUnpackI2_sse41(const int npts, const int lswap,
+                               const double t0, const double dt,
+                               const char *__restrict__ msg,
+                               int *__restrict__ resp,
+                               double *__restrict__ times);
+#endif
 
 /*!
  * @brief Unpacks the tracebuf2 messages read from the ring and returns
- *        the concatenated data for the desired SNCL's in the tb2Data struct
+ *        the concatenated data for the desired SNCL's in the tb2Data struct.
+ *        Each message header is parsed once, routed to its trace with the
+ *        SNCL index, and its samples are appended to that trace's staging
+ *        buffers.  The staging buffers are retained between calls and only
+ *        grown when a read exceeds their capacity.
  *
  * @param[in] nRead          number of traces read off the ring
- * @param[in] msgs           tracebuf2 messages read off ring.  the i'th message
- *                           is given by (i-1)*MAX_TRACEBUF_SIZ for
- *                           i=1,2,...,nRead
+ * @param[in] msgs           tracebuf2 messages read off ring packed at their
+ *                           actual length
+ * @param[in] msgOffset      the i'th message begins at msgs[msgOffset[i]]
+ *                           and is msgOffset[i+1] - msgOffset[i] bytes long
+ *                           [nRead+1]
+ * @param[in] snclIndex      maps a SNCL to its trace in tb2Data.  the k'th
+ *                           trace in tb2Data must have id k in the index.
+ * @param[in] lappend        if true then the messages are appended to the
+ *                           data already in tb2Data.  otherwise, the data
+ *                           from the previous read is discarded.
  *
  * @param[in,out] tb2Data    on input contains the desired SNCL's whose data 
  *                           will be unpacked from the header (should it be
  *                           present).  
  *                           on output contains the data in the messages for
  *                           the SNCL's defined in this structure (should a 
- *                           match be found).
+ *                           match be found).  the samples are in the order
+ *                           in which the messages were read and a new chunk
+ *                           begins whenever a message is not contiguous with
+ *                           its predecessor.
  *
  * @result 0 indicates success
  *
@@ -45,18 +86,16 @@ static int fastUnpack(const int npts, const int lswap,
 int traceBuffer_ewrr_unpackTraceBuf2Messages(
     const int nRead,
     const char *msgs,
+    const int *msgOffset,
+    const struct snclIndex_struct *snclIndex,
+    const bool lappend,
     struct tb2Data_struct *tb2Data)
 {
-    char *msg, netw[64], stat[64], chan[64], loc[64];
+    struct tb2Trace_struct *trace;
     TRACE2_HEADER traceHeader;
-    //long *longData;
-    //short *shortData;
-    double *times, dt;
-    int *imap, *imapPtr, *imsg, *iperm, *kpts, *nmsg, *resp,
-        dtype, i, i1, i2, ierr, im, indx, ir, k, kndx, l,
-        lswap, nchunks, nReadPtr, nsamp0, npts, nsort;
-    const int maxpts = MAX_TRACEBUF_SIZ/16; // MAX_TRACEBUF_SIZ/sizeof(int16_t)
-    const bool clearSNCL = false;
+    double dt;
+    int dtype, i, ierr, indx, k, kndx, lswap, msgLen, nchunks, nsamp0, npts;
+    const int hdrSize = (int) (sizeof(TRACE2_HEADER));
     //------------------------------------------------------------------------//
     //
     // Check the tb2data was initialized
@@ -67,397 +106,461 @@ int traceBuffer_ewrr_unpackTraceBuf2Messages(
     }
     // Nothing to do
     if (tb2Data->ntraces == 0){return 0;}
-    if (nRead == 0){return 0;}
-//printf("%d\n", nRead);
-    // Set the workspace
-    msg   = memory_calloc8c(MAX_TRACEBUF_SIZ);
-    imap  = memory_calloc32i(nRead+1);
-    imsg  = memory_calloc32i(nRead);
-    iperm = memory_calloc32i(nRead);
-    kpts  = memory_calloc32i(tb2Data->ntraces);
-    nmsg  = memory_calloc32i(tb2Data->ntraces);
-    imapPtr = memory_calloc32i(nRead + 1); // worst case size
-    times = memory_calloc64f(nRead);
-    resp  = memory_calloc32i(maxpts);
-    for (i=0; i<nRead+1; i++){imap[i] = tb2Data->ntraces + 1;}
-    // Loop on waveforms and get workspace count
-    for (k=0; k<tb2Data->ntraces; k++)
-    {
-        // Copy on the SNCL
-        memset(netw, 0, sizeof(netw));
-        memset(stat, 0, sizeof(stat));
-        memset(chan, 0, sizeof(chan));
-        memset(loc,  0, sizeof(loc));
-        strcpy(netw, tb2Data->traces[k].netw);
-        strcpy(stat, tb2Data->traces[k].stnm);
-        strcpy(chan, tb2Data->traces[k].chan); 
-        strcpy(loc,  tb2Data->traces[k].loc);
-        // Loop on the messages and hunt for matching SNCL
-        for (i=0; i<nRead; i++)
-        {
-            indx = i*MAX_TRACEBUF_SIZ;
-            memcpy(msg, &msgs[indx], MAX_TRACEBUF_SIZ*sizeof(char));
-            memcpy(&traceHeader, msg, sizeof(TRACE2_HEADER));
-            // Get the bytes in right endianness
-            nsamp0 = traceHeader.nsamp;
-            ierr = WaveMsg2MakeLocal(&traceHeader);
-            if (ierr < 0)
-            {
-                 LOG_ERRMSG("%s", "Error flipping bytes");
-                 return -1;
-            }
-            // This is a match - update the 
-            if ((strcasecmp(netw, traceHeader.net)  == 0) &&
-                (strcasecmp(stat, traceHeader.sta)  == 0) &&
-                (strcasecmp(chan, traceHeader.chan) == 0) &&
-                (strcasecmp(loc,  traceHeader.loc)  == 0))
-            {
-                if (imap[i] < tb2Data->ntraces + 1)
-                {
-                    LOG_ERRMSG("%s", "Error multiply mapped wave");
-                    return -1;
-                }
-                imap[i] = k;
-                imsg[i] = i;
-                npts = traceHeader.nsamp;
-                if (npts < 0 || npts > maxpts)
-                {
-                    LOG_ERRMSG("Invalid number of points %d %d", npts, maxpts);
-                    return -1;
-                }
-                times[i] = traceHeader.starttime;
-                kpts[k] = kpts[k] + traceHeader.nsamp;
-                nmsg[k] = nmsg[k] + 1;
-//printf("match %d %d %d %d\n", i, k, nRead, tb2Data->ntraces);
-                //longData  = (long *)  (msg + sizeof(TRACE2_HEADER));
-                //shortData = (short *) (msg + sizeof(TRACE2_HEADER));
-                break;
-            }
-        } // Loop on messages read
-    } // Loop on waveforms
-    // Argsort the messages to their destinations (SNCLs).  Note, if using
-    // intel performance primitives the sort will be stable.  Therefore, if
-    // the messages are ordered temporally (more likely case) the unpacking
-    // will be faster
-//printf("%d\n", nRead);
-    imap[nRead] =-1;
-    ierr = sorting_argsort32i_work(nRead, imap, SORT_ASCENDING, iperm);
-    if (ierr != 0)
+    if (!snclIndex->linit || snclIndex->nids != tb2Data->ntraces)
     {
-        LOG_ERRMSG("%s", "Error sorting messages");
+        LOG_ERRMSG("%s", "SNCL index inconsistent with tb2Data");
         return -1;
     }
-    // Apply the permutations
-    ierr = sorting_applyPermutation32i_work(nRead, iperm, imap,  imap);
-    ierr = sorting_applyPermutation32i_work(nRead, iperm, imsg,  imsg);
-    ierr = sorting_applyPermutation64f_work(nRead, iperm, times, times);
-    // Make a list so that the messages will be unpacked in order of
-    // of SNCL matches as to reduce cache conflicts.
-    nReadPtr = 0;
-    for (i=0; i<nRead; i++)
+    // Don't let the previous read's data linger
+    if (!lappend)
     {
-//printf("%d\n", imap[i]);
-        if (imap[i] == tb2Data->ntraces + 1){break;} // Out of things to do 
-        // update next station
-        if (imap[i+1] != imap[i])
+        for (k=0; k<tb2Data->ntraces; k++)
         {
-            imapPtr[nReadPtr+1] = i + 1;
-            i1 = imapPtr[nReadPtr];
-            i2 = imapPtr[nReadPtr+1];
-            // Do a partial sort based on start times
-            nsort = i2 - i1;
-            if (nsort > 1)
-            {
-//printf("sorting %d %d\n", i1, i2);
-                // Verify sort is necessary (benefit of stable sort) 
-                if (!sorting_issorted64f(nsort, &times[i1],
-                                              SORT_ASCENDING, &ierr))
-                {
-                    ierr = sorting_argsort64f_work(nsort, &times[i1],
-                                                        SORT_ASCENDING, iperm);
-                    if (ierr != 0)
-                    {
-                        LOG_ERRMSG("%s", "Failed partial sort");
-                        return -1;
-                    }
-                    sorting_applyPermutation32i_work(nsort, iperm,
-                                                     &imap[i1],
-                                                     &imap[i1]);
-                    sorting_applyPermutation32i_work(nsort, iperm,
-                                                     &imsg[i1],
-                                                     &imsg[i1]);
-                    sorting_applyPermutation64f_work(nsort, iperm,
-                                                     &times[i1],
-                                                     &times[i1]);
-                }
-            }
-            else if (nsort == 0)
-            {
-                LOG_ERRMSG("%s", "Counting error");
-                return -1;
-            }
-            nReadPtr = nReadPtr + 1;
+            tb2Data->traces[k].npts = 0;
+            tb2Data->traces[k].nchunks = 0;
         }
     }
-    // Now set the workspace
-    for (k=0; k<tb2Data->ntraces; k++)
+    // Parse, route, and unpack each message in one pass
+    for (i=0; i<nRead; i++)
     {
-        traceBfufer_ewrr_freetb2Trace(clearSNCL, &tb2Data->traces[k]);
-        if (kpts[k] > 0)
+        indx = msgOffset[i];
+        msgLen = msgOffset[i+1] - msgOffset[i];
+        if (msgLen < hdrSize || msgLen > MAX_TRACEBUF_SIZ)
         {
-            tb2Data->traces[k].data  = memory_calloc32i(kpts[k]);
-            tb2Data->traces[k].times = memory_calloc64f(kpts[k]);
-            tb2Data->traces[k].chunkPtr = memory_calloc32i(nmsg[k]+1);
-            tb2Data->traces[k].npts = kpts[k];
+            LOG_ERRMSG("Invalid message length %d", msgLen);
+            continue;
         }
-    }
-//printf("nReadPtr: %d\n", nReadPtr);
-    // Unpack the traces
-    for (ir=0; ir<nReadPtr; ir++)
-    {
-        i1 = imapPtr[ir];
-        i2 = imapPtr[ir+1];
-        k = imap[i1];
-        kndx = 0;
-//printf("%d %d %d %d %d %d\n", tb2Data->ntraces, k, ir, i1, i2, kpts[k]);
-        // Loop on the messages for this SNCL
-        for (im=i1; im<i2; im++)
+        memcpy(&traceHeader, &msgs[indx], sizeof(TRACE2_HEADER));
+        // Get the bytes in right endianness
+        nsamp0 = traceHeader.nsamp;
+        ierr = WaveMsg2MakeLocal(&traceHeader);
+        if (ierr < 0)
         {
-            i = imsg[im];
-            if (i < 0 || i >= nRead)
-            {
-                LOG_ERRMSG("Invalid message number %d", i);
-                continue;
-            }
-            indx = i*MAX_TRACEBUF_SIZ;
-            memcpy(msg, &msgs[indx], MAX_TRACEBUF_SIZ*sizeof(char));
-            memcpy(&traceHeader, msg, sizeof(TRACE2_HEADER));
-            nsamp0 = traceHeader.nsamp;
-            ierr = WaveMsg2MakeLocal(&traceHeader);
-            if (ierr < 0)
-            {
-                 LOG_ERRMSG("%s", "Error flipping bytes");
-            }
-            dtype = 4;
-            if (strcasecmp(traceHeader.datatype, "s2\0") == 0 ||
-                strcasecmp(traceHeader.datatype, "i2\0") == 0)
-            {
-                dtype = 2;
-            }
-            lswap = 0;
-            if (nsamp0 != traceHeader.nsamp){lswap = 1;}
-            npts = traceHeader.nsamp;
-            ierr = fastUnpack(npts, lswap, dtype, &msgs[indx], resp);
-            if (ierr != 0)
-            {
-                LOG_ERRMSG("%s", "Error unpacking data");
-            }
-            // Update the points
-            dt = 1.0/traceHeader.samprate;
-            tb2Data->traces[k].dt = dt;
-            // Is a new chunk beginning?
-            if (im > i1)
-            {
-                if (fabs( (tb2Data->traces[k].times[kndx] + dt)
-                        - traceHeader.starttime ) < 1.e-6)
-                {
-                    tb2Data->traces[k].nchunks = tb2Data->traces[k].nchunks + 1;
-                    nchunks = tb2Data->traces[k].nchunks;
-                    tb2Data->traces[k].chunkPtr[nchunks] = kndx + 1;
-                }
-            }
-            // Update the points
-#ifdef _OPENMP
-            #pragma omp simd
-#endif
-            for (l=0; l<npts; l++)
-            {
-                tb2Data->traces[k].data[kndx+l] = resp[l];
-                tb2Data->traces[k].times[kndx+l] = traceHeader.starttime
-                                                 + (double) l*dt;
-            }
-            kndx = kndx + npts; 
-// printf("%16.8f %s %s %s %s %d %f\n", traceHeader.starttime,
-//                                traceHeader.net, traceHeader.sta,
-//                                traceHeader.chan, traceHeader.loc,
-//                                traceHeader.nsamp, (double) resp[0]/1000000); 
-        } // Loop on messages for this SNCL
-        // Special case for one message
-        if (i2 - i1 == 1 && kpts[k] > 0)
+            LOG_ERRMSG("%s", "Error flipping bytes");
+            continue;
+        }
+        k = traceBuffer_sncl_find(traceHeader.net, traceHeader.sta,
+                                  traceHeader.chan, traceHeader.loc,
+                                  snclIndex);
+        // Not a SNCL of interest
+        if (k < 0 || k >= tb2Data->ntraces){continue;}
+        trace = &tb2Data->traces[k];
+        dtype = 4;
+        if (strcasecmp(traceHeader.datatype, "s2\0") == 0 ||
+            strcasecmp(traceHeader.datatype, "i2\0") == 0)
         {
-            tb2Data->traces[k].nchunks = 1;
-            tb2Data->traces[k].chunkPtr[tb2Data->traces[k].nchunks] = kpts[k];
+            dtype = 2;
         }
-        // Reality check
-        if (kndx != kpts[k])
+        npts = traceHeader.nsamp;
+        if (npts < 0 || hdrSize + dtype*npts > msgLen)
         {
-            LOG_ERRMSG("Lost count %d %d", kndx, kpts[k]);
+            LOG_ERRMSG("Invalid number of points %d", npts);
+            continue;
+        }
+        if (npts == 0){continue;}
+        if (traceHeader.samprate <= 0.0)
+        {
+            LOG_ERRMSG("Invalid sampling rate %f", traceHeader.samprate);
+            continue;
+        }
+        lswap = 0;
+        if (nsamp0 != traceHeader.nsamp){lswap = 1;}
+        dt = 1.0/traceHeader.samprate;
+        // Make sure there's room to append this message
+        ierr = traceBuffer_ewrr_reservetb2Trace(trace->npts + npts,
+                                                trace->nchunks + 1, trace);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error growing staging buffers");
             return -1;
         }
-        if (tb2Data->traces[k].nchunks > 0)
+        kndx = trace->npts;
+        ierr = traceBuffer_ewrr_unpackSamples(TB2_UNPACK_AUTO,
+                                              npts, lswap, dtype,
+                                              traceHeader.starttime, dt,
+                                              &msgs[indx], &trace->data[kndx],
+                                              &trace->times[kndx]);
+        if (ierr != 0)
         {
-            nchunks = tb2Data->traces[k].nchunks;
-            if (tb2Data->traces[k].chunkPtr[nchunks] != tb2Data->traces[k].npts)
-            {
-                LOG_ERRMSG("Inconsistent number of points %d %d",
-                           tb2Data->traces[k].chunkPtr[nchunks],
-                           tb2Data->traces[k].npts);
-                return -1;
-            }
+            LOG_ERRMSG("%s", "Error unpacking data");
+            continue;
         }
-    } // Loop on pointers
-
-    // Free space
-    memory_free8c(&msg);
-    memory_free32i(&imap);
-    memory_free32i(&imsg);
-    memory_free32i(&iperm);
-    memory_free32i(&kpts);
-    memory_free32i(&nmsg);
-    memory_free32i(&resp);
-    memory_free64f(&times);
-    memory_free32i(&imapPtr);
+        // Is a new chunk beginning?
+        nchunks = trace->nchunks;
+        if (nchunks == 0 ||
+            fabs( (trace->times[kndx-1] + dt) - traceHeader.starttime ) > 1.e-6)
+        {
+            trace->chunkPtr[nchunks] = kndx;
+            trace->nchunks = nchunks + 1;
+        }
+        trace->dt = dt;
+        trace->npts = kndx + npts;
+        trace->chunkPtr[trace->nchunks] = trace->npts;
+    } // Loop on messages read
     return 0;
 }
 //============================================================================//
 /*!
- * @brief Unpacks a 4 byte integer character data
+ * @brief Unpacks 4 byte integer character data and fills the sample times
  *
  * @param[in] npts    number of points to unpack
  * @param[in] lswap   if 0 then do not byte swap the data.
  *                    if 1 then do byte swap the data.
- * @param[in] msg     tracebuf2 message to unpack [MAX_TRACEBUF_SIZ]
+ * @param[in] t0      epochal time (UTC seconds) of first sample
+ * @param[in] dt      sampling period (s)
+ * @param[in] msg     tracebuf2 message to unpack
  *
  * @param[out] resp   response data [npts]
+ * @param[out] times  epochal time (UTC seconds) of each sample [npts]
  *
  * @author Ben Baker (ISTI)
  *
  * @copyright Apache 2
  *
- * @bug This doesn't vectorize.
- *
  */
 static void fastUnpackI4(const int npts, const int lswap,
+                         const double t0, const double dt,
                          const char *__restrict__ msg,
-                         int *__restrict__ resp)
+                         int *__restrict__ resp,
+                         double *__restrict__ times)
 {
-    const int ioff = (int) (sizeof(TRACE2_HEADER));
-    char c4[4];
-    int i, i4;
+    const char *data = &msg[sizeof(TRACE2_HEADER)];
+    uint32_t u4;
+    int i;
     if (lswap == 0)
     {
-        //#pragma omp simd
-        for (i=0; i<npts; i++)
-        {
-            c4[0] = msg[ioff+4*i+0];
-            c4[1] = msg[ioff+4*i+1]; 
-            c4[2] = msg[ioff+4*i+2]; 
-            c4[3] = msg[ioff+4*i+3];
-            memcpy(&i4, c4, sizeof(int));
-            resp[i] = (int) i4; 
-        }
+        memcpy(resp, data, (size_t) npts*sizeof(int));
     }
     else
     {
-        //#pragma omp simd
         for (i=0; i<npts; i++)
         {
-            c4[3] = msg[ioff+4*i+0];
-            c4[2] = msg[ioff+4*i+1]; 
-            c4[1] = msg[ioff+4*i+2]; 
-            c4[0] = msg[ioff+4*i+3];
-            memcpy(&i4, c4, sizeof(int));
-            resp[i] = (int) i4;
+            memcpy(&u4, &data[4*i], sizeof(uint32_t));
+            u4 = ((u4 & 0x000000FFu) << 24) | ((u4 & 0x0000FF00u) <<  8)
+               | ((u4 & 0x00FF0000u) >>  8) | ((u4 & 0xFF000000u) >> 24);
+            resp[i] = (int) u4;
         }
     }
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (i=0; i<npts; i++)
+    {
+        times[i] = t0 + (double) i*dt;
+    }
     return;
 }
 //============================================================================//
 /*!
- * @brief Unpacks a 2 byte integer character data
+ * @brief Unpacks 2 byte integer character data and fills the sample times
  *
  * @param[in] npts    number of points to unpack
  * @param[in] lswap   if 0 then do not byte swap the data.
  *                    if 1 then do byte swap the data.
- * @param[in] msg     tracebuf2 message to unpack [MAX_TRACEBUF_SIZ]
+ * @param[in] t0      epochal time (UTC seconds) of first sample
+ * @param[in] dt      sampling period (s)
+ * @param[in] msg     tracebuf2 message to unpack
  *
  * @param[out] resp   response data [npts]
+ * @param[out] times  epochal time (UTC seconds) of each sample [npts]
  *
  * @author Ben Baker (ISTI)
  *
  * @copyright Apache 2
  *
- * @bug This doesn't vectorize.
- *
  */
 static void fastUnpackI2(const int npts, const int lswap,
+                         const double t0, const double dt,
                          const char *__restrict__ msg,
-                         int *__restrict__ resp)
+                         int *__restrict__ resp,
+                         double *__restrict__ times)
 {
-    const int ioff = (int) (sizeof(TRACE2_HEADER));
-    char c2[2];
+    const char *data = &msg[sizeof(TRACE2_HEADER)];
+    uint16_t u2;
     int i;
-    short i2;
-    if (lswap == 0)
+    for (i=0; i<npts; i++)
     {
-        //#pragma omp simd
-        for (i=0; i<npts; i++)
-        {
-            c2[0] = msg[ioff+2*i+0];
-            c2[1] = msg[ioff+2*i+1];
-            memcpy(&i2, c2, sizeof(short));
-            resp[i] = (int) i2;
-        }
+        memcpy(&u2, &data[2*i], sizeof(uint16_t));
+        if (lswap != 0){u2 = (uint16_t) ((u2 << 8) | (u2 >> 8));}
+        resp[i] = (int) ((int16_t) u2);
     }
-    else
+#ifdef _OPENMP
+    #pragma omp simd
+#endif
+    for (i=0; i<npts; i++)
     {
-        //#pragma omp simd
-        for (i=0; i<npts; i++)
-        {
-            c2[1] = msg[ioff+2*i+0];
-            c2[0] = msg[ioff+2*i+1]; 
-            memcpy(&i2, c2, sizeof(short));
-            resp[i] = (int) i2;
-        }
-    }   
+        times[i] = t0 + (double) i*dt;
+    }
     return;
 }
+#ifdef UNPACK_USE_X86
 //============================================================================//
 /*!
- * @brief Unpacks a 2 or 4 byte integer character data
+ * @brief AVX2 version of fastUnpackI4.  Eight samples are byte swapped with
+ *        a single shuffle and their times are computed four at a time.
+ */
+__attribute__((target("avx2")))
+static void fastUnpackI4_avx2(const int npts, const int lswap,
+                              const double t0, const double dt,
+                              const char *__restrict__ msg,
+                              int *__restrict__ resp,
+                              double *__restrict__ times)
+{
+    const char *data = &msg[sizeof(TRACE2_HEADER)];
+    __m256i v, vshuf;
+    __m256d vdt, vidx, vfour, vt0;
+    int i;
+    vshuf = _mm256_setr_epi8(3, 2, 1, 0,  7, 6, 5, 4,
+                             11, 10, 9, 8,  15, 14, 13, 12,
+                             3, 2, 1, 0,  7, 6, 5, 4,
+                             11, 10, 9, 8,  15, 14, 13, 12);
+    vt0 = _mm256_set1_pd(t0);
+    vdt = _mm256_set1_pd(dt);
+    vfour = _mm256_set1_pd(4.0);
+    vidx = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+    for (i=0; i<npts-7; i=i+8)
+    {
+        v = _mm256_loadu_si256((const __m256i *) &data[4*i]);
+        if (lswap != 0){v = _mm256_shuffle_epi8(v, vshuf);}
+        _mm256_storeu_si256((__m256i *) &resp[i], v);
+        _mm256_storeu_pd(&times[i],
+                         _mm256_add_pd(vt0, _mm256_mul_pd(vidx, vdt)));
+        vidx = _mm256_add_pd(vidx, vfour);
+        _mm256_storeu_pd(&times[i+4],
+                         _mm256_add_pd(vt0, _mm256_mul_pd(vidx, vdt)));
+        vidx = _mm256_add_pd(vidx, vfour);
+    }
+    if (i < npts)
+    {
+        fastUnpackI4(npts - i, lswap, t0 + (double) i*dt, dt,
+                     &msg[4*i], &resp[i], &times[i]);
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief AVX2 version of fastUnpackI2.  Eight samples are byte swapped with
+ *        a single shuffle and sign extended to 32 bit integers.
+ */
+__attribute__((target("avx2")))
+static void fastUnpackI2_avx2(const int npts, const int lswap,
+                              const double t0, const double dt,
+                              const char *__restrict__ msg,
+                              int *__restrict__ resp,
+                              double *__restrict__ times)
+{
+    const char *data = &msg[sizeof(TRACE2_HEADER)];
+    __m128i v, vshuf;
+    __m256d vdt, vidx, vfour, vt0;
+    int i;
+    vshuf = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                          9, 8, 11, 10, 13, 12, 15, 14);
+    vt0 = _mm256_set1_pd(t0);
+    vdt = _mm256_set1_pd(dt);
+    vfour = _mm256_set1_pd(4.0);
+    vidx = _mm256_setr_pd(0.0, 1.0, 2.0, 3.0);
+    for (i=0; i<npts-7; i=i+8)
+    {
+        v = _mm_loadu_si128((const __m128i *) &data[2*i]);
+        if (lswap != 0){v = _mm_shuffle_epi8(v, vshuf);}
+        _mm256_storeu_si256((__m256i *) &resp[i], _mm256_cvtepi16_epi32(v));
+        _mm256_storeu_pd(&times[i],
+                         _mm256_add_pd(vt0, _mm256_mul_pd(vidx, vdt)));
+        vidx = _mm256_add_pd(vidx, vfour);
+        _mm256_storeu_pd(&times[i+4],
+                         _mm256_add_pd(vt0, _mm256_mul_pd(vidx, vdt)));
+        vidx = _mm256_add_pd(vidx, vfour);
+    }
+    if (i < npts)
+    {
+        fastUnpackI2(npts - i, lswap, t0 + (double) i*dt, dt,
+                     &msg[2*i], &resp[i], &times[i]);
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief SSE4.1 version of fastUnpackI4.  Four samples are byte swapped
+ *        with a single shuffle.
+ */
+__attribute__((target("sse4.1")))
+static void fastUnpackI4_sse41(const int npts, const int lswap,
+                               const double t0, const double dt,
+                               const char *__restrict__ msg,
+                               int *__restrict__ resp,
+                               double *__restrict__ times)
+{
+    const char *data = &msg[sizeof(TRACE2_HEADER)];
+    __m128i v, vshuf;
+    __m128d vdt, vidx, vtwo, vt0;
+    int i;
+    vshuf = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4,
+                          11, 10, 9, 8, 15, 14, 13, 12);
+    vt0 = _mm_set1_pd(t0);
+    vdt = _mm_set1_pd(dt);
+    vtwo = _mm_set1_pd(2.0);
+    vidx = _mm_setr_pd(0.0, 1.0);
+    for (i=0; i<npts-3; i=i+4)
+    {
+        v = _mm_loadu_si128((const __m128i *) &data[4*i]);
+        if (lswap != 0){v = _mm_shuffle_epi8(v, vshuf);}
+        _mm_storeu_si128((__m128i *) &resp[i], v);
+        _mm_storeu_pd(&times[i], _mm_add_pd(vt0, _mm_mul_pd(vidx, vdt)));
+        vidx = _mm_add_pd(vidx, vtwo);
+        _mm_storeu_pd(&times[i+2], _mm_add_pd(vt0, _mm_mul_pd(vidx, vdt)));
+        vidx = _mm_add_pd(vidx, vtwo);
+    }
+    if (i < npts)
+    {
+        fastUnpackI4(npts - i, lswap, t0 + (double) i*dt, dt,
+                     &msg[4*i], &resp[i], &times[i]);
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief SSE4.1 version of fastUnpackI2.  Four samples are byte swapped
+ *        with a single shuffle and sign extended to 32 bit integers.
+ */
+__attribute__((target("sse4.1")))
+static void fastUnpackI2_sse41(const int npts, const int lswap,
+                               const double t0, const double dt,
+                               const char *__restrict__ msg,
+                               int *__restrict__ resp,
+                               double *__restrict__ times)
+{
+    const char *data = &msg[sizeof(TRACE2_HEADER)];
+    __m128i v, vshuf;
+    __m128d vdt, vidx, vtwo, vt0;
+    int i;
+    vshuf = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6,
+                          9, 8, 11, 10, 13, 12, 15, 14);
+    vt0 = _mm_set1_pd(t0);
+    vdt = _mm_set1_pd(dt);
+    vtwo = _mm_set1_pd(2.0);
+    vidx = _mm_setr_pd(0.0, 1.0);
+    for (i=0; i<npts-3; i=i+4)
+    {
+        v = _mm_loadl_epi64((const __m128i *) &data[2*i]);
+        if (lswap != 0){v = _mm_shuffle_epi8(v, vshuf);}
+        _mm_storeu_si128((__m128i *) &resp[i], _mm_cvtepi16_epi32(v));
+        _mm_storeu_pd(&times[i], _mm_add_pd(vt0, _mm_mul_pd(vidx, vdt)));
+        vidx = _mm_add_pd(vidx, vtwo);
+        _mm_storeu_pd(&times[i+2], _mm_add_pd(vt0, _mm_mul_pd(vidx, vdt)));
+        vidx = _mm_add_pd(vidx, vtwo);
+    }
+    if (i < npts)
+    {
+        fastUnpackI2(npts - i, lswap, t0 + (double) i*dt, dt,
+                     &msg[2*i], &resp[i], &times[i]);
+    }
+    return;
+}
+#endif
+//============================================================================//
+/*!
+ * @brief Unpacks 2 or 4 byte integer character data and fills the sample
+ *        times.  With TB2_UNPACK_AUTO the widest kernel the CPU supports is
+ *        selected at run time on x86 and the scalar kernel is used
+ *        elsewhere.  A specific kernel can be requested so that each one
+ *        can be compared against the scalar kernel.
  *
+ * @param[in] kernel  kernel with which to unpack the data
  * @param[in] npts    number of points to unpack
  * @param[in] lswap   if 0 then do not byte swap the data.
  *                    if 1 then do byte swap the data.
  * @param[in] dtype   if 4 then the data is 4 bytes.
  *                    if 2 then the data is 2 bytes.
- * @param[in] msg     tracebuf2 message to unpack [MAX_TRACEBUF_SIZ]
+ * @param[in] t0      epochal time (UTC seconds) of first sample
+ * @param[in] dt      sampling period (s)
+ * @param[in] msg     tracebuf2 message to unpack
  *
  * @param[out] resp   response data [npts]
+ * @param[out] times  epochal time (UTC seconds) of each sample [npts]
+ *
+ * @result 0 indicates success.
+ *         1 indicates the requested kernel was not compiled or is not
+ *         supported by this CPU.
+ *         -1 indicates an invalid data type or kernel.
  *
  * @author Ben Baker (ISTI)
  *
  * @copyright Apache 2
  *
  */
-static int fastUnpack(const int npts, const int lswap,
-                      const int dtype,
-                      const char *__restrict__ msg,
-                      int *__restrict__ resp)
+int traceBuffer_ewrr_unpackSamples(const enum tb2Unpack_kernel kernel,
+                                   const int npts, const int lswap,
+                                   const int dtype,
+                                   const double t0, const double dt,
+                                   const char *__restrict__ msg,
+                                   int *__restrict__ resp,
+                                   double *__restrict__ times)
 {
+#ifdef UNPACK_USE_X86
+    enum tb2Unpack_kernel use;
+#endif
+    if (dtype != 2 && dtype != 4)
+    {
+        LOG_ERRMSG("%s", "Invalid type");
+        return -1;
+    }
+    if (kernel != TB2_UNPACK_AUTO && kernel != TB2_UNPACK_SCALAR &&
+        kernel != TB2_UNPACK_SSE41 && kernel != TB2_UNPACK_AVX2)
+    {
+        LOG_ERRMSG("Invalid kernel %d", (int) kernel);
+        return -1;
+    }
     if (npts < 1){return 0;} // Nothing to do
-    if (dtype == 4)
+#ifdef UNPACK_USE_X86
+    use = kernel;
+    if (use == TB2_UNPACK_AUTO)
+    {
+        use = TB2_UNPACK_SCALAR;
+        if (__builtin_cpu_supports("avx2"))
+        {
+            use = TB2_UNPACK_AVX2;
+        }
+        else if (__builtin_cpu_supports("sse4.1"))
+        {
+            use = TB2_UNPACK_SSE41;
+        }
+    }
+    if (use == TB2_UNPACK_AVX2)
     {
-        fastUnpackI4(npts, lswap, msg, resp);
+        if (!__builtin_cpu_supports("avx2")){return 1;}
+        if (dtype == 4)
+        {
+            fastUnpackI4_avx2(npts, lswap, t0, dt, msg, resp, times);
+        }
+        else
+        {
+            fastUnpackI2_avx2(npts, lswap, t0, dt, msg, resp, times);
+        }
+        return 0;
+    }
+    if (use == TB2_UNPACK_SSE41)
+    {
+        if (!__builtin_cpu_supports("sse4.1")){return 1;}
+        if (dtype == 4)
+        {
+            fastUnpackI4_sse41(npts, lswap, t0, dt, msg, resp, times);
+        }
+        else
+        {
+            fastUnpackI2_sse41(npts, lswap, t0, dt, msg, resp, times);
+        }
+        return 0;
     }
-    else if (dtype == 2)
+#else
+    if (kernel == TB2_UNPACK_SSE41 || kernel == TB2_UNPACK_AVX2){return 1;}
+#endif
+    if (dtype == 4)
     {
-        fastUnpackI2(npts, lswap, msg, resp);
+        fastUnpackI4(npts, lswap, t0, dt, msg, resp, times);
     }
     else
     {
-        LOG_ERRMSG("%s", "Invalid type");
-        return -1;
+        fastUnpackI2(npts, lswap, t0, dt, msg, resp, times);
     }
     return 0;
 }
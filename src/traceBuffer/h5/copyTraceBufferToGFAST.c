@@ -63,7 +63,6 @@ int traceBuffer_h5_copyTraceBufferToGFAST(
                               traceBuffer->traces[i].data, 
                               gps_data->data[k].maxpts,
                               gps_data->data[k].ubuff);
-            memory_free64f(&traceBuffer->traces[i].data);
             if (ierr1 != 0)
             {
                 LOG_ERRMSG("%s", "Error copying ubuff");
@@ -96,7 +95,6 @@ int traceBuffer_h5_copyTraceBufferToGFAST(
                               traceBuffer->traces[i].data, 
                               gps_data->data[k].maxpts,
                               gps_data->data[k].nbuff);
-            memory_free64f(&traceBuffer->traces[i].data);
             if (ierr1 != 0)
             {
                 LOG_ERRMSG("%s", "Error copying nbuff");
@@ -122,7 +120,6 @@ int traceBuffer_h5_copyTraceBufferToGFAST(
                               traceBuffer->traces[i].data, 
                               gps_data->data[k].maxpts,
                               gps_data->data[k].ebuff);
-            memory_free64f(&traceBuffer->traces[i].data);
             if (ierr1 != 0)
             {
                 LOG_ERRMSG("%s", "Error copying ebuff");
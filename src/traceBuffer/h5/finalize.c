@@ -6,7 +6,7 @@
 #include "iscl/memory/memory.h"
 
 /*!
- * @brief Closes the HDF5 file on h5trace
+ * @brief Releases the circular buffers and closes the HDF5 file on h5trace
  *
  * @param[in,out] h5trace   on input holds the HDF5 file handle and
  *                          h5traceBuffer properties. 
@@ -41,6 +41,8 @@ int traceBuffer_h5_finalize(struct h5traceBuffer_struct *h5trace)
             {
                 free(h5trace->traces[i].metaGroupName);
             }
+            memory_free64f(&h5trace->traces[i].ringBuffer);
+            memory_free64f(&h5trace->traces[i].data);
         }
         free(h5trace->traces);
     }
@@ -53,11 +55,15 @@ int traceBuffer_h5_finalize(struct h5traceBuffer_struct *h5trace)
         free(h5trace->dtGroupName);
         memory_free32i(&h5trace->dtPtr);
     }
-    status = H5Fclose(h5trace->fileID);
-    if (status != 0)
+    memory_free32i(&h5trace->tb2Map);
+    if (h5trace->lh5File)
     {
-        LOG_ERRMSG("%s", "Error closing file");
-        ierr = 1; 
+        status = H5Fclose(h5trace->fileID);
+        if (status != 0)
+        {
+            LOG_ERRMSG("%s", "Error closing file");
+            ierr = 1; 
+        }
     }
     memset(h5trace, 0, sizeof(struct h5traceBuffer_struct));
     return ierr;
@@ -8,6 +8,9 @@
 #include "iscl/array/array.h"
 #include "iscl/memory/memory.h"
 
+static int getRingData(const double t1, const double t2,
+                       struct h5traceBuffer_struct *h5traceBuffer);
+
 /*!
  * @brief Returns the data on for the stations and channels in the
  *        h5traceBuffer from epochal times t1 to t2
@@ -16,7 +19,8 @@
  * @param[in] t2                 epochal end time of traces (UTC seconds)
  *
  * @param[in,out] h5traceBuffer  on input contains the desired traces (SNCLs)
- *                               to query the HDF5 file.
+ *                               to query the in-memory circular buffers or,
+ *                               if they are not available, the HDF5 file.
  *                               on successful exit contains the traces for
  *                               each SNCL from times t1 to t2.  any unknown
  *                               data points must be detected by the user as
@@ -30,131 +34,152 @@
 int traceBuffer_h5_getData(const double t1, const double t2,
                            struct h5traceBuffer_struct *h5traceBuffer)
 {
-    double *gain, *work, dt, ts1, ts2;
-    int i1, i2, ibeg, idt, iend, ierr, j1, j2, k, k1, k2,
-        maxpts, ncopy, ntraces;
+    int idt, ierr, k1, k2, ntraces;
     hid_t groupID;
     herr_t status;
     //------------------------------------------------------------------------//
+    // Read from memory
+    if (h5traceBuffer->lringBuffer)
+    {
+        ierr = getRingData(t1, t2, h5traceBuffer);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error getting data from circular buffers");
+        }
+        return ierr;
+    }
+    // Read the window [t1, t2] from each sampling period group
     for (idt=0; idt<h5traceBuffer->ndtGroups; idt++)
     {
-        gain = NULL;
-        work = NULL;
         k1 = h5traceBuffer->dtPtr[idt];
         k2 = h5traceBuffer->dtPtr[idt+1];
         ntraces = k2 - k1;
         if (ntraces == 0){continue;}
-        // Open + read the data and attributes for this dataset 
         groupID = H5Gopen2(h5traceBuffer->fileID,
                            h5traceBuffer->dtGroupName[idt], H5P_DEFAULT);
-        gain = memory_calloc64f(ntraces);
-        work = traceBuffer_h5_readData(groupID, ntraces,
-                                       &maxpts, &dt, &ts1, &ts2, gain, &ierr);
+        ierr = traceBuffer_h5_readDataSlab(groupID, ntraces, t1, t2,
+                                           &h5traceBuffer->traces[k1]);
+        status = H5Gclose(groupID);
         if (ierr != 0)
         {
             LOG_ERRMSG("%s", "Error reading data");
             return -1;
         }
-        // This concludes the fileIO
-        status = H5Gclose(groupID);
-        // Check what i just read
         if (status < 0)
         {
             LOG_ERRMSG("Error closing group %s",
                        h5traceBuffer->dtGroupName[idt]);
             return -1;
         }
+    } // Loop on sampling period groups
+    return 0;
+}
+//============================================================================//
+/*!
+ * @brief Copies the data from epochal times t1 to t2 off of the in-memory
+ *        circular buffers.
+ *
+ * @param[in] t1                 epochal start time of traces (UTC seconds)
+ * @param[in] t2                 epochal end time of traces (UTC seconds)
+ *
+ * @param[in,out] h5traceBuffer  on input contains the circular buffers.
+ *                               on successful exit contains the traces for
+ *                               each SNCL from times t1 to t2.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ */
+static int getRingData(const double t1, const double t2,
+                       struct h5traceBuffer_struct *h5traceBuffer)
+{
+    struct h5trace_struct *trace;
+    double dt, ts1, ts2;
+    int i1, ierr, istart, k, maxpts, ncopy, nseg1, nseg2;
+    //------------------------------------------------------------------------//
+    for (k=0; k<h5traceBuffer->ntraces; k++)
+    {
+        trace = &h5traceBuffer->traces[k];
+        maxpts = trace->maxpts;
+        dt = trace->dt;
+        if (trace->ringBuffer == NULL)
+        {
+            LOG_ERRMSG("Circular buffer not set on trace %d", k+1);
+            return -1;
+        }
         if (dt <= 0.0)
         {
             LOG_ERRMSG("Invalid sampling period %f", dt);
             return -1;
-        } 
+        }
         if (maxpts < 1)
         {
             LOG_ERRMSG("Invalid number of points %d", maxpts);
-            return -1; 
+            return -1;
         }
-        // Check what I just read
-        if (t1 > ts2)
+        // The end time accumulates multiples of dt so allow half a sample
+        ts2 = trace->ringEndTime;
+        ts1 = ts2 - (double) (maxpts - 1)*dt;
+        if (t1 > ts2 + 0.5*dt)
         {
             LOG_ERRMSG("%s", "Start time is too new");
             return -1;
         }
-        if (t2 < ts1)
+        if (t2 < ts1 - 0.5*dt)
         {
             LOG_ERRMSG("%s", "End time is too old");
             return -1;
         }
-        if (t2 > ts1 + (double) (maxpts - 1)*dt)
+        if (t2 > ts2 + 0.5*dt)
         {
             LOG_ERRMSG("%s", "Looking for data that's too current");
             return -1;
         }
-        if (t1 < ts1)
+        if (t1 < ts1 - 0.5*dt)
         {
             LOG_ERRMSG("%s", "Error start time is too old");
             return -1;
         }
-        // Indices in chunk to read from
-        i1 = (int) ((t1 - ts1)/dt + 0.5);
-        i2 = (int) ((t2 - ts1)/dt + 0.5);
-        i1 = MAX(i1, 0);          //if (i1 < 0){i1 = 0;}
-        i2 = MIN(i2, maxpts - 1); //if (i2 > maxpts - 1){i2 = maxpts - 1;}
-        // Indices to set (if i were more clever i could make this span a
-        // superset of the times in memory - but then i'd fill it with NaNs
-        // and risk messing up the offset computation - particularly at the
-        // beginning where we have to know the position at the origin time)
-        j1 = i1;
-        j2 = i2;
-        j1 = MAX(j1, 0);          //if (j1 < 0){j1 = 0;} 
-        j2 = MIN(j2, maxpts - 1); //if (j2 > maxpts - 1){j2 = maxpts - 1;}
-        if (i2 - i1 > j2 - j1)
+        i1 = MAX(0, (int) ((t1 - ts1)/dt + 0.5));
+        ncopy = (int) ((t2 - t1)/dt + 0.5) + 1;
+        // set info for this trace and reuse its buffer if it is big enough
+        if (trace->data == NULL || trace->nalloc < ncopy)
+        {
+            memory_free64f(&trace->data);
+            trace->data = memory_calloc64f(ncopy);
+            trace->nalloc = ncopy;
+        }
+        ierr = array_set64f_work(ncopy, (double) NAN, trace->data);
+        if (ierr != 0)
         {
-            LOG_ERRMSG("%s", "Error source array larger than dest array");
+            LOG_ERRMSG("Error initializing trace %d", k+1);
             return -1;
         }
-        ncopy = (int) ((t2 - t1)/dt + 0.5) + 1;
-        /*
-        ncopy = (int) ((t2 - t1)/dt + 0.5) + 1;
-        j1 = 0;
-        j2 = j1 + ncopy;
-        */
-        // Get the data onto the buffers
-        for (k=k1; k<k2; k++)
+        trace->t1 = t1;
+        trace->ncopy = ncopy;
+        // copy it - the oldest sample is at ringHead + 1 
+        ncopy = MIN(ncopy, maxpts - i1);
+        istart = (trace->ringHead + 1 + i1)%maxpts;
+        nseg1 = MIN(ncopy, maxpts - istart);
+        nseg2 = ncopy - nseg1;
+        ierr = 0;
+        if (nseg1 > 0)
         {
-            // set info for this trace
-            memory_free64f(&h5traceBuffer->traces[k].data);
-            h5traceBuffer->traces[k].t1 = t1;
-            h5traceBuffer->traces[k].ncopy = ncopy;
-            h5traceBuffer->traces[k].gain = gain[k-k1];
-            // Set the data to NaN's
-            h5traceBuffer->traces[k].data
-                = array_set64f(ncopy, (double) NAN, &ierr);
-            // copy it
-            ibeg = h5traceBuffer->traces[k].traceNumber*maxpts + i1;
-            iend = ibeg + ncopy - 1; //i2;
-            if (iend - ibeg + 1 != ncopy)
-            {
-                LOG_ERRMSG("Inconsistent copy size %d %d %d",
-                           ibeg, iend, ncopy);
-                return -1;
-            }
-            if (iend >= maxpts*ntraces)
-            {
-                LOG_ERRMSG("%s", "Critical error - work bounds exceeded");
-                return -1;
-            } 
-            //memcpy(&h5traceBuffer->traces[k].data[j1], &work[ibeg],
-            //       (size_t) (ncopy)*sizeof(double)); 
-            //ierr = array_copy64f_work(ncopy, &work[ibeg],
-            //                          &h5traceBuffer->traces[k].data[j1]);
-            ierr = array_copy64f_work(ncopy, &work[ibeg],
-                                      &h5traceBuffer->traces[k].data[0]);
-        } // Loop on streams in this group
-        // Release temporary memory 
-        memory_free64f(&work);
-        memory_free64f(&gain);
-    } // Loop on sampling period groups
+            ierr = array_copy64f_work(nseg1, &trace->ringBuffer[istart],
+                                      &trace->data[0]);
+        }
+        if (nseg2 > 0 && ierr == 0)
+        {
+            ierr = array_copy64f_work(nseg2, &trace->ringBuffer[0],
+                                      &trace->data[nseg1]);
+        }
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("Error copying circular buffer on trace %d", k+1);
+            return -1;
+        }
+    } // Loop on traces
     return 0;
 }
 /*!
@@ -16,8 +16,11 @@
  *
  * @param[in] job                If job = 1 then the file will be opened as
  *                               read only.
- *                               If job = 2 then the file will be opened as
- *                               read/write.
+ *                               If job = 2 then the traces will be buffered
+ *                               in memory and the file will be opened as
+ *                               read/write so that the traces are saved.
+ *                               If job = 3 then the traces will only be
+ *                               buffered in memory and no file is created.
  * @param[in] linMemory          If true then keep the opened file in memory.
  * @param[in] h5dir              directory where HDF5 file exists
  * @param[in] h5file             name of the HDF5 file in the directory
@@ -38,7 +41,8 @@ int traceBuffer_h5_initialize(const int job,
 {
     FILE *fp;
     double *work; 
-    char **traceOut, **traces, h5name[PATH_MAX], cwork[512], temp[64];
+    struct snclIndex_struct snclIndex;
+    char **traceOut, **traces, h5name[PATH_MAX], cwork[512];
     herr_t status;
     hsize_t dims[2];
     hid_t dataSet, dataSpace, groupID, properties;
@@ -46,6 +50,13 @@ int traceBuffer_h5_initialize(const int job,
     int i, ierr, j, k, maxpts, ndtGroups, ntraces;
     size_t blockSize;
     const bool lsave = true;;
+    memset(&snclIndex, 0, sizeof(struct snclIndex_struct));
+    // Check the job
+    if (job < 1 || job > 3)
+    {
+        LOG_ERRMSG("Invalid job %d", job);
+        return -1;
+    }
     // Make sure there is data
     if (h5traceBuffer->traces == NULL || h5traceBuffer->ntraces < 1)
     {
@@ -85,6 +96,7 @@ int traceBuffer_h5_initialize(const int job,
             }
         }
         h5traceBuffer->fileID = H5Fopen(h5name, H5F_ACC_RDONLY, properties);
+        h5traceBuffer->lh5File = true;
         status = H5Pclose(properties);
         if (status < 0)
         {
@@ -114,31 +126,38 @@ int traceBuffer_h5_initialize(const int job,
         if (ntraces != h5traceBuffer->ntraces)
         {
             LOG_ERRMSG("%s", "metadata size inconsistency");
-            return -1;
+            goto ERROR;
+        }
+        // Index the trace names then match those SNCLs
+        ierr = traceBuffer_sncl_initialize(ntraces, &snclIndex);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error initializing SNCL index");
+            goto ERROR;
+        }
+        for (j=0; j<ntraces; j++)
+        {
+            if (traceBuffer_sncl_insertKey(traces[j], &snclIndex) != j)
+            {
+                LOG_ERRMSG("Error indexing trace %s", traces[j]);
+                goto ERROR;
+            }
         }
-        // Match those SNCLs
         for (i=0; i<h5traceBuffer->ntraces; i++)
         {
-            memset(temp, 0, sizeof(temp));
-            strcpy(temp, h5traceBuffer->traces[i].netw);
-            strcat(temp, ".\0");
-            strcat(temp, h5traceBuffer->traces[i].stnm);
-            strcat(temp, ".\0");
-            strcat(temp, h5traceBuffer->traces[i].chan);
-            strcat(temp, ".\0");
-            strcat(temp, h5traceBuffer->traces[i].loc);
-            for (j=0; j<h5traceBuffer->ntraces; j++)
+            j = traceBuffer_sncl_find(h5traceBuffer->traces[i].netw,
+                                      h5traceBuffer->traces[i].stnm,
+                                      h5traceBuffer->traces[i].chan,
+                                      h5traceBuffer->traces[i].loc,
+                                      &snclIndex);
+            if (j < 0)
             {
-                if (strcasecmp(traces[j], temp) == 0)
-                {
-                    h5traceBuffer->traces[i].traceNumber = j;
-                    goto FOUND_TRACE;
-                }
+                LOG_ERRMSG("%s", "Failed to find trace!");
+                goto ERROR;
             }
-            LOG_ERRMSG("%s", "Failed to find trace!");
-            return -1;
-FOUND_TRACE:;
+            h5traceBuffer->traces[i].traceNumber = j;
         }
+        traceBuffer_sncl_finalize(&snclIndex);
         if (ntraces > 0)
         {
             free(traces[0]);
@@ -151,7 +170,7 @@ FOUND_TRACE:;
         // Set the time to now
         tbeg = (double) ((long) (ISCL_time_timeStamp())); 
         // If scratch file was saved then remove it 
-        if (os_path_isfile(h5name))
+        if (job == 2 && os_path_isfile(h5name))
         {
             LOG_WARNMSG("Deleting file %s", h5name);
         }
@@ -180,6 +199,25 @@ FOUND_TRACE:;
             LOG_ERRMSG("%s", "There's no data in the buffers");
             return -1;
         }
+        // Allocate the in-memory circular buffers.  These hold the most
+        // recent maxpts samples of each trace and are what getData reads.
+        for (i=0; i<h5traceBuffer->ntraces; i++)
+        {
+            memory_free64f(&h5traceBuffer->traces[i].ringBuffer);
+            h5traceBuffer->traces[i].ringBuffer
+                = array_set64f(h5traceBuffer->traces[i].maxpts,
+                               (double) NAN, &ierr);
+            h5traceBuffer->traces[i].ringHead
+                = h5traceBuffer->traces[i].maxpts - 1;
+            h5traceBuffer->traces[i].ringEndTime = tbeg;
+        }
+        h5traceBuffer->lringBuffer = true;
+        // The HDF5 file is only needed if the traces are to be saved
+        if (job == 3)
+        {
+            h5traceBuffer->linit = true;
+            return 0;
+        }
         blockSize = (size_t)
                     (h5traceBuffer->ntraces*(8*maxpts + 4*8 + 64 + 2*8 + 2*4));
         // add a little extra
@@ -196,6 +234,7 @@ FOUND_TRACE:;
         }
         h5traceBuffer->fileID = H5Fcreate(h5name, H5F_ACC_TRUNC,
                                           H5P_DEFAULT, properties);
+        h5traceBuffer->lh5File = true;
         status = H5Pclose(properties);
         if (status < 0)
         {
@@ -358,4 +397,12 @@ FOUND_TRACE:;
     }
     h5traceBuffer->linit = true;
     return 0;
+ERROR:;
+    traceBuffer_sncl_finalize(&snclIndex);
+    if (ntraces > 0)
+    {
+        free(traces[0]);
+        free(traces);
+    }
+    return -1;
 }
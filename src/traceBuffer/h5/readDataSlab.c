@@ -0,0 +1,203 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <float.h>
+#include <math.h>
+#include <string.h>
+#include "gfast_traceBuffer.h"
+#include "gfast_core.h"
+#include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
+
+/*!
+ * @brief Reads the samples from epochal times t1 to t2 for each trace in
+ *        the blocked data /Data in the Data group.  Only the hyperslab
+ *        spanning [t1, t2] is read from the HDF5 file so the cost scales
+ *        with the length of the requested window rather than the length
+ *        of the buffer.
+ *
+ * @param[in] groupID     handle for HDF5 group with data
+ * @param[in] ntraces     number of traces I'm expecting to read
+ * @param[in] t1          epochal start time of traces (UTC seconds)
+ * @param[in] t2          epochal end time of traces (UTC seconds)
+ *
+ * @param[in,out] traces  on input holds the trace numbers of the traces
+ *                        in the data block [ntraces].
+ *                        on output the data holds the samples from t1
+ *                        to t2 and the gain is set.  the data buffers are
+ *                        only reallocated when they are too small.
+ *                        unknown samples are NaN.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ */
+int traceBuffer_h5_readDataSlab(const hid_t groupID,
+                                const int ntraces,
+                                const double t1, const double t2,
+                                struct h5trace_struct *traces)
+{
+    double *gain, dt, ts1, ts2;
+    hid_t attribute, dataSet, dataSpace, memSpace;
+    hsize_t count[2], dims[2], start[2];
+    herr_t status;
+    int i1, ierr, k, maxpts, ncopy, nread, ntracesIn, rankIn;
+    const int rank = 2;
+    //------------------------------------------------------------------------//
+    //
+    // Open the data and pick off the attributes
+    ierr = 0;
+    gain = NULL;
+    memSpace =-1;
+    dataSet = H5Dopen2(groupID, "Data\0", H5P_DEFAULT);
+    dataSpace = H5Dget_space(dataSet);
+    rankIn = H5Sget_simple_extent_ndims(dataSpace);
+    if (rankIn != rank)
+    {
+        LOG_ERRMSG("Invalid number of dimensions %d", rankIn);
+        ierr = 1;
+        goto ERROR;
+    }
+    status = H5Sget_simple_extent_dims(dataSpace, dims, NULL);
+    attribute = H5Aopen(dataSet, "SamplingPeriod\0", H5P_DEFAULT);
+    status = H5Aread(attribute, H5T_NATIVE_DOUBLE, &dt);
+    status = H5Aclose(attribute);
+    attribute = H5Aopen(dataSet, "StartTime\0", H5P_DEFAULT);
+    status = H5Aread(attribute, H5T_NATIVE_DOUBLE, &ts1);
+    status = H5Aclose(attribute);
+    attribute = H5Aopen(dataSet, "NumberOfTraces\0", H5P_DEFAULT);
+    status = H5Aread(attribute, H5T_NATIVE_INT, &ntracesIn);
+    status = H5Aclose(attribute);
+    attribute = H5Aopen(dataSet, "NumberOfPoints\0", H5P_DEFAULT);
+    status = H5Aread(attribute, H5T_NATIVE_INT, &maxpts);
+    status = H5Aclose(attribute);
+    // Check what I just read
+    if (ntracesIn != ntraces || (int) dims[0] != ntraces)
+    {
+        LOG_ERRMSG("Inconsistent number of traces %d %d", ntracesIn, ntraces);
+        ierr = 1;
+        goto ERROR;
+    }
+    if (dt <= 0.0)
+    {
+        LOG_ERRMSG("Invalid sampling period %f", dt);
+        ierr = 1;
+        goto ERROR;
+    }
+    if (maxpts < 1 || (int) dims[1] != maxpts)
+    {
+        LOG_ERRMSG("Invalid number of points %d", maxpts);
+        ierr = 1;
+        goto ERROR;
+    }
+    ts2 = ts1 + (double) (maxpts - 1)*dt;
+    if (t1 > ts2)
+    {
+        LOG_ERRMSG("%s", "Start time is too new");
+        ierr = 1;
+        goto ERROR;
+    }
+    if (t2 < ts1)
+    {
+        LOG_ERRMSG("%s", "End time is too old");
+        ierr = 1;
+        goto ERROR;
+    }
+    if (t2 > ts2)
+    {
+        LOG_ERRMSG("%s", "Looking for data that's too current");
+        ierr = 1;
+        goto ERROR;
+    }
+    if (t1 < ts1)
+    {
+        LOG_ERRMSG("%s", "Error start time is too old");
+        ierr = 1;
+        goto ERROR;
+    }
+    // Indices in chunk to read from
+    i1 = (int) ((t1 - ts1)/dt + 0.5);
+    i1 = MAX(i1, 0);
+    ncopy = (int) ((t2 - t1)/dt + 0.5) + 1;
+    nread = MIN(ncopy, maxpts - i1);
+    if (nread < 1)
+    {
+        LOG_ERRMSG("Invalid read size %d", nread);
+        ierr = 1;
+        goto ERROR;
+    }
+    // Read each trace's hyperslab straight onto its data buffer
+    count[0] = 1;
+    count[1] = (hsize_t) nread;
+    memSpace = H5Screate_simple(1, &count[1], NULL);
+    for (k=0; k<ntraces; k++)
+    {
+        if (traces[k].traceNumber < 0 || traces[k].traceNumber >= ntraces)
+        {
+            LOG_ERRMSG("Invalid trace number %d", traces[k].traceNumber);
+            ierr = 1;
+            goto ERROR;
+        }
+        if (traces[k].data == NULL || traces[k].nalloc < ncopy)
+        {
+            memory_free64f(&traces[k].data);
+            traces[k].data = memory_calloc64f(ncopy);
+            traces[k].nalloc = ncopy;
+        }
+        array_set64f_work(ncopy, (double) NAN, traces[k].data);
+        traces[k].t1 = t1;
+        traces[k].ncopy = ncopy;
+        start[0] = (hsize_t) traces[k].traceNumber;
+        start[1] = (hsize_t) i1;
+        status = H5Sselect_hyperslab(dataSpace, H5S_SELECT_SET,
+                                     start, NULL, count, NULL);
+        if (status < 0)
+        {
+            LOG_ERRMSG("%s", "Error selecting hyperslab");
+            ierr = 1;
+            goto ERROR;
+        }
+        status = H5Dread(dataSet, H5T_NATIVE_DOUBLE, memSpace, dataSpace,
+                         H5P_DEFAULT, traces[k].data);
+        if (status < 0)
+        {
+            LOG_ERRMSG("%s", "Error loading data");
+            ierr = 1;
+            goto ERROR;
+        }
+    }
+    status  = H5Sclose(memSpace);
+    status += H5Sclose(dataSpace);
+    status += H5Dclose(dataSet);
+    memSpace =-1;
+    if (status < 0)
+    {
+        LOG_ERRMSG("%s", "Error closing data dataset");
+        return -1;
+    }
+    // Likewise get the gain for each channel
+    gain = memory_calloc64f(ntraces);
+    dataSet = H5Dopen2(groupID, "Gain\0", H5P_DEFAULT);
+    dataSpace = H5Dget_space(dataSet);
+    dims[0] = (hsize_t) ntraces;
+    memSpace = H5Screate_simple(1, dims, NULL);
+    status = H5Dread(dataSet, H5T_NATIVE_DOUBLE, memSpace, dataSpace,
+                     H5P_DEFAULT, gain);
+    if (status < 0)
+    {
+        LOG_ERRMSG("%s", "Error loading gain");
+        ierr = 1;
+        goto ERROR;
+    }
+    for (k=0; k<ntraces; k++)
+    {
+        traces[k].gain = gain[k];
+    }
+ERROR:;
+    if (memSpace >= 0){H5Sclose(memSpace);}
+    H5Sclose(dataSpace);
+    H5Dclose(dataSet);
+    memory_free64f(&gain);
+    return ierr;
+}
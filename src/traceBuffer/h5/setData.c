@@ -10,6 +10,11 @@
 #include "iscl/array/array.h"
 #include "iscl/memory/memory.h"
 
+static int setRingData(const double currentTime,
+                       const int *__restrict__ map,
+                       const bool *__restrict__ lhaveData,
+                       struct tb2Data_struct tb2Data,
+                       struct h5traceBuffer_struct h5traceBuffer);
 /*
 static int update_dataSet(const hid_t groupID,
                           const char *dataSetName, 
@@ -18,9 +23,11 @@ static int update_dataSet(const hid_t groupID,
 */
 
 /*!
- * @brief Sets the data in the HDF5 file from the data on the tb2Data 
- *        buffer.  If any data is late then it will be filled with NaN's
- *        in the HDF5 file.
+ * @brief Sets the data in the trace buffer from the data on the tb2Data 
+ *        buffer.  The in-memory circular buffers are updated in time
+ *        proportional to the number of new samples.  The HDF5 file is
+ *        only rewritten if the traces are to be saved.  If any data is
+ *        late then it will be filled with NaN's.
  *
  * @param[in] currentTime    current time (UTC seconds since epoch) to which to
  *                           update the HDF5 data buffers. 
@@ -28,8 +35,9 @@ static int update_dataSet(const hid_t groupID,
  *                           disk.  the SNCLs on tb2Data should correspond
  *                           to the SNCLs on h5TraceBuffer and the data should
  *                           be in temporal order. 
- * @param[in] h5traceBuffer  holds the HDF5 group names for each trace and
- *                           HDF5 file details
+ * @param[in] h5traceBuffer  holds the HDF5 group names for each trace,
+ *                           the map from each trace to its trace in
+ *                           tb2Data, and HDF5 file details
  *
  * @author Ben Baker (ISTI)
  *
@@ -40,7 +48,8 @@ int traceBuffer_h5_setData(const double currentTime,
                            struct h5traceBuffer_struct h5traceBuffer)
 {
     double *dwork, *gains, *work;
-    int *map, c1, c2, chunk, i, i1, i2, idt, ierr, ierrAll,
+    const int *map;
+    int c1, c2, chunk, i, i1, i2, idt, ierr, ierrAll,
         indx, is, ishift, jndx, k, k1, k2, maxpts, nchunks, ncopy, ntraces;
     double dt, ts1, ts2;
     bool *lhaveData;
@@ -63,58 +72,42 @@ int traceBuffer_h5_setData(const double currentTime,
     {
         return 0;
     }
-    // Not finished yet
-    if (h5traceBuffer.ndtGroups > 1)
+    if (h5traceBuffer.tb2Map == NULL)
     {
-        LOG_ERRMSG("%s", "Multiple dt groups not yet done");
+        LOG_ERRMSG("%s", "Error tb2Data map not set");
         return -1;
     }
-    // Make a map from the HDF5 trace buffer to the tracebuffer2 data
-    map = array_set32i(h5traceBuffer.ntraces, -1, &ierr);
+    // Flag the traces with new data on the tracebuffer2 data
+    map = h5traceBuffer.tb2Map;
     lhaveData = memory_calloc8l(h5traceBuffer.ntraces);
     for (i=0; i<h5traceBuffer.ntraces; i++)
     {
-        // Take an educated guess
-        if (i < tb2Data.ntraces)
+        k = map[i];
+        if (k < 0 || k >= tb2Data.ntraces){continue;}
+        if (tb2Data.traces[k].npts > 0)
         {
-            if ((strcasecmp(h5traceBuffer.traces[i].netw,
-                                  tb2Data.traces[i].netw) == 0) &&
-                (strcasecmp(h5traceBuffer.traces[i].stnm,
-                                  tb2Data.traces[i].stnm) == 0) && 
-                (strcasecmp(h5traceBuffer.traces[i].chan,
-                                  tb2Data.traces[i].chan) == 0) &&
-                (strcasecmp(h5traceBuffer.traces[i].loc,
-                                  tb2Data.traces[i].loc)  == 0))
-            {
-                map[i] = i;
-                if (tb2Data.traces[i].npts > 0)
-                {
-                    lhaveData[i] = true; 
-                }
-                goto NEXT_TRACE; 
-            }
+            lhaveData[i] = true;
         }
-        // Hunt through the tracebuffers
-        for (k=0; k<tb2Data.ntraces; k++)
+    }
+    // Update the in-memory circular buffers
+    if (h5traceBuffer.lringBuffer)
+    {
+        ierr = setRingData(currentTime, map, lhaveData, tb2Data, h5traceBuffer);
+        if (ierr != 0)
         {
-            if ((strcasecmp(h5traceBuffer.traces[i].netw,
-                                  tb2Data.traces[k].netw) == 0) &&
-                (strcasecmp(h5traceBuffer.traces[i].stnm,
-                                  tb2Data.traces[k].stnm) == 0) &&  
-                (strcasecmp(h5traceBuffer.traces[i].chan,
-                                  tb2Data.traces[k].chan) == 0) &&
-                (strcasecmp(h5traceBuffer.traces[i].loc,
-                                  tb2Data.traces[k].loc)  == 0)) 
-            {   
-                map[i] = k;
-                if (tb2Data.traces[i].npts > 0)
-                {
-                    lhaveData[i] = true;
-                }
-                goto NEXT_TRACE;
-            }
+            LOG_ERRMSG("%s", "Error updating circular buffers");
+            ierrAll = 1;
+            goto ERROR;
         }
-NEXT_TRACE:;
+    }
+    // The HDF5 file is only rewritten if the traces are to be saved
+    if (!h5traceBuffer.lh5File){goto ERROR;}
+    // Not finished yet
+    if (h5traceBuffer.ndtGroups > 1)
+    {
+        LOG_ERRMSG("%s", "Multiple dt groups not yet done");
+        ierrAll = 1;
+        goto ERROR;
     }
     for (idt=0; idt<h5traceBuffer.ndtGroups; idt++)
     {
@@ -156,7 +149,6 @@ NEXT_TRACE:;
         dwork = array_set64f(maxpts*ntraces, (double) NAN, &ierr);
         ishift = (int) ((currentTime - ts2)/dt + 0.5);
         ncopy = maxpts - ishift;
-printf("%d\n", ishift);
         for (k=0; k<ntraces; k++)
         {
             indx = k*maxpts + ishift;
@@ -191,11 +183,12 @@ printf("%d\n", ishift);
                 i2 = tb2Data.traces[i].chunkPtr[chunk+1];
                 for (is=i1; is<i2; is++)
                 {
-                    // data expired
-                    if (tb2Data.traces[i].times[is] < ts1){continue;}
+                    // data expired or from the future
+                    jndx = (int) ((tb2Data.traces[i].times[is] - ts1)/dt
+                                + 0.5);
+                    if (jndx < 0 || jndx > maxpts - 1){continue;}
                     // insert it
-                    indx = k*maxpts
-                         + (int) ((tb2Data.traces[i].times[is] - ts1)/dt + 0.5);
+                    indx = k*maxpts + jndx;
                     dwork[indx] = (double) tb2Data.traces[i].data[is];
                 }
             } // Loop on data chunks 
@@ -234,12 +227,97 @@ printf("%d\n", ishift);
         memory_free64f(&work); 
         memory_free64f(&dwork);
     }
+ERROR:;
     // Free memory
-    memory_free32i(&map);
     memory_free8l(&lhaveData);
     return ierrAll;
 }
 //============================================================================//
+/*!
+ * @brief Advances the in-memory circular buffers to the current time and
+ *        inserts the new samples.  The cost is proportional to the number
+ *        of expired plus new samples rather than the buffer length.
+ *
+ * @param[in] currentTime    current time (UTC seconds since epoch) to which
+ *                           to advance the circular buffers
+ * @param[in] map            maps from the i'th trace in h5traceBuffer to the
+ *                           trace in tb2Data [h5traceBuffer.ntraces]
+ * @param[in] lhaveData      if true then the i'th trace in h5traceBuffer has
+ *                           new data in tb2Data [h5traceBuffer.ntraces]
+ * @param[in] tb2Data        holds the tracebuffer2 data to insert
+ * @param[in] h5traceBuffer  holds the circular buffers.  on exit the
+ *                           circular buffers on the traces are updated.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ */
+static int setRingData(const double currentTime,
+                       const int *__restrict__ map,
+                       const bool *__restrict__ lhaveData,
+                       struct tb2Data_struct tb2Data,
+                       struct h5traceBuffer_struct h5traceBuffer)
+{
+    struct h5trace_struct *trace;
+    double *ring, dt, ts1;
+    int chunk, i, i1, i2, indx, is, ishift, j, k, maxpts, nchunks;
+    //------------------------------------------------------------------------//
+    for (k=0; k<h5traceBuffer.ntraces; k++)
+    {
+        trace = &h5traceBuffer.traces[k];
+        ring = trace->ringBuffer;
+        maxpts = trace->maxpts;
+        dt = trace->dt;
+        if (ring == NULL || maxpts < 1 || dt <= 0.0)
+        {
+            LOG_ERRMSG("Invalid circular buffer on trace %d", k+1);
+            return -1;
+        }
+        // Expire the oldest samples
+        ishift = (int) ((currentTime - trace->ringEndTime)/dt + 0.5);
+        if (ishift < 0)
+        {
+            LOG_ERRMSG("Update time is less than most recent time %f %f",
+                       currentTime, trace->ringEndTime);
+            return -1;
+        }
+        if (ishift >= maxpts)
+        {
+            for (j=0; j<maxpts; j++){ring[j] = (double) NAN;}
+        }
+        else
+        {
+            for (j=1; j<=ishift; j++)
+            {
+                ring[(trace->ringHead + j)%maxpts] = (double) NAN;
+            }
+        }
+        trace->ringHead = (trace->ringHead + ishift%maxpts)%maxpts;
+        trace->ringEndTime = trace->ringEndTime + (double) ishift*dt;
+        if (!lhaveData[k]){continue;}
+        // Insert the new data.  The oldest sample is at ringHead + 1.
+        ts1 = trace->ringEndTime - (double) (maxpts - 1)*dt;
+        i = map[k];
+        nchunks = tb2Data.traces[i].nchunks;
+        for (chunk=0; chunk<nchunks; chunk++)
+        {
+            i1 = tb2Data.traces[i].chunkPtr[chunk];
+            i2 = tb2Data.traces[i].chunkPtr[chunk+1];
+            for (is=i1; is<i2; is++)
+            {
+                indx = (int) ((tb2Data.traces[i].times[is] - ts1)/dt + 0.5);
+                // data expired or from the future
+                if (indx < 0 || indx > maxpts - 1){continue;}
+                ring[(trace->ringHead + 1 + indx)%maxpts]
+                    = (double) tb2Data.traces[i].data[is];
+            }
+        } // Loop on data chunks
+    } // Loop on traces
+    return 0;
+}
+//============================================================================//
 /*!
  * @brief Updates the subset of data in the existing dataSetName
  *        to dataSet[i1:i2] inclusive
@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_traceBuffer.h"
+#include "gfast_core.h"
+#include "iscl/memory/memory.h"
+
+/*!
+ * @brief Maps each trace in the HDF5 trace buffer to its trace in the
+ *        tracebuffer2 data.  The SNCLs are fixed after initialization so
+ *        this is done once rather than on every call to
+ *        traceBuffer_h5_setData.
+ *
+ * @param[in] snclIndex          maps a SNCL to its trace in tb2Data.  the
+ *                               k'th trace in tb2Data must have id k in
+ *                               the index.
+ *
+ * @param[in,out] h5traceBuffer  on input holds the SNCLs of the traces.
+ *                               on output tb2Map maps the i'th trace to
+ *                               its trace in tb2Data or to -1 if it is not
+ *                               in tb2Data.
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ */
+int traceBuffer_h5_setTb2DataMap(const struct snclIndex_struct *snclIndex,
+                                 struct h5traceBuffer_struct *h5traceBuffer)
+{
+    int i;
+    //------------------------------------------------------------------------//
+    if (!snclIndex->linit)
+    {
+        LOG_ERRMSG("%s", "Error SNCL index not set");
+        return -1;
+    }
+    if (h5traceBuffer->traces == NULL || h5traceBuffer->ntraces < 1)
+    {
+        LOG_ERRMSG("%s", "Input traces do not exist");
+        return -1;
+    }
+    memory_free32i(&h5traceBuffer->tb2Map);
+    h5traceBuffer->tb2Map = memory_calloc32i(h5traceBuffer->ntraces);
+    if (h5traceBuffer->tb2Map == NULL)
+    {
+        LOG_ERRMSG("%s", "Error allocating tb2Data map");
+        return -1;
+    }
+    for (i=0; i<h5traceBuffer->ntraces; i++)
+    {
+        h5traceBuffer->tb2Map[i]
+            = traceBuffer_sncl_find(h5traceBuffer->traces[i].netw,
+                                    h5traceBuffer->traces[i].stnm,
+                                    h5traceBuffer->traces[i].chan,
+                                    h5traceBuffer->traces[i].loc,
+                                    snclIndex);
+    }
+    return 0;
+}
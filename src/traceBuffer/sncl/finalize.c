@@ -0,0 +1,26 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_traceBuffer.h"
+#include "gfast_core.h"
+#include "iscl/memory/memory.h"
+
+/*!
+ * @brief Releases memory on the SNCL hash index.
+ *
+ * @param[in,out] snclIndex  on input the SNCL index.
+ *                           on output the structure has been cleared.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+void traceBuffer_sncl_finalize(struct snclIndex_struct *snclIndex)
+{
+    memory_free8c(&snclIndex->keys);
+    if (snclIndex->hashes != NULL){free(snclIndex->hashes);}
+    memory_free32i(&snclIndex->table);
+    memset(snclIndex, 0, sizeof(struct snclIndex_struct));
+    return;
+}
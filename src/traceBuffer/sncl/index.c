@@ -0,0 +1,252 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include "gfast_traceBuffer.h"
+#include "gfast_core.h"
+
+static int normalizeKey(const char *key, char keyOut[SNCL_KEY_LEN]);
+static unsigned int hashKey(const char *key);
+static int probe(const char *key, const unsigned int hash,
+                 const struct snclIndex_struct *snclIndex, int *slot);
+
+/*!
+ * @brief Makes the upper case NET.STA.CHAN.LOC key for the given SNCL.
+ *        Since the key is upper case lookups are case insensitive.
+ *
+ * @param[in] netw     null terminated network name
+ * @param[in] stnm     null terminated station name
+ * @param[in] chan     null terminated channel name
+ * @param[in] loc      null terminated location code
+ *
+ * @param[out] key     null terminated NET.STA.CHAN.LOC key
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_sncl_makeKey(const char *netw, const char *stnm,
+                             const char *chan, const char *loc,
+                             char key[SNCL_KEY_LEN])
+{
+    char temp[SNCL_KEY_LEN];
+    int lenos;
+    //------------------------------------------------------------------------//
+    memset(key, 0, SNCL_KEY_LEN*sizeof(char));
+    lenos = snprintf(temp, SNCL_KEY_LEN, "%s.%s.%s.%s",
+                     netw, stnm, chan, loc);
+    if (lenos < 0 || lenos >= SNCL_KEY_LEN)
+    {
+        LOG_ERRMSG("SNCL %s.%s.%s.%s is too long", netw, stnm, chan, loc);
+        return -1;
+    }
+    return normalizeKey(temp, key);
+}
+//============================================================================//
+/*!
+ * @brief Interns the key and returns its dense id.  If the key already
+ *        exists then its existing id is returned.
+ *
+ * @param[in] key            null terminated NET.STA.CHAN.LOC key
+ *
+ * @param[in,out] snclIndex  on input the SNCL index.
+ *                           on output the key has been interned.
+ *
+ * @result the id of the key on success.
+ *         -1 indicates an error.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_sncl_insertKey(const char *key,
+                               struct snclIndex_struct *snclIndex)
+{
+    char keyWork[SNCL_KEY_LEN];
+    unsigned int hash;
+    int id, slot;
+    //------------------------------------------------------------------------//
+    if (!snclIndex->linit)
+    {
+        LOG_ERRMSG("%s", "SNCL index never initialized");
+        return -1;
+    }
+    if (normalizeKey(key, keyWork) != 0){return -1;}
+    hash = hashKey(keyWork);
+    id = probe(keyWork, hash, snclIndex, &slot);
+    if (id >= 0){return id;}
+    if (snclIndex->nids >= snclIndex->maxids)
+    {
+        LOG_ERRMSG("SNCL index is full %d", snclIndex->maxids);
+        return -1;
+    }
+    id = snclIndex->nids;
+    strcpy(&snclIndex->keys[id*SNCL_KEY_LEN], keyWork);
+    snclIndex->hashes[id] = hash;
+    snclIndex->table[slot] = id;
+    snclIndex->nids = snclIndex->nids + 1;
+    return id;
+}
+//============================================================================//
+/*!
+ * @brief Interns the SNCL and returns its dense id.  If the SNCL already
+ *        exists then its existing id is returned.
+ *
+ * @param[in] netw           null terminated network name
+ * @param[in] stnm           null terminated station name
+ * @param[in] chan           null terminated channel name
+ * @param[in] loc            null terminated location code
+ *
+ * @param[in,out] snclIndex  on input the SNCL index.
+ *                           on output the SNCL has been interned.
+ *
+ * @result the id of the SNCL on success.
+ *         -1 indicates an error.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_sncl_insert(const char *netw, const char *stnm,
+                            const char *chan, const char *loc,
+                            struct snclIndex_struct *snclIndex)
+{
+    char key[SNCL_KEY_LEN];
+    if (traceBuffer_sncl_makeKey(netw, stnm, chan, loc, key) != 0)
+    {
+        return -1;
+    }
+    return traceBuffer_sncl_insertKey(key, snclIndex);
+}
+//============================================================================//
+/*!
+ * @brief Finds the id of the given key.
+ *
+ * @param[in] key         null terminated NET.STA.CHAN.LOC key
+ * @param[in] snclIndex   the SNCL index
+ *
+ * @result the id of the key.
+ *         -1 indicates the key was not found.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_sncl_findKey(const char *key,
+                             const struct snclIndex_struct *snclIndex)
+{
+    char keyWork[SNCL_KEY_LEN];
+    int slot;
+    if (!snclIndex->linit || snclIndex->nids < 1){return -1;}
+    if (normalizeKey(key, keyWork) != 0){return -1;}
+    return probe(keyWork, hashKey(keyWork), snclIndex, &slot);
+}
+//============================================================================//
+/*!
+ * @brief Finds the id of the given SNCL.
+ *
+ * @param[in] netw        null terminated network name
+ * @param[in] stnm        null terminated station name
+ * @param[in] chan        null terminated channel name
+ * @param[in] loc         null terminated location code
+ * @param[in] snclIndex   the SNCL index
+ *
+ * @result the id of the SNCL.
+ *         -1 indicates the SNCL was not found.
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_sncl_find(const char *netw, const char *stnm,
+                          const char *chan, const char *loc,
+                          const struct snclIndex_struct *snclIndex)
+{
+    char key[SNCL_KEY_LEN];
+    int slot;
+    if (!snclIndex->linit || snclIndex->nids < 1){return -1;}
+    if (traceBuffer_sncl_makeKey(netw, stnm, chan, loc, key) != 0)
+    {
+        return -1;
+    }
+    return probe(key, hashKey(key), snclIndex, &slot);
+}
+//============================================================================//
+/*!
+ * @brief Copies the key to an upper case work key.
+ *
+ * @param[in] key      null terminated key
+ *
+ * @param[out] keyOut  null terminated upper case key
+ *
+ * @result 0 indicates success
+ *
+ */
+static int normalizeKey(const char *key, char keyOut[SNCL_KEY_LEN])
+{
+    int i;
+    for (i=0; i<SNCL_KEY_LEN; i++)
+    {
+        keyOut[i] = (char) toupper((unsigned char) key[i]);
+        if (key[i] == '\0'){return 0;}
+    }
+    LOG_ERRMSG("%s", "SNCL key is too long");
+    keyOut[SNCL_KEY_LEN-1] = '\0';
+    return -1;
+}
+//============================================================================//
+/*!
+ * @brief 32 bit FNV-1a hash of the null terminated key.
+ */
+static unsigned int hashKey(const char *key)
+{
+    unsigned int hash;
+    const unsigned char *c;
+    hash = 2166136261u;
+    for (c=(const unsigned char *) key; *c != '\0'; c++)
+    {
+        hash = (hash ^ (unsigned int) *c)*16777619u;
+    }
+    return hash;
+}
+//============================================================================//
+/*!
+ * @brief Linearly probes the hash table for the key.
+ *
+ * @param[in] key        null terminated upper case key
+ * @param[in] hash       hash of key
+ * @param[in] snclIndex  the SNCL index
+ *
+ * @param[out] slot      if the key is found then this is its slot in the
+ *                       hash table.  otherwise, this is the empty slot
+ *                       where the key would be inserted.
+ *
+ * @result the id of the key or -1 if the key is not in the table
+ *
+ */
+static int probe(const char *key, const unsigned int hash,
+                 const struct snclIndex_struct *snclIndex, int *slot)
+{
+    int id, k, mask;
+    mask = snclIndex->tableSize - 1;
+    *slot = (int) (hash & (unsigned int) mask);
+    for (k=0; k<snclIndex->tableSize; k++)
+    {
+        id = snclIndex->table[*slot];
+        if (id < 0){return -1;}
+        if (snclIndex->hashes[id] == hash &&
+            strcmp(&snclIndex->keys[id*SNCL_KEY_LEN], key) == 0)
+        {
+            return id;
+        }
+        *slot = (*slot + 1) & mask;
+    }
+    return -1;
+}
@@ -0,0 +1,53 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast_traceBuffer.h"
+#include "gfast_core.h"
+#include "iscl/array/array.h"
+#include "iscl/memory/memory.h"
+
+/*!
+ * @brief Initializes the SNCL hash index.  The hash table is sized to be
+ *        at most half full so that lookups remain O(1).
+ *
+ * @param[in] maxids       max number of SNCLs that will be interned
+ *
+ * @param[out] snclIndex   on successful exit has space for maxids SNCLs
+ *                         and an empty hash table
+ *
+ * @result 0 indicates success
+ *
+ * @author Ben Baker (ISTI)
+ *
+ * @copyright Apache 2
+ *
+ */
+int traceBuffer_sncl_initialize(const int maxids,
+                                struct snclIndex_struct *snclIndex)
+{
+    int ierr, tableSize;
+    //------------------------------------------------------------------------//
+    memset(snclIndex, 0, sizeof(struct snclIndex_struct));
+    if (maxids < 1)
+    {
+        LOG_ERRMSG("Invalid number of SNCLs %d", maxids);
+        return -1;
+    }
+    tableSize = 16;
+    while (tableSize < 2*maxids){tableSize = 2*tableSize;}
+    snclIndex->keys = memory_calloc8c(maxids*SNCL_KEY_LEN);
+    snclIndex->hashes = (unsigned int *)
+                        calloc((size_t) maxids, sizeof(unsigned int));
+    snclIndex->table = array_set32i(tableSize, -1, &ierr);
+    if (snclIndex->keys == NULL || snclIndex->hashes == NULL || ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error allocating SNCL index");
+        traceBuffer_sncl_finalize(snclIndex);
+        return -1;
+    }
+    snclIndex->tableSize = tableSize;
+    snclIndex->maxids = maxids;
+    snclIndex->nids = 0;
+    snclIndex->linit = true;
+    return 0;
+}
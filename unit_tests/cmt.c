@@ -3,11 +3,15 @@
 #include <stdbool.h>
 #include <string.h>
 #include <math.h>
+#include <float.h>
 #include "gfast.h"
 #include "iscl/memory/memory.h"
 
 int cmt_greens_test(void);
 int cmt_inversion_test(void);
+int cmt_cachedDepthGridSearch_test(void);
+int cmt_gridSearch_test(void);
+int cmt_adaptiveGridSearch_test(void);
 
 static bool lequal(double a, double b, double tol)
 {
@@ -185,18 +189,57 @@ ERROR:;
     return ierr;
 }
 //============================================================================//
+/*!
+ * @brief Allocates the CMT results for a depth grid search.
+ */
+static void setResults(const int nsites, const int ndeps,
+                       const double *srcDepths,
+                       struct GFAST_cmtResults_struct *cmt)
+{
+    int i;
+    cmt->nsites = nsites;
+    cmt->ndeps = ndeps;
+    cmt->nlats = 1;
+    cmt->nlons = 1;
+    cmt->l2 = memory_calloc64f(ndeps);
+    cmt->pct_dc = memory_calloc64f(ndeps);
+    cmt->objfn = memory_calloc64f(ndeps);
+    cmt->mts = memory_calloc64f(ndeps*6);
+    cmt->str1 = memory_calloc64f(ndeps);
+    cmt->str2 = memory_calloc64f(ndeps);
+    cmt->dip1 = memory_calloc64f(ndeps);
+    cmt->dip2 = memory_calloc64f(ndeps);
+    cmt->rak1 = memory_calloc64f(ndeps);
+    cmt->rak2 = memory_calloc64f(ndeps);
+    cmt->Mw = memory_calloc64f(ndeps);
+    cmt->srcDepths = memory_calloc64f(ndeps);
+    cmt->EN = memory_calloc64f(ndeps*nsites);
+    cmt->NN = memory_calloc64f(ndeps*nsites);
+    cmt->UN = memory_calloc64f(ndeps*nsites);
+    cmt->Einp = memory_calloc64f(nsites);
+    cmt->Ninp = memory_calloc64f(nsites);
+    cmt->Uinp = memory_calloc64f(nsites);
+    cmt->lsiteUsed = memory_calloc8l(nsites);
+    cmt->decompWork = memory_calloc64f(CMT_DECOMP_LWORK*ndeps);
+    for (i=0; i<ndeps; i++){cmt->srcDepths[i] = srcDepths[i];}
+    return;
+}
+//============================================================================//
 int cmt_inversion_test(void)
 {
     const char *filenm = "files/final_cmt.maule.txt\0";
     struct GFAST_cmt_props_struct cmt_props;
     struct GFAST_offsetData_struct cmt_data;
-    struct GFAST_cmtResults_struct cmt_ref, cmt; 
+    struct GFAST_cmtResults_struct cmt_ref, cmt, cmtAdapt;
     double SA_lat, SA_lon, SA_dep;
-    int i, ierr, j;
+    int i, ierr, iopt, j, nsearched;
+    // 97 of the depths can be refined 5 times
+    const int ndepsAdapt = 97;
     memset(&cmt_props, 0, sizeof(cmt_props));
     memset(&cmt_data, 0, sizeof(cmt_data));
     memset(&cmt_ref, 0, sizeof(cmt_ref));
     memset(&cmt, 0, sizeof(cmt));
+    memset(&cmtAdapt, 0, sizeof(cmtAdapt));
     ierr = read_results(filenm,
                         &cmt_props,
                         &cmt_data,
@@ -208,35 +251,11 @@ int cmt_inversion_test(void)
         return EXIT_FAILURE;
     }
     // Set space
-    cmt.nsites = cmt_ref.nsites;
-    cmt.ndeps = cmt_ref.ndeps;
-    cmt.nlats = cmt_ref.nlats;
-    cmt.nlons = cmt_ref.nlons;
-    cmt.l2 = memory_calloc64f(cmt.ndeps);
-    cmt.pct_dc = memory_calloc64f(cmt.ndeps);
-    cmt.objfn = memory_calloc64f(cmt.ndeps);
-    cmt.mts = memory_calloc64f(cmt.ndeps*6);
-    cmt.str1 = memory_calloc64f(cmt.ndeps);
-    cmt.str2 = memory_calloc64f(cmt.ndeps);
-    cmt.dip1 = memory_calloc64f(cmt.ndeps);
-    cmt.dip2 = memory_calloc64f(cmt.ndeps);
-    cmt.rak1 = memory_calloc64f(cmt.ndeps);
-    cmt.rak2 = memory_calloc64f(cmt.ndeps);
-    cmt.Mw = memory_calloc64f(cmt.ndeps);
-    cmt.srcDepths = memory_calloc64f(cmt.ndeps);
-    cmt.EN = memory_calloc64f(cmt.ndeps*cmt_data.nsites);
-    cmt.NN = memory_calloc64f(cmt.ndeps*cmt_data.nsites);
-    cmt.UN = memory_calloc64f(cmt.ndeps*cmt_data.nsites);
-    cmt.Einp = memory_calloc64f(cmt_data.nsites);
-    cmt.Ninp = memory_calloc64f(cmt_data.nsites);
-    cmt.Uinp = memory_calloc64f(cmt_data.nsites);
-    cmt.lsiteUsed = memory_calloc8l(cmt_data.nsites);
-    for (i=0; i<cmt.ndeps; i++)
-    {
-        cmt.srcDepths[i] = cmt_ref.srcDepths[i];
-    }
+    setResults(cmt_data.nsites, cmt_ref.ndeps, cmt_ref.srcDepths, &cmt);
+    setResults(cmt_data.nsites, ndepsAdapt, cmt_ref.srcDepths, &cmtAdapt);
     ierr = eewUtils_driveCMT(cmt_props,
                              SA_lat, SA_lon, SA_dep,
+                             NULL,
                              cmt_data,
                              &cmt);
     if (ierr != CMT_SUCCESS)
@@ -323,13 +342,609 @@ int cmt_inversion_test(void)
             } 
         }
     }
+    // The adaptive search matches the full search at the depths it visits
+    // and finds the same optimum
+    iopt = cmt.opt_indx;
+    if (iopt >= ndepsAdapt)
+    {
+        LOG_ERRMSG("Error optimum %d is outside adaptive grid", iopt);
+        return EXIT_FAILURE;
+    }
+    cmt_props.ngridSearch_deps = ndepsAdapt;
+    cmt_props.ladaptive = true;
+    cmt_props.adaptive_nrefine = 5;
+    cmt_props.adaptive_maxEvals = 20;
+    ierr = eewUtils_driveCMT(cmt_props,
+                             SA_lat, SA_lon, SA_dep,
+                             NULL,
+                             cmt_data,
+                             &cmtAdapt);
+    if (ierr != CMT_SUCCESS)
+    {
+        LOG_ERRMSG("%s", "Error computing adaptive CMT");
+        return EXIT_FAILURE;
+    }
+    if (cmtAdapt.opt_indx != iopt)
+    {
+        LOG_ERRMSG("Error adaptive optimum %d differs from %d",
+                   cmtAdapt.opt_indx, iopt);
+        return EXIT_FAILURE;
+    }
+    nsearched = 0;
+    for (i=0; i<cmtAdapt.ndeps; i++)
+    {
+        if (cmtAdapt.objfn[i] == DBL_MAX){continue;}
+        nsearched = nsearched + 1;
+        if (!lequal(cmtAdapt.objfn[i], cmt_ref.objfn[i], 1.e-4) ||
+            !lequal(cmtAdapt.Mw[i], cmt.Mw[i], 1.e-10))
+        {
+            LOG_ERRMSG("Error adaptive objfn is wrong %f %f %f",
+                       cmtAdapt.srcDepths[i], cmtAdapt.objfn[i],
+                       cmt_ref.objfn[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (nsearched < 4 || nsearched > cmt_props.adaptive_maxEvals)
+    {
+        LOG_ERRMSG("Error adaptive search visited %d depths", nsearched);
+        return EXIT_FAILURE;
+    }
     // Clean up
     GFAST_core_cmt_finalizeOffsetData(&cmt_data);
     GFAST_core_cmt_finalizeResults(&cmt);
+    GFAST_core_cmt_finalizeResults(&cmtAdapt);
     GFAST_core_cmt_finalizeResults(&cmt_ref);
     LOG_INFOMSG("%s", "Success!");
     return EXIT_SUCCESS; 
 }
+//============================================================================//
+/*!
+ * @brief Compacts the active sites into the inversion arrays.
+ */
+static int compactSites(const struct GFAST_offsetData_struct cmt_data,
+                        const bool *luse, const int zone,
+                        const double scale,
+                        double *utmRecvEasting, double *utmRecvNorthing,
+                        double *staAlt,
+                        double *nObs, double *eObs, double *uObs,
+                        double *nWts, double *eWts, double *uWts)
+{
+    double x, y;
+    int k, l1, zone_loc;
+    bool lnorthp;
+    l1 = 0;
+    for (k=0; k<cmt_data.nsites; k++)
+    {
+        if (!luse[k]){continue;}
+        zone_loc = zone;
+        core_coordtools_ll2utm(cmt_data.sta_lat[k], cmt_data.sta_lon[k],
+                               &y, &x, &lnorthp, &zone_loc);
+        utmRecvEasting[l1] = x;
+        utmRecvNorthing[l1] = y;
+        staAlt[l1] = cmt_data.sta_alt[k];
+        nObs[l1] = scale*cmt_data.nbuff[k];
+        eObs[l1] = scale*cmt_data.ebuff[k];
+        uObs[l1] = scale*cmt_data.ubuff[k];
+        nWts[l1] = cmt_data.wtn[k];
+        eWts[l1] = cmt_data.wte[k];
+        uWts[l1] = cmt_data.wtu[k];
+        l1 = l1 + 1;
+    }
+    return l1;
+}
+//============================================================================//
+int cmt_cachedDepthGridSearch_test(void)
+{
+    const char *filenm = "files/final_cmt.maule.txt\0";
+    struct GFAST_cmt_props_struct cmt_props;
+    struct GFAST_offsetData_struct cmt_data;
+    struct GFAST_cmtResults_struct cmt_ref, cmt;
+    double *eEst, *eEstRef, *eObs, *eWts, *mts, *mtsRef,
+           *nEst, *nEstRef, *nObs, *nWts, *staAlt,
+           *uEst, *uEstRef, *uObs, *uWts,
+           *utmRecvEasting, *utmRecvNorthing,
+           SA_lat, SA_lon, SA_dep, scale, x1, y1;
+    int i, ierr, itest, l1, nsites, zone_loc;
+    bool *luse, lnorthp;
+    // Drop the last sites, reuse, add the sites back, then drop one
+    const int ndrop[4] = {3, 3, 0, 1};
+    const double scales[4] = {1.0, 1.1, 1.1, 0.9};
+    memset(&cmt_props, 0, sizeof(cmt_props));
+    memset(&cmt_data, 0, sizeof(cmt_data));
+    memset(&cmt_ref, 0, sizeof(cmt_ref));
+    memset(&cmt, 0, sizeof(cmt));
+    ierr = read_results(filenm,
+                        &cmt_props,
+                        &cmt_data,
+                        &cmt_ref,
+                        &SA_lat, &SA_lon, &SA_dep);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error reading input file");
+        return EXIT_FAILURE;
+    }
+    nsites = cmt_data.nsites;
+    cmt.nsites = nsites;
+    cmt.ndeps = cmt_ref.ndeps;
+    ierr = core_cmt_initializeGreensCache(&cmt);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error initializing cache");
+        return EXIT_FAILURE;
+    }
+    luse = memory_calloc8l(nsites);
+    utmRecvEasting = memory_calloc64f(nsites);
+    utmRecvNorthing = memory_calloc64f(nsites);
+    staAlt = memory_calloc64f(nsites);
+    nObs = memory_calloc64f(nsites);
+    eObs = memory_calloc64f(nsites);
+    uObs = memory_calloc64f(nsites);
+    nWts = memory_calloc64f(nsites);
+    eWts = memory_calloc64f(nsites);
+    uWts = memory_calloc64f(nsites);
+    nEst = memory_calloc64f(nsites*cmt.ndeps);
+    eEst = memory_calloc64f(nsites*cmt.ndeps);
+    uEst = memory_calloc64f(nsites*cmt.ndeps);
+    nEstRef = memory_calloc64f(nsites*cmt.ndeps);
+    eEstRef = memory_calloc64f(nsites*cmt.ndeps);
+    uEstRef = memory_calloc64f(nsites*cmt.ndeps);
+    mts = memory_calloc64f(6*cmt.ndeps);
+    mtsRef = memory_calloc64f(6*cmt.ndeps);
+    zone_loc = cmt_props.utm_zone;
+    core_coordtools_ll2utm(SA_lat, SA_lon,
+                           &y1, &x1,
+                           &lnorthp, &zone_loc);
+    for (itest=0; itest<4; itest++)
+    {
+        scale = scales[itest];
+        for (i=0; i<nsites; i++){luse[i] = true;}
+        for (i=0; i<ndrop[itest]; i++){luse[nsites-1-i] = false;}
+        l1 = compactSites(cmt_data, luse, zone_loc, scale,
+                          utmRecvEasting, utmRecvNorthing, staAlt,
+                          nObs, eObs, uObs, nWts, eWts, uWts);
+        ierr = core_cmt_depthGridSearch(l1, cmt.ndeps,
+                                        0, true,
+                                        x1, y1,
+                                        cmt_ref.srcDepths,
+                                        utmRecvEasting,
+                                        utmRecvNorthing,
+                                        staAlt,
+                                        nObs, eObs, uObs,
+                                        nWts, eWts, uWts,
+                                        nEstRef, eEstRef, uEstRef,
+                                        mtsRef);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing reference CMT");
+            return EXIT_FAILURE;
+        }
+        ierr = core_cmt_cachedDepthGridSearch(cmt.greens, nsites, luse,
+                                              l1, cmt.ndeps,
+                                              0, true,
+                                              x1, y1,
+                                              cmt_ref.srcDepths,
+                                              utmRecvEasting,
+                                              utmRecvNorthing,
+                                              staAlt,
+                                              nObs, eObs, uObs,
+                                              nWts, eWts, uWts,
+                                              nEst, eEst, uEst,
+                                              mts);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing cached CMT");
+            return EXIT_FAILURE;
+        }
+        for (i=0; i<6*cmt.ndeps; i++)
+        {
+            if (!lequal(mts[i], mtsRef[i], 1.e-8))
+            {
+                LOG_ERRMSG("Error mts differ in test %d %e %e",
+                           itest, mts[i], mtsRef[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        for (i=0; i<l1*cmt.ndeps; i++)
+        {
+            if (fabs(nEst[i] - nEstRef[i]) > 1.e-10 ||
+                fabs(eEst[i] - eEstRef[i]) > 1.e-10 ||
+                fabs(uEst[i] - uEstRef[i]) > 1.e-10)
+            {
+                LOG_ERRMSG("Error estimates differ in test %d", itest);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    // Clean up
+    memory_free8l(&luse);
+    memory_free64f(&utmRecvEasting);
+    memory_free64f(&utmRecvNorthing);
+    memory_free64f(&staAlt);
+    memory_free64f(&nObs);
+    memory_free64f(&eObs);
+    memory_free64f(&uObs);
+    memory_free64f(&nWts);
+    memory_free64f(&eWts);
+    memory_free64f(&uWts);
+    memory_free64f(&nEst);
+    memory_free64f(&eEst);
+    memory_free64f(&uEst);
+    memory_free64f(&nEstRef);
+    memory_free64f(&eEstRef);
+    memory_free64f(&uEstRef);
+    memory_free64f(&mts);
+    memory_free64f(&mtsRef);
+    GFAST_core_cmt_finalizeOffsetData(&cmt_data);
+    GFAST_core_cmt_finalizeResults(&cmt);
+    GFAST_core_cmt_finalizeResults(&cmt_ref);
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
+//============================================================================//
+int cmt_gridSearch_test(void)
+{
+    const char *filenm = "files/final_cmt.maule.txt\0";
+    struct GFAST_cmt_props_struct cmt_props;
+    struct GFAST_offsetData_struct cmt_data;
+    struct GFAST_cmtResults_struct cmt_ref;
+    double *eEst, *eEstRef, *eObs, *eWts, *mts, *mtsRef,
+           *nEst, *nEstRef, *nObs, *nWts, *staAlt,
+           *uEst, *uEstRef, *uObs, *uWts,
+           *utmRecvEasting, *utmRecvNorthing,
+           dx, dy, dz, res2, SA_lat, SA_lon, SA_dep, wrss, x1, y1,
+           xsrc[9], ysrc[9];
+    int i, idep, ierr, ilat, ilatLon, ilon, l1, ndeps, nloc, nsites,
+        zone_loc;
+    bool *luse, lnorthp;
+    const int nlats = 3;
+    const int nlons = 3;
+    memset(&cmt_props, 0, sizeof(cmt_props));
+    memset(&cmt_data, 0, sizeof(cmt_data));
+    memset(&cmt_ref, 0, sizeof(cmt_ref));
+    ierr = read_results(filenm,
+                        &cmt_props,
+                        &cmt_data,
+                        &cmt_ref,
+                        &SA_lat, &SA_lon, &SA_dep);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error reading input file");
+        return EXIT_FAILURE;
+    }
+    nsites = cmt_data.nsites;
+    ndeps = cmt_ref.ndeps;
+    nloc = nlats*nlons*ndeps;
+    luse = memory_calloc8l(nsites);
+    utmRecvEasting = memory_calloc64f(nsites);
+    utmRecvNorthing = memory_calloc64f(nsites);
+    staAlt = memory_calloc64f(nsites);
+    nObs = memory_calloc64f(nsites);
+    eObs = memory_calloc64f(nsites);
+    uObs = memory_calloc64f(nsites);
+    nWts = memory_calloc64f(nsites);
+    eWts = memory_calloc64f(nsites);
+    uWts = memory_calloc64f(nsites);
+    nEst = memory_calloc64f(nsites*nloc);
+    eEst = memory_calloc64f(nsites*nloc);
+    uEst = memory_calloc64f(nsites*nloc);
+    nEstRef = memory_calloc64f(nsites*ndeps);
+    eEstRef = memory_calloc64f(nsites*ndeps);
+    uEstRef = memory_calloc64f(nsites*ndeps);
+    mts = memory_calloc64f(6*nloc);
+    mtsRef = memory_calloc64f(6*ndeps);
+    for (i=0; i<nsites; i++){luse[i] = true;}
+    zone_loc = cmt_props.utm_zone;
+    core_coordtools_ll2utm(SA_lat, SA_lon,
+                           &y1, &x1,
+                           &lnorthp, &zone_loc);
+    l1 = compactSites(cmt_data, luse, zone_loc, 1.0,
+                      utmRecvEasting, utmRecvNorthing, staAlt,
+                      nObs, eObs, uObs, nWts, eWts, uWts);
+    // Put a 20 km grid around the source
+    for (ilon=0; ilon<nlons; ilon++)
+    {
+        for (ilat=0; ilat<nlats; ilat++)
+        {
+            ilatLon = ilon*nlats + ilat;
+            xsrc[ilatLon] = x1 + (double) (ilon - 1)*20.e3;
+            ysrc[ilatLon] = y1 + (double) (ilat - 1)*20.e3;
+        }
+    }
+    ierr = core_cmt_gridSearch(l1, ndeps, nlats, nlons,
+                               0, true,
+                               xsrc, ysrc,
+                               cmt_ref.srcDepths,
+                               utmRecvEasting,
+                               utmRecvNorthing,
+                               staAlt,
+                               nObs, eObs, uObs,
+                               nWts, eWts, uWts,
+                               nEst, eEst, uEst,
+                               mts);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error computing grid search");
+        return EXIT_FAILURE;
+    }
+    // Compare each grid point to the QR solution
+    for (ilatLon=0; ilatLon<nlats*nlons; ilatLon++)
+    {
+        ierr = core_cmt_depthGridSearch(l1, ndeps,
+                                        0, true,
+                                        xsrc[ilatLon], ysrc[ilatLon],
+                                        cmt_ref.srcDepths,
+                                        utmRecvEasting,
+                                        utmRecvNorthing,
+                                        staAlt,
+                                        nObs, eObs, uObs,
+                                        nWts, eWts, uWts,
+                                        nEstRef, eEstRef, uEstRef,
+                                        mtsRef);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing reference CMT");
+            return EXIT_FAILURE;
+        }
+        for (i=0; i<6*ndeps; i++)
+        {
+            if (!lequal(mts[6*ilatLon*ndeps+i], mtsRef[i], 1.e-6))
+            {
+                LOG_ERRMSG("Error mts differ at %d %e %e", ilatLon,
+                           mts[6*ilatLon*ndeps+i], mtsRef[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        for (i=0; i<l1*ndeps; i++)
+        {
+            if (fabs(nEst[ilatLon*ndeps*l1+i] - nEstRef[i]) > 1.e-8 ||
+                fabs(eEst[ilatLon*ndeps*l1+i] - eEstRef[i]) > 1.e-8 ||
+                fabs(uEst[ilatLon*ndeps*l1+i] - uEstRef[i]) > 1.e-8)
+            {
+                LOG_ERRMSG("Error estimates differ at %d", ilatLon);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    // Verify the residual computed from the normal equations
+    for (idep=0; idep<ndeps; idep++)
+    {
+        ierr = core_cmt_solveNormalEquations(l1, 1,
+                                             0, true,
+                                             &x1, &y1,
+                                             &cmt_ref.srcDepths[idep],
+                                             utmRecvEasting,
+                                             utmRecvNorthing,
+                                             staAlt,
+                                             nObs, eObs, uObs,
+                                             nWts, eWts, uWts,
+                                             nEst, eEst, uEst,
+                                             mts, &wrss);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error solving normal equations");
+            return EXIT_FAILURE;
+        }
+        res2 = 0.0;
+        for (i=0; i<l1; i++)
+        {
+            dx = nWts[i]*(nObs[i] - nEst[i]);
+            dy = eWts[i]*(eObs[i] - eEst[i]);
+            dz = uWts[i]*(uObs[i] - uEst[i]);
+            res2 = res2 + dx*dx + dy*dy + dz*dz;
+        }
+        if (!lequal(wrss, res2, 1.e-6))
+        {
+            LOG_ERRMSG("Error residual is wrong %e %e", wrss, res2);
+            return EXIT_FAILURE;
+        }
+    }
+    // Clean up
+    memory_free8l(&luse);
+    memory_free64f(&utmRecvEasting);
+    memory_free64f(&utmRecvNorthing);
+    memory_free64f(&staAlt);
+    memory_free64f(&nObs);
+    memory_free64f(&eObs);
+    memory_free64f(&uObs);
+    memory_free64f(&nWts);
+    memory_free64f(&eWts);
+    memory_free64f(&uWts);
+    memory_free64f(&nEst);
+    memory_free64f(&eEst);
+    memory_free64f(&uEst);
+    memory_free64f(&nEstRef);
+    memory_free64f(&eEstRef);
+    memory_free64f(&uEstRef);
+    memory_free64f(&mts);
+    memory_free64f(&mtsRef);
+    GFAST_core_cmt_finalizeOffsetData(&cmt_data);
+    GFAST_core_cmt_finalizeResults(&cmt_ref);
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
+//============================================================================//
+int cmt_adaptiveGridSearch_test(void)
+{
+    const char *filenm = "files/final_cmt.maule.txt\0";
+    struct GFAST_cmt_props_struct cmt_props;
+    struct GFAST_offsetData_struct cmt_data;
+    struct GFAST_cmtResults_struct cmt_ref;
+    double *eEst, *eEstRef, *eObs, *eWts, *evalDepths, *evalEastings,
+           *evalNorthings, *mts, *mtsRef, *nEst, *nEstRef, *nObs, *nWts,
+           *objfn, *staAlt, *uEst, *uEstRef, *uObs, *uWts,
+           *utmRecvEasting, *utmRecvNorthing,
+           depths[10], SA_lat, SA_lon, SA_dep, x1, y1;
+    int i, ierr, iopt, itest, j, l1, maxEvals, ncoarse, nevals, nsites,
+        zone_loc;
+    bool *luse, lnorthp;
+    const int nlats = 3;
+    const int nlons = 3;
+    const int ndeps = 10;
+    const int nrefine = 4;
+    const double dx = 40.e3;
+    const double dy = 40.e3;
+    memset(&cmt_props, 0, sizeof(cmt_props));
+    memset(&cmt_data, 0, sizeof(cmt_data));
+    memset(&cmt_ref, 0, sizeof(cmt_ref));
+    ierr = read_results(filenm,
+                        &cmt_props,
+                        &cmt_data,
+                        &cmt_ref,
+                        &SA_lat, &SA_lon, &SA_dep);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error reading input file");
+        return EXIT_FAILURE;
+    }
+    nsites = cmt_data.nsites;
+    ncoarse = nlats*nlons*ndeps;
+    maxEvals = ncoarse + 26*nrefine;
+    for (i=0; i<ndeps; i++){depths[i] = 5.0 + 10.0*(double) i;}
+    luse = memory_calloc8l(nsites);
+    utmRecvEasting = memory_calloc64f(nsites);
+    utmRecvNorthing = memory_calloc64f(nsites);
+    staAlt = memory_calloc64f(nsites);
+    nObs = memory_calloc64f(nsites);
+    eObs = memory_calloc64f(nsites);
+    uObs = memory_calloc64f(nsites);
+    nWts = memory_calloc64f(nsites);
+    eWts = memory_calloc64f(nsites);
+    uWts = memory_calloc64f(nsites);
+    nEst = memory_calloc64f(nsites*maxEvals);
+    eEst = memory_calloc64f(nsites*maxEvals);
+    uEst = memory_calloc64f(nsites*maxEvals);
+    nEstRef = memory_calloc64f(nsites);
+    eEstRef = memory_calloc64f(nsites);
+    uEstRef = memory_calloc64f(nsites);
+    evalEastings = memory_calloc64f(maxEvals);
+    evalNorthings = memory_calloc64f(maxEvals);
+    evalDepths = memory_calloc64f(maxEvals);
+    objfn = memory_calloc64f(maxEvals);
+    mts = memory_calloc64f(6*maxEvals);
+    mtsRef = memory_calloc64f(6);
+    for (i=0; i<nsites; i++){luse[i] = true;}
+    zone_loc = cmt_props.utm_zone;
+    core_coordtools_ll2utm(SA_lat, SA_lon,
+                           &y1, &x1,
+                           &lnorthp, &zone_loc);
+    l1 = compactSites(cmt_data, luse, zone_loc, 1.0,
+                      utmRecvEasting, utmRecvNorthing, staAlt,
+                      nObs, eObs, uObs, nWts, eWts, uWts);
+    // Run with the full budget then with a truncated budget
+    for (itest=0; itest<2; itest++)
+    {
+        if (itest == 1){maxEvals = ncoarse + 5;}
+        ierr = core_cmt_adaptiveGridSearch(l1, nlats, nlons, ndeps,
+                                           nrefine, maxEvals,
+                                           0, true,
+                                           x1, y1, dx, dy, depths,
+                                           utmRecvEasting,
+                                           utmRecvNorthing,
+                                           staAlt,
+                                           nObs, eObs, uObs,
+                                           nWts, eWts, uWts,
+                                           &nevals, &iopt,
+                                           evalEastings,
+                                           evalNorthings,
+                                           evalDepths,
+                                           mts, objfn,
+                                           nEst, eEst, uEst);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error in adaptive search");
+            return EXIT_FAILURE;
+        }
+        if (nevals <= ncoarse || nevals > maxEvals ||
+            (itest == 1 && nevals != maxEvals))
+        {
+            LOG_ERRMSG("Error wrong number of evaluations %d", nevals);
+            return EXIT_FAILURE;
+        }
+        // The optimum is the best evaluated node
+        for (i=0; i<nevals; i++)
+        {
+            if (objfn[i] < objfn[iopt])
+            {
+                LOG_ERRMSG("Error node %d beats optimum %d", i, iopt);
+                return EXIT_FAILURE;
+            }
+            for (j=0; j<i; j++)
+            {
+                if (evalEastings[i] == evalEastings[j] &&
+                    evalNorthings[i] == evalNorthings[j] &&
+                    evalDepths[i] == evalDepths[j])
+                {
+                    LOG_ERRMSG("Error node %d evaluated twice", i);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        // The optimum agrees with the QR solution at that node
+        ierr = core_cmt_depthGridSearch(l1, 1,
+                                        0, true,
+                                        evalEastings[iopt],
+                                        evalNorthings[iopt],
+                                        &evalDepths[iopt],
+                                        utmRecvEasting,
+                                        utmRecvNorthing,
+                                        staAlt,
+                                        nObs, eObs, uObs,
+                                        nWts, eWts, uWts,
+                                        nEstRef, eEstRef, uEstRef,
+                                        mtsRef);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing reference CMT");
+            return EXIT_FAILURE;
+        }
+        for (i=0; i<6; i++)
+        {
+            if (!lequal(mts[6*iopt+i], mtsRef[i], 1.e-6))
+            {
+                LOG_ERRMSG("Error mts differ %e %e",
+                           mts[6*iopt+i], mtsRef[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        for (i=0; i<l1; i++)
+        {
+            if (fabs(nEst[iopt*l1+i] - nEstRef[i]) > 1.e-8 ||
+                fabs(eEst[iopt*l1+i] - eEstRef[i]) > 1.e-8 ||
+                fabs(uEst[iopt*l1+i] - uEstRef[i]) > 1.e-8)
+            {
+                LOG_ERRMSG("%s", "Error optimum estimates differ");
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    // Clean up
+    memory_free8l(&luse);
+    memory_free64f(&utmRecvEasting);
+    memory_free64f(&utmRecvNorthing);
+    memory_free64f(&staAlt);
+    memory_free64f(&nObs);
+    memory_free64f(&eObs);
+    memory_free64f(&uObs);
+    memory_free64f(&nWts);
+    memory_free64f(&eWts);
+    memory_free64f(&uWts);
+    memory_free64f(&nEst);
+    memory_free64f(&eEst);
+    memory_free64f(&uEst);
+    memory_free64f(&nEstRef);
+    memory_free64f(&eEstRef);
+    memory_free64f(&uEstRef);
+    memory_free64f(&evalEastings);
+    memory_free64f(&evalNorthings);
+    memory_free64f(&evalDepths);
+    memory_free64f(&objfn);
+    memory_free64f(&mts);
+    memory_free64f(&mtsRef);
+    GFAST_core_cmt_finalizeOffsetData(&cmt_data);
+    GFAST_core_cmt_finalizeResults(&cmt_ref);
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
 /*
 int cmt_greens_test2()
 {
@@ -5,6 +5,7 @@
 #include "gfast.h"
 
 int coord_test_ll2utm(void);
+int coord_test_ll2utm_batch(void);
 
 int coord_test_ll2utm(void)
 {
@@ -109,6 +110,92 @@ int coord_test_ll2utm(void)
     LOG_INFOMSG("%s", "Success!");
     return EXIT_SUCCESS;
 }
+//============================================================================//
+int coord_test_ll2utm_batch(void)
+{
+    double lat[9] = {  48.83532872,  42.83609887,  45.48651503,
+                       49.87305293,  50.64035267,  41.90232489,
+                       48.29785467, -33.44890000, -35.84470000};
+    double lon[9] = {-125.13510527, 235.43665371,-123.97812400,
+                     -127.12266484,-128.13499899,-120.30283244,
+                     -124.62490719,-70.66930000, 287.78530000};
+    double lat1[9], lon1[9], utmEast[9], utmNorth[9], x, y;
+    int i, ierr, zone;
+    bool lnorthp;
+    // Natural zones
+    ierr = GFAST_core_coordtools_ll2utm_batch(9, lat, lon, -1,
+                                              utmNorth, utmEast);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error calling ll2utm_batch");
+        return EXIT_FAILURE;
+    }
+    for (i=0; i<9; i++)
+    {
+        zone =-1;
+        GFAST_core_coordtools_ll2utm(lat[i], lon[i], &y, &x, &lnorthp, &zone);
+        if (fabs(utmNorth[i] - y) > 1.e-6 || fabs(utmEast[i] - x) > 1.e-6)
+        {
+            LOG_ERRMSG("Batch ll2utm mismatch %d %f %f %f %f",
+                       i, utmNorth[i], y, utmEast[i], x);
+            return EXIT_FAILURE;
+        }
+    }
+    // Fixed zone with round trip
+    zone = 10;
+    ierr = GFAST_core_coordtools_ll2utm_batch(7, lat, lon, zone,
+                                              utmNorth, utmEast);
+    ierr += GFAST_core_coordtools_utm2ll_batch(7, zone, true,
+                                               utmNorth, utmEast,
+                                               lat1, lon1);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error calling batch conversions");
+        return EXIT_FAILURE;
+    }
+    for (i=0; i<7; i++)
+    {
+        GFAST_core_coordtools_utm2ll(zone, true, utmNorth[i], utmEast[i],
+                                     &y, &x);
+        if (fabs(lat1[i] - y) > 1.e-10 || fabs(lon1[i] - x) > 1.e-10)
+        {
+            LOG_ERRMSG("Batch utm2ll mismatch %d", i);
+            return EXIT_FAILURE;
+        }
+        if (fabs(lat1[i] - lat[i]) > 1.e-5 ||
+            (fabs(lon1[i] - lon[i]) > 1.e-5 &&
+             fabs(lon1[i] - 360.0 - lon[i]) > 1.e-5))
+        {
+            LOG_ERRMSG("Failed to recover lat/lon %d %f %f %f %f",
+                       i, lat[i], lat1[i], lon[i], lon1[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    // Southern hemisphere round trip in place
+    zone = 19;
+    ierr = GFAST_core_coordtools_ll2utm_batch(2, &lat[7], &lon[7], zone,
+                                              utmNorth, utmEast);
+    ierr += GFAST_core_coordtools_utm2ll_batch(2, zone, false,
+                                               utmNorth, utmEast,
+                                               utmNorth, utmEast);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error calling batch conversions 2");
+        return EXIT_FAILURE;
+    }
+    for (i=0; i<2; i++)
+    {
+        if (fabs(utmNorth[i] - lat[7+i]) > 1.e-5 ||
+            (fabs(utmEast[i] - lon[7+i]) > 1.e-5 &&
+             fabs(utmEast[i] - 360.0 - lon[7+i]) > 1.e-5))
+        {
+            LOG_ERRMSG("Failed to recover lat/lon 2 %d", i);
+            return EXIT_FAILURE;
+        }
+    }
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
 
 /*
     int nstat = 9;
@@ -3,15 +3,20 @@
 #include <string.h>
 #include <stdbool.h>
 #include <math.h>
+#include <float.h>
 #include "gfast.h"
 #include "iscl/memory/memory.h"
 
 int ff_meshPlane_test(void);
 int ff_greens_test(void);
+int ff_okadaReference_test(void);
 int ff_regularizer_test(void);
 double *__read_grns(const char *fname, int *nrows, int *ncols, int *ierr);
 struct sparseMatrix_coo_struct __read_treg(const char *fname, int *ierr);
 int ff_inversion_test(void);
+int ff_greensCache_test(void);
+int ff_cgls_test(void);
+int ff_covariance_test(void);
 double *__read_xyz(const char *fname, int *l1, int *l2, int *ierr);
 int __read_faultPlane(const char *fname,
                       int *utm_zone,
@@ -253,6 +258,82 @@ double *__read_grns(const char *fname, int *nrows, int *ncols, int *ierr)
     return grns;
 }
 //============================================================================//
+/*!
+ * @brief Expands the compressed sparse row regularizer and compares it to
+ *        the dense regularizer.
+ */
+static int compareSparseRegularizer(const int nstr, const int ndip,
+                                    const double len, const double wid)
+{
+    double *length, *T, *Tcsr, *Tdense, *width;
+    int *colIdx, *rowPtr, i, ierr, j, l2, mrowsT, ncolsT, nnzT, nt;
+    l2 = nstr*ndip;
+    ierr = GFAST_core_ff_getRegularizerSize(nstr, ndip, &mrowsT, &nnzT);
+    if (ierr != 0 || mrowsT != 2*l2 + 2*(2*ndip + nstr - 2))
+    {
+        LOG_ERRMSG("Error getting regularizer size %d %d", nstr, ndip);
+        return EXIT_FAILURE;
+    }
+    ncolsT = 2*l2;
+    nt = mrowsT*ncolsT;
+    length = memory_calloc64f(l2);
+    width = memory_calloc64f(l2);
+    for (i=0; i<l2; i++)
+    {
+        length[i] = len*(1.0 + 0.01*(double) i);
+        width[i] = wid*(1.0 - 0.01*(double) i);
+    }
+    Tdense = memory_calloc64f(nt);
+    Tcsr = memory_calloc64f(nt);
+    T = memory_calloc64f(nnzT);
+    rowPtr = memory_calloc32i(mrowsT+1);
+    colIdx = memory_calloc32i(nnzT);
+    ierr = GFAST_core_ff_setRegularizer(l2, nstr, ndip, nt,
+                                        width, length, Tdense);
+    ierr += GFAST_core_ff_setRegularizerCSR(l2, nstr, ndip, mrowsT, nnzT,
+                                            width, length,
+                                            rowPtr, colIdx, T);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("Error computing regularizers %d %d", nstr, ndip);
+        return EXIT_FAILURE;
+    }
+    if (rowPtr[0] != 0 || rowPtr[mrowsT] != nnzT)
+    {
+        LOG_ERRMSG("%s", "Invalid row pointers");
+        return EXIT_FAILURE;
+    }
+    for (i=0; i<mrowsT; i++)
+    {
+        for (j=rowPtr[i]; j<rowPtr[i+1]; j++)
+        {
+            if (j > rowPtr[i] && colIdx[j] <= colIdx[j-1])
+            {
+                LOG_ERRMSG("Columns not increasing in row %d", i);
+                return EXIT_FAILURE;
+            }
+            Tcsr[i*ncolsT+colIdx[j]] = T[j];
+        }
+    }
+    for (i=0; i<nt; i++)
+    {
+        if (Tcsr[i] != Tdense[i])
+        {
+            LOG_ERRMSG("Differing T %d %d: %e %e", nstr, ndip,
+                       Tcsr[i], Tdense[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    memory_free64f(&length);
+    memory_free64f(&width);
+    memory_free64f(&Tdense);
+    memory_free64f(&Tcsr);
+    memory_free64f(&T);
+    memory_free32i(&rowPtr);
+    memory_free32i(&colIdx);
+    return EXIT_SUCCESS;
+}
+//============================================================================//
 /*!
  * @brief Tests the regularization matrix computation for the finite
  *        fault inversion
@@ -336,6 +417,15 @@ COMPARE:;
     if (T != NULL){free(T);}
     if (length != NULL){free(length);}
     if (width != NULL){free(width);}
+    // The sparse regularizer must match the dense regularizer
+    if (compareSparseRegularizer(nstr, ndip, len, wid) != EXIT_SUCCESS ||
+        compareSparseRegularizer(1, 4, len, wid) != EXIT_SUCCESS ||
+        compareSparseRegularizer(4, 1, len, wid) != EXIT_SUCCESS ||
+        compareSparseRegularizer(2, 3, len, wid) != EXIT_SUCCESS)
+    {
+        LOG_ERRMSG("%s", "Sparse regularizer differs");
+        return EXIT_FAILURE;
+    }
     LOG_INFOMSG("%s", "Success!");
     return EXIT_SUCCESS;
 }
@@ -454,6 +544,130 @@ int ff_greens_test(void)
     return EXIT_SUCCESS;
 }
 //============================================================================//
+/*!
+ * @brief Sets the station/fault offsets and the patch geometry of a
+ *        nstr x ndip fault whose strike, width, and length vary along the
+ *        fault.  If dip0 is 90 then the fault is vertical.  Otherwise the
+ *        dip steepens by 2 degrees per row down dip.
+ */
+static void setOkadaGeometry(const int l1, const int nstr, const int ndip,
+                             const double dip0,
+                             double *e, double *n, double *depth,
+                             double *strike, double *dip,
+                             double *W, double *L)
+{
+    double cosDip, cosStr, pe, pn, pz, se, sinDip, sinStr, sn;
+    int i, id, is, j;
+    const double pi180 = M_PI/180.0;
+    for (id=0; id<ndip; id++)
+    {
+        for (is=0; is<nstr; is++)
+        {
+            i = id*nstr + is;
+            strike[i] = 20.0 + 0.5*(double) is;
+            dip[i] = dip0;
+            if (dip0 < 90.0){dip[i] = dip0 + 2.0*(double) id;}
+            W[i] = 8000.0 + 100.0*(double) id;
+            L[i] = 9000.0 + 50.0*(double) is;
+            cosStr = cos(strike[i]*pi180);
+            sinStr = sin(strike[i]*pi180);
+            cosDip = cos(dip[i]*pi180);
+            sinDip = sin(dip[i]*pi180);
+            // Patch centers down dip of a trace along strike
+            pe = sinStr*10000.0*(double) is + cosStr*cosDip*9000.0*(double) id;
+            pn = cosStr*10000.0*(double) is - sinStr*cosDip*9000.0*(double) id;
+            pz = 6000.0 + sinDip*9000.0*(double) id;
+            for (j=0; j<l1; j++)
+            {
+                se =-40000.0 + 37000.0*(double) j;
+                sn = 15000.0 - 23000.0*(double) (j%3) + 5000.0*(double) j;
+                e[i*l1+j] = se - pe;
+                n[i*l1+j] = sn - pn;
+                depth[i*l1+j] = pz;
+            }
+        }
+    }
+    return;
+}
+//============================================================================//
+/*!
+ * @brief Compares the Okada Green's functions of a dipping and a vertical
+ *        fault to those computed by the original patch-by-patch kernel.
+ *        The patch count is not a multiple of the kernel's patch block.
+ */
+int ff_okadaReference_test(void)
+{
+    const char *grnsfl[2] = {"files/okada_dip.txt\0",
+                             "files/okada_vertical.txt\0"};
+    const double dip0[2] = {35.0, 90.0};
+    const double tol = 1.e-8;
+    const int l1 = 3;
+    const int nstr = 10;
+    const int ndip = 7;
+    const int l2 = nstr*ndip;
+    double *depth, *dip, *e, *Gmat, *grns, *L, *n, *strike, *W;
+    int i, ierr, ifault, ncols, nrows;
+    //------------------------------------------------------------------------//
+    ierr = 0;
+    grns = NULL;
+    e = memory_calloc64f(l1*l2);
+    n = memory_calloc64f(l1*l2);
+    depth = memory_calloc64f(l1*l2);
+    strike = memory_calloc64f(l2);
+    dip = memory_calloc64f(l2);
+    W = memory_calloc64f(l2);
+    L = memory_calloc64f(l2);
+    Gmat = memory_calloc64f(3*l1*2*l2);
+    for (ifault=0; ifault<2; ifault++)
+    {
+        grns = __read_grns(grnsfl[ifault], &nrows, &ncols, &ierr);
+        if (ierr != 0 || nrows != 3*l1 || ncols != 2*l2)
+        {
+            LOG_ERRMSG("Error reading %s", grnsfl[ifault]);
+            ierr = 1;
+            goto ERROR;
+        }
+        setOkadaGeometry(l1, nstr, ndip, dip0[ifault],
+                         e, n, depth, strike, dip, W, L);
+        ierr = core_ff_setForwardModel__okadagreenF(l1, l2,
+                                                    e, n, depth,
+                                                    strike, dip,
+                                                    W, L,
+                                                    Gmat);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("Error setting forward model for dip %f",
+                       dip0[ifault]);
+            goto ERROR;
+        }
+        for (i=0; i<nrows*ncols; i++)
+        {
+            if (!lequal(Gmat[i], grns[i], tol))
+            {
+                LOG_ERRMSG("Error G[%d] for dip %f: %e %e",
+                           i, dip0[ifault], Gmat[i], grns[i]);
+                ierr = 1;
+                goto ERROR;
+            }
+        }
+        free(grns);
+        grns = NULL;
+    }
+ERROR:;
+    if (grns != NULL){free(grns);}
+    memory_free64f(&e);
+    memory_free64f(&n);
+    memory_free64f(&depth);
+    memory_free64f(&strike);
+    memory_free64f(&dip);
+    memory_free64f(&W);
+    memory_free64f(&L);
+    memory_free64f(&Gmat);
+    if (ierr != 0){return EXIT_FAILURE;}
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
+//============================================================================//
 int ff_meshPlane_test(void)
 {
     const char *fname[2] = {"files/final_fp1.maule.txt\0",
@@ -566,7 +780,60 @@ int ff_meshPlane_test(void)
     return EXIT_SUCCESS;
 }
 //============================================================================//
-
+/*!
+ * @brief Allocates the finite fault results structure for the fault planes
+ *        in the reference solution.
+ */
+static void allocateResults(const struct GFAST_ff_props_struct ff_props,
+                            const struct GFAST_offsetData_struct ff_data,
+                            const struct GFAST_ffResults_struct ff_ref,
+                            struct GFAST_ffResults_struct *ff)
+{
+    int i, l2;
+    ff->nfp = ff_ref.nfp;
+    ff->fp = (struct GFAST_faultPlane_struct *)
+              calloc((size_t) ff->nfp, sizeof(struct GFAST_faultPlane_struct)); 
+    ff->SA_lat = ff_ref.SA_lat;
+    ff->SA_lon = ff_ref.SA_lon;
+    ff->SA_dep = ff_ref.SA_dep;
+    ff->SA_mag = ff_ref.SA_mag;
+    ff->vr = ISCL_memory_calloc__double(ff->nfp);
+    ff->Mw = ISCL_memory_calloc__double(ff->nfp); 
+    ff->str = ISCL_memory_calloc__double(ff->nfp);
+    ff->dip = ISCL_memory_calloc__double(ff->nfp);
+    for (i=0; i<ff->nfp; i++)
+    {
+        ff->fp[i].maxobs = ff_data.nsites;
+        ff->fp[i].nstr = ff_props.nstr;
+        ff->fp[i].ndip = ff_props.ndip;
+        ff->str[i] = ff_ref.str[i];
+        ff->dip[i] = ff_ref.dip[i];
+        l2 = ff_props.nstr*ff_props.ndip;
+        ff->fp[i].lon_vtx = ISCL_memory_calloc__double(4*l2);
+        ff->fp[i].lat_vtx = ISCL_memory_calloc__double(4*l2);
+        ff->fp[i].dep_vtx = ISCL_memory_calloc__double(4*l2);
+        ff->fp[i].fault_xutm = ISCL_memory_calloc__double(l2);
+        ff->fp[i].fault_yutm = ISCL_memory_calloc__double(l2);
+        ff->fp[i].fault_alt  = ISCL_memory_calloc__double(l2);
+        ff->fp[i].strike     = ISCL_memory_calloc__double(l2);
+        ff->fp[i].dip        = ISCL_memory_calloc__double(l2);
+        ff->fp[i].length     = ISCL_memory_calloc__double(l2);
+        ff->fp[i].width      = ISCL_memory_calloc__double(l2);
+        ff->fp[i].sslip = ISCL_memory_calloc__double(l2);
+        ff->fp[i].dslip = ISCL_memory_calloc__double(l2);
+        ff->fp[i].sslip_unc = ISCL_memory_calloc__double(l2);
+        ff->fp[i].dslip_unc = ISCL_memory_calloc__double(l2);
+        ff->fp[i].Uinp = ISCL_memory_calloc__double(ff->fp[i].maxobs);
+        ff->fp[i].UN   = ISCL_memory_calloc__double(ff->fp[i].maxobs);
+        ff->fp[i].Ninp = ISCL_memory_calloc__double(ff->fp[i].maxobs);
+        ff->fp[i].NN   = ISCL_memory_calloc__double(ff->fp[i].maxobs);
+        ff->fp[i].Einp = ISCL_memory_calloc__double(ff->fp[i].maxobs);
+        ff->fp[i].EN   = ISCL_memory_calloc__double(ff->fp[i].maxobs);
+        ff->fp[i].fault_ptr = ISCL_memory_calloc__int(l2+1);
+    }
+    return;
+}
+//============================================================================//
 int ff_inversion_test(void)
 {
     const char *fname = "files/final_ff.maule.txt\0";
@@ -591,52 +858,13 @@ int ff_inversion_test(void)
         return EXIT_FAILURE;
     }
     // allocate space for fault
-    ff.nfp = ff_ref.nfp;
-    ff.fp = (struct GFAST_faultPlane_struct *)
-              calloc((size_t) ff.nfp, sizeof(struct GFAST_faultPlane_struct)); 
-    ff.SA_lat = ff_ref.SA_lat;
-    ff.SA_lon = ff_ref.SA_lon;
-    ff.SA_dep = ff_ref.SA_dep;
-    ff.SA_mag = ff_ref.SA_mag;
+    allocateResults(ff_props, ff_data, ff_ref, &ff);
     SA_lat = ff.SA_lat;
     SA_lon = ff.SA_lon;
     SA_dep = ff.SA_dep;
-    ff.vr = ISCL_memory_calloc__double(ff.nfp);
-    ff.Mw = ISCL_memory_calloc__double(ff.nfp); 
-    ff.str = ISCL_memory_calloc__double(ff.nfp);
-    ff.dip = ISCL_memory_calloc__double(ff.nfp);
-    for (i=0; i<ff.nfp; i++)
-    {
-        ff.fp[i].maxobs = ff_data.nsites;
-        ff.fp[i].nstr = ff_props.nstr;
-        ff.fp[i].ndip = ff_props.ndip;
-        ff.str[i] = ff_ref.str[i];
-        ff.dip[i] = ff_ref.dip[i];
-        l2 = ff_props.nstr*ff_props.ndip;
-        ff.fp[i].lon_vtx = ISCL_memory_calloc__double(4*l2);
-        ff.fp[i].lat_vtx = ISCL_memory_calloc__double(4*l2);
-        ff.fp[i].dep_vtx = ISCL_memory_calloc__double(4*l2);
-        ff.fp[i].fault_xutm = ISCL_memory_calloc__double(l2);
-        ff.fp[i].fault_yutm = ISCL_memory_calloc__double(l2);
-        ff.fp[i].fault_alt  = ISCL_memory_calloc__double(l2);
-        ff.fp[i].strike     = ISCL_memory_calloc__double(l2);
-        ff.fp[i].dip        = ISCL_memory_calloc__double(l2);
-        ff.fp[i].length     = ISCL_memory_calloc__double(l2);
-        ff.fp[i].width      = ISCL_memory_calloc__double(l2);
-        ff.fp[i].sslip = ISCL_memory_calloc__double(l2);
-        ff.fp[i].dslip = ISCL_memory_calloc__double(l2);
-        ff.fp[i].sslip_unc = ISCL_memory_calloc__double(l2);
-        ff.fp[i].dslip_unc = ISCL_memory_calloc__double(l2);
-        ff.fp[i].Uinp = ISCL_memory_calloc__double(ff.fp[i].maxobs);
-        ff.fp[i].UN   = ISCL_memory_calloc__double(ff.fp[i].maxobs);
-        ff.fp[i].Ninp = ISCL_memory_calloc__double(ff.fp[i].maxobs);
-        ff.fp[i].NN   = ISCL_memory_calloc__double(ff.fp[i].maxobs);
-        ff.fp[i].Einp = ISCL_memory_calloc__double(ff.fp[i].maxobs);
-        ff.fp[i].EN   = ISCL_memory_calloc__double(ff.fp[i].maxobs);
-        ff.fp[i].fault_ptr = ISCL_memory_calloc__int(l2+1);
-    }
     ierr = eewUtils_driveFF(ff_props,
                             SA_lat, SA_lon,
+                            NULL,
                             ff_data, &ff);
     if (ierr != 0)
     {
@@ -681,3 +909,481 @@ int ff_inversion_test(void)
     LOG_INFOMSG("%s", "Success!");
     return EXIT_SUCCESS;
 }
+//============================================================================//
+int ff_greensCache_test(void)
+{
+    const char *fname = "files/final_ff.maule.txt\0";
+    struct GFAST_ff_props_struct ff_props;
+    struct GFAST_offsetData_struct ff_data;
+    struct GFAST_ffResults_struct ff_ref, ff, ffc;
+    double Mw0;
+    int entry[2], i, ierr, itest, j, l2;
+    const int ntest = 6;
+    memset(&ff_props, 0, sizeof(ff_props));
+    memset(&ff_data, 0, sizeof(ff_data));
+    memset(&ff_ref, 0, sizeof(ff_ref));
+    memset(&ff, 0, sizeof(ff));
+    memset(&ffc, 0, sizeof(ffc));
+    ff_props.verbose = 0;
+    ierr = read_results(fname,
+                        &ff_props,
+                        &ff_data,
+                        &ff_ref);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error reading results");
+        return EXIT_FAILURE;
+    }
+    if (ff_ref.nfp != 2)
+    {
+        LOG_ERRMSG("Expecting two fault planes %d", ff_ref.nfp);
+        return EXIT_FAILURE;
+    }
+    allocateResults(ff_props, ff_data, ff_ref, &ff);
+    allocateResults(ff_props, ff_data, ff_ref, &ffc);
+    ierr = core_ff_initializeGreensCache(&ffc);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error initializing cache");
+        return EXIT_FAILURE;
+    }
+    l2 = ff_props.nstr*ff_props.ndip;
+    Mw0 = ff_ref.SA_mag;
+    entry[0] = 0;
+    entry[1] = 0;
+    // 0: fill the cache; 1: reuse everything; 2: drop sites;
+    // 3: restore the sites; 4: resize the fault; 5: restore the fault
+    for (itest=0; itest<ntest; itest++)
+    {
+        if (itest == 2)
+        {
+            for (i=0; i<ff_data.nsites; i=i+5){ff_data.lactive[i] = false;}
+        }
+        if (itest == 3)
+        {
+            for (i=0; i<ff_data.nsites; i=i+5){ff_data.lactive[i] = true;}
+        }
+        ff.SA_mag = Mw0;
+        if (itest == 4){ff.SA_mag = Mw0 + 0.1;}
+        ffc.SA_mag = ff.SA_mag;
+        ierr = eewUtils_driveFF(ff_props,
+                                ff.SA_lat, ff.SA_lon,
+                                NULL,
+                                ff_data, &ff);
+        ierr += eewUtils_driveFF(ff_props,
+                                 ffc.SA_lat, ffc.SA_lon,
+                                 NULL,
+                                 ff_data, &ffc);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("Error inverting ff on test %d", itest);
+            return EXIT_FAILURE;
+        }
+        for (j=0; j<ff.nfp; j++)
+        {
+            if (!lequal(ff.vr[j], ffc.vr[j], 1.e-10) ||
+                !lequal(ff.Mw[j], ffc.Mw[j], 1.e-10))
+            {
+                LOG_ERRMSG("Error vr or Mw differ %d %d", itest, j);
+                return EXIT_FAILURE;
+            }
+            for (i=0; i<l2; i++)
+            {
+                if (!lequal(ff.fp[j].sslip[i], ffc.fp[j].sslip[i], 1.e-10) ||
+                    !lequal(ff.fp[j].dslip[i], ffc.fp[j].dslip[i], 1.e-10) ||
+                    !lequal(ff.fp[j].sslip_unc[i],
+                            ffc.fp[j].sslip_unc[i], 1.e-10))
+                {
+                    LOG_ERRMSG("Error slip differs %d %d %d", itest, j, i);
+                    return EXIT_FAILURE;
+                }
+            }
+            for (i=0; i<ff.fp[j].nsites_used; i++)
+            {
+                if (!lequal(ff.fp[j].UN[i], ffc.fp[j].UN[i], 1.e-10))
+                {
+                    LOG_ERRMSG("Error estimates differ %d %d", itest, j);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+        // The original planes should still be cached after the resize
+        if (itest == 3)
+        {
+            entry[0] = ffc.greens->planeEntry[0];
+            entry[1] = ffc.greens->planeEntry[1];
+        }
+        if (itest == 5 &&
+            (ffc.greens->planeEntry[0] != entry[0] ||
+             ffc.greens->planeEntry[1] != entry[1]))
+        {
+            LOG_ERRMSG("%s", "Error fault planes were not reused");
+            return EXIT_FAILURE;
+        }
+    }
+    GFAST_core_ff_finalizeOffsetData(&ff_data);
+    GFAST_core_ff_finalizeResults(&ff_ref);
+    GFAST_core_ff_finalizeResults(&ff);
+    GFAST_core_ff_finalizeResults(&ffc);
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
+//============================================================================//
+/*!
+ * @brief Compares the largest slip difference to the largest slip.
+ */
+static double slipMisfit(const int l2,
+                         const struct GFAST_ffResults_struct ff,
+                         const struct GFAST_ffResults_struct ffi)
+{
+    double dmax, smax;
+    int i, j;
+    dmax = 0.0;
+    smax = 0.0;
+    for (j=0; j<ff.nfp; j++)
+    {
+        for (i=0; i<l2; i++)
+        {
+            smax = fmax(smax, fmax(fabs(ff.fp[j].sslip[i]),
+                                   fabs(ff.fp[j].dslip[i])));
+            dmax = fmax(dmax, fabs(ff.fp[j].sslip[i] - ffi.fp[j].sslip[i]));
+            dmax = fmax(dmax, fabs(ff.fp[j].dslip[i] - ffi.fp[j].dslip[i]));
+        }
+    }
+    if (smax == 0.0){return dmax;}
+    return dmax/smax;
+}
+//============================================================================//
+/*!
+ * @brief Tests the warm started CGLS slip solver against the direct solver
+ *        on a sequence of slowly growing offsets.
+ *
+ * @result EXIT_SUCCESS indicates success
+ *
+ */
+int ff_cgls_test(void)
+{
+    const char *fname = "files/final_ff.maule.txt\0";
+    struct GFAST_ff_props_struct ff_props, cgls_props;
+    struct GFAST_offsetData_struct ff_data;
+    struct GFAST_ffResults_struct ff_ref, ff, ffi, ffb;
+    double misfit, *n0, *e0, *u0;
+    int i, ierr, itest, j, l2, niter0, niter;
+    const int ntest = 4;
+    memset(&ff_props, 0, sizeof(ff_props));
+    memset(&ff_data, 0, sizeof(ff_data));
+    memset(&ff_ref, 0, sizeof(ff_ref));
+    memset(&ff, 0, sizeof(ff));
+    memset(&ffi, 0, sizeof(ffi));
+    memset(&ffb, 0, sizeof(ffb));
+    ff_props.verbose = 0;
+    ierr = read_results(fname,
+                        &ff_props,
+                        &ff_data,
+                        &ff_ref);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error reading results");
+        return EXIT_FAILURE;
+    }
+    ff_props.solver = FF_DIRECT_SOLVER;
+    cgls_props = ff_props;
+    cgls_props.solver = FF_CGLS_SOLVER;
+    cgls_props.cgls_tol = 1.e-10;
+    cgls_props.cgls_maxit = 2000;
+    cgls_props.min_slip =-DBL_MAX;
+    cgls_props.max_slip = DBL_MAX;
+    // Exact uncertainties would replace CGLS with the direct solve
+    cgls_props.unc_nprobe = 20;
+    allocateResults(ff_props, ff_data, ff_ref, &ff);
+    allocateResults(ff_props, ff_data, ff_ref, &ffi);
+    allocateResults(ff_props, ff_data, ff_ref, &ffb);
+    ierr  = core_ff_initializeGreensCache(&ffi);
+    ierr += core_ff_initializeGreensCache(&ffb);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error initializing cache");
+        return EXIT_FAILURE;
+    }
+    l2 = ff_props.nstr*ff_props.ndip;
+    n0 = memory_calloc64f(ff_data.nsites);
+    e0 = memory_calloc64f(ff_data.nsites);
+    u0 = memory_calloc64f(ff_data.nsites);
+    for (i=0; i<ff_data.nsites; i++)
+    {
+        n0[i] = ff_data.nbuff[i];
+        e0[i] = ff_data.ebuff[i];
+        u0[i] = ff_data.ubuff[i];
+    }
+    // The offsets grow by a few percent each tick
+    niter0 = 0;
+    for (itest=0; itest<ntest; itest++)
+    {
+        for (i=0; i<ff_data.nsites; i++)
+        {
+            ff_data.nbuff[i] = n0[i]*(1.0 + 0.02*(double) itest);
+            ff_data.ebuff[i] = e0[i]*(1.0 + 0.02*(double) itest);
+            ff_data.ubuff[i] = u0[i]*(1.0 + 0.01*(double) itest);
+        }
+        ierr = eewUtils_driveFF(ff_props,
+                                ff.SA_lat, ff.SA_lon,
+                                NULL,
+                                ff_data, &ff);
+        ierr += eewUtils_driveFF(cgls_props,
+                                 ffi.SA_lat, ffi.SA_lon,
+                                 NULL,
+                                 ff_data, &ffi);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("Error inverting ff on test %d", itest);
+            return EXIT_FAILURE;
+        }
+        misfit = slipMisfit(l2, ff, ffi);
+        if (misfit > 1.e-6)
+        {
+            LOG_ERRMSG("CGLS slip differs on test %d %e", itest, misfit);
+            return EXIT_FAILURE;
+        }
+        for (j=0; j<ff.nfp; j++)
+        {
+            if (!lequal(ff.vr[j], ffi.vr[j], 1.e-6) ||
+                !lequal(ff.Mw[j], ffi.Mw[j], 1.e-6))
+            {
+                LOG_ERRMSG("Error vr or Mw differ %d %d", itest, j);
+                return EXIT_FAILURE;
+            }
+        }
+        // Warm starts should take fewer iterations than the cold start
+        niter = 0;
+        for (j=0; j<ffi.nfp; j++)
+        {
+            niter = niter
+                  + ffi.greens->planes[ffi.greens->planeEntry[j]].niter;
+        }
+        if (itest == 0)
+        {
+            niter0 = niter;
+        }
+        else if (niter >= niter0)
+        {
+            LOG_ERRMSG("Warm start took %d iterations but cold took %d",
+                       niter, niter0);
+            return EXIT_FAILURE;
+        }
+    }
+    // Exact uncertainties of unbounded slip reuse the direct solution
+    cgls_props.unc_nprobe = 0;
+    ierr = eewUtils_driveFF(cgls_props,
+                            ffb.SA_lat, ffb.SA_lon,
+                            NULL,
+                            ff_data, &ffb);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error inverting ff with exact uncertainties");
+        return EXIT_FAILURE;
+    }
+    misfit = slipMisfit(l2, ff, ffb);
+    if (misfit > 1.e-12)
+    {
+        LOG_ERRMSG("Slip differs from direct solution %e", misfit);
+        return EXIT_FAILURE;
+    }
+    for (j=0; j<ffb.nfp; j++)
+    {
+        for (i=0; i<l2; i++)
+        {
+            if (!lequal(ffb.fp[j].sslip_unc[i], ff.fp[j].sslip_unc[i], 1.e-8))
+            {
+                LOG_ERRMSG("Uncertainty differs %d %d", j, i);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    // Nonnegative slip
+    cgls_props.min_slip = 0.0;
+    ierr = eewUtils_driveFF(cgls_props,
+                            ffb.SA_lat, ffb.SA_lon,
+                            NULL,
+                            ff_data, &ffb);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error inverting ff with bounds");
+        return EXIT_FAILURE;
+    }
+    for (j=0; j<ffb.nfp; j++)
+    {
+        for (i=0; i<l2; i++)
+        {
+            if (ffb.fp[j].sslip[i] < 0.0 || ffb.fp[j].dslip[i] < 0.0)
+            {
+                LOG_ERRMSG("Slip bound violated %d %d", j, i);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    memory_free64f(&n0);
+    memory_free64f(&e0);
+    memory_free64f(&u0);
+    GFAST_core_ff_finalizeOffsetData(&ff_data);
+    GFAST_core_ff_finalizeResults(&ff_ref);
+    GFAST_core_ff_finalizeResults(&ff);
+    GFAST_core_ff_finalizeResults(&ffi);
+    GFAST_core_ff_finalizeResults(&ffb);
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
+//============================================================================//
+/*!
+ * @brief Tests the exact and estimated diagonals of the slip covariance
+ *        matrix on a small synthetic inversion.
+ *
+ * @result EXIT_SUCCESS indicates success
+ *
+ */
+int ff_covariance_test(void)
+{
+    const int nstr = 4;
+    const int ndip = 3;
+    const int mrowsG = 36;
+    const int nprobe = 5000;
+    double *cdiag, *cref, *G, *length, *Ri, *S, *T, *U, *U0, *u, *width,
+           rij, emax;
+    int *colIdx, *rowPtr, i, ierr, j, k, l2, mrowsT, ncols, nnzT;
+    l2 = nstr*ndip;
+    ncols = 2*l2;
+    ierr = GFAST_core_ff_getRegularizerSize(nstr, ndip, &mrowsT, &nnzT);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error getting regularizer size");
+        return EXIT_FAILURE;
+    }
+    G = memory_calloc64f(mrowsG*ncols);
+    u = memory_calloc64f(mrowsG);
+    length = memory_calloc64f(l2);
+    width = memory_calloc64f(l2);
+    T = memory_calloc64f(nnzT);
+    rowPtr = memory_calloc32i(mrowsT+1);
+    colIdx = memory_calloc32i(nnzT);
+    U = memory_calloc64f(ncols*ncols);
+    U0 = memory_calloc64f(ncols*ncols);
+    Ri = memory_calloc64f(ncols*ncols);
+    S = memory_calloc64f(ncols);
+    cdiag = memory_calloc64f(ncols);
+    cref = memory_calloc64f(ncols);
+    for (i=0; i<mrowsG; i++)
+    {
+        for (j=0; j<ncols; j++)
+        {
+            G[i*ncols+j] = sin(0.37*(double) (i+1)*(double) (j+2))
+                         + 0.1*cos(1.3*(double) (i+j));
+        }
+        u[i] = cos(0.21*(double) i);
+    }
+    for (i=0; i<l2; i++)
+    {
+        length[i] = 20.e3;
+        width[i] = 10.e3;
+    }
+    ierr = GFAST_core_ff_setRegularizerCSR(l2, nstr, ndip, mrowsT, nnzT,
+                                           width, length,
+                                           rowPtr, colIdx, T);
+    ierr += GFAST_core_ff_solveNormalEquations(mrowsG, ncols, mrowsT, 0.5,
+                                               G, u, rowPtr, colIdx, T,
+                                               U, S);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error factoring normal equations");
+        return EXIT_FAILURE;
+    }
+    memcpy(U0, U, (size_t) (ncols*ncols)*sizeof(double));
+    // Reference diagonal from the rows of inv(U) by back substitution
+    for (j=0; j<ncols; j++)
+    {
+        for (i=j; i>=0; i--)
+        {
+            rij = (i == j) ? 1.0 : 0.0;
+            for (k=i+1; k<=j; k++)
+            {
+                rij = rij - U0[i*ncols+k]*Ri[k*ncols+j];
+            }
+            Ri[i*ncols+j] = rij/U0[i*ncols+i];
+        }
+    }
+    for (i=0; i<ncols; i++)
+    {
+        cref[i] = 0.0;
+        for (j=0; j<ncols; j++)
+        {
+            cref[i] = cref[i] + Ri[i*ncols+j]*Ri[i*ncols+j];
+        }
+    }
+    // Randomized estimate leaves U unchanged
+    ierr = GFAST_core_ff_covarianceDiagonal(ncols, nprobe, 1, U, cdiag);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error estimating covariance diagonal");
+        return EXIT_FAILURE;
+    }
+    emax = 0.0;
+    for (i=0; i<ncols; i++)
+    {
+        emax = fmax(emax, fabs(cdiag[i] - cref[i])/cref[i]);
+    }
+    if (emax > 0.1 || memcmp(U, U0, (size_t) (ncols*ncols)*sizeof(double)))
+    {
+        LOG_ERRMSG("Error randomized covariance diagonal %e", emax);
+        return EXIT_FAILURE;
+    }
+    // Randomized estimate without the factor
+    ierr = GFAST_core_ff_estimateCovarianceDiagonalCGLS(mrowsG, ncols,
+                                                        mrowsT, 0.5,
+                                                        G, rowPtr, colIdx, T,
+                                                        nprobe, 2,
+                                                        1000, 1.e-12, cdiag);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error estimating covariance diagonal with CGLS");
+        return EXIT_FAILURE;
+    }
+    emax = 0.0;
+    for (i=0; i<ncols; i++)
+    {
+        emax = fmax(emax, fabs(cdiag[i] - cref[i])/cref[i]);
+    }
+    if (emax > 0.1)
+    {
+        LOG_ERRMSG("Error CGLS covariance diagonal %e", emax);
+        return EXIT_FAILURE;
+    }
+    // Exact diagonal
+    ierr = GFAST_core_ff_covarianceDiagonal(ncols, 0, 0, U, cdiag);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error computing covariance diagonal");
+        return EXIT_FAILURE;
+    }
+    for (i=0; i<ncols; i++)
+    {
+        if (!lequal(cdiag[i], cref[i], 1.e-10))
+        {
+            LOG_ERRMSG("Error covariance diagonal %d %e %e",
+                       i, cdiag[i], cref[i]);
+            return EXIT_FAILURE;
+        }
+    }
+    memory_free64f(&G);
+    memory_free64f(&u);
+    memory_free64f(&length);
+    memory_free64f(&width);
+    memory_free64f(&T);
+    memory_free32i(&rowPtr);
+    memory_free32i(&colIdx);
+    memory_free64f(&U);
+    memory_free64f(&U0);
+    memory_free64f(&Ri);
+    memory_free64f(&S);
+    memory_free64f(&cdiag);
+    memory_free64f(&cref);
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
@@ -4,10 +4,28 @@
 #include <stdbool.h>
 #include <math.h>
 #include "gfast.h"
+#ifdef GFAST_USE_INTEL
+ #ifdef __clang__
+  #pragma clang diagnostic push
+  #pragma clang diagnostic ignored "-Weverything"
+ #endif
+ #include <mkl_lapacke.h>
+ #ifdef __clang__
+  #pragma clang diagnostic pop
+ #endif
+#else
+#include <lapacke.h>
+#endif
+#include "iscl/linalg/linalg.h"
 #include "iscl/memory/memory.h"
+#include "iscl/statistics/statistics.h"
+#include "iscl/time/time.h"
 
 int pgd_inversion_test(void);
 int pgd_inversion_test2(void);
+int pgd_evaluateDepth_test(void);
+int pgd_interquartileRange_test(void);
+int pgd_gridSearch_test(void);
 
 static bool lequal(double a, double b, double tol)
 {
@@ -210,6 +228,8 @@ int pgd_inversion_test2(void)
     pgd.UP = ISCL_memory_calloc__double(pgd.ndeps*pgd.nsites);
     pgd.UPinp = ISCL_memory_calloc__double(pgd.nsites);
     pgd.srcDepths = ISCL_memory_calloc__double(pgd.ndeps);
+    pgd.srcLats = ISCL_memory_calloc__double(pgd.nlats);
+    pgd.srcLons = ISCL_memory_calloc__double(pgd.nlons);
     pgd.srdist = ISCL_memory_calloc__double(pgd.ndeps*pgd.nsites);
     pgd.lsiteUsed = ISCL_memory_calloc__bool(pgd.nsites);
     for (i=0; i<pgd.ndeps; i++)
@@ -218,6 +238,7 @@ int pgd_inversion_test2(void)
     }
     ierr = eewUtils_drivePGD(pgd_props,
                              SA_lat, SA_lon, SA_dep,
+                             NULL,
                              pgd_data, &pgd);
     if (ierr != PGD_SUCCESS)
     {
@@ -253,3 +274,441 @@ int pgd_inversion_test2(void)
     LOG_INFOMSG("%s", "Success!");
     return EXIT_SUCCESS;
 }
+//============================================================================//
+/*!
+ * @brief Compares the closed form depth solver to the QR least squares
+ *        solution on the Maule data and reports the timings.
+ */
+int pgd_evaluateDepth_test(void)
+{
+    const char *filenm = "files/final_pgd.maule.txt\0";
+    struct GFAST_pgd_props_struct pgd_props;
+    struct GFAST_peakDisplacementData_struct pgd_data;
+    struct GFAST_pgdResults_struct pgd_ref;
+    double *b, *d, *G, *r, *repi, *srdist, *Uest, *utmRecvEasting,
+           *utmRecvNorthing, *W, *Wb, *WG, *wres,
+           est, M, M1[1], SA_dep, SA_lat, SA_lon, tqr, tkernel,
+           utmSrcEasting, utmSrcNorthing, VR, VR1, xden, xnum;
+    int i, idep, ierr, k, l1, zone;
+    bool lnorthp;
+    const double A =-6.687;
+    const double B = 1.500;
+    const double C =-0.214;
+    const double tol = 1.e-10;
+    const int nrep = 100;
+    memset(&pgd_props, 0, sizeof(pgd_props));
+    memset(&pgd_data, 0, sizeof(pgd_data));
+    memset(&pgd_ref, 0, sizeof(pgd_ref));
+    b = NULL;
+    d = NULL;
+    G = NULL;
+    r = NULL;
+    repi = NULL;
+    srdist = NULL;
+    Uest = NULL;
+    utmRecvEasting = NULL;
+    utmRecvNorthing = NULL;
+    W = NULL;
+    Wb = NULL;
+    WG = NULL;
+    wres = NULL;
+    ierr = read_results(filenm,
+                        &pgd_props,
+                        &pgd_data,
+                        &pgd_ref,
+                        &SA_lat, &SA_lon, &SA_dep);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error reading input file");
+        goto ERROR;
+    }
+    l1 = pgd_data.nsites;
+    b = memory_calloc64f(l1);
+    d = memory_calloc64f(l1);
+    G = memory_calloc64f(l1);
+    r = memory_calloc64f(l1);
+    repi = memory_calloc64f(l1);
+    srdist = memory_calloc64f(l1);
+    Uest = memory_calloc64f(l1);
+    utmRecvEasting = memory_calloc64f(l1);
+    utmRecvNorthing = memory_calloc64f(l1);
+    W = memory_calloc64f(l1);
+    Wb = memory_calloc64f(l1);
+    WG = memory_calloc64f(l1);
+    wres = memory_calloc64f(l1);
+    zone = pgd_props.utm_zone;
+    if (zone ==-12345){zone =-1;}
+    GFAST_core_coordtools_ll2utm(SA_lat, SA_lon,
+                                 &utmSrcNorthing, &utmSrcEasting,
+                                 &lnorthp, &zone);
+    for (i=0; i<l1; i++)
+    {
+        GFAST_core_coordtools_ll2utm(pgd_data.sta_lat[i], pgd_data.sta_lon[i],
+                                     &utmRecvNorthing[i], &utmRecvEasting[i],
+                                     &lnorthp, &zone);
+        d[i] = pgd_data.pd[i]*100.0;
+        repi[i] = sqrt( pow(utmSrcEasting  - utmRecvEasting[i], 2)
+                      + pow(utmSrcNorthing - utmRecvNorthing[i], 2) )*1.e-3;
+    }
+    core_scaling_pgd_setRHS(l1, pgd_props.dist_tol, pgd_props.disp_def,
+                            A, d, b);
+    core_scaling_pgd_setDiagonalWeightMatrix(l1, repi, pgd_data.wt, W);
+    core_scaling_pgd_weightObservations(l1, W, b, Wb);
+    xden = 0.0;
+    for (i=0; i<l1; i++){xden = xden + fabs(W[i]*d[i]);}
+    tqr = 0.0;
+    tkernel = 0.0;
+    for (idep=0; idep<pgd_ref.ndeps; idep++)
+    {
+        // Reference QR solution
+        time_tic();
+        for (k=0; k<nrep; k++)
+        {
+            for (i=0; i<l1; i++)
+            {
+                r[i] = sqrt( pow(utmSrcEasting  - utmRecvEasting[i], 2)
+                           + pow(utmSrcNorthing - utmRecvNorthing[i], 2)
+                           + pow(pgd_ref.srcDepths[idep]*1000.0
+                                - pgd_data.sta_alt[i], 2) )*1.e-3;
+            }
+            core_scaling_pgd_setForwardModel(l1, B, C, r, G);
+            core_scaling_pgd_weightForwardModel(l1, W, G, WG);
+            ierr = linalg_lstsq_qr64f_work(LAPACK_COL_MAJOR,
+                                           l1, 1, 1, false, WG, Wb,
+                                           M1, NULL);
+            xnum = 0.0;
+            for (i=0; i<l1; i++)
+            {
+                est = pow(10.0, G[i]*M1[0] + A);
+                xnum = xnum + fabs(W[i]*(d[i] - est));
+            }
+            VR1 = (1.0 - xnum/xden)*100.0;
+        }
+        tqr = tqr + time_toc();
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error solving least squares problem");
+            goto ERROR;
+        }
+        // Closed form
+        time_tic();
+        for (k=0; k<nrep; k++)
+        {
+            ierr = core_scaling_pgd_evaluateDepth(l1, A, B, C,
+                                                  pgd_ref.srcDepths[idep],
+                                                  utmSrcEasting,
+                                                  utmSrcNorthing,
+                                                  utmRecvEasting,
+                                                  utmRecvNorthing,
+                                                  pgd_data.sta_alt,
+                                                  d, W, Wb, xden,
+                                                  G, srdist, Uest, wres,
+                                                  &M, &VR);
+        }
+        tkernel = tkernel + time_toc();
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error evaluating depth");
+            goto ERROR;
+        }
+        if (!lequal(M, M1[0], tol) || !lequal(VR, VR1, tol))
+        {
+            LOG_ERRMSG("Closed form mismatch at depth %f: %f %f %f %f",
+                       pgd_ref.srcDepths[idep], M, M1[0], VR, VR1);
+            ierr = 1;
+            goto ERROR;
+        }
+        if (!lequal(M, pgd_ref.mpgd[idep], 1.e-4))
+        {
+            LOG_ERRMSG("Error mpgd is wrong %f %f %f",
+                       pgd_ref.srcDepths[idep], M, pgd_ref.mpgd[idep]);
+            ierr = 1;
+            goto ERROR;
+        }
+    }
+    LOG_INFOMSG("QR time: %e (s); closed form time: %e (s)", tqr, tkernel);
+ERROR:;
+    memory_free64f(&b);
+    memory_free64f(&d);
+    memory_free64f(&G);
+    memory_free64f(&r);
+    memory_free64f(&repi);
+    memory_free64f(&srdist);
+    memory_free64f(&Uest);
+    memory_free64f(&utmRecvEasting);
+    memory_free64f(&utmRecvNorthing);
+    memory_free64f(&W);
+    memory_free64f(&Wb);
+    memory_free64f(&WG);
+    memory_free64f(&wres);
+    core_scaling_pgd_finalizeData(&pgd_data);
+    core_scaling_pgd_finalizeResults(&pgd_ref);
+    if (ierr != 0){return EXIT_FAILURE;}
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
+//============================================================================//
+/*!
+ * @brief Verifies the selection based interquartile range against the
+ *        sort based percentiles for a range of sizes including ties.
+ */
+int pgd_interquartileRange_test(void)
+{
+    double *work, *x, iqr, iqrSketch, pct[2];
+    int i, ierr, n;
+    const double q[2] = {25.0, 75.0};
+    const double tol = 1.e-14;
+    const int nmax = 2000;
+    //------------------------------------------------------------------------//
+    x = memory_calloc64f(nmax);
+    work = memory_calloc64f(nmax);
+    for (n=1; n<=nmax; n=2*n+1)
+    {
+        // Deterministic scrambled data; the modulus makes duplicates
+        for (i=0; i<n; i++)
+        {
+            x[i] = (double) ((i*7919 + 13)%(n/2 + 1)) - 0.25*(double) n;
+        }
+        ierr = statistics_percentile64f_work(n, x, 2, q,
+                                             STATS_PERCENTILE_LINEAR, pct);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing percentiles");
+            goto ERROR;
+        }
+        ierr = core_scaling_pgd_interquartileRange(n, 0, x, work, &iqr);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error computing interquartile range");
+            goto ERROR;
+        }
+        if (fabs(iqr - (pct[1] - pct[0])) > tol*fmax(1.0, fabs(iqr)))
+        {
+            LOG_ERRMSG("IQR mismatch for n=%d: %f %f",
+                       n, iqr, pct[1] - pct[0]);
+            ierr = 1;
+            goto ERROR;
+        }
+    }
+    // The sketch should be close for a uniform distribution
+    n = nmax;
+    for (i=0; i<n; i++){x[i] = (double) ((i*7919)%n);}
+    ierr = core_scaling_pgd_interquartileRange(n, 5, x, NULL, &iqrSketch);
+    if (ierr != 0 || fabs(iqrSketch - 0.5*(double) (n - 1)) > 0.05*(double) n)
+    {
+        LOG_ERRMSG("Sketch IQR is inaccurate %f %f",
+                   iqrSketch, 0.5*(double) (n - 1));
+        ierr = 1;
+        goto ERROR;
+    }
+ERROR:;
+    memory_free64f(&x);
+    memory_free64f(&work);
+    if (ierr != 0){return EXIT_FAILURE;}
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
+//============================================================================//
+/*!
+ * @brief Verifies the batched epicentral grid search matches the depth
+ *        grid search at each epicenter and that the PGD driver's grid is
+ *        centered on the event.
+ */
+int pgd_gridSearch_test(void)
+{
+    const char *filenm = "files/final_pgd.maule.txt\0";
+    struct GFAST_pgd_props_struct pgd_props;
+    struct GFAST_peakDisplacementData_struct pgd_data;
+    struct GFAST_pgdResults_struct pgd, pgd_ref;
+    double *d, *iqr, *iqr1, *M, *M1, *srdist, *srdist1, *Uest, *Uest1,
+           *utmRecvEasting, *utmRecvNorthing, *utmSrcEastings,
+           *utmSrcNorthings, *VR, *VR1, SA_dep, SA_lat, SA_lon;
+    int i, idep, ierr, ilat, ilatLon, ilon, iloc, indx, l1, ndeps,
+        nlatLon, nloc, zone;
+    bool lnorthp;
+    const double tol = 1.e-12;
+    const int nlats = 3;
+    const int nlons = 3;
+    memset(&pgd_props, 0, sizeof(pgd_props));
+    memset(&pgd_data, 0, sizeof(pgd_data));
+    memset(&pgd_ref, 0, sizeof(pgd_ref));
+    memset(&pgd, 0, sizeof(pgd));
+    ierr = read_results(filenm,
+                        &pgd_props,
+                        &pgd_data,
+                        &pgd_ref,
+                        &SA_lat, &SA_lon, &SA_dep);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error reading input file");
+        return EXIT_FAILURE;
+    }
+    l1 = pgd_data.nsites;
+    ndeps = pgd_ref.ndeps;
+    nlatLon = nlats*nlons;
+    nloc = nlatLon*ndeps;
+    d = memory_calloc64f(l1);
+    utmRecvEasting = memory_calloc64f(l1);
+    utmRecvNorthing = memory_calloc64f(l1);
+    utmSrcEastings = memory_calloc64f(nlatLon);
+    utmSrcNorthings = memory_calloc64f(nlatLon);
+    M = memory_calloc64f(nloc);
+    VR = memory_calloc64f(nloc);
+    iqr = memory_calloc64f(nloc);
+    Uest = memory_calloc64f(l1*nloc);
+    srdist = memory_calloc64f(l1*nloc);
+    M1 = memory_calloc64f(ndeps);
+    VR1 = memory_calloc64f(ndeps);
+    iqr1 = memory_calloc64f(ndeps);
+    Uest1 = memory_calloc64f(l1*ndeps);
+    srdist1 = memory_calloc64f(l1*ndeps);
+    zone = pgd_props.utm_zone;
+    if (zone ==-12345){zone =-1;}
+    GFAST_core_coordtools_ll2utm(SA_lat, SA_lon,
+                                 &utmSrcNorthings[0], &utmSrcEastings[0],
+                                 &lnorthp, &zone);
+    for (i=0; i<l1; i++)
+    {
+        GFAST_core_coordtools_ll2utm(pgd_data.sta_lat[i], pgd_data.sta_lon[i],
+                                     &utmRecvNorthing[i], &utmRecvEasting[i],
+                                     &lnorthp, &zone);
+        d[i] = pgd_data.pd[i]*100.0;
+    }
+    // Perturb the epicenter by 20 km in each direction
+    for (ilon=0; ilon<nlons; ilon++)
+    {
+        for (ilat=0; ilat<nlats; ilat++)
+        {
+            ilatLon = ilon*nlats + ilat;
+            utmSrcEastings[ilatLon] = utmSrcEastings[0]
+                                    + (double) (ilon - nlons/2)*20.e3;
+            utmSrcNorthings[ilatLon] = utmSrcNorthings[0]
+                                     + (double) (ilat - nlats/2)*20.e3;
+        }
+    }
+    ierr = core_scaling_pgd_gridSearch(l1, ndeps, nlats, nlons, 0,
+                                       pgd_props.dist_tol,
+                                       pgd_props.disp_def,
+                                       0,
+                                       utmSrcEastings, utmSrcNorthings,
+                                       pgd_ref.srcDepths,
+                                       utmRecvEasting, utmRecvNorthing,
+                                       pgd_data.sta_alt, d, pgd_data.wt,
+                                       srdist, M, VR, iqr, Uest);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Error in grid search");
+        return EXIT_FAILURE;
+    }
+    for (ilatLon=0; ilatLon<nlatLon; ilatLon++)
+    {
+        ierr = core_scaling_pgd_depthGridSearch(l1, ndeps, 0,
+                                                pgd_props.dist_tol,
+                                                pgd_props.disp_def,
+                                                utmSrcEastings[ilatLon],
+                                                utmSrcNorthings[ilatLon],
+                                                pgd_ref.srcDepths,
+                                                utmRecvEasting,
+                                                utmRecvNorthing,
+                                                pgd_data.sta_alt, d,
+                                                pgd_data.wt,
+                                                srdist1, M1, VR1, iqr1,
+                                                Uest1);
+        if (ierr != 0)
+        {
+            LOG_ERRMSG("%s", "Error in depth grid search");
+            return EXIT_FAILURE;
+        }
+        for (idep=0; idep<ndeps; idep++)
+        {
+            iloc = ilatLon*ndeps + idep;
+            if (!lequal(M[iloc], M1[idep], tol) ||
+                !lequal(VR[iloc], VR1[idep], tol) ||
+                !lequal(iqr[iloc], iqr1[idep], tol))
+            {
+                LOG_ERRMSG("Grid search mismatch at %d %d", ilatLon, idep);
+                return EXIT_FAILURE;
+            }
+            for (i=0; i<l1; i++)
+            {
+                if (!lequal(Uest[iloc*l1+i], Uest1[idep*l1+i], tol) ||
+                    !lequal(srdist[iloc*l1+i], srdist1[idep*l1+i], tol))
+                {
+                    LOG_ERRMSG("Estimate mismatch at %d %d", ilatLon, idep);
+                    return EXIT_FAILURE;
+                }
+            }
+        }
+    }
+    // The driver should center its grid on the event
+    pgd_props.dLat = 0.1;
+    pgd_props.dLon = 0.1;
+    pgd.nsites = l1;
+    pgd.ndeps = ndeps;
+    pgd.nlats = nlats;
+    pgd.nlons = nlons;
+    pgd.mpgd = memory_calloc64f(nloc);
+    pgd.mpgd_vr = memory_calloc64f(nloc);
+    pgd.dep_vr_pgd = memory_calloc64f(nloc);
+    pgd.iqr = memory_calloc64f(nloc);
+    pgd.UP = memory_calloc64f(nloc*l1);
+    pgd.UPinp = memory_calloc64f(l1);
+    pgd.srcDepths = memory_calloc64f(ndeps);
+    pgd.srcLats = memory_calloc64f(nlats);
+    pgd.srcLons = memory_calloc64f(nlons);
+    pgd.srdist = memory_calloc64f(nloc*l1);
+    pgd.lsiteUsed = memory_calloc8l(l1);
+    for (idep=0; idep<ndeps; idep++)
+    {
+        pgd.srcDepths[idep] = pgd_ref.srcDepths[idep];
+    }
+    ierr = eewUtils_drivePGD(pgd_props,
+                             SA_lat, SA_lon, SA_dep,
+                             NULL,
+                             pgd_data, &pgd);
+    if (ierr != PGD_SUCCESS)
+    {
+        LOG_ERRMSG("%s", "Error computing PGD on grid");
+        return EXIT_FAILURE;
+    }
+    if (!lequal(pgd.srcLats[nlats/2], SA_lat, tol) ||
+        !lequal(pgd.srcLons[nlons/2], SA_lon, tol) ||
+        !lequal(pgd.srcLats[nlats-1] - pgd.srcLats[0], 0.2, 1.e-10))
+    {
+        LOG_ERRMSG("%s", "Epicentral grid is not centered on the event");
+        return EXIT_FAILURE;
+    }
+    // The center node should reproduce the reference
+    ilatLon = (nlons/2)*nlats + nlats/2;
+    for (idep=0; idep<ndeps; idep++)
+    {
+        indx = ilatLon*ndeps + idep;
+        if (!lequal(pgd.mpgd[indx], pgd_ref.mpgd[idep], 1.e-4))
+        {
+            LOG_ERRMSG("Error mpgd is wrong %f %f %f",
+                       pgd.srcDepths[idep], pgd.mpgd[indx],
+                       pgd_ref.mpgd[idep]);
+            return EXIT_FAILURE;
+        }
+    }
+    memory_free64f(&d);
+    memory_free64f(&utmRecvEasting);
+    memory_free64f(&utmRecvNorthing);
+    memory_free64f(&utmSrcEastings);
+    memory_free64f(&utmSrcNorthings);
+    memory_free64f(&M);
+    memory_free64f(&VR);
+    memory_free64f(&iqr);
+    memory_free64f(&Uest);
+    memory_free64f(&srdist);
+    memory_free64f(&M1);
+    memory_free64f(&VR1);
+    memory_free64f(&iqr1);
+    memory_free64f(&Uest1);
+    memory_free64f(&srdist1);
+    core_scaling_pgd_finalizeResults(&pgd);
+    core_scaling_pgd_finalizeData(&pgd_data);
+    core_scaling_pgd_finalizeResults(&pgd_ref);
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
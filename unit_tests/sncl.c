@@ -0,0 +1,78 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "gfast.h"
+
+int sncl_index_test(void);
+
+int sncl_index_test(void)
+{
+    struct snclIndex_struct snclIndex;
+    char stnm[64];
+    const char *chans[3] = {"LYZ\0", "LYN\0", "LYE\0"};
+    const int nsta = 2000;
+    int i, id, ierr, j;
+    //------------------------------------------------------------------------//
+    ierr = GFAST_traceBuffer_sncl_initialize(3*nsta, &snclIndex);
+    if (ierr != 0)
+    {
+        LOG_ERRMSG("%s", "Failed to initialize SNCL index");
+        return EXIT_FAILURE;
+    }
+    // Ids must be dense and in order of insertion
+    for (i=0; i<nsta; i++)
+    {
+        sprintf(stnm, "S%04d", i);
+        for (j=0; j<3; j++)
+        {
+            id = GFAST_traceBuffer_sncl_insert("UW\0", stnm, chans[j],
+                                               "--\0", &snclIndex);
+            if (id != 3*i + j)
+            {
+                LOG_ERRMSG("Wrong id %d %d", id, 3*i + j);
+                return EXIT_FAILURE;
+            }
+        }
+    }
+    // Re-inserting returns the existing id
+    id = GFAST_traceBuffer_sncl_insert("UW\0", "S0007\0", "LYN\0", "--\0",
+                                       &snclIndex);
+    if (id != 22 || snclIndex.nids != 3*nsta)
+    {
+        LOG_ERRMSG("Duplicate insert failed %d %d", id, snclIndex.nids);
+        return EXIT_FAILURE;
+    }
+    // Lookups are case insensitive
+    id = GFAST_traceBuffer_sncl_find("uw\0", "s1999\0", "lye\0", "--\0",
+                                     &snclIndex);
+    if (id != 3*1999 + 2)
+    {
+        LOG_ERRMSG("Failed to find SNCL %d", id);
+        return EXIT_FAILURE;
+    }
+    id = GFAST_traceBuffer_sncl_findKey("UW.S0100.LYZ.--\0", &snclIndex);
+    if (id != 300)
+    {
+        LOG_ERRMSG("Failed to find key %d", id);
+        return EXIT_FAILURE;
+    }
+    // Unknown SNCLs aren't found
+    if (GFAST_traceBuffer_sncl_find("CI\0", "S0001\0", "LYZ\0", "--\0",
+                                    &snclIndex) !=-1 ||
+        GFAST_traceBuffer_sncl_find("UW\0", "S0001\0", "LYZ\0", "00\0",
+                                    &snclIndex) !=-1)
+    {
+        LOG_ERRMSG("%s", "Found a SNCL that doesn't exist");
+        return EXIT_FAILURE;
+    }
+    // The index is full
+    if (GFAST_traceBuffer_sncl_insert("UW\0", "NEW\0", "LYZ\0", "--\0",
+                                      &snclIndex) !=-1)
+    {
+        LOG_ERRMSG("%s", "Inserted into a full index");
+        return EXIT_FAILURE;
+    }
+    GFAST_traceBuffer_sncl_finalize(&snclIndex);
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}
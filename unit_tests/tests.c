@@ -2,16 +2,29 @@
 #include <stdlib.h>
 
 int coord_test_ll2utm(void);
+int coord_test_ll2utm_batch(void);
 int pgd_inversion_test(void);
 int pgd_inversion_test2(void);
+int pgd_evaluateDepth_test(void);
+int pgd_interquartileRange_test(void);
+int pgd_gridSearch_test(void);
 int cmopad_test(int verb);
 int readCoreInfo_test(void);
+int sncl_index_test(void);
+int unpack_kernels_test(void);
 int cmt_greens_test(void);
 int cmt_inversion_test(void);
+int cmt_cachedDepthGridSearch_test(void);
+int cmt_gridSearch_test(void);
+int cmt_adaptiveGridSearch_test(void);
 int ff_greens_test(void);
+int ff_okadaReference_test(void);
 int ff_meshPlane_test(void);
 int ff_regularizer_test(void);
 int ff_inversion_test(void);
+int ff_greensCache_test(void);
+int ff_cgls_test(void);
+int ff_covariance_test(void);
 
 int main()
 {
@@ -44,6 +57,27 @@ int main()
         return EXIT_FAILURE;
     }
 
+    ierr = coord_test_ll2utm_batch();
+    if (ierr != 0)
+    {
+        printf("%s: Failed the batch latlon 2 utm test!\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    ierr = sncl_index_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed the SNCL index test!\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    ierr = unpack_kernels_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed the tracebuf2 unpack kernels test!\n", __func__);
+        return EXIT_FAILURE;
+    }
+
 /*
     ierr = cmopad_test(0);
     if (ierr != 0)
@@ -72,6 +106,13 @@ int main()
         return EXIT_FAILURE;
     }
 
+    ierr = ff_okadaReference_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed the ff Okada reference test\n", __func__);
+        return EXIT_FAILURE;
+    }
+
     ierr = ff_meshPlane_test();
     if (ierr != 0)
     {
@@ -103,6 +144,25 @@ int main()
         return EXIT_FAILURE;
     }
 
+    ierr = pgd_evaluateDepth_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed PGD closed form depth test\n", __func__);
+        return EXIT_FAILURE;
+    }
+    ierr = pgd_interquartileRange_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed PGD interquartile range test\n", __func__);
+        return EXIT_FAILURE;
+    }
+    ierr = pgd_gridSearch_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed PGD grid search test\n", __func__);
+        return EXIT_FAILURE;
+    }
+
     ierr = cmt_inversion_test();
     if (ierr != 0)
     {
@@ -110,12 +170,54 @@ int main()
         return EXIT_FAILURE;
     }
 
+    ierr = cmt_cachedDepthGridSearch_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed CMT cached depth grid search test\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    ierr = cmt_gridSearch_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed CMT grid search test\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    ierr = cmt_adaptiveGridSearch_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed CMT adaptive grid search test\n", __func__);
+        return EXIT_FAILURE;
+    }
+
     ierr = ff_inversion_test();
     if (ierr != 0)
     {
         printf("%s: Failed FF Inversion test\n", __func__);
         return EXIT_FAILURE;
     }
+
+    ierr = ff_greensCache_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed FF Green's function cache test\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    ierr = ff_cgls_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed FF CGLS slip solver test\n", __func__);
+        return EXIT_FAILURE;
+    }
+
+    ierr = ff_covariance_test();
+    if (ierr != 0)
+    {
+        printf("%s: Failed FF slip covariance test\n", __func__);
+        return EXIT_FAILURE;
+    }
     printf("%s: All tests passed\n", __func__);
     return EXIT_SUCCESS;
 }
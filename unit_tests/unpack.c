@@ -0,0 +1,129 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <math.h>
+#include "gfast.h"
+
+int unpack_kernels_test(void);
+
+/*!
+ * @brief Compares every compiled tracebuf2 sample decoding kernel against
+ *        the scalar kernel for both sample sizes, both byte orders, and
+ *        all tail lengths of the vector loops.
+ *
+ * @result EXIT_SUCCESS indicates success
+ *
+ */
+int unpack_kernels_test(void)
+{
+#ifdef GFAST_USE_EW
+    const enum tb2Unpack_kernel kernels[3] = {TB2_UNPACK_AUTO,
+                                              TB2_UNPACK_SSE41,
+                                              TB2_UNPACK_AVX2};
+    const int maxpts = 67;
+    const int nguard = 8;
+    const double t0 = 1.5e9 + 0.25;
+    const double dt = 0.2;
+    char *msg;
+    double *times, *times0;
+    int *resp, *resp0, dtype, i, ierr, ik, lswap, npts, ntested;
+    uint32_t state;
+    size_t nbytes;
+    //------------------------------------------------------------------------//
+    nbytes = sizeof(TRACE2_HEADER) + 4*(size_t) maxpts;
+    msg = (char *) calloc(nbytes, sizeof(char));
+    resp = (int *) calloc((size_t) (maxpts + nguard), sizeof(int));
+    resp0 = (int *) calloc((size_t) (maxpts + nguard), sizeof(int));
+    times = (double *) calloc((size_t) (maxpts + nguard), sizeof(double));
+    times0 = (double *) calloc((size_t) (maxpts + nguard), sizeof(double));
+    // Fill the samples with bytes that exercise the sign bits
+    state = 12345;
+    for (i=(int) sizeof(TRACE2_HEADER); i<(int) nbytes; i++)
+    {
+        state = state*1103515245u + 12345u;
+        msg[i] = (char) (state >> 24);
+    }
+    ntested = 0;
+    for (ik=0; ik<3; ik++)
+    {
+        for (dtype=2; dtype<=4; dtype=dtype+2)
+        {
+            for (lswap=0; lswap<2; lswap++)
+            {
+                for (npts=0; npts<=maxpts; npts++)
+                {
+                    for (i=0; i<maxpts+nguard; i++)
+                    {
+                        resp[i] =-7;
+                        resp0[i] =-7;
+                        times[i] =-7.0;
+                        times0[i] =-7.0;
+                    }
+                    ierr = traceBuffer_ewrr_unpackSamples(TB2_UNPACK_SCALAR,
+                                                          npts, lswap, dtype,
+                                                          t0, dt, msg,
+                                                          resp0, times0);
+                    if (ierr != 0)
+                    {
+                        LOG_ERRMSG("%s", "Error unpacking scalar samples");
+                        goto ERROR;
+                    }
+                    ierr = traceBuffer_ewrr_unpackSamples(kernels[ik],
+                                                          npts, lswap, dtype,
+                                                          t0, dt, msg,
+                                                          resp, times);
+                    // Kernel is not compiled or not supported by this CPU
+                    if (ierr == 1){break;}
+                    if (ierr != 0)
+                    {
+                        LOG_ERRMSG("Error unpacking with kernel %d", ik);
+                        goto ERROR;
+                    }
+                    // Includes the guard samples past npts.  The tails
+                    // restart the times from a shifted t0 so allow a few
+                    // ulps at epochal times.
+                    for (i=0; i<maxpts+nguard; i++)
+                    {
+                        if (resp[i] != resp0[i] ||
+                            fabs(times[i] - times0[i]) > 1.e-6)
+                        {
+                            LOG_ERRMSG("Kernel %d differs: %d %d %d %d",
+                                       ik, dtype, lswap, npts, i);
+                            ierr = 1;
+                            goto ERROR;
+                        }
+                    }
+                    ntested = ntested + 1;
+                }
+            }
+        }
+    }
+    // The scalar kernel must handle the byte orders correctly
+    memset(&msg[sizeof(TRACE2_HEADER)], 0, 4);
+    msg[sizeof(TRACE2_HEADER)+0] = 0x01;
+    msg[sizeof(TRACE2_HEADER)+1] = 0x02;
+    ierr = traceBuffer_ewrr_unpackSamples(TB2_UNPACK_SCALAR, 1, 0, 2,
+                                          t0, dt, msg, resp0, times0);
+    ierr += traceBuffer_ewrr_unpackSamples(TB2_UNPACK_SCALAR, 1, 1, 2,
+                                           t0, dt, msg, resp, times);
+    if (ierr != 0 || resp0[0] + resp[0] != 0x0201 + 0x0102 ||
+        resp0[0] == resp[0])
+    {
+        LOG_ERRMSG("%s", "Error byte swapping 2 byte samples");
+        ierr = 1;
+        goto ERROR;
+    }
+    LOG_INFOMSG("Compared %d kernel unpacks", ntested);
+    ierr = 0;
+ERROR:;
+    free(msg);
+    free(resp);
+    free(resp0);
+    free(times);
+    free(times0);
+    if (ierr != 0){return EXIT_FAILURE;}
+#endif
+    LOG_INFOMSG("%s", "Success!");
+    return EXIT_SUCCESS;
+}